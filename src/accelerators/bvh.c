@@ -11,13 +11,13 @@
 
 #include "../renderer/pathtrace.h"
 
-#include "../datatypes/vertexbuffer.h"
 #include "../datatypes/poly.h"
 #include "../datatypes/vector.h"
 #include "../datatypes/bbox.h"
 #include "../datatypes/lightRay.h"
 #include "../datatypes/mesh.h"
 #include "../datatypes/instance.h"
+#include "../utils/statistics.h"
 
 /*
  * This BVH builder is based on "On fast Construction of SAH-based Bounding Volume Hierarchies",
@@ -44,6 +44,7 @@ struct bvh {
 	struct bvhNode* nodes;
 	int *primIndices;
 	unsigned nodeCount;
+	bool ownsArrays; // False if the arrays point into a mapped mesh file
 };
 
 // Bin used to approximate the SAH.
@@ -107,21 +108,21 @@ static inline unsigned partitionPrimitiveIndices(
 				break;
 			i++;
 		}
-
+		
 		while (i < j) {
 			unsigned binIndex = computeBinIndex(axis, &centers[bvh->primIndices[j - 1]], node->bounds[axis * 2], node->bounds[axis * 2 + 1]);
 			if (binIndex < bin)
 				break;
 			j--;
 		}
-
+		
 		if (i >= j)
 			break;
-
+		
 		int tmp = bvh->primIndices[j - 1];
 		bvh->primIndices[j - 1] = bvh->primIndices[i];
 		bvh->primIndices[i] = tmp;
-
+		
 		j--;
 		i++;
 	}
@@ -138,12 +139,12 @@ static void buildBvhRecursive(
 {
 	unsigned primCount = end - begin;
 	struct bvhNode *node = &bvh->nodes[nodeId];
-
+	
 	if (depth >= MAX_BVH_DEPTH || primCount < 2) {
 		makeLeaf(node, begin, primCount);
 		return;
 	}
-
+	
 	Bin bins[3][BIN_COUNT];
 	float minCost[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
 	unsigned minBin[3] = { 1, 1, 1 };
@@ -153,7 +154,7 @@ static void buildBvhRecursive(
 			bins[axis][i].bbox = emptyBBox;
 			bins[axis][i].count = 0;
 		}
-
+		
 		// Fill bins with primitives
 		for (unsigned i = begin; i < end; ++i) {
 			int primIndex = bvh->primIndices[i];
@@ -162,7 +163,7 @@ static void buildBvhRecursive(
 			extendBBox(&bin->bbox, &bboxes[primIndex]);
 			bin->count++;
 		}
-
+		
 		// Sweep from the right to the left to compute the partial SAH cost.
 		// Recall that the SAH is the sum of two parts: SA(left) * N(left) + SA(right) * N(right).
 		// This loop computes SA(right) * N(right) alone.
@@ -174,7 +175,7 @@ static void buildBvhRecursive(
 			extendBBox(&curBBox, &bin->bbox);
 			bin->cost = curCount * bboxHalfArea(&curBBox);
 		}
-
+		
 		// Sweep from the left to the right to compute the full cost and find the minimum.
 		curBBox = emptyBBox;
 		curCount = 0;
@@ -189,12 +190,12 @@ static void buildBvhRecursive(
 			}
 		}
 	}
-
+	
 	// Find the minimum cost for all three axes
 	unsigned minAxis = 0;
 	if (minCost[1] < minCost[0]) minAxis = 1;
 	if (minCost[2] < minCost[minAxis]) minAxis = 2;
-
+	
 	// Determine if splitting is beneficial or not
 	float leafCost = nodeArea(node) * (primCount - TRAVERSAL_COST);
 	if (minCost[minAxis] > leafCost) {
@@ -213,14 +214,14 @@ static void buildBvhRecursive(
 			return;
 		}
 	}
-
+	
 	// Perform the split by partitioning primitive indices in-place
 	unsigned beginRight = partitionPrimitiveIndices(node, bvh, centers, minAxis, minBin[minAxis], begin, end);
 	if (beginRight > begin) {
 		unsigned leftIndex = bvh->nodeCount;
 		unsigned rightIndex = leftIndex + 1;
 		bvh->nodeCount += 2;
-
+		
 		// Compute the bounding box of the children
 		struct boundingBox leftBBox = emptyBBox;
 		struct boundingBox rightBBox = emptyBBox;
@@ -232,7 +233,7 @@ static void buildBvhRecursive(
 		storeBBoxInNode(&bvh->nodes[rightIndex], &rightBBox);
 		node->firstChildOrPrim = leftIndex;
 		node->isLeaf = false;
-
+		
 		buildBvhRecursive(leftIndex, bvh, bboxes, centers, begin, beginRight, depth + 1);
 		buildBvhRecursive(rightIndex, bvh, bboxes, centers, beginRight, end, depth + 1);
 	} else {
@@ -251,14 +252,15 @@ static inline struct bvh *buildBvhGeneric(
 		bvh->nodeCount = 0;
 		bvh->nodes = NULL;
 		bvh->primIndices = NULL;
+		bvh->ownsArrays = true;
 		return bvh;
 	}
 	struct vector *centers = malloc(sizeof(struct vector) * count);
 	struct boundingBox *bboxes = malloc(sizeof(struct boundingBox) * count);
 	int *primIndices = malloc(sizeof(int) * count);
-
+	
 	struct boundingBox rootBBox = emptyBBox;
-
+	
 	// Precompute bboxes and centers
 	for (unsigned i = 0; i < count; ++i) {
 		getBBoxAndCenter(userData, i, &bboxes[i], &centers[i]);
@@ -266,18 +268,20 @@ static inline struct bvh *buildBvhGeneric(
 		rootBBox.min = vecMin(rootBBox.min, bboxes[i].min);
 		rootBBox.max = vecMax(rootBBox.max, bboxes[i].max);
 	}
-
+	
 	// Binary tree property: total number of nodes (inner + leaves) = 2 * number of leaves - 1
 	unsigned maxNodes = 2 * count - 1;
-
+	
 	struct bvh *bvh = malloc(sizeof(struct bvh));
 	bvh->nodeCount = 1;
-	bvh->nodes = malloc(sizeof(struct bvhNode) * maxNodes);
+	// Zeroed, so inner nodes and padding have no stale bytes when the nodes are written to a mesh file
+	bvh->nodes = calloc(maxNodes, sizeof(struct bvhNode));
 	bvh->primIndices = primIndices;
+	bvh->ownsArrays = true;
 	storeBBoxInNode(&bvh->nodes[0], &rootBBox);
-
+	
 	buildBvhRecursive(0, bvh, bboxes, centers, 0, count, 0);
-
+	
 	// Shrink array of nodes (since some leaves may contain more than 1 primitive)
 	bvh->nodes = realloc(bvh->nodes, sizeof(struct bvhNode) * bvh->nodeCount);
 	free(centers);
@@ -285,11 +289,17 @@ static inline struct bvh *buildBvhGeneric(
 	return bvh;
 }
 
+struct polyBvhInput {
+	const struct vector *vertices;
+	const struct poly *polys;
+};
+
 static void getPolyBBoxAndCenter(void *userData, unsigned i, struct boundingBox *bbox, struct vector *center) {
-	struct poly *polys = userData;
-	struct vector v0 = g_vertices[polys[i].vertexIndex[0]];
-	struct vector v1 = g_vertices[polys[i].vertexIndex[1]];
-	struct vector v2 = g_vertices[polys[i].vertexIndex[2]];
+	const struct polyBvhInput *input = userData;
+	const struct poly *p = &input->polys[i];
+	struct vector v0 = input->vertices[p->vertexIndex[0]];
+	struct vector v1 = input->vertices[p->vertexIndex[1]];
+	struct vector v2 = input->vertices[p->vertexIndex[2]];
 	*center = getMidPoint(v0, v1, v2);
 	bbox->min = vecMin(v0, vecMin(v1, v2));
 	bbox->max = vecMax(v0, vecMax(v1, v2));
@@ -301,8 +311,9 @@ struct boundingBox getRootBoundingBox(const struct bvh *bvh) {
 	return box;
 }
 
-struct bvh *buildBottomLevelBvh(struct poly *polys, unsigned count) {
-	return buildBvhGeneric(polys, getPolyBBoxAndCenter, count);
+struct bvh *buildBottomLevelBvh(const struct vector *vertices, const struct poly *polys, unsigned count) {
+	struct polyBvhInput input = {vertices, polys};
+	return buildBvhGeneric(&input, getPolyBBoxAndCenter, count);
 }
 
 static void getInstanceBBoxAndCenter(void *userData, unsigned i, struct boundingBox *bbox, struct vector *center) {
@@ -353,17 +364,18 @@ static inline bool intersectNode(
 static inline bool traverseBvhGeneric(
 	void* userData,
 	const struct bvh *bvh,
-	bool (*intersectLeaf)(void*, const struct bvh*, const struct bvhNode*, const struct lightRay*, struct hitRecord*),
+	bool (*intersectLeaf)(void*, const struct bvh*, const struct bvhNode*, const struct lightRay*, struct hit*, struct stats*),
 	const struct lightRay *ray,
-	struct hitRecord *isect)
+	struct hit *hit,
+	struct stats *stats)
 {
 	if (bvh->nodeCount < 1) {
-		isect->instIndex = -1;
+		hit->instIndex = -1;
 		return false;
 	}
 	const struct bvhNode *stack[MAX_BVH_DEPTH + 1];
 	int stackSize = 0;
-
+	
 	// Precompute ray octant and inverse direction
 	int octant[] = {
 		ray->direction.x < 0 ? 1 : 0,
@@ -372,51 +384,54 @@ static inline bool traverseBvhGeneric(
 	};
 	struct vector invDir = { 1.0f / ray->direction.x, 1.0f / ray->direction.y, 1.0f / ray->direction.z };
 	struct vector scaledStart = vecScale(vecMul(ray->start, invDir), -1.0f);
-	float maxDist = isect->distance;
+	float maxDist = hit->distance;
 	
 	if (bvh->nodeCount < 1) return false;
-
+	
 	// Special case when the BVH is just a single leaf
 	if (bvh->nodeCount == 1) {
 		float tEntry;
+		stats_add(stats, bvh_nodes_visited, 1);
 		if (intersectNode(bvh->nodes, &invDir, &scaledStart, octant, maxDist, &tEntry))
-			return intersectLeaf(userData, bvh, bvh->nodes, ray, isect);
+			return intersectLeaf(userData, bvh, bvh->nodes, ray, hit, stats);
 		return false;
 	}
-
+	
 	const struct bvhNode *node = bvh->nodes;
 	bool hasHit = false;
+	unsigned nodesVisited = 0;
 	while (true) {
 		unsigned firstChild = node->firstChildOrPrim;
 		const struct bvhNode *leftNode  = &bvh->nodes[firstChild];
 		const struct bvhNode *rightNode = &bvh->nodes[firstChild + 1];
-
+		
 		float tEntryLeft, tEntryRight;
 		bool hitLeft = intersectNode(leftNode, &invDir, &scaledStart, octant, maxDist, &tEntryLeft);
 		bool hitRight = intersectNode(rightNode, &invDir, &scaledStart, octant, maxDist, &tEntryRight);
-
+		nodesVisited += 2;
+		
 		if (hitLeft) {
 			if (unlikely(leftNode->isLeaf)) {
-				if (intersectLeaf(userData, bvh, leftNode, ray, isect)) {
-					maxDist = isect->distance;
+				if (intersectLeaf(userData, bvh, leftNode, ray, hit, stats)) {
+					maxDist = hit->distance;
 					hasHit = true;
 				}
 				leftNode = NULL;
 			}
 		} else
 			leftNode = NULL;
-
+		
 		if (hitRight) {
 			if (unlikely(rightNode->isLeaf)) {
-				if (intersectLeaf(userData, bvh, rightNode, ray, isect)) {
-					maxDist = isect->distance;
+				if (intersectLeaf(userData, bvh, rightNode, ray, hit, stats)) {
+					maxDist = hit->distance;
 					hasHit = true;
 				}
 				rightNode = NULL;
 			}
 		} else
 			rightNode = NULL;
-
+		
 		if ((rightNode != NULL) & (leftNode != NULL)) {
 			// Choose the child that is the closest, and push the other on the stack.
 			if (tEntryLeft > tEntryRight) {
@@ -435,6 +450,7 @@ static inline bool traverseBvhGeneric(
 			node = stack[--stackSize];
 		}
 	}
+	stats_add(stats, bvh_nodes_visited, nodesVisited);
 	return hasHit;
 }
 
@@ -443,22 +459,24 @@ static inline bool intersectBottomLevelLeaf(
 	const struct bvh *bvh,
 	const struct bvhNode *leaf,
 	const struct lightRay *ray,
-	struct hitRecord *isect)
+	struct hit *hit,
+	struct stats *stats)
 {
-	struct poly *polygons = userData;
+	const struct mesh *mesh = userData;
+	stats_add(stats, triangle_tests, leaf->primCount);
 	bool found = false;
 	for (int i = 0; i < leaf->primCount; ++i) {
-		struct poly *p = &polygons[bvh->primIndices[leaf->firstChildOrPrim + i]];
-		if (rayIntersectsWithPolygon(ray, p, isect)) {
-			isect->polygon = p;
+		const struct triangle *p = &mesh->polygons[bvh->primIndices[leaf->firstChildOrPrim + i]];
+		if (rayIntersectsWithPolygon(ray, mesh->vertices, p, hit)) {
+			hit->polygon = p;
 			found = true;
 		}
 	}
 	return found;
 }
 
-bool traverseBottomLevelBvh(const struct mesh *mesh, const struct lightRay *ray, struct hitRecord *isect) {
-	return traverseBvhGeneric(mesh->polygons, mesh->bvh, intersectBottomLevelLeaf, ray, isect);
+bool traverseBottomLevelBvh(const struct mesh *mesh, const struct lightRay *ray, struct hit *hit, struct stats *stats) {
+	return traverseBvhGeneric((void*)mesh, mesh->bvh, intersectBottomLevelLeaf, ray, hit, stats);
 }
 
 static inline bool intersectTopLevelLeaf(
@@ -466,14 +484,15 @@ static inline bool intersectTopLevelLeaf(
 	const struct bvh *bvh,
 	const struct bvhNode *leaf,
 	const struct lightRay *ray,
-	struct hitRecord *isect)
+	struct hit *hit,
+	struct stats *stats)
 {
 	const struct instance *instances = userData;
 	bool found = false;
 	for (int i = 0; i < leaf->primCount; ++i) {
 		int currIndex = bvh->primIndices[leaf->firstChildOrPrim + i];
-		if (instances[currIndex].intersectFn(&instances[currIndex], ray, isect)) {
-			isect->instIndex = currIndex;
+		if (instances[currIndex].intersectFn(&instances[currIndex], ray, hit, stats)) {
+			hit->instIndex = currIndex;
 			found = true;
 		}
 	}
@@ -484,15 +503,81 @@ bool traverseTopLevelBvh(
 	const struct instance *instances,
 	const struct bvh *bvh,
 	const struct lightRay *ray,
-	struct hitRecord *isect)
+	struct hit *hit,
+	struct stats *stats)
 {
-	return traverseBvhGeneric((void*)instances, bvh, intersectTopLevelLeaf, ray, isect);
+	return traverseBvhGeneric((void*)instances, bvh, intersectTopLevelLeaf, ray, hit, stats);
+}
+
+size_t bvhNodeSize(void) {
+	return sizeof(struct bvhNode);
+}
+
+unsigned getBvhArrays(const struct bvh *bvh, const void **nodes, const int **primIndices) {
+	*nodes = bvh->nodes;
+	*primIndices = bvh->primIndices;
+	return bvh->nodeCount;
+}
+
+struct bvh *bvhFromArrays(const void *nodes, unsigned nodeCount, const int *primIndices, unsigned primCount) {
+	// Check the arrays index each other correctly, so a damaged file can't send the traversal out of bounds.
+	// The traversal treats the root as an inner node unless it's the only one.
+	const struct bvhNode *nodeArray = nodes;
+	if (!nodeCount || nodeArray[0].isLeaf != (nodeCount == 1)) return NULL;
+	// Children always come after their parent, so nodes can't form cycles, and depths are final by the time we reach them.
+	// The traversal stack holds one node per level.
+	unsigned char *depths = calloc(nodeCount, sizeof(*depths));
+	bool valid = true;
+	for (unsigned i = 0; i < nodeCount && valid; ++i) {
+		const struct bvhNode *node = &nodeArray[i];
+		if (node->isLeaf) {
+			valid = (uint64_t)node->firstChildOrPrim + node->primCount <= primCount;
+		} else {
+			valid = node->firstChildOrPrim > i && (uint64_t)node->firstChildOrPrim + 1 < nodeCount && depths[i] < MAX_BVH_DEPTH;
+			if (valid) {
+				depths[node->firstChildOrPrim] = max(depths[node->firstChildOrPrim], depths[i] + 1);
+				depths[node->firstChildOrPrim + 1] = max(depths[node->firstChildOrPrim + 1], depths[i] + 1);
+			}
+		}
+	}
+	free(depths);
+	if (!valid) return NULL;
+	for (unsigned i = 0; i < primCount; ++i) {
+		if (primIndices[i] < 0 || (unsigned)primIndices[i] >= primCount) return NULL;
+	}
+	struct bvh *bvh = malloc(sizeof(struct bvh));
+	bvh->nodes = (struct bvhNode *)nodes;
+	bvh->primIndices = (int *)primIndices;
+	bvh->nodeCount = nodeCount;
+	bvh->ownsArrays = false;
+	return bvh;
 }
 
+#ifdef CRAY_TESTING
+// Not in bvh.h. The kernel micro-benchmarks use this to time intersectNode() on its own,
+// without the traversal logic around it. Returns the amount of nodes tested.
+unsigned intersectAllNodes(const struct bvh *bvh, const struct lightRay *ray, unsigned *hits) {
+	int octant[] = {
+		ray->direction.x < 0 ? 1 : 0,
+		ray->direction.y < 0 ? 1 : 0,
+		ray->direction.z < 0 ? 1 : 0
+	};
+	struct vector invDir = { 1.0f / ray->direction.x, 1.0f / ray->direction.y, 1.0f / ray->direction.z };
+	struct vector scaledStart = vecScale(vecMul(ray->start, invDir), -1.0f);
+	for (unsigned i = 0; i < bvh->nodeCount; ++i) {
+		float tEntry;
+		*hits += intersectNode(&bvh->nodes[i], &invDir, &scaledStart, octant, FLT_MAX, &tEntry);
+	}
+	return bvh->nodeCount;
+}
+#endif
+
 void destroyBvh(struct bvh *bvh) {
 	if (bvh) {
-		if (bvh->nodes) free(bvh->nodes);
-		if (bvh->primIndices) free(bvh->primIndices);
+		if (bvh->ownsArrays) {
+			if (bvh->nodes) free(bvh->nodes);
+			if (bvh->primIndices) free(bvh->primIndices);
+		}
 		free(bvh);
 	}
 }
@@ -9,13 +9,16 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stddef.h>
 
 struct lightRay;
-struct hitRecord;
+struct vector;
+struct hit;
 struct mesh;
 struct poly;
 struct instance;
 struct boundingBox;
+struct stats;
 
 struct bvh;
 
@@ -23,9 +26,10 @@ struct bvh;
 struct boundingBox getRootBoundingBox(const struct bvh *bvh);
 
 /// Builds a BVH for a given set of polygons
-/// @param polygons Array of polygons to process
+/// @param vertices Vertex array the polygon vertex indices point into
+/// @param polys Array of polygons to process
 /// @param count Amount of polygons given
-struct bvh *buildBottomLevelBvh(struct poly *polys, unsigned count);
+struct bvh *buildBottomLevelBvh(const struct vector *vertices, const struct poly *polys, unsigned count);
 
 /// Builds a top-level BVH for a given set of instances
 /// @param instances Instances to build a top-level BVH for
@@ -33,9 +37,24 @@ struct bvh *buildBottomLevelBvh(struct poly *polys, unsigned count);
 struct bvh *buildTopLevelBvh(struct instance *instances, unsigned instanceCount);
 
 /// Intersect a ray with a scene top-level BVH
-bool traverseTopLevelBvh(const struct instance *instances, const struct bvh *bvh, const struct lightRay *ray, struct hitRecord *isect);
+bool traverseTopLevelBvh(const struct instance *instances, const struct bvh *bvh, const struct lightRay *ray, struct hit *hit, struct stats *stats);
 
-bool traverseBottomLevelBvh(const struct mesh *mesh, const struct lightRay *ray, struct hitRecord *isect);
+bool traverseBottomLevelBvh(const struct mesh *mesh, const struct lightRay *ray, struct hit *hit, struct stats *stats);
+
+/// Size of one BVH node in bytes. Stored BVHs with a different node size can't be used.
+size_t bvhNodeSize(void);
+
+/// Get the arrays of a BVH, for storing it in a file
+/// @param nodes Set to the node array
+/// @param primIndices Set to the primitive index array, one index per primitive
+/// @return Amount of nodes
+unsigned getBvhArrays(const struct bvh *bvh, const void **nodes, const int **primIndices);
+
+/// Wrap arrays stored with getBvhArrays() in a BVH, without copying them
+/// @param primCount Amount of primitives the BVH was built for
+/// @return New BVH, or NULL if the arrays are inconsistent
+/// @note The arrays are not freed with the BVH, and have to outlive it
+struct bvh *bvhFromArrays(const void *nodes, unsigned nodeCount, const int *primIndices, unsigned primCount);
 
 /// Frees the memory allocated by the given BVH
 void destroyBvh(struct bvh *);
@@ -24,6 +24,11 @@
 #include "utils/encoders/encoder.h"
 #include <stdarg.h>
 #include "utils/string.h"
+#include "utils/benchmark.h"
+#include "utils/networking.h"
+#include "utils/loaders/crmesh.h"
+#include "datatypes/animation.h"
+#include "renderer/denoise.h"
 
 #define VERSION "0.6.3"
 
@@ -69,6 +74,19 @@ char *crGetFilePath(char *fullPath) {
 	return getFilePath(fullPath);
 }
 
+//Write the noisy frame and feature buffers next to the image, e.g. rendered_albedo_0000.png
+static void writeFeatureImages(const struct imageFile *image) {
+	for (enum featureType type = featureNoisy; type <= featureDepth; ++type) {
+		if (type == featureNoisy && !g_renderer->prefs.denoise) continue; //Same as the image
+		char *fileName = concatString(image->fileName, featureSuffix(type));
+		struct imageFile *file = newImageFile(featureImage(g_renderer, type), image->filePath, fileName, image->count, image->type);
+		file->info = image->info;
+		writeImage(file);
+		destroyImageFile(file);
+		free(fileName);
+	}
+}
+
 void crWriteImage() {
 	if (currentImage) {
 		if (g_renderer->state.saveImage) {
@@ -82,7 +100,9 @@ void crWriteImage() {
 				.threadCount = crGetThreadCount()
 			};
 			writeImage(file);
+			if (g_renderer->prefs.writeAovs) writeFeatureImages(file);
 			destroyImageFile(file);
+			currentImage = NULL; //Freed along with the image file
 		} else {
 			logr(info, "Abort pressed, image won't be saved.\n");
 		}
@@ -254,6 +274,23 @@ bool crGetAntialiasing() {
 	return g_renderer->prefs.antialiasing;
 }
 
+int crRunBenchmark() {
+	return runBenchmark();
+}
+
+int crStartWorker() {
+	return startWorker(intPref("worker_port"));
+}
+
+int crConvertMesh() {
+	return convertMesh(stringPref("convert_input"), isSet("convert_output") ? stringPref("convert_output") : NULL);
+}
+
+void crSetProgressCallback(void (*callback)(float progress, void *userData), void *userData) {
+	g_renderer->state.progressCallback = callback;
+	g_renderer->state.progressUserData = userData;
+}
+
 void crRenderSingleFrame() {
 	initDisplay(g_renderer->prefs.fullscreen, g_renderer->prefs.borderless, g_renderer->prefs.imageWidth, g_renderer->prefs.imageHeight, g_renderer->prefs.scale);
 	startTimer(g_renderer->state.timer);
@@ -262,6 +299,34 @@ void crRenderSingleFrame() {
 	destroyDisplay();
 }
 
+int crGetFrameCount() {
+	struct animation *animation = g_renderer->scene->animation;
+	return animation ? animation->frameCount : 1;
+}
+
+void crRenderAnimation() {
+	int frameCount = crGetFrameCount();
+	int firstImage = g_renderer->prefs.imgCount;
+	struct timeval timer = {0};
+	startTimer(&timer);
+	initDisplay(g_renderer->prefs.fullscreen, g_renderer->prefs.borderless, g_renderer->prefs.imageWidth, g_renderer->prefs.imageHeight, g_renderer->prefs.scale);
+	int frame = 0;
+	for (; frame < frameCount; ++frame) {
+		setAnimationFrame(g_renderer, frame);
+		g_renderer->prefs.imgCount = firstImage + frame;
+		startTimer(g_renderer->state.timer);
+		destroyTexture(currentImage);
+		currentImage = renderFrame(g_renderer);
+		printDuration(getMs(*g_renderer->state.timer));
+		crWriteImage();
+		if (!g_renderer->state.saveImage) break;
+	}
+	destroyDisplay();
+	char duration[64];
+	smartTime(getMs(timer), duration);
+	logr(info, "Rendered %i frames in %s\n", frame, duration);
+}
+
 //Interactive mode
 void crStartInteractive(void) {
 	ASSERT_NOT_REACHED();
@@ -86,6 +86,22 @@ bool crGetAntialiasing(void);
 //Single frame
 void crRenderSingleFrame(void);
 
+//Scenes with an "animation" section have more than one frame
+int crGetFrameCount(void);
+void crRenderAnimation(void); //Render and write out all frames, keeping the scene loaded in between
+
+//Render the bundled benchmark scenes and print results as JSON. Doesn't need crInitRenderer()
+int crRunBenchmark(void);
+
+//Run as a network render worker for a master started with --nodes. Doesn't need crInitRenderer()
+int crStartWorker(void);
+
+//Convert the mesh given with --convert to a .crmesh file. Doesn't need crInitRenderer()
+int crConvertMesh(void);
+
+//Called from the render main loop with progress in [0,1] whenever a tile finishes and on status updates
+void crSetProgressCallback(void (*callback)(float progress, void *userData), void *userData);
+
 //Interactive mode
 void crStartInteractive(void);
 void crPauseInteractive(void); //Toggle paused state
@@ -0,0 +1,74 @@
+//
+//  animation.c
+//  C-ray
+//
+//  Created by Valtteri on 18.10.2020.
+//  Copyright © 2020 Valtteri Koskivuori. All rights reserved.
+//
+
+#include "../includes.h"
+#include "animation.h"
+
+static int compareKeys(const void *a, const void *b) {
+	return ((const struct keyframe *)a)->frame - ((const struct keyframe *)b)->frame;
+}
+
+void sortKeys(struct track *track) {
+	qsort(track->keys, track->keyCount, sizeof(*track->keys), compareKeys);
+}
+
+static bool keysMatch(const struct keyframe *a, const struct keyframe *b) {
+	if (a->transformCount != b->transformCount) return false;
+	for (size_t i = 0; i < a->transformCount; ++i) {
+		if (a->transforms[i].type != b->transforms[i].type) return false;
+	}
+	return true;
+}
+
+static struct transform composeKey(const struct transformParams *params, size_t count) {
+	struct transform *tforms = calloc(count, sizeof(*tforms));
+	for (size_t i = 0; i < count; ++i) {
+		tforms[i] = transformFromParams(&params[i]);
+	}
+	struct transform composite = composeTransforms(tforms, count);
+	free(tforms);
+	return composite;
+}
+
+struct transform evaluateTrack(const struct track *track, int frame) {
+	const struct keyframe *first = &track->keys[0];
+	const struct keyframe *last = &track->keys[track->keyCount - 1];
+	if (frame <= first->frame) return composeKey(first->transforms, first->transformCount);
+	if (frame >= last->frame) return composeKey(last->transforms, last->transformCount);
+	
+	int next = 1;
+	while (track->keys[next].frame <= frame) ++next;
+	const struct keyframe *a = &track->keys[next - 1];
+	const struct keyframe *b = &track->keys[next];
+	if (a->frame == frame || !keysMatch(a, b)) return composeKey(a->transforms, a->transformCount);
+	
+	float t = (float)(frame - a->frame) / (float)(b->frame - a->frame);
+	struct transformParams *params = calloc(a->transformCount, sizeof(*params));
+	for (size_t i = 0; i < a->transformCount; ++i) {
+		params[i].type = a->transforms[i].type;
+		params[i].x = a->transforms[i].x + t * (b->transforms[i].x - a->transforms[i].x);
+		params[i].y = a->transforms[i].y + t * (b->transforms[i].y - a->transforms[i].y);
+		params[i].z = a->transforms[i].z + t * (b->transforms[i].z - a->transforms[i].z);
+	}
+	struct transform composite = composeKey(params, a->transformCount);
+	free(params);
+	return composite;
+}
+
+void destroyAnimation(struct animation *animation) {
+	if (animation) {
+		for (int i = 0; i < animation->trackCount; ++i) {
+			for (int k = 0; k < animation->tracks[i].keyCount; ++k) {
+				free(animation->tracks[i].keys[k].transforms);
+			}
+			free(animation->tracks[i].keys);
+		}
+		free(animation->tracks);
+		free(animation);
+	}
+}
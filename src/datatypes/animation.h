@@ -0,0 +1,45 @@
+//
+//  animation.h
+//  C-ray
+//
+//  Created by Valtteri on 18.10.2020.
+//  Copyright © 2020 Valtteri Koskivuori. All rights reserved.
+//
+
+#pragma once
+
+#include "transforms.h"
+
+/// Transforms of an animated object at a given frame
+struct keyframe {
+	int frame;
+	struct transformParams *transforms;
+	size_t transformCount;
+};
+
+/// Keyframes for a single animated object
+struct track {
+	int instanceIdx; //Index into scene instances, -1 for the camera
+	struct keyframe *keys; //Sorted by frame
+	int keyCount;
+};
+
+/// Animation for a scene. Only transforms are animated, so meshes, textures and
+/// bottom-level BVHs stay resident between frames.
+struct animation {
+	int frameCount;
+	struct track *tracks;
+	int trackCount;
+};
+
+/// Compute the composite transform of a track at a given frame.
+/// @remarks Keys are interpolated linearly if they have matching lists of transforms, otherwise the earlier key is held.
+/// Frames outside of the keyed range hold the first or last key.
+/// @param track Track to evaluate, needs at least one key
+/// @param frame Frame to evaluate the track at
+struct transform evaluateTrack(const struct track *track, int frame);
+
+/// Sort the keys of a track by frame. Call after adding keys.
+void sortKeys(struct track *track);
+
+void destroyAnimation(struct animation *animation);
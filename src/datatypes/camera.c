@@ -17,6 +17,22 @@ void updateCam(struct camera *cam) {
 	cam->forward = vecNormalize(cam->lookAt);
 	cam->right = vecCross(worldUp, cam->forward);
 	cam->up = vecCross(cam->forward, cam->right);
+	
+	//Rays are generated directly in world space, instead of transforming each one
+	cam->origin = vecZero();
+	transformPoint(&cam->origin, &cam->composite.A);
+	cam->worldForward = cam->forward;
+	cam->worldRight = cam->right;
+	cam->worldUp = cam->up;
+	transformVector(&cam->worldForward, &cam->composite.A);
+	transformVector(&cam->worldRight, &cam->composite.A);
+	transformVector(&cam->worldUp, &cam->composite.A);
+	cam->worldForward = vecNormalize(cam->worldForward);
+	cam->worldRight = vecNormalize(cam->worldRight);
+	cam->worldUp = vecNormalize(cam->worldUp);
+	cam->pixDeltaX = vecScale(cam->worldRight, cam->sensorSize.x / cam->width);
+	cam->pixDeltaY = vecScale(cam->worldUp, cam->sensorSize.y / cam->height);
+	cam->pixelSpread = atanf(cam->sensorSize.y / cam->height);
 }
 
 struct camera *newCamera(unsigned width, unsigned height, float FOV, float focalDistance, float fstops, struct transform composite) {
@@ -55,35 +71,39 @@ static inline float triangleDistribution(float v) {
 	return v;
 }
 
-struct lightRay getCameraRay(struct camera *cam, int x, int y, struct sampler *sampler) {
-	struct lightRay newRay = {{0}};
-	
-	newRay.start = vecZero();
-	
-	const float jitterX = triangleDistribution(getDimension(sampler));
-	const float jitterY = triangleDistribution(getDimension(sampler));
-	
-	struct vector pixX = vecScale(cam->right, (cam->sensorSize.x / cam->width));
-	struct vector pixY = vecScale(cam->up, (cam->sensorSize.y / cam->height));
+static inline struct vector pixelDirection(const struct camera *cam, int x, int y, float u, float v) {
+	const float jitterX = triangleDistribution(u);
+	const float jitterY = triangleDistribution(v);
 	struct vector pixV = vecAdd(
-							cam->forward,
+							cam->worldForward,
 							vecAdd(
-								vecScale(pixX, x - cam->width * 0.5f + jitterX + 0.5f),
-								vecScale(pixY, y - cam->height * 0.5f + jitterY + 0.5f)
+								vecScale(cam->pixDeltaX, x - cam->width * 0.5f + jitterX + 0.5f),
+								vecScale(cam->pixDeltaY, y - cam->height * 0.5f + jitterY + 0.5f)
 							)
 						);
-	newRay.direction = vecNormalize(pixV);
-	
+	return vecNormalize(pixV);
+}
+
+static inline struct lightRay lensRay(const struct camera *cam, struct vector direction, float u, float v) {
+	float ft = cam->focalDistance / vecDot(direction, cam->worldForward);
+	struct vector focusPoint = vecAdd(cam->origin, vecScale(direction, ft));
+	float r = sqrtf(u);
+	float theta = v * (2.0f * PI);
+	struct coord lensPoint = coordScale(cam->aperture, (struct coord){r * cosf(theta), r * sinf(theta)});
+	struct vector start = vecAdd(cam->origin, vecAdd(vecScale(cam->worldRight, lensPoint.x), vecScale(cam->worldUp, lensPoint.y)));
+	return (struct lightRay){start, vecNormalize(vecSub(focusPoint, start)), rayTypeIncident};
+}
+
+struct lightRay getCameraRay(struct camera *cam, int x, int y, struct sampler *sampler) {
+	const float u = getDimension(sampler);
+	const float v = getDimension(sampler);
+	struct vector direction = pixelDirection(cam, x, y, u, v);
 	if (cam->aperture > 0.0f) {
-		float ft = cam->focalDistance / vecDot(newRay.direction, cam->forward);
-		struct vector focusPoint = alongRay(&newRay, ft);
-		struct coord lensPoint = coordScale(cam->aperture, randomCoordOnUnitDisc(sampler));
-		newRay.start = vecAdd(newRay.start, vecAdd(vecScale(cam->right, lensPoint.x), vecScale(cam->up, lensPoint.y)));
-		newRay.direction = vecNormalize(vecSub(focusPoint, newRay.start));
+		const float lensU = getDimension(sampler);
+		const float lensV = getDimension(sampler);
+		return lensRay(cam, direction, lensU, lensV);
 	}
-	//To world space
-	transformRay(&newRay, &cam->composite.A);
-	return newRay;
+	return (struct lightRay){cam->origin, direction, rayTypeIncident};
 }
 
 void destroyCamera(struct camera *cam) {
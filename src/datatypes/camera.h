@@ -28,12 +28,24 @@ struct camera {
 	
 	struct transform composite;
 	
+	//World space versions of the above, so rays don't need to be transformed. Set in updateCam()
+	struct vector origin;
+	struct vector worldForward;
+	struct vector worldRight;
+	struct vector worldUp;
+	struct vector pixDeltaX; //Step of one pixel on the sensor
+	struct vector pixDeltaY;
+	float pixelSpread; //Angle one pixel covers, the initial ray cone spread for texture filtering
+	
 	int width;
 	int height;
 };
 
 struct camera *newCamera(unsigned width, unsigned height, float FOV, float focalDistance, float fstops, struct transform composite);
 
+/// Recompute the world space basis of the camera. Call after changing the camera transform.
+void updateCam(struct camera *cam);
+
 struct lightRay getCameraRay(struct camera *cam, int x, int y, struct sampler *sampler);
 
 void destroyCamera(struct camera *cam);
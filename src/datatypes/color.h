@@ -8,6 +8,7 @@
 #pragma once
 
 #include <math.h>
+#include <stdbool.h>
 
 #define AIR_IOR 1.0
 
@@ -64,6 +65,16 @@ static inline struct color grayscale(struct color c) {
 	return (struct color){b, b, b, 1.0f};
 }
 
+//Relative luminance of a linear Rec. 709 color
+static inline float luminance(struct color c) {
+	return 0.2126f * c.red + 0.7152f * c.green + 0.0722f * c.blue;
+}
+
+//True if any channel is positive, for telling light sources apart
+static inline bool isEmissive(struct color c) {
+	return c.red > 0.0f || c.green > 0.0f || c.blue > 0.0f;
+}
+
 //Multiply a color with a coefficient value
 static inline struct color colorCoef(float coef, struct color c) {
 	return (struct color){c.red * coef, c.green * coef, c.blue * coef, c.alpha * coef};
@@ -113,6 +124,18 @@ static inline struct color fromSRGB(struct color c) {
 	};
 }
 
+extern const float srgb8ToLinearTable[256];
+
+/// Decode an 8-bit sRGB value to linear. Same as SRGBToLinear(value / 255.0f), with a table lookup.
+static inline float SRGB8ToLinear(unsigned char value) {
+	return srgb8ToLinearTable[value];
+}
+
+/// Encode a linear value to 8-bit sRGB, rounded to the nearest level.
+/// Table driven, and within one level of rounding linearToSRGB() * 255.
+/// Values outside 0.0-1.0 are clamped.
+unsigned char linearToSRGB8(float channel);
+
 static inline struct color lerp(struct color start, struct color end, float t) {
 	return mixColors(start, end, t);
 }
@@ -0,0 +1,67 @@
+//
+//  half.h
+//  C-ray
+//
+//  Created by Valtteri on 18.10.2020.
+//  Copyright © 2020 Valtteri Koskivuori. All rights reserved.
+//
+
+#pragma once
+
+#include <stdint.h>
+#ifdef __F16C__
+#include <immintrin.h>
+#endif
+
+//IEEE 754 half precision floats, for compact texture storage.
+//CPUs with F16C convert in a single instruction. The fallbacks are
+//Fabian Giesen's half_to_float_fast5 and float_to_half_fast3_rtne (public domain).
+
+/// Largest finite half, values above it become infinity
+#define HALF_MAX 65504.0f
+
+static inline float halfToFloat(uint16_t h) {
+#ifdef __F16C__
+	return _cvtsh_ss(h);
+#endif
+	const union {uint32_t u; float f;} magic = {113 << 23};
+	const uint32_t shiftedExponent = 0x7c00 << 13;
+	union {uint32_t u; float f;} out = {(uint32_t)(h & 0x7fff) << 13};
+	const uint32_t exponent = shiftedExponent & out.u;
+	out.u += (127 - 15) << 23;
+	if (exponent == shiftedExponent) {
+		out.u += (128 - 16) << 23; //Inf and NaN
+	} else if (exponent == 0) {
+		out.u += 1 << 23; //Zero and subnormals, renormalized by the float unit
+		out.f -= magic.f;
+	}
+	out.u |= (uint32_t)(h & 0x8000) << 16;
+	return out.f;
+}
+
+/// Convert to half, rounding to the nearest even value
+static inline uint16_t floatToHalf(float value) {
+#ifdef __F16C__
+	return _cvtss_sh(value, _MM_FROUND_TO_NEAREST_INT);
+#endif
+	const union {uint32_t u; float f;} infinity = {255 << 23};
+	const union {uint32_t u; float f;} overflow = {(127 + 16) << 23};
+	const union {uint32_t u; float f;} subnormalMagic = {((127 - 15) + (23 - 10) + 1) << 23};
+	union {uint32_t u; float f;} in = {.f = value};
+	const uint32_t sign = in.u & 0x80000000u;
+	in.u ^= sign;
+	uint16_t out;
+	if (in.u >= overflow.u) {
+		out = in.u > infinity.u ? 0x7e00 : 0x7c00; //NaN stays NaN, everything else goes to infinity
+	} else if (in.u < (113 << 23)) {
+		//Subnormal or zero. Adding the magic number lets the float unit do the rounding.
+		in.f += subnormalMagic.f;
+		out = (uint16_t)(in.u - subnormalMagic.u);
+	} else {
+		const uint32_t mantissaOdd = (in.u >> 13) & 1;
+		in.u += ((uint32_t)(15 - 127) << 23) + 0xfff;
+		in.u += mantissaOdd;
+		out = (uint16_t)(in.u >> 13);
+	}
+	return out | (uint16_t)(sign >> 16);
+}
@@ -0,0 +1,286 @@
+//
+//  mipmap.c
+//  C-ray
+//
+//  Created by Valtteri on 18.10.2020.
+//  Copyright © 2020 Valtteri Koskivuori. All rights reserved.
+//
+
+#include "../../includes.h"
+#include "mipmap.h"
+
+#include "texturecache.h"
+#include "../color.h"
+#include "../vector.h"
+#include "../../utils/logging.h"
+#include "../../utils/assert.h"
+
+// Texels are stored in 8x8 tiles. An RGBA tile is 256 bytes for 8-bit data,
+// so the 2x2 texels of a bilinear lookup are in the same few cache lines.
+#define TILE_SHIFT 3
+#define TILE_SIZE (1 << TILE_SHIFT)
+#define TILE_MASK (TILE_SIZE - 1)
+
+static inline size_t texelIndex(const struct mipLevel *l, unsigned x, unsigned y) {
+	const size_t tile = (y >> TILE_SHIFT) * l->tilesX + (x >> TILE_SHIFT);
+	return (tile << (2 * TILE_SHIFT)) + ((y & TILE_MASK) << TILE_SHIFT) + (x & TILE_MASK);
+}
+
+static inline struct color decodeTexel(const struct mipmap *m, const struct mipLevel *l, size_t i) {
+	if (m->precision == char_p) {
+		const float scale = 1.0f / 255.0f;
+		if (m->channels == 1) {
+			const float value = l->data.byte_p[i] * scale;
+			return (struct color){value, value, value, 1.0f};
+		}
+		const unsigned char *texel = &l->data.byte_p[i * 4];
+		return (struct color){texel[0] * scale, texel[1] * scale, texel[2] * scale, texel[3] * scale};
+	}
+	if (m->channels == 1) {
+		const float value = l->data.float_p[i];
+		return (struct color){value, value, value, 1.0f};
+	}
+	const float *texel = &l->data.float_p[i * 4];
+	return (struct color){texel[0], texel[1], texel[2], texel[3]};
+}
+
+//Decode a texel to linear, whatever color space it's stored in
+static inline struct color decodeLinear(const struct mipmap *m, const struct mipLevel *l, size_t i) {
+	if (m->colorspace != sRGB) return decodeTexel(m, l, i);
+	if (m->precision == char_p) {
+		if (m->channels == 1) {
+			const float value = SRGB8ToLinear(l->data.byte_p[i]);
+			return (struct color){value, value, value, 1.0f};
+		}
+		const unsigned char *texel = &l->data.byte_p[i * 4];
+		return (struct color){SRGB8ToLinear(texel[0]), SRGB8ToLinear(texel[1]), SRGB8ToLinear(texel[2]), texel[3] * (1.0f / 255.0f)};
+	}
+	return fromSRGB(decodeTexel(m, l, i));
+}
+
+static inline unsigned char toByte(float value) {
+	return (unsigned char)(clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+static void storeTexel(struct mipmap *m, struct mipLevel *l, unsigned x, unsigned y, struct color c) {
+	const size_t i = texelIndex(l, x, y);
+	if (m->precision == char_p) {
+		if (m->channels == 1) {
+			l->data.byte_p[i] = toByte(c.red);
+		} else {
+			unsigned char *texel = &l->data.byte_p[i * 4];
+			texel[0] = toByte(c.red);
+			texel[1] = toByte(c.green);
+			texel[2] = toByte(c.blue);
+			texel[3] = toByte(c.alpha);
+		}
+	} else {
+		if (m->channels == 1) {
+			l->data.float_p[i] = c.red;
+		} else {
+			float *texel = &l->data.float_p[i * 4];
+			texel[0] = c.red;
+			texel[1] = c.green;
+			texel[2] = c.blue;
+			texel[3] = c.alpha;
+		}
+	}
+}
+
+static inline size_t texelSize(const struct mipmap *m) {
+	return m->channels * (m->precision == char_p ? sizeof(unsigned char) : sizeof(float));
+}
+
+size_t mipLevelBytes(const struct mipmap *m, int level) {
+	const struct mipLevel *l = &m->levels[level];
+	const size_t tilesY = (l->height + TILE_MASK) >> TILE_SHIFT;
+	return l->tilesX * tilesY * TILE_SIZE * TILE_SIZE * texelSize(m);
+}
+
+static bool allocLevel(const struct mipmap *m, int level) {
+	struct mipLevel *l = &m->levels[level];
+	l->data.byte_p = calloc(mipLevelBytes(m, level), 1);
+	return l->data.byte_p != NULL;
+}
+
+//Box filter the 2x2 texels under each texel of the next level. Odd edges reuse the last row or column.
+static void downsample(struct mipmap *m, int level) {
+	const struct mipLevel *src = &m->levels[level - 1];
+	struct mipLevel *dst = &m->levels[level];
+	for (unsigned y = 0; y < dst->height; ++y) {
+		const unsigned y0 = min(2 * y, src->height - 1);
+		const unsigned y1 = min(2 * y + 1, src->height - 1);
+		for (unsigned x = 0; x < dst->width; ++x) {
+			const unsigned x0 = min(2 * x, src->width - 1);
+			const unsigned x1 = min(2 * x + 1, src->width - 1);
+			const struct color c[4] = {
+				decodeLinear(m, src, texelIndex(src, x0, y0)),
+				decodeLinear(m, src, texelIndex(src, x1, y0)),
+				decodeLinear(m, src, texelIndex(src, x0, y1)),
+				decodeLinear(m, src, texelIndex(src, x1, y1))
+			};
+			struct color sum = clearColor;
+			for (int i = 0; i < 4; ++i) sum = addColors(sum, c[i]);
+			struct color average = colorCoef(0.25f, sum);
+			if (m->colorspace == sRGB) average = toSRGB(average);
+			storeTexel(m, dst, x, y, average);
+		}
+	}
+}
+
+struct mipmap *newMipmapLayout(unsigned width, unsigned height, int channels, enum precision precision, enum colorspace colorspace) {
+	if (!width || !height) return NULL;
+	struct mipmap *m = calloc(1, sizeof(*m));
+	m->colorspace = colorspace;
+	m->precision = precision == char_p ? char_p : float_p; //Compact HDR formats are expanded
+	m->hasAlpha = channels > 3;
+	m->channels = channels == 1 ? 1 : 4;
+	
+	unsigned size = max(width, height);
+	m->levelCount = 1;
+	while (size > 1) {
+		size >>= 1;
+		m->levelCount++;
+	}
+	m->levels = calloc(m->levelCount, sizeof(*m->levels));
+	for (int level = 0; level < m->levelCount; ++level) {
+		struct mipLevel *l = &m->levels[level];
+		l->width = max(width >> level, 1);
+		l->height = max(height >> level, 1);
+		l->tilesX = (l->width + TILE_MASK) >> TILE_SHIFT;
+	}
+	return m;
+}
+
+struct mipmap *newMipmap(const struct texture *t, enum colorspace colorspace) {
+	if (!t || !t->data.byte_p) return NULL;
+	struct mipmap *m = newMipmapLayout(t->width, t->height, t->channels, t->precision, colorspace);
+	if (!m) return NULL;
+	m->hasAlpha = t->hasAlpha;
+	
+	for (int level = 0; level < m->levelCount; ++level) {
+		if (!allocLevel(m, level)) {
+			logr(warning, "Failed to allocate %ux%u mip level.\n", m->levels[level].width, m->levels[level].height);
+			destroyMipmap(m);
+			return NULL;
+		}
+		if (level) {
+			downsample(m, level);
+		} else {
+			for (unsigned y = 0; y < t->height; ++y) {
+				for (unsigned x = 0; x < t->width; ++x) {
+					storeTexel(m, &m->levels[0], x, y, textureGetPixel(t, x, y));
+				}
+			}
+		}
+	}
+	return m;
+}
+
+static inline unsigned wrap(int value, unsigned size) {
+	if ((unsigned)value < size) return value; //Most lookups don't wrap, skip the division
+	const int wrapped = value % (int)size;
+	return wrapped < 0 ? (unsigned)wrapped + size : (unsigned)wrapped;
+}
+
+//Cached levels may be evicted while we sample them, so the cache hands out a copy
+//with texel data that stays valid until the calling thread leaves the cache.
+static inline struct mipLevel getLevel(const struct mipmap *m, int level) {
+	if (m->cache) return textureCacheLevel(m, level);
+	return m->levels[level];
+}
+
+struct color mipmapGetTexel(const struct mipmap *m, int level, int x, int y) {
+	ASSERT(level >= 0 && level < m->levelCount);
+	const struct mipLevel l = getLevel(m, level);
+	return decodeTexel(m, &l, texelIndex(&l, wrap(x, l.width), wrap(y, l.height)));
+}
+
+//Weighted sum of four texels, with the format checked once instead of per texel.
+//sRGB texels are decoded to linear first, so the filtering happens in linear space.
+static inline struct color blendTexels(const struct mipmap *m, const struct mipLevel *l, const size_t i[4], const float w[4]) {
+	float r = 0.0f, g = 0.0f, b = 0.0f, a = 0.0f;
+	if (m->colorspace == sRGB) {
+		if (m->precision == char_p && m->channels == 4) {
+			for (int t = 0; t < 4; ++t) {
+				const unsigned char *texel = &l->data.byte_p[i[t] * 4];
+				r += w[t] * SRGB8ToLinear(texel[0]);
+				g += w[t] * SRGB8ToLinear(texel[1]);
+				b += w[t] * SRGB8ToLinear(texel[2]);
+				a += w[t] * texel[3];
+			}
+			return (struct color){r, g, b, a * (1.0f / 255.0f)};
+		}
+		struct color sum = clearColor;
+		for (int t = 0; t < 4; ++t) sum = addColors(sum, colorCoef(w[t], decodeLinear(m, l, i[t])));
+		return sum;
+	}
+	if (m->precision == char_p) {
+		if (m->channels == 1) {
+			for (int t = 0; t < 4; ++t) r += w[t] * l->data.byte_p[i[t]];
+			r *= 1.0f / 255.0f;
+			return (struct color){r, r, r, 1.0f};
+		}
+		for (int t = 0; t < 4; ++t) {
+			const unsigned char *texel = &l->data.byte_p[i[t] * 4];
+			r += w[t] * texel[0];
+			g += w[t] * texel[1];
+			b += w[t] * texel[2];
+			a += w[t] * texel[3];
+		}
+		const float scale = 1.0f / 255.0f;
+		return (struct color){r * scale, g * scale, b * scale, a * scale};
+	}
+	if (m->channels == 1) {
+		for (int t = 0; t < 4; ++t) r += w[t] * l->data.float_p[i[t]];
+		return (struct color){r, r, r, 1.0f};
+	}
+	for (int t = 0; t < 4; ++t) {
+		const float *texel = &l->data.float_p[i[t] * 4];
+		r += w[t] * texel[0];
+		g += w[t] * texel[1];
+		b += w[t] * texel[2];
+		a += w[t] * texel[3];
+	}
+	return (struct color){r, g, b, a};
+}
+
+static struct color bilinear(const struct mipmap *m, int level, struct coord uv) {
+	const struct mipLevel resident = getLevel(m, level);
+	const struct mipLevel *l = &resident;
+	const float x = uv.x * l->width - 0.5f;
+	const float y = uv.y * l->height - 0.5f;
+	const float fx = floorf(x);
+	const float fy = floorf(y);
+	const unsigned x0 = wrap((int)fx, l->width);
+	const unsigned y0 = wrap((int)fy, l->height);
+	const unsigned x1 = x0 + 1 == l->width ? 0 : x0 + 1;
+	const unsigned y1 = y0 + 1 == l->height ? 0 : y0 + 1;
+	const float dx = x - fx;
+	const float dy = y - fy;
+	const size_t i[4] = {texelIndex(l, x0, y0), texelIndex(l, x1, y0), texelIndex(l, x0, y1), texelIndex(l, x1, y1)};
+	const float w[4] = {(1.0f - dx) * (1.0f - dy), dx * (1.0f - dy), (1.0f - dx) * dy, dx * dy};
+	return blendTexels(m, l, i, w);
+}
+
+struct color mipmapSample(const struct mipmap *m, struct coord uv, float width) {
+	//Footprint width in level 0 texels. Each level up halves it.
+	const float texels = width * max(m->levels[0].width, m->levels[0].height);
+	if (texels <= 1.0f) return bilinear(m, 0, uv);
+	const float lod = log2f(texels);
+	const int level = (int)lod;
+	if (level >= m->levelCount - 1) return bilinear(m, m->levelCount - 1, uv);
+	return lerp(bilinear(m, level, uv), bilinear(m, level + 1, uv), lod - level);
+}
+
+void destroyMipmap(struct mipmap *m) {
+	if (m) {
+		if (m->levels) {
+			for (int i = 0; i < m->levelCount; ++i) {
+				free(m->levels[i].data.byte_p);
+			}
+			free(m->levels);
+		}
+		free(m);
+	}
+}
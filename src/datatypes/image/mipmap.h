@@ -0,0 +1,72 @@
+//
+//  mipmap.h
+//  C-ray
+//
+//  Created by Valtteri on 18.10.2020.
+//  Copyright © 2020 Valtteri Koskivuori. All rights reserved.
+//
+
+#pragma once
+
+#include "texture.h"
+
+struct color;
+struct coord;
+struct textureCache;
+struct cacheEntry;
+
+/// One level of a mip pyramid. Texels are stored in square tiles, so a bilinear
+/// lookup usually touches a single cache line instead of two scanlines.
+struct mipLevel {
+	union {
+		unsigned char *byte_p;
+		float *float_p;
+	} data;
+	unsigned width;
+	unsigned height;
+	unsigned tilesX; //Tiles per row
+	unsigned lastUse; //Texture cache clock at the last lookup, unused for mipmaps loaded up front
+};
+
+/// Read-only, prefiltered texture for texture mapping. Built from a texture at load time,
+/// or level by level on first use when it belongs to a textureCache.
+/// @note Textures with more than one channel are always stored as RGBA.
+struct mipmap {
+	enum colorspace colorspace;
+	enum precision precision;
+	bool hasAlpha;
+	int channels; //1 or 4
+	int levelCount;
+	struct mipLevel *levels; //Level 0 is the full resolution image
+	struct textureCache *cache; //Owner of the level data, NULL if all levels are resident
+	struct cacheEntry *entry; //Where the cache loads the levels from
+};
+
+/// Build a mip pyramid from a texture
+/// @param t Source texture, can be destroyed afterwards
+/// @param colorspace Color space the texture data is in. sRGB data is averaged in linear space.
+/// @return New mipmap, or NULL if t has no data
+struct mipmap *newMipmap(const struct texture *t, enum colorspace colorspace);
+
+/// Set up the levels of a mipmap, without allocating any texel data
+/// @param width Width of the full resolution level
+/// @param height Height of the full resolution level
+/// @param channels Channel count of the source texture
+/// @param precision Precision of the source texture
+/// @param colorspace Color space of the source texture
+struct mipmap *newMipmapLayout(unsigned width, unsigned height, int channels, enum precision precision, enum colorspace colorspace);
+
+/// Size of the texel data of one level, in bytes
+size_t mipLevelBytes(const struct mipmap *m, int level);
+
+/// Get the texel at x, y of a given mip level, wrapped around the edges. Not decoded from sRGB.
+struct color mipmapGetTexel(const struct mipmap *m, int level, int x, int y);
+
+/// Sample the mipmap with a square filter footprint
+/// @param m Mipmap to sample
+/// @param uv Texture coordinates, wrapped to [0,1]
+/// @param width Footprint width in texture coordinates. 0 samples the full resolution level
+/// @return Trilinearly filtered color. sRGB mipmaps are decoded and filtered in linear space.
+struct color mipmapSample(const struct mipmap *m, struct coord uv, float width);
+
+void destroyMipmap(struct mipmap *m);
@@ -9,14 +9,187 @@
 #include "../../includes.h"
 
 #include "texture.h"
+#include "half.h"
 #include "../color.h"
+#include "../vector.h"
 #include "../../utils/logging.h"
 #include "../../utils/assert.h"
 
+//Block compressed HDR. Each 4x4 block stores two RGB9E5 endpoints, three 9-bit mantissas with a
+//shared 5-bit exponent, and a 4-bit index per pixel that picks one of 16 steps between them.
+//Like BC6H, but simple enough to encode at load time.
+#define BLOCK_BYTES 16
+#define RGB9E5_MAX (511.0f / 512.0f * 65536.0f)
+
+static inline unsigned blocksX(const struct texture *t) {
+	return (t->width + 3) >> 2;
+}
+
+static inline size_t blockCount(const struct texture *t) {
+	return (size_t)blocksX(t) * ((t->height + 3) >> 2);
+}
+
+//2^(exponent - 15 - 9), built directly from the float bits
+static inline float rgb9e5Scale(uint32_t exponent) {
+	const union {uint32_t u; float f;} scale = {(exponent + 103) << 23};
+	return scale.f;
+}
+
+static inline struct color decodeRGB9E5(uint32_t value) {
+	const float scale = rgb9e5Scale(value >> 27);
+	return (struct color){(value & 511) * scale, ((value >> 9) & 511) * scale, ((value >> 18) & 511) * scale, 1.0f};
+}
+
+static uint32_t encodeRGB9E5(struct color c) {
+	const float maxValue = max(c.red, max(c.green, c.blue));
+	if (maxValue <= 0.0f) return 0;
+	int power;
+	frexpf(maxValue, &power);
+	uint32_t exponent = max(power + 15, 0);
+	float scale = rgb9e5Scale(exponent);
+	if ((uint32_t)(maxValue / scale + 0.5f) > 511) {
+		exponent++;
+		scale *= 2.0f;
+	}
+	const uint32_t r = (uint32_t)(c.red / scale + 0.5f);
+	const uint32_t g = (uint32_t)(c.green / scale + 0.5f);
+	const uint32_t b = (uint32_t)(c.blue / scale + 0.5f);
+	return r | g << 9 | b << 18 | exponent << 27;
+}
+
+static inline const unsigned char *getBlock(const struct texture *t, unsigned x, unsigned y) {
+	return &t->data.block_p[((size_t)(y >> 2) * blocksX(t) + (x >> 2)) * BLOCK_BYTES];
+}
+
+//Position of a pixel between the block endpoints, 0-1
+static inline float blockStep(const unsigned char *block, unsigned x, unsigned y) {
+	const unsigned i = ((y & 3) << 2) | (x & 3);
+	return ((block[8 + (i >> 1)] >> ((i & 1) * 4)) & 15) * (1.0f / 15.0f);
+}
+
+static inline struct color blockGetPixel(const struct texture *t, unsigned x, unsigned y) {
+	const unsigned char *block = getBlock(t, x, y);
+	uint32_t endpoints[2];
+	memcpy(endpoints, block, sizeof(endpoints));
+	return lerp(decodeRGB9E5(endpoints[0]), decodeRGB9E5(endpoints[1]), blockStep(block, x, y));
+}
+
+//Neighbouring pixels are usually in the same block, so decode its endpoints once instead of per pixel
+static struct color blockGetPixelFiltered(const struct texture *t, int x, int y, float dx, float dy) {
+	struct color pixels[4];
+	const unsigned char *decoded = NULL;
+	struct color start = blackColor, end = blackColor;
+	for (int i = 0; i < 4; ++i) {
+		const unsigned px = (unsigned)(x + (i & 1)) % t->width;
+		const unsigned py = (unsigned)(y + (i >> 1)) % t->height;
+		const unsigned char *block = getBlock(t, px, py);
+		if (block != decoded) {
+			uint32_t endpoints[2];
+			memcpy(endpoints, block, sizeof(endpoints));
+			start = decodeRGB9E5(endpoints[0]);
+			end = decodeRGB9E5(endpoints[1]);
+			decoded = block;
+		}
+		pixels[i] = lerp(start, end, blockStep(block, px, py));
+	}
+	return lerp(lerp(pixels[0], pixels[1], dx), lerp(pixels[2], pixels[3], dx), dy);
+}
+
+//Endpoints span the block along its principal axis, and each pixel gets the closest step between them.
+//Bounding box corners would be cheaper, but get the axis backwards when channels vary in opposite directions.
+static void encodeBlock(const struct texture *t, unsigned bx, unsigned by, unsigned char *block) {
+	float pixels[16][3];
+	float mean[3] = {0.0f, 0.0f, 0.0f};
+	float low[3] = {RGB9E5_MAX, RGB9E5_MAX, RGB9E5_MAX};
+	float high[3] = {0.0f, 0.0f, 0.0f};
+	for (unsigned i = 0; i < 16; ++i) {
+		//Blocks on the right and top edges repeat the last column and row
+		const unsigned x = min(bx * 4 + (i & 3), t->width - 1);
+		const unsigned y = min(by * 4 + (i >> 2), t->height - 1);
+		const struct color c = textureGetPixel(t, x, y);
+		const float rgb[3] = {c.red, c.green, c.blue};
+		for (int j = 0; j < 3; ++j) {
+			pixels[i][j] = clamp(rgb[j], 0.0f, RGB9E5_MAX);
+			mean[j] += pixels[i][j] * (1.0f / 16.0f);
+			low[j] = min(low[j], pixels[i][j]);
+			high[j] = max(high[j], pixels[i][j]);
+		}
+	}
+	
+	float covariance[3][3] = {{0.0f}};
+	for (unsigned i = 0; i < 16; ++i) {
+		for (int j = 0; j < 3; ++j) {
+			for (int k = 0; k < 3; ++k) covariance[j][k] += (pixels[i][j] - mean[j]) * (pixels[i][k] - mean[k]);
+		}
+	}
+	//Power iteration, starting from the bounding box diagonal
+	float axis[3] = {high[0] - low[0], high[1] - low[1], high[2] - low[2]};
+	for (int iteration = 0; iteration < 8; ++iteration) {
+		float next[3];
+		for (int j = 0; j < 3; ++j) next[j] = covariance[j][0] * axis[0] + covariance[j][1] * axis[1] + covariance[j][2] * axis[2];
+		const float largest = max(fabsf(next[0]), max(fabsf(next[1]), fabsf(next[2])));
+		if (largest <= 0.0f) break;
+		for (int j = 0; j < 3; ++j) axis[j] = next[j] / largest;
+	}
+	float first = 0.0f, last = 0.0f;
+	for (unsigned i = 0; i < 16; ++i) {
+		const float along = (pixels[i][0] - mean[0]) * axis[0] + (pixels[i][1] - mean[1]) * axis[1] + (pixels[i][2] - mean[2]) * axis[2];
+		first = min(first, along);
+		last = max(last, along);
+	}
+	const float lengthSquared = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+	if (lengthSquared > 0.0f) {
+		first /= lengthSquared;
+		last /= lengthSquared;
+	}
+	struct color ends[2];
+	for (int e = 0; e < 2; ++e) {
+		const float along = e ? last : first;
+		ends[e] = (struct color){
+			clamp(mean[0] + axis[0] * along, low[0], high[0]),
+			clamp(mean[1] + axis[1] * along, low[1], high[1]),
+			clamp(mean[2] + axis[2] * along, low[2], high[2]),
+			1.0f
+		};
+	}
+	const uint32_t endpoints[2] = {encodeRGB9E5(ends[0]), encodeRGB9E5(ends[1])};
+	memcpy(block, endpoints, sizeof(endpoints));
+	memset(&block[8], 0, 8);
+	
+	//Project onto the quantized endpoints, since those are what the decoder sees
+	const struct color start = decodeRGB9E5(endpoints[0]);
+	const struct color end = decodeRGB9E5(endpoints[1]);
+	const float line[3] = {end.red - start.red, end.green - start.green, end.blue - start.blue};
+	const float lineSquared = line[0] * line[0] + line[1] * line[1] + line[2] * line[2];
+	if (lineSquared <= 0.0f) return;
+	for (unsigned i = 0; i < 16; ++i) {
+		const float along = ((pixels[i][0] - start.red) * line[0] + (pixels[i][1] - start.green) * line[1] + (pixels[i][2] - start.blue) * line[2]) / lineSquared;
+		const unsigned step = (unsigned)(clamp(along, 0.0f, 1.0f) * 15.0f + 0.5f);
+		block[8 + (i >> 1)] |= step << ((i & 1) * 4);
+	}
+}
+
 //General-purpose setPixel function
 void setPixel(struct texture *t, struct color c, unsigned x, unsigned y) {
 	ASSERT(x < t->width); ASSERT(y < t->height);
-	if (t->precision == char_p) {
+	ASSERT(t->precision != block_p);
+	if (t->precision == half_p) {
+		uint16_t *pixel = &t->data.half_p[(x + (t->height - (y + 1)) * t->width) * t->channels];
+		pixel[0] = floatToHalf(clamp(c.red, -HALF_MAX, HALF_MAX));
+		if (t->channels == 1) return;
+		pixel[1] = floatToHalf(clamp(c.green, -HALF_MAX, HALF_MAX));
+		pixel[2] = floatToHalf(clamp(c.blue, -HALF_MAX, HALF_MAX));
+		if (t->hasAlpha) pixel[3] = floatToHalf(clamp(c.alpha, -HALF_MAX, HALF_MAX));
+		return;
+	}
+	if (t->channels == 1) {
+		//Single channel textures only store the red component
+		if (t->precision == char_p) {
+			t->data.byte_p[x + (t->height - (y + 1)) * t->width] = (unsigned char)min(c.red * 255.0f, 255.0f);
+		} else if (t->precision == float_p) {
+			t->data.float_p[x + (t->height - (y + 1)) * t->width] = c.red;
+		}
+	} else if (t->precision == char_p) {
 		t->data.byte_p[(x + (t->height - (y + 1)) * t->width) * t->channels + 0] = (unsigned char)min(c.red * 255.0f, 255.0f);
 		t->data.byte_p[(x + (t->height - (y + 1)) * t->width) * t->channels + 1] = (unsigned char)min(c.green * 255.0f, 255.0f);
 		t->data.byte_p[(x + (t->height - (y + 1)) * t->width) * t->channels + 2] = (unsigned char)min(c.blue * 255.0f, 255.0f);
@@ -30,11 +203,35 @@ void setPixel(struct texture *t, struct color c, unsigned x, unsigned y) {
 	}
 }
 
+void setPixelSRGB(struct texture *t, struct color c, unsigned x, unsigned y) {
+	ASSERT(x < t->width); ASSERT(y < t->height);
+	if (t->precision != char_p) {
+		setPixel(t, toSRGB(c), x, y);
+		return;
+	}
+	unsigned char *pixel = &t->data.byte_p[(x + (t->height - (y + 1)) * t->width) * t->channels];
+	pixel[0] = linearToSRGB8(c.red);
+	if (t->channels == 1) return;
+	pixel[1] = linearToSRGB8(c.green);
+	pixel[2] = linearToSRGB8(c.blue);
+	if (t->hasAlpha) pixel[3] = (unsigned char)min(c.alpha * 255.0f, 255.0f);
+}
+
 struct color textureGetPixel(const struct texture *t, unsigned x, unsigned y) {
 	struct color output = {0.0f, 0.0f, 0.0f, 0.0f};
 	x = x % t->width;
 	y = y % t->height;
 	
+	if (t->precision == block_p) return blockGetPixel(t, x, y);
+	if (t->precision == half_p) {
+		const uint16_t *pixel = &t->data.half_p[(x + ((t->height - 1) - y) * t->width) * t->channels];
+		output.red = halfToFloat(pixel[0]);
+		if (t->channels == 1) return (struct color){output.red, output.red, output.red, 1.0f};
+		output.green = halfToFloat(pixel[1]);
+		output.blue = halfToFloat(pixel[2]);
+		output.alpha = t->hasAlpha ? halfToFloat(pixel[3]) : 1.0f;
+		return output;
+	}
 	if (t->channels == 1) {
 		if (t->precision == float_p) {
 			output.red   = t->data.float_p[(x + ((t->height - 1) - y) * t->width) * t->channels];
@@ -69,6 +266,7 @@ struct color textureGetPixelFiltered(const struct texture *t, float x, float y)
 	float ycopy = y - 0.5f;
 	int xint = (int)xcopy;
 	int yint = (int)ycopy;
+	if (t->precision == block_p) return blockGetPixelFiltered(t, xint, yint, xcopy - xint, ycopy - yint);
 	struct color topleft = textureGetPixel(t, xint, yint);
 	struct color topright = textureGetPixel(t, xint + 1, yint);
 	struct color botleft = textureGetPixel(t, xint, yint + 1);
@@ -109,12 +307,58 @@ struct texture *newTexture(enum precision p, unsigned width, unsigned height, in
 			}
 		}
 			break;
+		case half_p:
+		case block_p: {
+			t->data.byte_p = calloc(textureBytes(t), 1);
+			if (!t->data.byte_p) {
+				logr(warning, "Failed to allocate %ix%i texture.\n", width, height);
+				destroyTexture(t);
+				return NULL;
+			}
+		}
+			break;
 		default:
 			break;
 	}
 	return t;
 }
 
+size_t textureBytes(const struct texture *t) {
+	const size_t pixels = (size_t)t->width * t->height * t->channels;
+	switch (t->precision) {
+		case char_p:
+			return pixels * sizeof(*t->data.byte_p);
+		case float_p:
+			return pixels * sizeof(*t->data.float_p);
+		case half_p:
+			return pixels * sizeof(*t->data.half_p);
+		case block_p:
+			return blockCount(t) * BLOCK_BYTES;
+		default:
+			return 0;
+	}
+}
+
+struct texture *convertTexture(const struct texture *t, enum precision precision) {
+	struct texture *new = newTexture(precision, t->width, t->height, precision == block_p ? 3 : t->channels);
+	if (!new) return NULL;
+	new->colorspace = t->colorspace;
+	if (precision == block_p) {
+		for (unsigned by = 0; by < (t->height + 3) / 4; ++by) {
+			for (unsigned bx = 0; bx < blocksX(t); ++bx) {
+				encodeBlock(t, bx, by, &new->data.block_p[((size_t)by * blocksX(t) + bx) * BLOCK_BYTES]);
+			}
+		}
+		return new;
+	}
+	for (unsigned y = 0; y < t->height; ++y) {
+		for (unsigned x = 0; x < t->width; ++x) {
+			setPixel(new, textureGetPixel(t, x, y), x, y);
+		}
+	}
+	return new;
+}
+
 void textureFromSRGB(struct texture *t) {
 	if (t->colorspace == sRGB) return;
 	for (unsigned x = 0; x < t->width; ++x) {
@@ -9,6 +9,8 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 enum colorspace {
 	linear,
@@ -18,6 +20,8 @@ enum colorspace {
 enum precision {
 	char_p,
 	float_p,
+	half_p, //16-bit floats, half the size of float_p
+	block_p, //RGB in 4x4 blocks of 16 bytes, read-only
 	none
 };
 
@@ -28,6 +32,8 @@ struct texture {
 	union {
 		unsigned char *byte_p; //For 24/32bit
 		float *float_p; //For hdr
+		uint16_t *half_p;
+		unsigned char *block_p;
 	} data;
 	int channels;
 	unsigned width;
@@ -38,8 +44,15 @@ struct color;
 
 struct texture *newTexture(enum precision p, unsigned width, unsigned height, int channels);
 
+/// Store a pixel. Not supported for block_p textures, see convertTexture().
 void setPixel(struct texture *t, struct color c, unsigned int x, unsigned int y);
 
+/// Store a linear color as sRGB. Same as setPixel(t, toSRGB(c), x, y), but 8-bit textures
+/// are encoded with a table instead of powf(), and rounded instead of truncated.
+/// @param t Texture to store the pixel in
+/// @param c Linear color
+void setPixelSRGB(struct texture *t, struct color c, unsigned x, unsigned y);
+
 /// Get the color of a pixel from a given texture
 /// @param t Texture to retrieve color from
 /// @param x X coordinate of pixel
@@ -47,6 +60,18 @@ void setPixel(struct texture *t, struct color c, unsigned int x, unsigned int y)
 struct color textureGetPixel(const struct texture *t, unsigned x, unsigned y);
 struct color textureGetPixelFiltered(const struct texture *t, float x, float y);
 
+/// Make a copy of a texture in another precision, for storing HDR data compactly.
+/// half_p keeps 11 significant bits and clamps to +-65504. block_p stores each 4x4 block
+/// as two shared exponent RGB endpoints and 16 steps between them, at 1 byte per pixel.
+/// It drops alpha and clamps negative values to 0, so use it for RGB radiance only.
+/// @param t Texture to convert, left unchanged
+/// @param precision Precision of the copy
+/// @return New texture, or NULL if it couldn't be allocated
+struct texture *convertTexture(const struct texture *t, enum precision precision);
+
+/// Size of the pixel data of a texture, in bytes
+size_t textureBytes(const struct texture *t);
+
 /// Convert texture from sRGB to linear color space
 /// @remarks The texture data will be modified directly.
 /// @param t Texture to convert
@@ -0,0 +1,362 @@
+//
+//  texturecache.c
+//  C-ray
+//
+//  Created by Valtteri on 18.10.2020.
+//  Copyright © 2020 Valtteri Koskivuori. All rights reserved.
+//
+
+#include "../../includes.h"
+#include "texturecache.h"
+
+#include "texture.h"
+#include "../../utils/logging.h"
+#include "../../utils/string.h"
+#include "../../utils/fileio.h"
+#include "../../utils/hashtable.h"
+#include "../../utils/statistics.h"
+#include "../../utils/platform/mutex.h"
+#include "../../utils/platform/thread.h"
+#include "../../utils/platform/atomic.h"
+#include "../../utils/loaders/textureloader.h"
+
+struct cacheEntry {
+	char *path; //Canonical, so every path to the same file maps to one entry
+	uint64_t hash; //Of the path, to skip most string compares when looking up
+	int references; //Materials using this mipmap
+	struct crMutex *loadMutex; //Held while decoding, so two threads never decode the same file
+};
+
+//Evicted level data, freed once no thread can be reading it anymore
+struct retiredLevel {
+	void *data;
+	unsigned epoch;
+};
+
+struct textureCache {
+	struct crMutex *mutex; //Guards everything here, and all writes to level data pointers
+	size_t budget;
+	size_t resident;
+	unsigned clock; //Bumped on every textureCacheEnter(), the LRU timestamp
+	
+	struct mipmap **mipmaps;
+	int mipmapCount;
+	
+	//Epoch based reclamation. Threads inside the cache are counted
+	//in active[epoch & 1] of the epoch they entered in.
+	unsigned epoch;
+	int active[2];
+	struct retiredLevel *retired;
+	int retiredCount;
+	int retiredCapacity;
+	
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t evictions;
+	
+	int references; //Total textureCacheAdd() calls that returned a mipmap, for reporting sharing
+};
+
+//Hits are counted without locking, and added to the cache totals when a thread leaves
+static THREAD_LOCAL uint64_t threadHits = 0;
+
+struct textureCache *newTextureCache(size_t budget) {
+	struct textureCache *cache = calloc(1, sizeof(*cache));
+	cache->mutex = createMutex();
+	cache->budget = budget;
+	return cache;
+}
+
+static void retire(struct textureCache *cache, void *data);
+static void reclaim(struct textureCache *cache);
+
+//Free a mipmap that's no longer in the cache, along with its entry
+static void destroyEntry(struct mipmap *m) {
+	free(m->entry->path);
+	destroyMutex(m->entry->loadMutex);
+	free(m->entry);
+	destroyMipmap(m);
+}
+
+//Must hold the cache mutex
+static struct mipmap *findMipmap(struct textureCache *cache, const char *path, uint64_t hash, enum colorspace colorspace) {
+	for (int i = 0; i < cache->mipmapCount; ++i) {
+		struct mipmap *m = cache->mipmaps[i];
+		if (m->entry->hash == hash && m->colorspace == colorspace && !strcmp(m->entry->path, path)) return m;
+	}
+	return NULL;
+}
+
+struct mipmap *textureCacheAdd(struct textureCache *cache, const char *path, enum colorspace colorspace) {
+	char *pathCopy = copyString(path);
+	pathCopy[strcspn(pathCopy, "\n")] = 0;
+	char *canonical = getCanonicalPath(pathCopy);
+	free(pathCopy);
+	const uint64_t hash = hashDataToU64(canonical, strlen(canonical));
+	
+	lockMutex(cache->mutex);
+	struct mipmap *shared = findMipmap(cache, canonical, hash, colorspace);
+	if (shared) {
+		shared->entry->references++;
+		cache->references++;
+	}
+	releaseMutex(cache->mutex);
+	if (shared) {
+		free(canonical);
+		return shared;
+	}
+	
+	unsigned width, height;
+	int channels;
+	if (!loadTextureInfo(canonical, &width, &height, &channels)) {
+		free(canonical);
+		return NULL;
+	}
+	//Textures are always decoded to 8 bits per channel, see loadTextureFromBuffer()
+	struct mipmap *m = newMipmapLayout(width, height, channels, char_p, colorspace);
+	if (!m) {
+		free(canonical);
+		return NULL;
+	}
+	m->cache = cache;
+	m->entry = calloc(1, sizeof(*m->entry));
+	m->entry->path = canonical;
+	m->entry->hash = hash;
+	m->entry->references = 1;
+	m->entry->loadMutex = createMutex();
+	
+	lockMutex(cache->mutex);
+	//Meshes register their textures from their own loading threads, don't add a file twice if another one beat us to it
+	shared = findMipmap(cache, canonical, hash, colorspace);
+	if (shared) {
+		shared->entry->references++;
+	} else {
+		cache->mipmaps = realloc(cache->mipmaps, (cache->mipmapCount + 1) * sizeof(*cache->mipmaps));
+		cache->mipmaps[cache->mipmapCount++] = m;
+	}
+	cache->references++;
+	releaseMutex(cache->mutex);
+	if (shared) {
+		destroyEntry(m);
+		return shared;
+	}
+	return m;
+}
+
+void textureCacheRelease(struct mipmap *m) {
+	if (!m || !m->cache) return;
+	struct textureCache *cache = m->cache;
+	lockMutex(cache->mutex);
+	if (--m->entry->references > 0) {
+		releaseMutex(cache->mutex);
+		return;
+	}
+	for (int i = 0; i < cache->mipmapCount; ++i) {
+		if (cache->mipmaps[i] == m) {
+			cache->mipmaps[i] = cache->mipmaps[--cache->mipmapCount];
+			break;
+		}
+	}
+	for (int level = 0; level < m->levelCount; ++level) {
+		if (!m->levels[level].data.byte_p) continue;
+		cache->resident -= mipLevelBytes(m, level);
+		retire(cache, m->levels[level].data.byte_p);
+		m->levels[level].data.byte_p = NULL;
+	}
+	reclaim(cache);
+	releaseMutex(cache->mutex);
+	destroyEntry(m);
+}
+
+void textureCacheSummary(struct textureCache *cache) {
+	if (!cache) return;
+	lockMutex(cache->mutex);
+	size_t bytes = 0;
+	for (int i = 0; i < cache->mipmapCount; ++i) {
+		for (int level = 0; level < cache->mipmaps[i]->levelCount; ++level) {
+			bytes += mipLevelBytes(cache->mipmaps[i], level);
+		}
+	}
+	if (cache->mipmapCount) {
+		char *size = humanFileSize(bytes);
+		logr(info, "Textures: %i files for %i maps, %s if all resident\n", cache->mipmapCount, cache->references, size);
+		free(size);
+	}
+	releaseMutex(cache->mutex);
+}
+
+static inline void *levelData(const struct mipLevel *l) {
+	return atomicLoadPointer((void *const *)&l->data.byte_p);
+}
+
+static inline void setLevelData(struct mipLevel *l, void *data) {
+	atomicStorePointer((void **)&l->data.byte_p, data);
+}
+
+//Free retired levels no thread can hold anymore. Must hold the cache mutex.
+static void reclaim(struct textureCache *cache) {
+	if (!cache->active[0] && !cache->active[1]) {
+		for (int i = 0; i < cache->retiredCount; ++i) free(cache->retired[i].data);
+		cache->retiredCount = 0;
+		return;
+	}
+	//Move on once every thread from the previous epoch has left. Threads that could
+	//have seen a level retired in epoch e entered in e or earlier, so they are all gone by e + 2.
+	if (!cache->active[(cache->epoch + 1) & 1]) cache->epoch++;
+	int kept = 0;
+	for (int i = 0; i < cache->retiredCount; ++i) {
+		if (cache->epoch - cache->retired[i].epoch >= 2) {
+			free(cache->retired[i].data);
+		} else {
+			cache->retired[kept++] = cache->retired[i];
+		}
+	}
+	cache->retiredCount = kept;
+}
+
+static void retire(struct textureCache *cache, void *data) {
+	if (cache->retiredCount == cache->retiredCapacity) {
+		cache->retiredCapacity = cache->retiredCapacity ? cache->retiredCapacity * 2 : 16;
+		cache->retired = realloc(cache->retired, cache->retiredCapacity * sizeof(*cache->retired));
+	}
+	cache->retired[cache->retiredCount++] = (struct retiredLevel){data, cache->epoch};
+}
+
+//Evict least recently used levels until we're within budget. Levels of the mipmap
+//that was just loaded are kept, even if that texture alone is over budget.
+//Must hold the cache mutex.
+static void evict(struct textureCache *cache, const struct mipmap *keep) {
+	while (cache->resident > cache->budget) {
+		struct mipmap *victim = NULL;
+		int victimLevel = 0;
+		unsigned oldest = 0;
+		for (int i = 0; i < cache->mipmapCount; ++i) {
+			struct mipmap *m = cache->mipmaps[i];
+			if (m == keep) continue;
+			for (int level = 0; level < m->levelCount; ++level) {
+				if (!m->levels[level].data.byte_p) continue;
+				const unsigned age = cache->clock - atomicLoadRelaxed(&m->levels[level].lastUse);
+				if (!victim || age > oldest) {
+					victim = m;
+					victimLevel = level;
+					oldest = age;
+				}
+			}
+		}
+		if (!victim) break;
+		retire(cache, victim->levels[victimLevel].data.byte_p);
+		setLevelData(&victim->levels[victimLevel], NULL);
+		cache->resident -= mipLevelBytes(victim, victimLevel);
+		cache->evictions++;
+	}
+}
+
+//Decode the file, and keep the requested level and the ones below it.
+//Smaller levels are cheap, and trilinear lookups need the next one anyway.
+static void *loadLevel(struct mipmap *m, int level) {
+	struct textureCache *cache = m->cache;
+	lockMutex(m->entry->loadMutex);
+	void *data = levelData(&m->levels[level]);
+	if (data) {
+		//Another thread got here first
+		releaseMutex(m->entry->loadMutex);
+		threadHits++;
+		return data;
+	}
+	
+	struct texture *image = loadTexture(m->entry->path);
+	struct mipmap *decoded = newMipmap(image, m->colorspace);
+	destroyTexture(image);
+	if (!decoded || decoded->levels[0].width != m->levels[0].width || decoded->levels[0].height != m->levels[0].height || decoded->channels != m->channels) {
+		//The file changed or went away since it was added. Render it black rather than crash.
+		logr(warning, "Failed to load texture \"%s\", it has changed since the scene was loaded\n", m->entry->path);
+		destroyMipmap(decoded);
+		decoded = newMipmapLayout(m->levels[0].width, m->levels[0].height, m->channels, m->precision, m->colorspace);
+		for (int i = level; i < m->levelCount; ++i) {
+			decoded->levels[i].data.byte_p = calloc(mipLevelBytes(decoded, i), 1);
+		}
+	}
+	
+	lockMutex(cache->mutex);
+	for (int i = level; i < m->levelCount; ++i) {
+		if (m->levels[i].data.byte_p) continue;
+		atomicStoreRelaxed(&m->levels[i].lastUse, cache->clock);
+		setLevelData(&m->levels[i], decoded->levels[i].data.byte_p);
+		decoded->levels[i].data.byte_p = NULL;
+		cache->resident += mipLevelBytes(m, i);
+	}
+	data = m->levels[level].data.byte_p;
+	cache->misses++;
+	evict(cache, m);
+	reclaim(cache);
+	releaseMutex(cache->mutex);
+	releaseMutex(m->entry->loadMutex);
+	destroyMipmap(decoded);
+	return data;
+}
+
+struct mipLevel textureCacheLevel(const struct mipmap *m, int level) {
+	//Only the lastUse timestamp is written here, texels stay read-only
+	struct mipLevel *l = &((struct mipmap *)m)->levels[level];
+	void *data = levelData(l);
+	if (likely(data != NULL)) {
+		threadHits++;
+	} else {
+		data = loadLevel((struct mipmap *)m, level);
+	}
+	const unsigned now = atomicLoadRelaxed(&m->cache->clock);
+	if (atomicLoadRelaxed(&l->lastUse) != now) atomicStoreRelaxed(&l->lastUse, now);
+	return (struct mipLevel){.data.byte_p = data, .width = l->width, .height = l->height, .tilesX = l->tilesX};
+}
+
+int textureCacheEnter(struct textureCache *cache) {
+	if (!cache) return 0;
+	lockMutex(cache->mutex);
+	const unsigned epoch = cache->epoch;
+	cache->active[epoch & 1]++;
+	atomicStoreRelaxed(&cache->clock, cache->clock + 1);
+	releaseMutex(cache->mutex);
+	return (int)epoch;
+}
+
+void textureCacheLeave(struct textureCache *cache, int epoch) {
+	if (!cache) return;
+	lockMutex(cache->mutex);
+	cache->active[epoch & 1]--;
+	cache->hits += threadHits;
+	threadHits = 0;
+	reclaim(cache);
+	releaseMutex(cache->mutex);
+}
+
+size_t textureCacheResidentBytes(struct textureCache *cache) {
+	lockMutex(cache->mutex);
+	const size_t resident = cache->resident;
+	releaseMutex(cache->mutex);
+	return resident;
+}
+
+void collectTextureCacheStats(struct textureCache *cache, struct stats *stats) {
+	if (!cache) return;
+	lockMutex(cache->mutex);
+	cache->hits += threadHits;
+	threadHits = 0;
+	stats_add(stats, texture_hits, cache->hits);
+	stats_add(stats, texture_misses, cache->misses);
+	stats_add(stats, texture_evictions, cache->evictions);
+	cache->hits = 0;
+	cache->misses = 0;
+	cache->evictions = 0;
+	releaseMutex(cache->mutex);
+}
+
+void destroyTextureCache(struct textureCache *cache) {
+	if (cache) {
+		for (int i = 0; i < cache->retiredCount; ++i) free(cache->retired[i].data);
+		free(cache->retired);
+		for (int i = 0; i < cache->mipmapCount; ++i) destroyEntry(cache->mipmaps[i]);
+		free(cache->mipmaps);
+		destroyMutex(cache->mutex);
+		free(cache);
+	}
+}
@@ -0,0 +1,61 @@
+//
+//  texturecache.h
+//  C-ray
+//
+//  Created by Valtteri on 18.10.2020.
+//  Copyright © 2020 Valtteri Koskivuori. All rights reserved.
+//
+
+#pragma once
+
+#include "mipmap.h"
+
+struct stats;
+
+/// Owns the mipmaps of scene textures, and decodes their levels from disk the first
+/// time they are sampled. Levels that haven't been used for the longest time are evicted
+/// to stay within a memory budget, and loaded again if they are needed later.
+/// Lookups don't take any locks. Render threads bracket their work with
+/// textureCacheEnter() and textureCacheLeave(), and evicted levels are only freed
+/// once every thread that could still be reading them has left.
+struct textureCache;
+
+/// @param budget Maximum amount of texel data to keep resident, in bytes
+struct textureCache *newTextureCache(size_t budget);
+
+/// Register a texture file with the cache, and take a reference to it. Only the file header is read here.
+/// Paths that resolve to a file already in the cache with the same color space share its mipmap.
+/// @param cache Cache to add the texture to
+/// @param path Path to the image file
+/// @param colorspace Color space the texture data is in
+/// @return Mipmap owned by the cache. NULL if the file can't be read.
+struct mipmap *textureCacheAdd(struct textureCache *cache, const char *path, enum colorspace colorspace);
+
+/// Drop a reference taken with textureCacheAdd(). The mipmap is freed when the last one is dropped.
+/// @remarks Not safe while rendering, as threads may be sampling the mipmap.
+void textureCacheRelease(struct mipmap *m);
+
+/// Log how many files the cache holds, and how many material maps share them
+void textureCacheSummary(struct textureCache *cache);
+
+/// Start using textures from the cache on the calling thread
+/// @param cache Cache, or NULL
+/// @return Epoch to pass to textureCacheLeave()
+int textureCacheEnter(struct textureCache *cache);
+
+/// Stop using textures from the cache. Levels handed out since textureCacheEnter() may be freed after this.
+void textureCacheLeave(struct textureCache *cache, int epoch);
+
+/// Get a level of a mipmap owned by the cache, loading it if it isn't resident.
+/// @remarks The calling thread has to be between textureCacheEnter() and textureCacheLeave()
+/// @return Copy of the level, with texel data that stays valid until textureCacheLeave()
+struct mipLevel textureCacheLevel(const struct mipmap *m, int level);
+
+/// Amount of texel data currently resident, in bytes
+size_t textureCacheResidentBytes(struct textureCache *cache);
+
+/// Add lookup hits, misses and evictions since the last call to the given stats
+void collectTextureCacheStats(struct textureCache *cache, struct stats *stats);
+
+/// Free the cache and every mipmap in it
+void destroyTextureCache(struct textureCache *cache);
@@ -15,19 +15,25 @@
 #include "bbox.h"
 #include "mesh.h"
 #include "sphere.h"
+#include "poly.h"
 #include "scene.h"
+#include "../utils/statistics.h"
 
-static bool intersectSphere(const struct instance *instance, const struct lightRay *ray, struct hitRecord *isect) {
+static bool intersectSphere(const struct instance *instance, const struct lightRay *ray, struct hit *hit, struct stats *stats) {
+	stats_add(stats, sphere_tests, 1);
 	struct lightRay copy = *ray;
 	transformRay(&copy, &instance->composite.Ainv);
-	if (rayIntersectsWithSphere(&copy, (struct sphere*)instance->object, isect)) {
-		isect->polygon = NULL;
-		isect->material = ((struct sphere*)instance->object)->material;
-		transformPoint(&isect->hitPoint, &instance->composite.A);
-		transformVectorWithTranspose(&isect->surfaceNormal, &instance->composite.Ainv);
-		return true;
-	}
-	return false;
+	return rayIntersectsWithSphere(&copy, (struct sphere*)instance->object, hit);
+}
+
+static void sphereSurface(const struct instance *instance, const struct lightRay *ray, struct hitRecord *isect) {
+	struct lightRay copy = *ray;
+	transformRay(&copy, &instance->composite.Ainv);
+	isect->material = &((struct sphere*)instance->object)->material;
+	isect->hitPoint = alongRay(&copy, isect->distance);
+	isect->surfaceNormal = vecNormalize(isect->hitPoint);
+	transformPoint(&isect->hitPoint, &instance->composite.A);
+	transformVectorWithTranspose(&isect->surfaceNormal, &instance->composite.Ainv);
 }
 
 static void getSphereBBoxAndCenter(const struct instance *instance, struct boundingBox *bbox, struct vector *center) {
@@ -50,28 +56,38 @@ struct instance newSphereInstance(struct sphere *sphere) {
 		.object = sphere,
 		.composite = newTransform(),
 		.intersectFn = intersectSphere,
+		.surfaceFn = sphereSurface,
 		.getBBoxAndCenterFn = getSphereBBoxAndCenter
 	};
 }
 
-static bool intersectMesh(const struct instance *instance, const struct lightRay *ray, struct hitRecord *isect) {
+static bool intersectMesh(const struct instance *instance, const struct lightRay *ray, struct hit *hit, struct stats *stats) {
 	struct lightRay copy = *ray;
 	transformRay(&copy, &instance->composite.Ainv);
-	if (traverseBottomLevelBvh((struct mesh*)instance->object, &copy, isect)) {
-		isect->material = ((struct mesh*)instance->object)->materials[isect->polygon->materialIndex];
-		transformPoint(&isect->hitPoint, &instance->composite.A);
-		transformVectorWithTranspose(&isect->surfaceNormal, &instance->composite.Ainv);
-		if (likely(!isect->material.hasNormalMap)) {
-			isect->surfaceNormal = vecNormalize(isect->surfaceNormal);
-		} else {
-			//struct color pixel = colorForUV(isect, Normal);
-			// FIXME
-			//isect->surfaceNormal = vecNormalize((struct vector){(pixel.red * 2.0f) - 1.0f, (pixel.green * 2.0f) - 1.0f, pixel.blue * 0.5f});
-			isect->surfaceNormal = vecNormalize(isect->surfaceNormal);
-		}
-		return true;
+	return traverseBottomLevelBvh((struct mesh*)instance->object, &copy, hit, stats);
+}
+
+static void meshSurface(const struct instance *instance, const struct lightRay *ray, struct hitRecord *isect) {
+	struct lightRay copy = *ray;
+	transformRay(&copy, &instance->composite.Ainv);
+	const struct mesh *mesh = instance->object;
+	isect->mesh = mesh;
+	isect->material = &mesh->materials[isect->polygon->materialIndex];
+	isect->hitPoint = alongRay(&copy, isect->distance);
+	isect->surfaceNormal = polygonNormal(mesh, isect->polygon, isect->uv);
+	if (isect->material->hasTexture || isect->material->hasNormalMap || isect->material->hasSpecularMap) {
+		isect->uvScale = polygonUVScale(mesh, isect->polygon, &instance->composite.A);
+	}
+	transformPoint(&isect->hitPoint, &instance->composite.A);
+	transformVectorWithTranspose(&isect->surfaceNormal, &instance->composite.Ainv);
+	if (likely(!isect->material->hasNormalMap)) {
+		isect->surfaceNormal = vecNormalize(isect->surfaceNormal);
+	} else {
+		//struct color pixel = colorForUV(isect, Normal);
+		// FIXME
+		//isect->surfaceNormal = vecNormalize((struct vector){(pixel.red * 2.0f) - 1.0f, (pixel.green * 2.0f) - 1.0f, pixel.blue * 0.5f});
+		isect->surfaceNormal = vecNormalize(isect->surfaceNormal);
 	}
-	return false;
 }
 
 static void getMeshBBoxAndCenter(const struct instance *instance, struct boundingBox *bbox, struct vector *center) {
@@ -86,6 +102,7 @@ struct instance newMeshInstance(struct mesh *mesh) {
 		.object = mesh,
 		.composite = newTransform(),
 		.intersectFn = intersectMesh,
+		.surfaceFn = meshSurface,
 		.getBBoxAndCenterFn = getMeshBBoxAndCenter
 	};
 }
@@ -14,7 +14,9 @@
 struct world;
 struct matrix4x4;
 struct lightRay;
+struct hit;
 struct hitRecord;
+struct stats;
 
 struct sphere;
 struct mesh;
@@ -22,7 +24,9 @@ struct mesh;
 struct instance {
 	enum {Mesh, Sphere} type;
 	struct transform composite;
-	bool (*intersectFn)(const struct instance*, const struct lightRay*, struct hitRecord*);
+	bool (*intersectFn)(const struct instance*, const struct lightRay*, struct hit*, struct stats*);
+	//Fill in the hit point, normal and material for the closest hit, after traversal
+	void (*surfaceFn)(const struct instance*, const struct lightRay*, struct hitRecord*);
 	void (*getBBoxAndCenterFn)(const struct instance*, struct boundingBox*, struct vector*);
 	void *object;
 };
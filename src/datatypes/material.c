@@ -10,8 +10,9 @@
 #include "material.h"
 
 #include "../renderer/pathtrace.h"
-#include "vertexbuffer.h"
-#include "image/texture.h"
+#include "mesh.h"
+#include "image/mipmap.h"
+#include "image/texturecache.h"
 #include "poly.h"
 #include "../utils/assert.h"
 
@@ -73,27 +74,22 @@ void assignBSDF(struct material *mat) {
 //Transform the intersection coordinates to the texture coordinate space
 //And grab the color at that point. Texture mapping.
 struct color colorForUV(const struct hitRecord *isect, enum textureType type) {
-	struct color output;
-	const struct texture *tex = NULL;
+	const struct mipmap *tex = NULL;
 	switch (type) {
 		case Normal:
-			tex = isect->material.hasNormalMap ? isect->material.normalMap : NULL;
+			tex = isect->material->hasNormalMap ? isect->material->normalMap : NULL;
 			break;
 		case Specular:
-			tex = isect->material.hasSpecularMap ? isect->material.specularMap : NULL;
+			tex = isect->material->hasSpecularMap ? isect->material->specularMap : NULL;
 			break;
 		default:
-			tex = isect->material.hasTexture ? isect->material.texture : NULL;
+			tex = isect->material->hasTexture ? isect->material->texture : NULL;
 			break;
 	}
 	
 	if (!tex) return warningMaterial().diffuse;
 	
-	const struct poly *p = isect->polygon;
-	
-	//Texture width and height for this material
-	const float width = tex->width;
-	const float heigh = tex->height;
+	const struct triangle *p = isect->polygon;
 
 	//barycentric coordinates for this polygon
 	const float u = isect->uv.x;
@@ -101,23 +97,16 @@ struct color colorForUV(const struct hitRecord *isect, enum textureType type) {
 	const float w = 1.0f - u - v;
 	
 	//Weighted texture coordinates
-	const struct coord ucomponent = coordScale(u, g_textureCoords[p->textureIndex[1]]);
-	const struct coord vcomponent = coordScale(v, g_textureCoords[p->textureIndex[2]]);
-	const struct coord wcomponent = coordScale(w, g_textureCoords[p->textureIndex[0]]);
+	const struct coord ucomponent = coordScale(u, meshTextureCoord(isect->mesh, p->index[1]));
+	const struct coord vcomponent = coordScale(v, meshTextureCoord(isect->mesh, p->index[2]));
+	const struct coord wcomponent = coordScale(w, meshTextureCoord(isect->mesh, p->index[0]));
 	
 	// textureXY = u * v1tex + v * v2tex + w * v3tex
 	const struct coord textureXY = addCoords(addCoords(ucomponent, vcomponent), wcomponent);
 	
-	const float x = (textureXY.x*(width));
-	const float y = (textureXY.y*(heigh));
-	
-	//Get the color value at these XY coordinates
-	output = textureGetPixelFiltered(tex, x, y);
-	
-	//Since the texture is probably srgb, transform it back to linear colorspace for rendering
-	if (type == Diffuse) output = fromSRGB(output);
-	
-	return output;
+	//Get the color value at these texture coordinates, filtered over the ray footprint.
+	//sRGB textures are decoded to linear as they are filtered.
+	return mipmapSample(tex, textureXY, isect->footprint * isect->uvScale);
 }
 
 static struct color gradient(struct hitRecord *isect) {
@@ -133,8 +122,8 @@ static struct color gradient(struct hitRecord *isect) {
 //This is a checkerboard pattern mapped to the surface coordinate space
 //Caveat: This only works for meshes that have texture coordinates (i.e. were UV-unwrapped).
 static struct color mappedCheckerBoard(struct hitRecord *isect, float coef) {
-	ASSERT(isect->material.hasTexture);
-	const struct poly *p = isect->polygon;
+	ASSERT(isect->material->hasTexture);
+	const struct triangle *p = isect->polygon;
 	
 	//barycentric coordinates for this polygon
 	const float u = isect->uv.x;
@@ -142,9 +131,9 @@ static struct color mappedCheckerBoard(struct hitRecord *isect, float coef) {
 	const float w = 1.0f - u - v;
 	
 	//Weighted coordinates
-	const struct coord ucomponent = coordScale(u, g_textureCoords[p->textureIndex[1]]);
-	const struct coord vcomponent = coordScale(v, g_textureCoords[p->textureIndex[2]]);
-	const struct coord wcomponent = coordScale(w, g_textureCoords[p->textureIndex[0]]);
+	const struct coord ucomponent = coordScale(u, meshTextureCoord(isect->mesh, p->index[1]));
+	const struct coord vcomponent = coordScale(v, meshTextureCoord(isect->mesh, p->index[2]));
+	const struct coord wcomponent = coordScale(w, meshTextureCoord(isect->mesh, p->index[0]));
 	
 	// textureXY = u * v1tex + v * v2tex + w * v3tex
 	const struct coord surfaceXY = addCoords(addCoords(ucomponent, vcomponent), wcomponent);
@@ -170,7 +159,7 @@ static struct color unmappedCheckerBoard(struct hitRecord *isect, float coef) {
 }
 
 static struct color checkerBoard(struct hitRecord *isect, float coef) {
-	return isect->material.hasTexture ? mappedCheckerBoard(isect, coef) : unmappedCheckerBoard(isect, coef);
+	return isect->material->hasTexture ? mappedCheckerBoard(isect, coef) : unmappedCheckerBoard(isect, coef);
 }
 
 static struct vector reflectVec(const struct vector *incident, const struct vector *normal) {
@@ -209,11 +198,11 @@ bool weightedBSDF(struct hitRecord *isect, struct color *attenuation, struct lig
 
 //TODO: Make this a function ptr in the material?
 static struct color diffuseColor(const struct hitRecord *isect) {
-	return isect->material.hasTexture ? colorForUV(isect, Diffuse) : isect->material.diffuse;
+	return isect->material->hasTexture ? colorForUV(isect, Diffuse) : isect->material->diffuse;
 }
 
 static float roughnessValue(const struct hitRecord *isect) {
-	return isect->material.hasSpecularMap ? colorForUV(isect, Specular).red : isect->material.roughness;
+	return isect->material->hasSpecularMap ? colorForUV(isect, Specular).red : isect->material->roughness;
 }
 
 bool lambertianBSDF(const struct hitRecord *isect, struct color *attenuation, struct lightRay *scattered, sampler *sampler) {
@@ -285,16 +274,16 @@ bool plasticBSDF(const struct hitRecord *isect, struct color *attenuation, struc
 	
 	if (vecDot(isect->incident.direction, isect->surfaceNormal) > 0.0f) {
 		outwardNormal = vecNegate(isect->surfaceNormal);
-		niOverNt = isect->material.IOR;
-		cosine = isect->material.IOR * vecDot(isect->incident.direction, isect->surfaceNormal) / vecLength(isect->incident.direction);
+		niOverNt = isect->material->IOR;
+		cosine = isect->material->IOR * vecDot(isect->incident.direction, isect->surfaceNormal) / vecLength(isect->incident.direction);
 	} else {
 		outwardNormal = isect->surfaceNormal;
-		niOverNt = 1.0f / isect->material.IOR;
+		niOverNt = 1.0f / isect->material->IOR;
 		cosine = -(vecDot(isect->incident.direction, isect->surfaceNormal) / vecLength(isect->incident.direction));
 	}
 	
 	if (refract(isect->incident.direction, outwardNormal, niOverNt, &refracted)) {
-		reflectionProbability = schlick(cosine, isect->material.IOR);
+		reflectionProbability = schlick(cosine, isect->material->IOR);
 	} else {
 		*scattered = newRay(isect->hitPoint, reflected, rayTypeReflected);
 		reflectionProbability = 1.0f;
@@ -319,16 +308,16 @@ bool dielectricBSDF(const struct hitRecord *isect, struct color *attenuation, st
 	
 	if (vecDot(isect->incident.direction, isect->surfaceNormal) > 0.0f) {
 		outwardNormal = vecNegate(isect->surfaceNormal);
-		niOverNt = isect->material.IOR;
-		cosine = isect->material.IOR * vecDot(isect->incident.direction, isect->surfaceNormal) / vecLength(isect->incident.direction);
+		niOverNt = isect->material->IOR;
+		cosine = isect->material->IOR * vecDot(isect->incident.direction, isect->surfaceNormal) / vecLength(isect->incident.direction);
 	} else {
 		outwardNormal = isect->surfaceNormal;
-		niOverNt = 1.0f / isect->material.IOR;
+		niOverNt = 1.0f / isect->material->IOR;
 		cosine = -(vecDot(isect->incident.direction, isect->surfaceNormal) / vecLength(isect->incident.direction));
 	}
 	
 	if (refract(isect->incident.direction, outwardNormal, niOverNt, &refracted)) {
-		reflectionProbability = schlick(cosine, isect->material.IOR);
+		reflectionProbability = schlick(cosine, isect->material->IOR);
 	} else {
 		reflectionProbability = 1.0f;
 	}
@@ -353,9 +342,16 @@ void destroyMaterial(struct material *mat) {
 	if (mat) {
 		free(mat->textureFilePath);
 		free(mat->normalMapPath);
+		free(mat->specularMapPath);
 		free(mat->name);
 		if (mat->hasTexture) {
-			destroyTexture(mat->texture);
+			textureCacheRelease(mat->texture);
+		}
+		if (mat->hasNormalMap) {
+			textureCacheRelease(mat->normalMap);
+		}
+		if (mat->hasSpecularMap) {
+			textureCacheRelease(mat->specularMap);
 		}
 	}
 }
@@ -48,6 +48,7 @@
 struct lightRay;
 struct hitRecord;
 struct color;
+struct mipmap;
 
 enum bsdfType {
 	emission = 0,
@@ -71,11 +72,11 @@ struct material {
 	char *specularMapPath;
 	char *name;
 	bool hasTexture;
-	struct texture *texture;
+	struct mipmap *texture;
 	bool hasNormalMap;
-	struct texture *normalMap;
+	struct mipmap *normalMap;
 	bool hasSpecularMap;
-	struct texture *specularMap;
+	struct mipmap *specularMap;
 	struct color ambient;
 	struct color diffuse;
 	struct color specular;
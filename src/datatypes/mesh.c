@@ -10,17 +10,47 @@
 #include "mesh.h"
 
 #include "../accelerators/bvh.h"
-#include "vertexbuffer.h"
 #include "transforms.h"
 #include "poly.h"
 #include "material.h"
 #include "vector.h"
+#include "../utils/fileio.h"
+
+uint32_t encodeNormal(struct vector normal) {
+	const float length = fabsf(normal.x) + fabsf(normal.y) + fabsf(normal.z);
+	if (length == 0.0f) return 0;
+	float x = normal.x / length;
+	float y = normal.y / length;
+	if (normal.z < 0.0f) {
+		const float upperX = x;
+		x = (1.0f - fabsf(y)) * octahedronSign(upperX);
+		y = (1.0f - fabsf(upperX)) * octahedronSign(y);
+	}
+	const int16_t packedX = (int16_t)lroundf(clamp(x, -1.0f, 1.0f) * 32767.0f);
+	const int16_t packedY = (int16_t)lroundf(clamp(y, -1.0f, 1.0f) * 32767.0f);
+	return (uint32_t)(uint16_t)packedX | (uint32_t)(uint16_t)packedY << 16;
+}
+
+static inline uint16_t quantize(float value, float min, float step) {
+	if (step <= 0.0f) return 0;
+	return (uint16_t)lroundf(clamp((value - min) / step, 0.0f, (float)UINT16_MAX));
+}
+
+void encodeTextureCoord(struct mesh *mesh, unsigned index, struct coord uv) {
+	mesh->textureCoords[2 * index + 0] = quantize(uv.x, mesh->uvMin.x, mesh->uvStep.x);
+	mesh->textureCoords[2 * index + 1] = quantize(uv.y, mesh->uvMin.y, mesh->uvStep.y);
+}
 
 void destroyMesh(struct mesh *mesh) {
 	if (mesh) {
 		free(mesh->name);
+		if (!mesh->mapping) free(mesh->vertices);
+		free(mesh->normals);
+		free(mesh->textureCoords);
+		free(mesh->exactTextureCoords);
 		free(mesh->polygons);
 		destroyBvh(mesh->bvh);
+		unmapFile(mesh->mapping);
 		if (mesh->materials) {
 			for (int i = 0; i < mesh->materialCount; ++i) {
 				destroyMaterial(&mesh->materials[i]);
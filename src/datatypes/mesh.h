@@ -8,30 +8,31 @@
 
 #pragma once
 
+#include "vector.h"
+
 /*
- C-Ray stores all vectors and polygons in shared arrays, so these
- data structures just keep track of 'first-index offsets'
- These offsets are the element index of the first vector/polygon for this mesh
- The 'count' values are then used to keep track of where the vectors/polygons stop.
+ Every mesh owns its vertex data. Vertices are welded when the mesh is loaded,
+ so a single index per triangle corner addresses the position, normal and texture
+ coordinate streams. Normals and texture coordinates are stored compressed, and
+ are only there if the mesh has them. Texture coordinates spanning too large a range
+ to quantize finely enough, see MAX_UV_STEP, are kept at full precision instead. Positions of meshes loaded from .crmesh
+ files point straight into the mapped file instead of copying it.
  
  Materials are stored within the mesh struct in *materials
  */
 
 struct mesh {
-	//Vertices
+	//Vertex streams
+	struct vector *vertices;
 	int vertexCount;
-	int firstVectorIndex;
-	
-	//Normals
-	int normalCount;
-	int firstNormalIndex;
-	
-	//Texture coordinates
-	int textureCount;
-	int firstTextureIndex;
+	uint32_t *normals; //Octahedral encoded, see encodeNormal(). NULL if no triangle has normals
+	uint16_t *textureCoords; //u, v pairs quantized to uvStep increments from uvMin. NULL if the mesh has none, or uses exactTextureCoords
+	struct coord *exactTextureCoords; //Used instead of textureCoords when the UV range is too large to quantize
+	struct coord uvMin;
+	struct coord uvStep;
 	
 	//Faces
-	struct poly *polygons;
+	struct triangle *polygons;
 	int polyCount;
 	
 	//Materials
@@ -39,10 +40,46 @@ struct mesh {
 	struct material *materials;
 	
 	struct bvh *bvh;
-
+	struct fileMapping *mapping; //Mesh file the vertex positions and BVH point into, if it was loaded prebuilt
+	
 	char *name;
 };
 
+/// Pack a normal into two 16-bit coordinates on an octahedron. Doesn't need to be normalized.
+uint32_t encodeNormal(struct vector normal);
+
+//Largest texture coordinate quantization step, a quarter of a texel on an 8k texture.
+//This lets quantized coordinates span a range of 2, so textures can repeat once or be slightly offset.
+#define MAX_UV_STEP (1.0f / 32768.0f)
+
+/// Pack texture coordinates into two 16-bit steps from uvMin
+void encodeTextureCoord(struct mesh *mesh, unsigned index, struct coord uv);
+
+static inline float octahedronSign(float value) {
+	return value < 0.0f ? -1.0f : 1.0f;
+}
+
+/// Normal of a vertex, unpacked and normalized
+static inline struct vector meshNormal(const struct mesh *mesh, unsigned index) {
+	const uint32_t packed = mesh->normals[index];
+	const float x = (int16_t)(packed & 0xFFFF) * (1.0f / 32767.0f);
+	const float y = (int16_t)(packed >> 16) * (1.0f / 32767.0f);
+	struct vector n = {x, y, 1.0f - fabsf(x) - fabsf(y)};
+	//The lower hemisphere is folded over the diagonals
+	if (n.z < 0.0f) {
+		n.x = (1.0f - fabsf(y)) * octahedronSign(x);
+		n.y = (1.0f - fabsf(x)) * octahedronSign(y);
+	}
+	return vecNormalize(n);
+}
+
+/// Texture coordinates of a vertex, or 0, 0 if the mesh has none
+static inline struct coord meshTextureCoord(const struct mesh *mesh, unsigned index) {
+	if (unlikely(!mesh->textureCoords)) return mesh->exactTextureCoords ? mesh->exactTextureCoords[index] : (struct coord){0.0f, 0.0f};
+	const uint16_t *uv = &mesh->textureCoords[2 * index];
+	return (struct coord){mesh->uvMin.x + uv[0] * mesh->uvStep.x, mesh->uvMin.y + uv[1] * mesh->uvStep.y};
+}
+
 void transformMesh(struct mesh *mesh);
 
 void destroyMesh(struct mesh *mesh);
@@ -8,46 +8,63 @@
 
 #include "../includes.h"
 #include "poly.h"
-#include "vertexbuffer.h"
 
 #include "vector.h"
 #include "lightRay.h"
 #include "../renderer/pathtrace.h"
+#include "transforms.h"
+#include "mesh.h"
 
-bool rayIntersectsWithPolygon(const struct lightRay *ray, const struct poly *poly, struct hitRecord *isect) {
+bool rayIntersectsWithPolygon(const struct lightRay *ray, const struct vector *vertices, const struct triangle *tri, struct hit *hit) {
 	// Möller-Trumbore ray-triangle intersection routine
 	// (see "Fast, Minimum Storage Ray-Triangle Intersection", by T. Moeller and B. Trumbore)
-	struct vector e1 = vecSub(g_vertices[poly->vertexIndex[0]], g_vertices[poly->vertexIndex[1]]);
-	struct vector e2 = vecSub(g_vertices[poly->vertexIndex[2]], g_vertices[poly->vertexIndex[0]]);
+	struct vector e1 = vecSub(vertices[tri->index[0]], vertices[tri->index[1]]);
+	struct vector e2 = vecSub(vertices[tri->index[2]], vertices[tri->index[0]]);
 	struct vector n = vecCross(e1, e2);
-
-	struct vector c = vecSub(g_vertices[poly->vertexIndex[0]], ray->start);
+	
+	struct vector c = vecSub(vertices[tri->index[0]], ray->start);
 	struct vector r = vecCross(ray->direction, c);
 	float invDet = 1.0f / vecDot(n, ray->direction);
-
+	
 	float u = vecDot(r, e2) * invDet;
 	float v = vecDot(r, e1) * invDet;
-	float w = 1.0f - u - v;
-
+	
 	// This order of comparisons guarantees that none of u, v, or t, are NaNs:
 	// IEEE-754 mandates that they compare to false if the left hand side is a NaN.
 	if (u >= 0.0f && v >= 0.0f && u + v <= 1.0f) {
 		float t = vecDot(n, c) * invDet;
-		if (t >= 0.0f && t < isect->distance) {
-			isect->uv = (struct coord) { u, v };
-			isect->distance = t;
-			if (likely(poly->hasNormals)) {
-				struct vector upcomp = vecScale(g_normals[poly->normalIndex[1]], u);
-				struct vector vpcomp = vecScale(g_normals[poly->normalIndex[2]], v);
-				struct vector wpcomp = vecScale(g_normals[poly->normalIndex[0]], w);
-				
-				isect->surfaceNormal = vecAdd(vecAdd(upcomp, vpcomp), wpcomp);
-			} else {
-				isect->surfaceNormal = n;
-			}
-			isect->hitPoint = alongRay(ray, t);
+		if (t >= 0.0f && t < hit->distance) {
+			hit->uv = (struct coord) { u, v };
+			hit->distance = t;
 			return true;
 		}
 	}
 	return false;
 }
+
+struct vector polygonNormal(const struct mesh *mesh, const struct triangle *tri, struct coord uv) {
+	if (likely(tri->hasNormals)) {
+		float w = 1.0f - uv.x - uv.y;
+		struct vector upcomp = vecScale(meshNormal(mesh, tri->index[1]), uv.x);
+		struct vector vpcomp = vecScale(meshNormal(mesh, tri->index[2]), uv.y);
+		struct vector wpcomp = vecScale(meshNormal(mesh, tri->index[0]), w);
+		return vecAdd(vecAdd(upcomp, vpcomp), wpcomp);
+	}
+	struct vector e1 = vecSub(mesh->vertices[tri->index[0]], mesh->vertices[tri->index[1]]);
+	struct vector e2 = vecSub(mesh->vertices[tri->index[2]], mesh->vertices[tri->index[0]]);
+	return vecCross(e1, e2);
+}
+
+float polygonUVScale(const struct mesh *mesh, const struct triangle *tri, const struct matrix4x4 *toWorld) {
+	struct vector e1 = vecSub(mesh->vertices[tri->index[1]], mesh->vertices[tri->index[0]]);
+	struct vector e2 = vecSub(mesh->vertices[tri->index[2]], mesh->vertices[tri->index[0]]);
+	transformVector(&e1, toWorld);
+	transformVector(&e2, toWorld);
+	const float worldArea = vecLength(vecCross(e1, e2));
+	if (worldArea <= 0.0f) return 0.0f;
+	const struct coord t0 = meshTextureCoord(mesh, tri->index[0]);
+	const struct coord t1 = meshTextureCoord(mesh, tri->index[1]);
+	const struct coord t2 = meshTextureCoord(mesh, tri->index[2]);
+	const float uvArea = fabsf((t1.x - t0.x) * (t2.y - t0.y) - (t1.y - t0.y) * (t2.x - t0.x));
+	return sqrtf(uvArea / worldArea);
+}
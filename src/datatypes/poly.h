@@ -8,6 +8,8 @@
 
 #pragma once
 
+//Polygon as it's read from a mesh file, with separate indices for each vertex attribute.
+//Meshes are converted to triangles once they're loaded, see compactMeshFile()
 struct poly {
 	int vertexIndex[MAX_CRAY_VERTEX_COUNT];
 	int normalIndex[MAX_CRAY_VERTEX_COUNT];
@@ -17,10 +19,28 @@ struct poly {
 	bool hasNormals;
 };
 
+//Triangle of a loaded mesh. Vertices are welded, so one index per corner addresses
+//the position, normal and texture coordinate of the mesh.
+struct triangle {
+	uint32_t index[3];
+	uint16_t materialIndex;
+	bool hasNormals;
+};
+
 struct lightRay;
+struct mesh;
 struct vector;
 struct coord;
-struct hitRecord;
+struct hit;
+struct matrix4x4;
 
 //Calculates intersection between a light ray and a polygon object. Returns true if intersection has happened.
-bool rayIntersectsWithPolygon(const struct lightRay *ray, const struct poly *poly, struct hitRecord *isect);
+//vertices is the vertex array of the mesh the polygon belongs to.
+//Only the distance and barycentric coordinates are stored, see polygonNormal()
+bool rayIntersectsWithPolygon(const struct lightRay *ray, const struct vector *vertices, const struct triangle *tri, struct hit *hit);
+
+//Shading normal at the given barycentric coordinates, interpolated if the polygon has vertex normals. Not normalized.
+struct vector polygonNormal(const struct mesh *mesh, const struct triangle *tri, struct coord uv);
+
+//Texture coordinate units per world unit across the polygon, once transformed with toWorld. Used to size texture filter footprints.
+float polygonUVScale(const struct mesh *mesh, const struct triangle *tri, const struct matrix4x4 *toWorld);
@@ -14,59 +14,40 @@
 #include "../utils/logging.h"
 #include "image/imagefile.h"
 #include "../renderer/renderer.h"
+#include "../renderer/denoise.h"
 #include "image/texture.h"
+#include "image/texturecache.h"
 #include "../renderer/envmap.h"
 #include "camera.h"
-#include "vertexbuffer.h"
 #include "../accelerators/bvh.h"
 #include "tile.h"
 #include "mesh.h"
 #include "poly.h"
-#include "../utils/platform/thread.h"
 #include "../utils/ui.h"
 #include "../datatypes/instance.h"
 #include "../datatypes/bbox.h"
+#include "../utils/args.h"
+#include "../utils/string.h"
+#include "animation.h"
+#include "../renderer/lights.h"
 
-struct bvhBuildTask {
-	struct bvh *bvh;
-	struct poly *polygons;
-	int polyCount;
-};
+//Upper bound for tile splits, per render thread
+#define SPLIT_TILES_PER_THREAD 32
 
-void *bvhBuildThread(void *arg) {
-	struct bvhBuildTask *task = (struct bvhBuildTask*)threadUserData(arg);
-	task->bvh = buildBottomLevelBvh(task->polygons, task->polyCount);
-	return NULL;
-}
-
-static void computeAccels(struct mesh *meshes, int meshCount) {
-	logr(info, "Computing BVHs: ");
-	struct timeval timer = {0};
-	startTimer(&timer);
-	struct bvhBuildTask *tasks = calloc(meshCount, sizeof(*tasks));
-	struct crThread *buildThreads = calloc(meshCount, sizeof(*buildThreads));
-	for (int t = 0; t < meshCount; ++t) {
-		tasks[t] = (struct bvhBuildTask){
-			.polygons = meshes[t].polygons,
-			.polyCount = meshes[t].polyCount
-		};
-		buildThreads[t] = (struct crThread){
-			.threadFunc = bvhBuildThread,
-			.userData = &tasks[t]
-		};
-		if (threadStart(&buildThreads[t])) {
-			logr(error, "Failed to create a bvhBuildTask\n");
-		}
-	}
-	
-	for (int t = 0; t < meshCount; ++t) {
-		threadWait(&buildThreads[t]);
-		meshes[t].bvh = tasks[t].bvh;
-	}
-	printSmartTime(getMs(timer));
-	free(tasks);
-	free(buildThreads);
-	printf("\n");
+//Quantize the image into renderTiles, and reserve room for tiles that get split off
+//at the end of the frame to keep all threads busy
+static void quantizeTiles(struct renderer *r) {
+	free(r->state.renderTiles);
+	r->state.tileCount = quantizeImage(&r->state.renderTiles,
+									   r->prefs.imageWidth,
+									   r->prefs.imageHeight,
+									   r->prefs.tileWidth,
+									   r->prefs.tileHeight,
+									   r->prefs.tileOrder);
+	r->state.finishedTileCount = 0;
+	r->state.tileCapacity = r->state.tileCount + r->prefs.threadCount * SPLIT_TILES_PER_THREAD;
+	r->state.requeueReserve = 0;
+	r->state.renderTiles = realloc(r->state.renderTiles, r->state.tileCapacity * sizeof(*r->state.renderTiles));
 }
 
 struct bvh *computeTopLevelBvh(struct instance *instances, int instanceCount) {
@@ -75,7 +56,7 @@ struct bvh *computeTopLevelBvh(struct instance *instances, int instanceCount) {
 	startTimer(&timer);
 	struct bvh *new = buildTopLevelBvh(instances, instanceCount);
 	printSmartTime(getMs(timer));
-	printf("\n");
+	fprintf(logStream(), "\n");
 	return new;
 }
 
@@ -86,14 +67,22 @@ static void printSceneStats(struct world *scene, unsigned long long ms) {
 	for (int i = 0; i < scene->instanceCount; ++i) {
 		if (scene->instances[i].type == Mesh) polys += ((struct mesh*)scene->instances[i].object)->polyCount;
 	}
-	printf("\n");
+	int vertices = 0, normals = 0, textureCoords = 0;
+	for (int i = 0; i < scene->meshCount; ++i) {
+		const struct mesh *mesh = &scene->meshes[i];
+		vertices += mesh->vertexCount;
+		if (mesh->normals) normals += mesh->vertexCount;
+		if (mesh->textureCoords || mesh->exactTextureCoords) textureCoords += mesh->vertexCount;
+	}
+	fprintf(logStream(), "\n");
 	logr(info, "Totals: %iV, %iN, %iT, %iP, %iS, %iM\n",
-		   vertexCount,
-		   normalCount,
-		   textureCount,
+		   vertices,
+		   normals,
+		   textureCoords,
 		   polys,
 		   scene->sphereCount,
 		   scene->meshCount);
+	textureCacheSummary(scene->textures);
 }
 
 //Split scene loading and prefs?
@@ -119,19 +108,22 @@ int loadScene(struct renderer *r, char *input) {
 			break;
 	}
 	
-	computeAccels(r->scene->meshes, r->scene->meshCount);
+	r->state.parseTimeUs = getUs(timer);
+	//Network workers get the scene as-is, and load it themselves
+	if (isSet("nodes")) r->state.sceneJson = copyString(input);
+	//Mesh BVHs were built while loading, see parseJSON()
+	struct timeval bvhTimer = {0};
+	startTimer(&bvhTimer);
 	r->scene->topLevel = computeTopLevelBvh(r->scene->instances, r->scene->instanceCount);
+	r->state.bvhBuildTimeUs += getUs(bvhTimer);
 	r->scene->rayOffset = 0.000001f * bboxDiagonal(getRootBoundingBox(r->scene->topLevel));
+	r->scene->lights = newLightList(r->scene);
+	if (r->scene->lights) logr(debug, "Sampling %i emitters directly\n", r->scene->lights->count);
 	logr(debug, "Computed ray offset is: %.08f\n", r->scene->rayOffset);
 	printSceneStats(r->scene, getMs(timer));
 	
 	//Quantize image into renderTiles
-	r->state.tileCount = quantizeImage(&r->state.renderTiles,
-									   r->prefs.imageWidth,
-									   r->prefs.imageHeight,
-									   r->prefs.tileWidth,
-									   r->prefs.tileHeight,
-									   r->prefs.tileOrder);
+	quantizeTiles(r);
 	
 	// Some of this stuff seems like it should be in newRenderer(), but notice
 	// how they depend on r->prefs, which is populated by parseJSON
@@ -144,6 +136,9 @@ int loadScene(struct renderer *r, char *input) {
 	//This buffer is used for storing UI stuff like currently rendering tile highlights
 	r->state.uiBuffer = newTexture(char_p, r->prefs.imageWidth, r->prefs.imageHeight, 4);
 	
+	//First hit albedo, normals and depth for the denoiser
+	allocFeatureBuffers(r);
+	
 	//Print a useful warning to user if the defined tile size results in less renderThreads
 	if (r->state.tileCount < r->prefs.threadCount) {
 		logr(warning, "WARNING: Rendering with a less than optimal thread count due to large tile size!\n");
@@ -153,6 +148,41 @@ int loadScene(struct renderer *r, char *input) {
 	return 0;
 }
 
+void setAnimationFrame(struct renderer *r, int frame) {
+	struct animation *animation = r->scene->animation;
+	logr(info, "Setting up frame %i of %i\n", frame + 1, animation->frameCount);
+	for (int i = 0; i < animation->trackCount; ++i) {
+		struct track *track = &animation->tracks[i];
+		if (track->instanceIdx == -1) {
+			r->scene->camera->composite = evaluateTrack(track, frame);
+			updateCam(r->scene->camera);
+		} else {
+			r->scene->instances[track->instanceIdx].composite = evaluateTrack(track, frame);
+		}
+	}
+	
+	//Meshes and their BVHs are in object space, so only the top level needs to move
+	struct timeval timer = {0};
+	startTimer(&timer);
+	destroyBvh(r->scene->topLevel);
+	r->scene->topLevel = computeTopLevelBvh(r->scene->instances, r->scene->instanceCount);
+	r->scene->rayOffset = 0.000001f * bboxDiagonal(getRootBoundingBox(r->scene->topLevel));
+	logr(debug, "Rebuilt top-level BVH in %lims\n", getMs(timer));
+	//Emitters are stored in world space
+	destroyLightList(r->scene->lights);
+	r->scene->lights = newLightList(r->scene);
+	
+	//Splits from the previous frame changed the tiles, so start over
+	quantizeTiles(r);
+	r->state.activeTiles = 0;
+	r->state.idleThreads = 0;
+	struct texture *buffer = r->state.renderBuffer;
+	memset(buffer->data.float_p, 0, buffer->width * buffer->height * buffer->channels * sizeof(*buffer->data.float_p));
+	buffer = r->state.uiBuffer;
+	memset(buffer->data.byte_p, 0, buffer->width * buffer->height * buffer->channels * sizeof(*buffer->data.byte_p));
+	clearFeatureBuffers(r);
+}
+
 //Free scene data
 void destroyScene(struct world *scene) {
 	if (scene) {
@@ -162,6 +192,9 @@ void destroyScene(struct world *scene) {
 			destroyMesh(&scene->meshes[i]);
 		}
 		destroyBvh(scene->topLevel);
+		destroyAnimation(scene->animation);
+		destroyLightList(scene->lights);
+		destroyTextureCache(scene->textures);
 		free(scene->meshes);
 		free(scene->spheres);
 		free(scene);
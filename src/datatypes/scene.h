@@ -33,14 +33,30 @@ struct world {
 	struct sphere *spheres;
 	int sphereCount;
 	
+	//Emissive geometry, for sampling lights directly. NULL if there is none.
+	struct lightList *lights;
+	
 	//Currently only one camera supported
 	struct camera *camera;
 	int cameraCount;
 	
 	//This value is scene-specific
 	float rayOffset;
+	
+	//Owns all mesh textures, and loads them as they are sampled
+	struct textureCache *textures;
+	
+	//Optional, keyframes for rendering a sequence
+	struct animation *animation;
 };
 
 int loadScene(struct renderer *r, char *input);
 
+/// Move the camera and instances to where they are at a given frame of the scene animation,
+/// and get the renderer ready to render it.
+/// @remarks Only the top-level BVH is rebuilt, everything else stays as it is.
+/// @param r Renderer with an animated scene loaded
+/// @param frame Frame to render next
+void setAnimationFrame(struct renderer *r, int frame);
+
 void destroyScene(struct world *scene);
@@ -49,12 +49,9 @@ bool intersect(const struct lightRay *ray, const struct sphere *sphere, float *t
 	return true;
 }
 
-bool rayIntersectsWithSphere(const struct lightRay *ray, const struct sphere *sphere, struct hitRecord *isect) {
-	if (intersect(ray, sphere, &isect->distance)) {
-		//Compute normal and store it to isect
-		isect->hitPoint = alongRay(ray, isect->distance);
-		isect->surfaceNormal = vecNormalize(isect->hitPoint);
-		isect->polygon = NULL;
+bool rayIntersectsWithSphere(const struct lightRay *ray, const struct sphere *sphere, struct hit *hit) {
+	if (intersect(ray, sphere, &hit->distance)) {
+		hit->polygon = NULL;
 		return true;
 	}
 	return false;
@@ -19,5 +19,7 @@ struct sphere {
 
 struct sphere defaultSphere(void);
 
-//Calculates intersection between a light ray and a sphere
-bool rayIntersectsWithSphere(const struct lightRay *ray, const struct sphere *sphere, struct hitRecord *isect);
+struct hit;
+
+//Calculates intersection between a light ray and a sphere. Only the distance is stored.
+bool rayIntersectsWithSphere(const struct lightRay *ray, const struct sphere *sphere, struct hit *hit);
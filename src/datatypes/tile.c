@@ -16,22 +16,118 @@
 #include "../libraries/pcg_basic.h"
 #include "../utils/args.h"
 
+//Tiles smaller than this are not worth splitting any further
+#define MIN_SPLIT_PIXELS 64
+
 static void reorderTiles(struct renderTile **tiles, unsigned tileCount, enum renderOrder tileOrder);
 
-struct renderTile nextTile(struct renderer *r) {
+static struct renderTile getTile(struct renderer *r, bool wait) {
 	struct renderTile tile;
 	memset(&tile, 0, sizeof(tile));
 	tile.tileNum = -1;
+	bool idle = false;
 	lockMutex(r->state.tileMutex);
-	if (r->state.finishedTileCount < r->state.tileCount) {
-		tile = r->state.renderTiles[r->state.finishedTileCount];
-		r->state.renderTiles[r->state.finishedTileCount].isRendering = true;
-		tile.tileNum = r->state.finishedTileCount++;
+	while (!r->state.renderAborted) {
+		if (r->state.finishedTileCount < r->state.tileCount) {
+			tile = r->state.renderTiles[r->state.finishedTileCount];
+			r->state.renderTiles[r->state.finishedTileCount].isRendering = true;
+			tile.tileNum = r->state.finishedTileCount++;
+			r->state.activeTiles++;
+			break;
+		}
+		//Queue is drained. Stick around while other threads may still split their tiles for us.
+		if (!wait || !r->state.activeTiles) break;
+		if (!idle) {
+			r->state.idleThreads++;
+			idle = true;
+		}
+		//Woken up by splitTile(), finishTile() or an abort
+		waitCondition(r->state.workerCond, r->state.tileMutex);
 	}
+	if (idle) r->state.idleThreads--;
 	releaseMutex(r->state.tileMutex);
 	return tile;
 }
 
+struct renderTile nextTile(struct renderer *r) {
+	return getTile(r, true);
+}
+
+struct renderTile tryNextTile(struct renderer *r) {
+	return getTile(r, false);
+}
+
+void finishTile(struct renderer *r, int tileNum) {
+	lockMutex(r->state.tileMutex);
+	r->state.renderTiles[tileNum].isRendering = false;
+	r->state.renderTiles[tileNum].renderComplete = true;
+	r->state.activeTiles--;
+	//Idle threads exit once nothing is left in flight
+	if (!r->state.activeTiles) broadcastCondition(r->state.workerCond);
+	//Let the main thread report progress
+	signalCondition(r->state.mainCond);
+	releaseMutex(r->state.tileMutex);
+}
+
+bool requeueTile(struct renderer *r, int tileNum) {
+	bool queued = false;
+	lockMutex(r->state.tileMutex);
+	struct renderTile tile = r->state.renderTiles[tileNum];
+	r->state.renderTiles[tileNum].isRendering = false;
+	r->state.activeTiles--;
+	if (r->state.tileCount < r->state.tileCapacity) {
+		tile.isRendering = false;
+		tile.renderComplete = false;
+		tile.tileNum = r->state.tileCount;
+		r->state.renderTiles[r->state.tileCount++] = tile;
+		queued = true;
+	}
+	//Wake up idle threads to either grab it, or exit if nothing is left
+	broadcastCondition(r->state.workerCond);
+	releaseMutex(r->state.tileMutex);
+	return queued;
+}
+
+bool splitTile(struct renderer *r, struct renderTile *tile, int nextSample) {
+	//Unlocked early-out, this runs after every sample pass
+	if (!r->state.idleThreads) return false;
+	//Need at least two passes left, a single one isn't worth handing over to another thread
+	if (r->prefs.sampleCount - nextSample < 2) return false;
+	if (tile->width * tile->height < 2 * MIN_SPLIT_PIXELS) return false;
+	
+	bool didSplit = false;
+	lockMutex(r->state.tileMutex);
+	int queued = r->state.tileCount - r->state.finishedTileCount;
+	if (queued < r->state.idleThreads && r->state.tileCount < r->state.tileCapacity - r->state.requeueReserve) {
+		struct renderTile other = *tile;
+		//Split along the longer axis
+		if (tile->width >= tile->height) {
+			tile->end.x = tile->begin.x + tile->width / 2;
+			other.begin.x = tile->end.x;
+		} else {
+			tile->end.y = tile->begin.y + tile->height / 2;
+			other.begin.y = tile->end.y;
+		}
+		tile->width = tile->end.x - tile->begin.x;
+		tile->height = tile->end.y - tile->begin.y;
+		other.width = other.end.x - other.begin.x;
+		other.height = other.end.y - other.begin.y;
+		
+		//Both halves have the same amount of samples done, so the running average carries over
+		other.isRendering = false;
+		other.renderComplete = false;
+		other.startSample = nextSample;
+		other.tileNum = r->state.tileCount;
+		r->state.renderTiles[other.tileNum] = other;
+		r->state.renderTiles[tile->tileNum] = *tile;
+		r->state.tileCount++;
+		signalCondition(r->state.workerCond);
+		didSplit = true;
+	}
+	releaseMutex(r->state.tileMutex);
+	return didSplit;
+}
+
 struct renderTile nextTileInteractive(struct renderer *r) {
 	struct renderTile tile;
 	memset(&tile, 0, sizeof(tile));
@@ -93,6 +189,7 @@ unsigned quantizeImage(struct renderTile **renderTiles, unsigned width, unsigned
 			tile->height = tile->end.y - tile->begin.y;
 			
 			//Samples have to start at 1, so the running average works
+			tile->startSample = 1;
 			tile->isRendering = false;
 			tile->tileNum = tileCount++;
 		}
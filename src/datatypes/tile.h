@@ -23,6 +23,7 @@ struct renderTile {
 	bool isRendering;
 	bool renderComplete;
 	int tileNum;
+	int startSample; //First sample to render. Tiles split off from an in-flight tile start mid-way
 };
 
 /// Quantize the render plane into an array of tiles, with properties as specified in the parameters below
@@ -39,4 +40,28 @@ unsigned quantizeImage(struct renderTile **renderTiles, unsigned width, unsigned
 /// @param r It's the renderer, yo.
 struct renderTile nextTile(struct renderer *r);
 
+/// Grab the next tile from the queue, without waiting for tiles to be split off
+/// @return A tile with tileNum -1 if the queue is empty right now
+struct renderTile tryNextTile(struct renderer *r);
+
 struct renderTile nextTileInteractive(struct renderer *r);
+
+/// Mark a tile as finished, so idle threads know when there is nothing left to split
+/// @param r Renderer
+/// @param tileNum Index of the finished tile
+void finishTile(struct renderer *r, int tileNum);
+
+/// Put an in-flight tile back at the end of the queue, for example when a network worker drops out.
+/// @remarks Room for these has to be reserved in tileCapacity and requeueReserve.
+/// @param r Renderer
+/// @param tileNum Index of the tile to give up
+/// @return false if there was no room to queue the tile again
+bool requeueTile(struct renderer *r, int tileNum);
+
+/// Split an in-flight tile in half if other threads are idling, and queue the other half.
+/// @remarks Call this between sample passes. The split-off half resumes from nextSample.
+/// @param r Renderer
+/// @param tile The tile currently being rendered by the calling thread, shrunk in place when split
+/// @param nextSample The next sample pass the calling thread would render for this tile
+/// @return true if the tile was split
+bool splitTile(struct renderer *r, struct renderTile *tile, int nextSample);
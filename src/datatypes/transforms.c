@@ -339,6 +339,52 @@ static char *transformTypeString(enum transformType type) {
 	}
 }
 
+struct transform transformFromParams(const struct transformParams *params) {
+	switch (params->type) {
+		case transformTypeXRotate:
+			return newTransformRotateX(params->x);
+		case transformTypeYRotate:
+			return newTransformRotateY(params->x);
+		case transformTypeZRotate:
+			return newTransformRotateZ(params->x);
+		case transformTypeScale:
+			return newTransformScale(params->x, params->y, params->z);
+		case transformTypeTranslate:
+			return newTransformTranslate(params->x, params->y, params->z);
+		default:
+			return newTransform();
+	}
+}
+
+struct transform composeTransforms(const struct transform *tforms, size_t count) {
+	struct transform composite = newTransform();
+	
+	// Translates
+	for (size_t i = 0; i < count; ++i) {
+		if (isTranslate(&tforms[i])) {
+			composite.A = multiplyMatrices(&composite.A, &tforms[i].A);
+		}
+	}
+	
+	// Rotates
+	for (size_t i = 0; i < count; ++i) {
+		if (isRotation(&tforms[i])) {
+			composite.A = multiplyMatrices(&composite.A, &tforms[i].A);
+		}
+	}
+	
+	// Scales
+	for (size_t i = 0; i < count; ++i) {
+		if (isScale(&tforms[i])) {
+			composite.A = multiplyMatrices(&composite.A, &tforms[i].A);
+		}
+	}
+	
+	composite.Ainv = inverseMatrix(&composite.A);
+	composite.type = transformTypeComposite;
+	return composite;
+}
+
 bool isRotation(const struct transform *t) {
 	return (t->type == transformTypeXRotate) || (t->type == transformTypeYRotate) || (t->type == transformTypeZRotate);
 }
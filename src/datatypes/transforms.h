@@ -42,6 +42,12 @@ struct transform {
 	struct matrix4x4 Ainv;
 };
 
+//Parameters for a single transform, for when transforms need to be blended (animation keyframes)
+struct transformParams {
+	enum transformType type; //Rotate, translate or scale
+	float x, y, z; //Rotations only use x, in radians
+};
+
 struct material;
 struct vector;
 struct boundingBox;
@@ -59,6 +65,12 @@ struct transform newTransformRotateY(float radians);
 struct transform newTransformRotateZ(float radians);
 struct transform newTransform(void);
 
+struct transform transformFromParams(const struct transformParams *params);
+
+/// Combine a list of transforms into a single composite transform.
+/// @remarks Order is translates, then rotates, then scales, regardless of the order in the list.
+struct transform composeTransforms(const struct transform *tforms, size_t count);
+
 struct matrix4x4 inverseMatrix(const struct matrix4x4 *mtx);
 struct matrix4x4 transposeMatrix(const struct matrix4x4 *tf);
 struct matrix4x4 multiplyMatrices(const struct matrix4x4 *A, const struct matrix4x4 *B); //FIXME: Maybe don't expose this.
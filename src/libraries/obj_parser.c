@@ -3,6 +3,7 @@
 #include <stdlib.h>
 #include "obj_parser.h"
 #include "list.h"
+#include "../utils/fileio.h"
 
 #ifdef WINDOWS
 #include <Shlwapi.h>
@@ -236,6 +237,23 @@ char *filePath(char *fullPath) {
 #endif
 }
 
+//Copy the next line of a mapped file into line, newline included, like fgets() does.
+//Lines longer than the buffer are cut short instead of split in two.
+static int obj_next_line(const struct fileMapping *file, size_t *offset, char *line, size_t line_size)
+{
+	if( *offset >= file->size )
+		return 0;
+	const char *start = (const char*)file->data + *offset;
+	const size_t remaining = file->size - *offset;
+	const char *newline = memchr(start, '\n', remaining);
+	const size_t length = newline ? (size_t)(newline - start) + 1 : remaining;
+	const size_t copied = length < line_size - 1 ? length : line_size - 1;
+	memcpy(line, start, copied);
+	line[copied] = '\0';
+	*offset += length;
+	return 1;
+}
+
 int obj_parse_mtl_file(char *filename, list *material_list)
 {
 	int line_number = 0;
@@ -243,17 +261,18 @@ int obj_parse_mtl_file(char *filename, list *material_list)
 	char current_line[OBJ_LINE_SIZE];
 	char material_open = 0;
 	obj_material *current_mtl = NULL;
-	FILE *mtl_file_stream;
+	struct fileMapping *mtl_file;
+	size_t offset = 0;
 	
 	// open scene
-	mtl_file_stream = fopen( filename, "r");
-	if(mtl_file_stream == 0)
+	mtl_file = mapFile(filename);
+	if(mtl_file == NULL)
 	{
 		fprintf(stderr, "Error reading file: %s\n", filename);
 		return 0;
 	}
 
-	while( fgets(current_line, OBJ_LINE_SIZE, mtl_file_stream) )
+	while( obj_next_line(mtl_file, &offset, current_line, OBJ_LINE_SIZE) )
 	{
 		current_token = strtok( current_line, " \t\n\r");
 		line_number++;
@@ -359,7 +378,7 @@ int obj_parse_mtl_file(char *filename, list *material_list)
 		}
 	}
 	
-	fclose(mtl_file_stream);
+	unmapFile(mtl_file);
 
 	return 1;
 
@@ -367,15 +386,16 @@ int obj_parse_mtl_file(char *filename, list *material_list)
 
 int obj_parse_obj_file(obj_growable_scene_data *growable_data, char *filepath)
 {
-	FILE* obj_file_stream;
+	struct fileMapping *obj_file;
+	size_t offset = 0;
 	int current_material = -1; 
 	char *current_token = NULL;
 	char current_line[OBJ_LINE_SIZE];
 	int line_number = 0;
 	
 	// open scene
-	obj_file_stream = fopen( filepath, "r");
-	if(obj_file_stream == 0)
+	obj_file = mapFile(filepath);
+	if(obj_file == NULL)
 	{
 		//fprintf(stderr, "Error reading file: %s\n", fullPath);
 		return 0;
@@ -394,7 +414,7 @@ int obj_parse_obj_file(obj_growable_scene_data *growable_data, char *filepath)
 
 
 	//parser loop
-	while( fgets(current_line, OBJ_LINE_SIZE, obj_file_stream) )
+	while( obj_next_line(obj_file, &offset, current_line, OBJ_LINE_SIZE) )
 	{
 		current_token = strtok( current_line, " \t\n\r");
 		line_number++;
@@ -508,7 +528,7 @@ int obj_parse_obj_file(obj_growable_scene_data *growable_data, char *filepath)
 		}
 	}
 
-	fclose(obj_file_stream);
+	unmapFile(obj_file);
 	
 	return 1;
 }
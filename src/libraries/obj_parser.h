@@ -132,5 +132,6 @@ typedef struct {
 
 int parse_obj_scene(obj_scene_data *data_out, char *path);
 void delete_obj_data(obj_scene_data *data_out);
+int obj_parse_mtl_file(char *filename, list *material_list);
 
 #endif
@@ -12,9 +12,24 @@
 #include "c-ray.h"
 
 int main(int argc, char *argv[]) {
-	crLog("C-ray v%s [%.8s], © 2015-2020 Valtteri Koskivuori\n", crGetVersion(), crGitHash());
 	crInitialize();
 	crParseArgs(argc, argv);
+	crLog("C-ray v%s [%.8s], © 2015-2020 Valtteri Koskivuori\n", crGetVersion(), crGitHash());
+	if (crOptionIsSet("benchmark")) {
+		int ret = crRunBenchmark();
+		crDestroyOptions();
+		return ret;
+	}
+	if (crOptionIsSet("worker")) {
+		int ret = crStartWorker();
+		crDestroyOptions();
+		return ret;
+	}
+	if (crOptionIsSet("convert")) {
+		int ret = crConvertMesh();
+		crDestroyOptions();
+		return ret;
+	}
 	crInitRenderer();
 	size_t bytes = 0;
 	char *input = crOptionIsSet("inputFile") ? crLoadFile(crPathArg(), &bytes) : crReadStdin(&bytes);
@@ -25,8 +40,12 @@ int main(int argc, char *argv[]) {
 		return -1;
 	}
 	free(input);
-	crRenderSingleFrame();
-	crWriteImage();
+	if (crGetFrameCount() > 1) {
+		crRenderAnimation();
+	} else {
+		crRenderSingleFrame();
+		crWriteImage();
+	}
 	crDestroyRenderer();
 	crDestroyOptions();
 	crLog("Render finished, exiting.\n");
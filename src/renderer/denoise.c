@@ -0,0 +1,299 @@
+//
+//  denoise.c
+//  C-ray
+//
+//  Created by Valtteri on 18.10.2020.
+//  Copyright © 2020 Valtteri Koskivuori. All rights reserved.
+//
+
+#include "../includes.h"
+#include "denoise.h"
+
+#include "../datatypes/image/imagefile.h"
+#include "renderer.h"
+#include "../datatypes/color.h"
+#include "../datatypes/image/texture.h"
+#include "../utils/platform/thread.h"
+#include "../utils/logging.h"
+
+// Edge-avoiding à-trous wavelet transform, from Dammertz et al. 2010.
+// Each pass applies a 5x5 B3 spline kernel with holes, so the footprint doubles every pass,
+// and neighbours are weighted down where color, normal or depth differ too much.
+// Fireflies are clamped first, the edge-stopping weights would otherwise keep them as they are.
+
+#define DENOISE_PASSES 5
+
+static const float kernel[3] = {3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f};
+
+//Weight falloffs. Color sigma is halved every pass, as the noise is filtered out.
+static const float colorPhi = 0.01f;
+static const float normalPhi = 0.2f;
+static const float depthPhi = 0.02f;
+
+//Pixels darker than this aren't demodulated, there's no lighting to separate
+static const float minAlbedo = 0.01f;
+
+struct denoisePass {
+	float *input;
+	float *output;
+	const float *normal;
+	const float *depth;
+	unsigned width;
+	unsigned height;
+	unsigned tileWidth;
+	unsigned tileHeight;
+	int step;
+	float colorPhi;
+	int threadCount;
+	void (*filter)(const struct denoisePass *pass, unsigned x, unsigned y);
+};
+
+struct denoiseThread {
+	const struct denoisePass *pass;
+	int thread;
+};
+
+void allocFeatureBuffers(struct renderer *r) {
+	if (!r->prefs.denoise && !r->prefs.writeAovs) return;
+	r->state.albedoBuffer = newTexture(float_p, r->prefs.imageWidth, r->prefs.imageHeight, 3);
+	r->state.normalBuffer = newTexture(float_p, r->prefs.imageWidth, r->prefs.imageHeight, 3);
+	r->state.depthBuffer = newTexture(float_p, r->prefs.imageWidth, r->prefs.imageHeight, 1);
+}
+
+static void clearTexture(struct texture *t) {
+	if (!t) return;
+	memset(t->data.float_p, 0, t->width * t->height * t->channels * sizeof(*t->data.float_p));
+}
+
+void clearFeatureBuffers(struct renderer *r) {
+	clearTexture(r->state.albedoBuffer);
+	clearTexture(r->state.normalBuffer);
+	clearTexture(r->state.depthBuffer);
+}
+
+void destroyFeatureBuffers(struct renderer *r) {
+	destroyTexture(r->state.albedoBuffer);
+	destroyTexture(r->state.normalBuffer);
+	destroyTexture(r->state.depthBuffer);
+	r->state.albedoBuffer = NULL;
+	r->state.normalBuffer = NULL;
+	r->state.depthBuffer = NULL;
+}
+
+static inline float demodulation(float albedo) {
+	return albedo > minAlbedo ? albedo : 1.0f;
+}
+
+//Compare colors in a compressed range, so bright highlights don't dominate the weights
+static inline float compress(float c) {
+	return c / (1.0f + c);
+}
+
+//Clamp to the brightest neighbour, so single pixel outliers are removed
+static void clampPixel(const struct denoisePass *pass, unsigned x, unsigned y) {
+	const unsigned p = y * pass->width + x;
+	float limit[3] = {0.0f, 0.0f, 0.0f};
+	for (int dy = -1; dy <= 1; ++dy) {
+		const int qy = (int)y + dy;
+		if (qy < 0 || qy >= (int)pass->height) continue;
+		for (int dx = -1; dx <= 1; ++dx) {
+			const int qx = (int)x + dx;
+			if ((!dx && !dy) || qx < 0 || qx >= (int)pass->width) continue;
+			const float *cq = &pass->input[(qy * pass->width + qx) * 3];
+			limit[0] = max(limit[0], cq[0]);
+			limit[1] = max(limit[1], cq[1]);
+			limit[2] = max(limit[2], cq[2]);
+		}
+	}
+	pass->output[p * 3 + 0] = min(pass->input[p * 3 + 0], limit[0]);
+	pass->output[p * 3 + 1] = min(pass->input[p * 3 + 1], limit[1]);
+	pass->output[p * 3 + 2] = min(pass->input[p * 3 + 2], limit[2]);
+}
+
+static void filterPixel(const struct denoisePass *pass, unsigned x, unsigned y) {
+	const unsigned p = y * pass->width + x;
+	const float *cp = &pass->input[p * 3];
+	const float *np = &pass->normal[p * 3];
+	const float zp = pass->depth[p];
+	const float cpr = compress(cp[0]), cpg = compress(cp[1]), cpb = compress(cp[2]);
+	
+	float sum[3] = {0.0f, 0.0f, 0.0f};
+	float weightSum = 0.0f;
+	for (int dy = -2; dy <= 2; ++dy) {
+		const int qy = (int)y + dy * pass->step;
+		if (qy < 0 || qy >= (int)pass->height) continue;
+		for (int dx = -2; dx <= 2; ++dx) {
+			const int qx = (int)x + dx * pass->step;
+			if (qx < 0 || qx >= (int)pass->width) continue;
+			const unsigned q = qy * pass->width + qx;
+			const float *cq = &pass->input[q * 3];
+			const float *nq = &pass->normal[q * 3];
+			const float zq = pass->depth[q];
+			
+			const float dr = cpr - compress(cq[0]);
+			const float dg = cpg - compress(cq[1]);
+			const float db = cpb - compress(cq[2]);
+			const float colorDist = dr * dr + dg * dg + db * db;
+			
+			const float nx = np[0] - nq[0], ny = np[1] - nq[1], nz = np[2] - nq[2];
+			const float normalDist = nx * nx + ny * ny + nz * nz;
+			
+			const float depthDist = fabsf(zp - zq) / (max(zp, zq) + 0.0001f);
+			
+			const float w = kernel[abs(dx)] * kernel[abs(dy)]
+						* expf(-colorDist / pass->colorPhi
+							   - normalDist / normalPhi
+							   - depthDist / (depthPhi * pass->step));
+			sum[0] += cq[0] * w;
+			sum[1] += cq[1] * w;
+			sum[2] += cq[2] * w;
+			weightSum += w;
+		}
+	}
+	//The center pixel always has a weight of kernel[0]^2, so weightSum is never zero
+	pass->output[p * 3 + 0] = sum[0] / weightSum;
+	pass->output[p * 3 + 1] = sum[1] / weightSum;
+	pass->output[p * 3 + 2] = sum[2] / weightSum;
+}
+
+static void *denoiseThread(void *arg) {
+	const struct denoiseThread *thread = (struct denoiseThread *)threadUserData(arg);
+	const struct denoisePass *pass = thread->pass;
+	const unsigned tilesX = (pass->width + pass->tileWidth - 1) / pass->tileWidth;
+	const unsigned tilesY = (pass->height + pass->tileHeight - 1) / pass->tileHeight;
+	for (unsigned tile = thread->thread; tile < tilesX * tilesY; tile += pass->threadCount) {
+		const unsigned beginX = (tile % tilesX) * pass->tileWidth;
+		const unsigned beginY = (tile / tilesX) * pass->tileHeight;
+		const unsigned endX = min(beginX + pass->tileWidth, pass->width);
+		const unsigned endY = min(beginY + pass->tileHeight, pass->height);
+		for (unsigned y = beginY; y < endY; ++y) {
+			for (unsigned x = beginX; x < endX; ++x) {
+				pass->filter(pass, x, y);
+			}
+		}
+	}
+	return NULL;
+}
+
+static void runPass(const struct denoisePass *pass) {
+	struct crThread *threads = calloc(pass->threadCount, sizeof(*threads));
+	struct denoiseThread *args = calloc(pass->threadCount, sizeof(*args));
+	for (int t = 0; t < pass->threadCount; ++t) {
+		args[t] = (struct denoiseThread){.pass = pass, .thread = t};
+		threads[t] = (struct crThread){.threadFunc = denoiseThread, .userData = &args[t]};
+		if (threadStart(&threads[t])) {
+			logr(error, "Failed to create a crThread.\n");
+		}
+	}
+	for (int t = 0; t < pass->threadCount; ++t) {
+		threadWait(&threads[t]);
+	}
+	free(args);
+	free(threads);
+}
+
+struct texture *denoise(struct renderer *r) {
+	const unsigned width = r->state.renderBuffer->width;
+	const unsigned height = r->state.renderBuffer->height;
+	const unsigned pixels = width * height;
+	const float *color = r->state.renderBuffer->data.float_p;
+	const float *albedo = r->state.albedoBuffer->data.float_p;
+	
+	//Filter lighting only, and multiply the albedo back in at the end
+	struct texture *result = newTexture(float_p, width, height, 3);
+	float *scratch = calloc(pixels * 3, sizeof(*scratch));
+	for (unsigned i = 0; i < pixels * 3; ++i) {
+		result->data.float_p[i] = color[i] / demodulation(albedo[i]);
+	}
+	
+	struct denoisePass pass = {
+		.normal = r->state.normalBuffer->data.float_p,
+		.depth = r->state.depthBuffer->data.float_p,
+		.width = width,
+		.height = height,
+		.tileWidth = r->prefs.tileWidth,
+		.tileHeight = r->prefs.tileHeight,
+		.colorPhi = colorPhi,
+		.threadCount = max(r->prefs.threadCount, 1)
+	};
+	pass.input = result->data.float_p;
+	pass.output = scratch;
+	pass.filter = clampPixel;
+	runPass(&pass);
+	
+	//Ping-pong between the two buffers
+	pass.filter = filterPixel;
+	for (int i = 0; i < DENOISE_PASSES; ++i) {
+		float *swap = pass.input;
+		pass.input = pass.output;
+		pass.output = swap;
+		pass.step = 1 << i;
+		runPass(&pass);
+		pass.colorPhi *= 0.25f;
+	}
+	
+	const float *filtered = pass.output;
+	for (unsigned i = 0; i < pixels * 3; ++i) {
+		result->data.float_p[i] = filtered[i] * demodulation(albedo[i]);
+	}
+	free(scratch);
+	return result;
+}
+
+struct texture *featureImage(const struct renderer *r, enum featureType type) {
+	const unsigned width = r->state.renderBuffer->width;
+	const unsigned height = r->state.renderBuffer->height;
+	struct texture *image = newTexture(char_p, width, height, 3);
+	
+	float maxDepth = 0.0f;
+	if (type == featureDepth) {
+		for (unsigned i = 0; i < width * height; ++i) {
+			maxDepth = max(maxDepth, r->state.depthBuffer->data.float_p[i]);
+		}
+	}
+	
+	for (unsigned y = 0; y < height; ++y) {
+		for (unsigned x = 0; x < width; ++x) {
+			struct color c = blackColor;
+			bool encodeSRGB = false;
+			switch (type) {
+				case featureNoisy:
+					c = textureGetPixel(r->state.renderBuffer, x, y);
+					encodeSRGB = true;
+					break;
+				case featureAlbedo:
+					c = textureGetPixel(r->state.albedoBuffer, x, y);
+					encodeSRGB = true;
+					break;
+				case featureNormal:
+					c = textureGetPixel(r->state.normalBuffer, x, y);
+					c = (struct color){c.red * 0.5f + 0.5f, c.green * 0.5f + 0.5f, c.blue * 0.5f + 0.5f, 1.0f};
+					break;
+				case featureDepth:
+					c = textureGetPixel(r->state.depthBuffer, x, y);
+					c = maxDepth > 0.0f ? colorCoef(1.0f / maxDepth, c) : c;
+					break;
+			}
+			if (encodeSRGB) {
+				setPixelSRGB(image, c, x, y);
+			} else {
+				setPixel(image, c, x, y);
+			}
+		}
+	}
+	return image;
+}
+
+const char *featureSuffix(enum featureType type) {
+	switch (type) {
+		case featureNoisy:
+			return "_noisy";
+		case featureAlbedo:
+			return "_albedo";
+		case featureNormal:
+			return "_normal";
+		case featureDepth:
+			return "_depth";
+	}
+	return "";
+}
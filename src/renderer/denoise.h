@@ -0,0 +1,49 @@
+//
+//  denoise.h
+//  C-ray
+//
+//  Created by Valtteri on 18.10.2020.
+//  Copyright © 2020 Valtteri Koskivuori. All rights reserved.
+//
+
+#pragma once
+
+struct renderer;
+struct texture;
+
+enum featureType {
+	featureNoisy = 0,
+	featureAlbedo,
+	featureNormal,
+	featureDepth
+};
+
+/// Allocate the first hit feature buffers, if the renderer prefs need them
+/// @param r Renderer with prefs set
+void allocFeatureBuffers(struct renderer *r);
+
+/// Clear the feature buffers for a new frame
+/// @param r Renderer
+void clearFeatureBuffers(struct renderer *r);
+
+/// Free the feature buffers
+/// @param r Renderer
+void destroyFeatureBuffers(struct renderer *r);
+
+/// Denoise the finished frame in renderBuffer with an edge-avoiding à-trous wavelet filter,
+/// guided by the albedo, normal and depth feature buffers.
+/// Lighting is filtered separately from albedo, so texture detail is kept.
+/// @remarks Runs on prefs.threadCount threads, over image tiles
+/// @param r Renderer with a finished frame and feature buffers
+/// @return New float precision texture with the denoised frame
+struct texture *denoise(struct renderer *r);
+
+/// Get a displayable copy of the noisy frame or one of the feature buffers, for writing to a file.
+/// Normals are mapped to 0-1, and depth is normalized to the farthest hit.
+/// @param r Renderer with a finished frame and feature buffers
+/// @param type Buffer to convert
+/// @return New char precision texture
+struct texture *featureImage(const struct renderer *r, enum featureType type);
+
+/// Suffix added to the output file name for the given buffer, e.g. "_albedo"
+const char *featureSuffix(enum featureType type);
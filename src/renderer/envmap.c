@@ -14,27 +14,74 @@
 #include "../datatypes/lightRay.h"
 #include "../datatypes/color.h"
 
-struct envMap *newEnvMap(struct texture *t) {
+//Image coordinates, 0-1 on both axes, for a normalized direction
+static inline void toImage(const struct envMap *map, struct vector ud, float *x, float *y) {
+	//To polar from cartesian
+	float phi = (atan2f(ud.z, ud.x) / 4.0f) + map->offset;
+	float theta = acosf(-ud.y);
+	
+	*y = wrapMinMax(theta / PI, 0.0f, 1.0f);
+	*x = wrapMinMax(phi / (PI / 2.0f), 0.0f, 1.0f);
+}
+
+//Inverse of toImage()
+static inline struct vector fromImage(const struct envMap *map, float x, float y) {
+	float phi = (x * (PI / 2.0f) - map->offset) * 4.0f;
+	float theta = y * PI;
+	float sinTheta = sinf(theta);
+	return (struct vector){sinTheta * cosf(phi), -cosf(theta), sinTheta * sinf(phi)};
+}
+
+//Rows are weighted by sin(theta), since rows near the poles cover a smaller solid angle
+static void computeDistribution(struct envMap *map) {
+	const struct texture *t = map->hdr;
+	if (!t || !t->width || !t->height) return;
+	const unsigned width = t->width;
+	const unsigned height = t->height;
+	float *conditional = calloc(width * height, sizeof(*conditional));
+	float *marginal = calloc(height, sizeof(*marginal));
+	
+	float total = 0.0f;
+	for (unsigned y = 0; y < height; ++y) {
+		const float sinTheta = sinf(PI * (y + 0.5f) / height);
+		float *row = &conditional[y * width];
+		float rowSum = 0.0f;
+		for (unsigned x = 0; x < width; ++x) {
+			rowSum += max(luminance(textureGetPixel(t, x, y)), 0.0f) * sinTheta;
+			row[x] = rowSum;
+		}
+		//Rows without any light are never picked, but keep their cdf valid
+		for (unsigned x = 0; x < width; ++x) {
+			row[x] = rowSum > 0.0f ? row[x] / rowSum : (x + 1.0f) / width;
+		}
+		row[width - 1] = 1.0f;
+		total += rowSum;
+		marginal[y] = total;
+	}
+	if (total <= 0.0f) {
+		free(conditional);
+		free(marginal);
+		return;
+	}
+	for (unsigned y = 0; y < height; ++y) {
+		marginal[y] /= total;
+	}
+	marginal[height - 1] = 1.0f;
+	map->conditional = conditional;
+	map->marginal = marginal;
+}
+
+struct envMap *newEnvMap(struct texture *hdr) {
 	struct envMap *new = calloc(1, sizeof(*new));
-	new->hdr = t;
+	new->hdr = hdr;
 	new->offset = 0.0f;
+	computeDistribution(new);
 	return new;
 }
 
 struct color getEnvMap(const struct lightRay *incidentRay, const struct envMap *map) {
-	//Unit direction vector
-	struct vector ud = vecNormalize(incidentRay->direction);
-	
-	//To polar from cartesian
-	float r = 1.0f; //Normalized above
-	float phi = (atan2f(ud.z, ud.x) / 4.0f) + map->offset;
-	float theta = acosf((-ud.y / r));
-	
-	float u = theta / PI;
-	float v = (phi / (PI / 2.0f));
-	
-	u = wrapMinMax(u, 0.0f, 1.0f);
-	v = wrapMinMax(v, 0.0f, 1.0f);
+	float u, v;
+	toImage(map, vecNormalize(incidentRay->direction), &v, &u);
 	
 	float x = (v * map->hdr->width);
 	float y = (u * map->hdr->height);
@@ -42,9 +89,73 @@ struct color getEnvMap(const struct lightRay *incidentRay, const struct envMap *
 	return textureGetPixelFiltered(map->hdr, x, y);
 }
 
+//First index with a cdf value above u
+static unsigned findInterval(const float *cdf, unsigned count, float u) {
+	unsigned first = 0;
+	unsigned last = count - 1;
+	while (first < last) {
+		unsigned mid = (first + last) / 2;
+		if (cdf[mid] > u) {
+			last = mid;
+		} else {
+			first = mid + 1;
+		}
+	}
+	return first;
+}
+
+static inline float cdfStep(const float *cdf, unsigned i) {
+	return i ? cdf[i] - cdf[i - 1] : cdf[0];
+}
+
+//Pixels are sampled with a constant density in image space, which has to be mapped to solid angle
+static inline float solidAnglePdf(const struct envMap *map, float pixelPdf, float sinTheta) {
+	if (sinTheta <= 0.0f) return 0.0f;
+	return pixelPdf * map->hdr->width * map->hdr->height / (2.0f * PI * PI * sinTheta);
+}
+
+struct color sampleEnvMap(const struct envMap *map, sampler *sampler, struct vector *direction, float *pdf) {
+	const float u0 = getDimension(sampler);
+	const float u1 = getDimension(sampler);
+	*pdf = 0.0f;
+	if (!map->marginal) return blackColor;
+	const unsigned width = map->hdr->width;
+	const unsigned height = map->hdr->height;
+	
+	const unsigned y = findInterval(map->marginal, height, u0);
+	const float *row = &map->conditional[y * width];
+	const unsigned x = findInterval(row, width, u1);
+	
+	//Place the sample within the pixel, by how far u landed into its cdf step
+	const float rowPdf = cdfStep(map->marginal, y);
+	const float pixelPdf = cdfStep(row, x);
+	const float fy = (y + (u0 - (map->marginal[y] - rowPdf)) / rowPdf) / height;
+	const float fx = (x + (u1 - (row[x] - pixelPdf)) / pixelPdf) / width;
+	
+	*direction = fromImage(map, fx, fy);
+	*pdf = solidAnglePdf(map, rowPdf * pixelPdf, sinf(fy * PI));
+	if (*pdf <= 0.0f) return blackColor;
+	const struct lightRay ray = {.direction = *direction};
+	return getEnvMap(&ray, map);
+}
+
+float envMapPdf(const struct envMap *map, struct vector direction) {
+	if (!map->marginal) return 0.0f;
+	const unsigned width = map->hdr->width;
+	const unsigned height = map->hdr->height;
+	float fx, fy;
+	toImage(map, direction, &fx, &fy);
+	const unsigned x = min((unsigned)(fx * width), width - 1);
+	const unsigned y = min((unsigned)(fy * height), height - 1);
+	const float pixelPdf = cdfStep(map->marginal, y) * cdfStep(&map->conditional[y * width], x);
+	return solidAnglePdf(map, pixelPdf, sqrtf(max(0.0f, 1.0f - direction.y * direction.y)));
+}
+
 void destroyEnvMap(struct envMap *map) {
 	if (map) {
 		if (map->hdr) destroyTexture(map->hdr);
+		free(map->marginal);
+		free(map->conditional);
 		free(map);
 	}
 }
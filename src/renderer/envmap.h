@@ -8,16 +8,39 @@
 
 #pragma once
 
+#include "../datatypes/vector.h"
+#include "../datatypes/color.h"
+#include "samplers/sampler.h"
+
 struct texture;
 struct lightRay;
 
 struct envMap {
 	struct texture *hdr;
 	float offset; // In radians
+	
+	//Distribution of pixels by luminance and the solid angle they cover, for sampling the map directly
+	float *marginal; //Cdf over rows
+	float *conditional; //Cdf over pixels, per row. width * height
 };
 
-struct envMap *newEnvMap(struct texture *);
+/// Wrap an environment map texture, and build the distribution for sampling it
+/// @param hdr Equirectangular float, half or block_p texture, owned by the map afterwards
+struct envMap *newEnvMap(struct texture *hdr);
 
 struct color getEnvMap(const struct lightRay *incidentRay, const struct envMap *map);
 
+/// Sample a direction towards a bright part of the environment
+/// @param map Environment map
+/// @param sampler Sampler, two dimensions are drawn
+/// @param direction Filled in with the sampled direction
+/// @param pdf Filled in with the solid angle pdf of direction, or 0 if nothing could be sampled
+/// @return Radiance from direction
+struct color sampleEnvMap(const struct envMap *map, sampler *sampler, struct vector *direction, float *pdf);
+
+/// Solid angle pdf that sampleEnvMap() would have sampled the given direction with
+/// @param map Environment map
+/// @param direction Normalized direction
+float envMapPdf(const struct envMap *map, struct vector direction);
+
 void destroyEnvMap(struct envMap *map);
@@ -0,0 +1,193 @@
+//
+//  lights.c
+//  C-ray
+//
+//  Created by Valtteri on 18.10.2020.
+//  Copyright © 2020 Valtteri Koskivuori. All rights reserved.
+//
+
+#include "../includes.h"
+#include "lights.h"
+
+#include "pathtrace.h"
+#include "../datatypes/scene.h"
+#include "../datatypes/instance.h"
+#include "../datatypes/mesh.h"
+#include "../datatypes/sphere.h"
+#include "../datatypes/poly.h"
+#include "../datatypes/transforms.h"
+
+static inline float emitterPower(const struct emitter *e) {
+	return luminance(e->emission) * e->area;
+}
+
+static struct emitter triangleEmitter(const struct mesh *mesh, const struct triangle *p, const struct transform *composite, struct color emission) {
+	struct vector v[3];
+	for (int i = 0; i < 3; ++i) {
+		v[i] = mesh->vertices[p->index[i]];
+		transformPoint(&v[i], &composite->A);
+	}
+	struct emitter e = {.type = emitterTriangle, .emission = emission};
+	e.v0 = v[0];
+	e.e1 = vecSub(v[1], v[0]);
+	e.e2 = vecSub(v[2], v[0]);
+	e.area = 0.5f * vecLength(vecCross(e.e1, e.e2));
+	return e;
+}
+
+//Spheres are assumed to be scaled uniformly
+static struct emitter sphereEmitter(const struct sphere *sphere, const struct transform *composite) {
+	struct emitter e = {.type = emitterSphere, .emission = sphere->material.emission};
+	e.v0 = vecZero();
+	transformPoint(&e.v0, &composite->A);
+	struct vector axis = {1.0f, 0.0f, 0.0f};
+	transformVector(&axis, &composite->A);
+	e.radius = sphere->radius * vecLength(axis);
+	e.area = 4.0f * PI * e.radius * e.radius;
+	return e;
+}
+
+static void addEmitter(struct lightList *lights, int *capacity, struct emitter e) {
+	if (emitterPower(&e) <= 0.0f) return;
+	if (lights->count == *capacity) {
+		*capacity = *capacity ? *capacity * 2 : 16;
+		lights->emitters = realloc(lights->emitters, *capacity * sizeof(*lights->emitters));
+	}
+	lights->emitters[lights->count++] = e;
+}
+
+struct lightList *newLightList(const struct world *scene) {
+	struct lightList *lights = calloc(1, sizeof(*lights));
+	int capacity = 0;
+	for (int i = 0; i < scene->instanceCount; ++i) {
+		const struct instance *instance = &scene->instances[i];
+		if (instance->type == Sphere) {
+			const struct sphere *sphere = instance->object;
+			if (isEmissive(sphere->material.emission)) addEmitter(lights, &capacity, sphereEmitter(sphere, &instance->composite));
+		} else {
+			const struct mesh *mesh = instance->object;
+			for (int p = 0; p < mesh->polyCount; ++p) {
+				const struct triangle *poly = &mesh->polygons[p];
+				struct color emission = mesh->materials[poly->materialIndex].emission;
+				if (isEmissive(emission)) addEmitter(lights, &capacity, triangleEmitter(mesh, poly, &instance->composite, emission));
+			}
+		}
+	}
+	if (!lights->count) {
+		destroyLightList(lights);
+		return NULL;
+	}
+
+	lights->cdf = calloc(lights->count, sizeof(*lights->cdf));
+	for (int i = 0; i < lights->count; ++i) {
+		lights->totalPower += emitterPower(&lights->emitters[i]);
+		lights->cdf[i] = lights->totalPower;
+	}
+	for (int i = 0; i < lights->count; ++i) {
+		lights->cdf[i] /= lights->totalPower;
+	}
+	lights->cdf[lights->count - 1] = 1.0f;
+	return lights;
+}
+
+//First emitter with a cdf value above u
+static int pickEmitter(const struct lightList *lights, float u) {
+	int first = 0;
+	int last = lights->count - 1;
+	while (first < last) {
+		int mid = (first + last) / 2;
+		if (lights->cdf[mid] > u) {
+			last = mid;
+		} else {
+			first = mid + 1;
+		}
+	}
+	return first;
+}
+
+//1 - cos of the half angle of the cone a sphere covers, or 0 if origin is inside it
+static inline float coneSize(const struct emitter *e, struct vector origin) {
+	const float distSquared = vecLengthSquared(vecSub(e->v0, origin));
+	const float radiusSquared = e->radius * e->radius;
+	if (distSquared <= radiusSquared) return 0.0f;
+	const float sinSquared = radiusSquared / distSquared;
+	const float cosMax = sqrtf(max(0.0f, 1.0f - sinSquared));
+	//Same as 1 - cosMax, without the cancellation for small or distant spheres
+	return sinSquared / (1.0f + cosMax);
+}
+
+static float solidAnglePdf(const struct emitter *e, struct vector origin, struct vector direction, float distance) {
+	if (e->type == emitterSphere) {
+		const float size = coneSize(e, origin);
+		return size > 0.0f ? 1.0f / (2.0f * PI * size) : 0.0f;
+	}
+	const struct vector normal = vecNormalize(vecCross(e->e1, e->e2));
+	const float cosine = fabsf(vecDot(normal, direction));
+	if (cosine < 0.000001f) return 0.0f;
+	return (distance * distance) / (e->area * cosine);
+}
+
+//Orthonormal basis from Duff et al. 2017, "Building an Orthonormal Basis, Revisited"
+static inline void basis(struct vector n, struct vector *t, struct vector *b) {
+	const float sign = copysignf(1.0f, n.z);
+	const float a = -1.0f / (sign + n.z);
+	const float c = n.x * n.y * a;
+	*t = (struct vector){1.0f + sign * n.x * n.x * a, sign * c, -sign * n.x};
+	*b = (struct vector){c, sign + n.y * n.y * a, -n.y};
+}
+
+bool sampleLights(const struct lightList *lights, struct vector origin, sampler *sampler, struct lightSample *sample) {
+	const float u0 = getDimension(sampler);
+	const float u1 = getDimension(sampler);
+	const float u2 = getDimension(sampler);
+	const struct emitter *e = &lights->emitters[pickEmitter(lights, u0)];
+	const float pickPdf = emitterPower(e) / lights->totalPower;
+
+	if (e->type == emitterSphere) {
+		//Sample the cone of directions the sphere covers
+		const float size = coneSize(e, origin);
+		if (size <= 0.0f) return false;
+		const struct vector toCenter = vecSub(e->v0, origin);
+		const float distance = vecLength(toCenter);
+		const struct vector w = vecScale(toCenter, 1.0f / distance);
+		struct vector t, b;
+		basis(w, &t, &b);
+		const float cosTheta = 1.0f - u1 * size;
+		const float sinThetaSquared = max(0.0f, 1.0f - cosTheta * cosTheta);
+		const float sinTheta = sqrtf(sinThetaSquared);
+		const float phi = 2.0f * PI * u2;
+		sample->direction = vecAdd(vecAdd(vecScale(t, sinTheta * cosf(phi)), vecScale(b, sinTheta * sinf(phi))), vecScale(w, cosTheta));
+		sample->distance = distance * cosTheta - sqrtf(max(0.0f, e->radius * e->radius - distance * distance * sinThetaSquared));
+		sample->pdf = pickPdf / (2.0f * PI * size);
+	} else {
+		//Uniform point on the triangle
+		const float su = sqrtf(u1);
+		const struct vector point = vecAdd(e->v0, vecAdd(vecScale(e->e1, 1.0f - su), vecScale(e->e2, u2 * su)));
+		const struct vector toPoint = vecSub(point, origin);
+		sample->distance = vecLength(toPoint);
+		if (sample->distance <= 0.0f) return false;
+		sample->direction = vecScale(toPoint, 1.0f / sample->distance);
+		sample->pdf = pickPdf * solidAnglePdf(e, origin, sample->direction, sample->distance);
+	}
+	sample->emission = e->emission;
+	return sample->pdf > 0.0f;
+}
+
+float lightPdf(const struct lightList *lights, const struct world *scene, const struct hitRecord *isect, struct vector origin) {
+	if (!lights) return 0.0f;
+	const struct instance *instance = &scene->instances[isect->instIndex];
+	//Rebuild the emitter that was hit, instead of keeping a lookup from polygons to emitters
+	const struct emitter e = instance->type == Sphere ?
+		sphereEmitter(instance->object, &instance->composite) :
+		triangleEmitter(instance->object, isect->polygon, &instance->composite, isect->material->emission);
+	const float pickPdf = emitterPower(&e) / lights->totalPower;
+	return pickPdf * solidAnglePdf(&e, origin, isect->incident.direction, isect->distance);
+}
+
+void destroyLightList(struct lightList *lights) {
+	if (lights) {
+		free(lights->emitters);
+		free(lights->cdf);
+		free(lights);
+	}
+}
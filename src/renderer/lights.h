@@ -0,0 +1,66 @@
+//
+//  lights.h
+//  C-ray
+//
+//  Created by Valtteri on 18.10.2020.
+//  Copyright © 2020 Valtteri Koskivuori. All rights reserved.
+//
+
+#pragma once
+
+#include "../datatypes/vector.h"
+#include "../datatypes/color.h"
+#include "samplers/sampler.h"
+
+struct world;
+struct hitRecord;
+
+/// An emissive triangle or sphere, in world space
+struct emitter {
+	enum {emitterTriangle, emitterSphere} type;
+	struct vector v0; //Triangle corner, or sphere center
+	struct vector e1; //Triangle edges
+	struct vector e2;
+	float radius;
+	float area;
+	struct color emission;
+};
+
+/// All emissive geometry in a scene, for next-event estimation.
+/// Emitters are picked with a probability proportional to their power.
+struct lightList {
+	struct emitter *emitters;
+	float *cdf; //Running sum of emitter power, normalized to 1
+	int count;
+	float totalPower;
+};
+
+/// A point on an emitter, as seen from a shading point
+struct lightSample {
+	struct vector direction; //Normalized, from the shading point towards the emitter
+	float distance;
+	float pdf; //Solid angle pdf, including picking the emitter
+	struct color emission;
+};
+
+/// Collect emissive triangles and spheres from the scene instances into world space
+/// @param scene Scene with instance transforms set
+/// @return New light list, or NULL if nothing in the scene emits light
+struct lightList *newLightList(const struct world *scene);
+
+/// Sample a point on one of the emitters
+/// @param lights Light list
+/// @param origin Shading point
+/// @param sampler Sampler, three dimensions are drawn
+/// @param sample Filled in with the sampled point
+/// @return false if no point could be sampled
+bool sampleLights(const struct lightList *lights, struct vector origin, sampler *sampler, struct lightSample *sample);
+
+/// Solid angle pdf that sampleLights() would have sampled the emitter hit by a ray from origin with
+/// @param lights Light list
+/// @param scene Scene the light list was built from
+/// @param isect Intersection with an emissive surface
+/// @param origin Start of the ray that found isect
+float lightPdf(const struct lightList *lights, const struct world *scene, const struct hitRecord *isect, struct vector origin);
+
+void destroyLightList(struct lightList *lights);
@@ -13,7 +13,7 @@
 #include "../datatypes/camera.h"
 #include "../accelerators/bvh.h"
 #include "../datatypes/image/texture.h"
-#include "../datatypes/vertexbuffer.h"
+#include "../datatypes/image/mipmap.h"
 #include "../datatypes/sphere.h"
 #include "../datatypes/poly.h"
 #include "../datatypes/mesh.h"
@@ -22,47 +22,175 @@
 #include "envmap.h"
 #include "../datatypes/transforms.h"
 #include "../datatypes/instance.h"
+#include "../utils/statistics.h"
+#include "lights.h"
 
-static struct hitRecord getClosestIsect(struct lightRay *incidentRay, const struct world *scene, sampler *sampler);
+static struct hitRecord getClosestIsect(struct lightRay *incidentRay, const struct world *scene, float coneWidth, float coneSpread, sampler *sampler, struct stats *stats);
 static struct color getBackground(const struct lightRay *incidentRay, const struct world *scene);
 
-struct color debugNormals(const struct lightRay *incidentRay, const struct world *scene, int maxDepth, sampler *sampler) {
+//Veach's power heuristic, with a beta of 2
+static inline float powerHeuristic(float pdf, float otherPdf) {
+	return (pdf * pdf) / (pdf * pdf + otherPdf * otherPdf);
+}
+
+//lambertianBSDF() samples a cosine weighted hemisphere around the surface normal
+static inline float lambertianPdf(const struct hitRecord *isect, struct vector direction) {
+	return max(vecDot(vecNormalize(isect->surfaceNormal), direction), 0.0f) / PI;
+}
+
+//Ray cone spread after a bounce, from Akenine-Möller et al. 2019, "Texture Level of Detail Strategies for Real-Time Ray Tracing".
+//Surface curvature is ignored. Mirror and glass bounces keep the spread, rough bounces widen it.
+static inline float scatteredSpread(float spread, const struct lightRay *scattered, const struct material *material) {
+	static const float diffuseSpread = 0.1f;
+	switch (scattered->rayType) {
+		case rayTypeReflected:
+		case rayTypeRefracted:
+			return spread + material->roughness;
+		default:
+			return max(spread, diffuseSpread);
+	}
+}
+
+//Width of the ray cone on the surface. It's stretched at grazing angles, up to a limit.
+static inline float coneFootprint(const struct hitRecord *isect, float coneWidth) {
+	const float cosine = fabsf(vecDot(vecNormalize(isect->surfaceNormal), vecNormalize(isect->incident.direction)));
+	return coneWidth / max(cosine, 0.1f);
+}
+
+//Coverage of the surface, the rest of the rays pass through it
+static inline float surfaceAlpha(const struct hitRecord *isect) {
+	if (!isect->material->hasTexture) return isect->material->diffuse.alpha;
+	return isect->material->texture->hasAlpha ? colorForUV(isect, Diffuse).alpha : 1.0f;
+}
+
+//Shading information for the closest hit, computed once traversal has finished
+static struct hitRecord getSurface(const struct world *scene, const struct lightRay *ray, const struct hit *hit) {
+	struct hitRecord isect = {
+		.incident = *ray,
+		.uv = hit->uv,
+		.distance = hit->distance,
+		.polygon = hit->polygon,
+		.instIndex = hit->instIndex
+	};
+	const struct instance *instance = &scene->instances[hit->instIndex];
+	instance->surfaceFn(instance, ray, &isect);
+	return isect;
+}
+
+//Fraction of light that gets through alpha blended surfaces between origin and the light.
+//Shadow rays don't track a cone of their own, blockers are filtered with the footprint at the origin.
+static float visibility(struct lightRay ray, float distance, const struct world *scene, float footprint, struct stats *stats) {
+	float transmittance = 1.0f;
+	for (int i = 0; i < 16; ++i) {
+		stats_add(stats, rays_traced, 1);
+		stats_add(stats, shadow_rays, 1);
+		ray.start = vecAdd(ray.start, vecScale(ray.direction, scene->rayOffset));
+		struct hit hit = {.distance = distance * 0.999f - scene->rayOffset, .instIndex = -1};
+		if (!traverseTopLevelBvh(scene->instances, scene->topLevel, &ray, &hit, stats)) return transmittance;
+		struct hitRecord isect = getSurface(scene, &ray, &hit);
+		if (isect.uvScale > 0.0f) isect.footprint = coneFootprint(&isect, footprint);
+		transmittance *= 1.0f - surfaceAlpha(&isect);
+		if (transmittance <= 0.0f) return 0.0f;
+		ray.start = isect.hitPoint;
+		distance -= isect.distance + scene->rayOffset;
+	}
+	return 0.0f;
+}
+
+//Light arriving from direction, weighted against lambertianBSDF() finding it
+static struct color directLight(const struct hitRecord *isect, const struct world *scene, struct vector direction, float distance, float pdf, struct color emission, struct stats *stats) {
+	const float cosine = vecDot(vecNormalize(isect->surfaceNormal), direction);
+	if (cosine <= 0.0f) return blackColor;
+	const float visible = visibility(newRay(isect->hitPoint, direction, rayTypeScattered), distance, scene, isect->footprint, stats);
+	if (visible <= 0.0f) return blackColor;
+	const float misWeight = powerHeuristic(pdf, cosine / PI);
+	const struct color albedo = isect->material->hasTexture ? colorForUV(isect, Diffuse) : isect->material->diffuse;
+	//albedo / PI is the lambertian BRDF
+	return colorCoef(visible * misWeight * cosine / (PI * pdf), multiplyColors(albedo, emission));
+}
+
+//Next-event estimation. Sample a point on an emitter, and a direction from the environment map
+static struct color sampleLight(const struct hitRecord *isect, const struct world *scene, sampler *sampler, struct stats *stats) {
+	struct color light = blackColor;
+	struct lightSample sample;
+	if (scene->lights && sampleLights(scene->lights, isect->hitPoint, sampler, &sample)) {
+		light = directLight(isect, scene, sample.direction, sample.distance, sample.pdf, sample.emission, stats);
+	}
+	if (scene->hdr) {
+		struct vector direction;
+		float pdf;
+		struct color environment = sampleEnvMap(scene->hdr, sampler, &direction, &pdf);
+		if (pdf > 0.0f) light = addColors(light, directLight(isect, scene, direction, FLT_MAX, pdf, environment, stats));
+	}
+	return light;
+}
+
+struct color debugNormals(const struct lightRay *incidentRay, const struct world *scene, int maxDepth, sampler *sampler, struct stats *stats) {
 	(void)maxDepth;
 	(void)sampler;
 	struct lightRay currentRay = *incidentRay;
-	struct hitRecord isect = getClosestIsect(&currentRay, scene, sampler);
+	struct hitRecord isect = getClosestIsect(&currentRay, scene, 0.0f, 0.0f, sampler, stats);
 	if (isect.instIndex < 0)
 		return getBackground(&currentRay, scene);
 	struct vector normal =  isect.surfaceNormal;
 	return colorWithValues(fabs(normal.x), fabs(normal.y), fabs(normal.z), 1.0f);
 }
 
-struct color pathTrace(const struct lightRay *incidentRay, const struct world *scene, int maxDepth, sampler *sampler) {
+struct color pathTrace(const struct lightRay *incidentRay, const struct world *scene, int maxDepth, sampler *sampler, struct stats *stats, struct featureSample *features) {
 #ifdef DBG_NORMALS
-	return debugNormals(incidentRay, scene, maxDepth, sampler);
+	return debugNormals(incidentRay, scene, maxDepth, sampler, stats);
 #endif
 	struct color weight = whiteColor; // Current path weight
 	struct color finalColor = blackColor; // Final path contribution
 	struct lightRay currentRay = *incidentRay;
+	float bsdfPdf = 0.0f; // Pdf of the last bounce, if lights were also sampled there
+	float coneWidth = 0.0f; // Ray cone, for picking texture mip levels
+	float coneSpread = scene->camera->pixelSpread;
+	stats_add(stats, paths, 1);
 
 	for (int depth = 0; depth < maxDepth; ++depth) {
-		const struct hitRecord isect = getClosestIsect(&currentRay, scene, sampler);
+		stats_add(stats, path_lengths, 1);
+		const struct hitRecord isect = getClosestIsect(&currentRay, scene, coneWidth, coneSpread, sampler, stats);
 		if (isect.instIndex < 0) {
-			finalColor = addColors(finalColor, multiplyColors(weight, getBackground(&currentRay, scene)));
+			stats_add(stats, background_hits, 1);
+			struct color background = getBackground(&currentRay, scene);
+			if (features && depth == 0) *features = (struct featureSample){background, vecZero(), 0.0f};
+			//The environment was sampled directly at the previous vertex too
+			float misWeight = bsdfPdf > 0.0f && scene->hdr ? powerHeuristic(bsdfPdf, envMapPdf(scene->hdr, vecNormalize(currentRay.direction))) : 1.0f;
+			finalColor = addColors(finalColor, multiplyColors(weight, colorCoef(misWeight, background)));
 			break;
 		}
+		coneWidth += coneSpread * isect.distance;
+		if (features && depth == 0) {
+			struct color albedo = isect.material->hasTexture ? colorForUV(&isect, Diffuse) : isect.material->diffuse;
+			*features = (struct featureSample){albedo, isect.surfaceNormal, isect.distance};
+		}
 
-		finalColor = addColors(finalColor, multiplyColors(weight, isect.material.emission));
+		if (isEmissive(isect.material->emission)) {
+			//Lights were sampled directly at the previous vertex, so weight this hit against that
+			float misWeight = bsdfPdf > 0.0f ? powerHeuristic(bsdfPdf, lightPdf(scene->lights, scene, &isect, currentRay.start)) : 1.0f;
+			finalColor = addColors(finalColor, multiplyColors(weight, colorCoef(misWeight, isect.material->emission)));
+		}
+		
+		const bool sampleDirect = (scene->lights || scene->hdr) && isect.material->type == lambertian;
+		if (sampleDirect) {
+			finalColor = addColors(finalColor, multiplyColors(weight, sampleLight(&isect, scene, sampler, stats)));
+		}
 		
 		struct color attenuation;
-		if (!isect.material.bsdf(&isect, &attenuation, &currentRay, sampler))
+		if (!isect.material->bsdf(&isect, &attenuation, &currentRay, sampler))
 			break;
+		stats_add(stats, bounces, 1);
+		coneSpread = scatteredSpread(coneSpread, &currentRay, isect.material);
+		bsdfPdf = sampleDirect ? lambertianPdf(&isect, currentRay.direction) : 0.0f;
 		
 		float probability = 1.0f;
 		if (depth >= 4) {
 			probability = max(attenuation.red, max(attenuation.green, attenuation.blue));
-			if (getDimension(sampler) > probability)
+			if (getDimension(sampler) > probability) {
+				stats_add(stats, rr_kills, 1);
 				break;
+			}
 		}
 
 		weight = colorCoef(1.0f / probability, multiplyColors(attenuation, weight));
@@ -76,24 +204,27 @@ struct color pathTrace(const struct lightRay *incidentRay, const struct world *s
 
  @param incidentRay Given light ray (set up in renderThread())
  @param scene  Given scene to cast that ray into
+ @param coneWidth Ray cone width at the ray origin
+ @param coneSpread Ray cone spread angle, the footprint for texture filtering is derived from these
+ @param stats Counters for the calling thread
  @return intersection struct with the appropriate values set
  */
-static struct hitRecord getClosestIsect(struct lightRay *incidentRay, const struct world *scene, sampler *sampler) {
+static struct hitRecord getClosestIsect(struct lightRay *incidentRay, const struct world *scene, float coneWidth, float coneSpread, sampler *sampler, struct stats *stats) {
+	stats_add(stats, rays_traced, 1);
 	incidentRay->start = vecAdd(incidentRay->start, vecScale(incidentRay->direction, scene->rayOffset));
-	struct hitRecord isect;
-	isect.instIndex = -1;
-	isect.distance = FLT_MAX;
-	isect.incident = *incidentRay;
-	isect.polygon = NULL;
+	struct hit hit = {.distance = FLT_MAX, .polygon = NULL, .instIndex = -1};
 	
-	if (!traverseTopLevelBvh(scene->instances, scene->topLevel, incidentRay, &isect))
-		return isect;
+	if (!traverseTopLevelBvh(scene->instances, scene->topLevel, incidentRay, &hit, stats))
+		return (struct hitRecord){.incident = *incidentRay, .distance = FLT_MAX, .instIndex = -1};
 	
-	float prob = isect.material.hasTexture ? colorForUV(&isect, Diffuse).alpha : isect.material.diffuse.alpha;
+	struct hitRecord isect = getSurface(scene, incidentRay, &hit);
+	coneWidth += coneSpread * isect.distance;
+	isect.footprint = isect.uvScale > 0.0f ? coneFootprint(&isect, coneWidth) : coneWidth;
+	float prob = surfaceAlpha(&isect);
 	if (prob < 1.0f) {
 		if (getDimension(sampler) > prob) {
 			struct lightRay next = {isect.hitPoint, incidentRay->direction, rayTypeIncident};
-			return getClosestIsect(&next, scene, sampler);
+			return getClosestIsect(&next, scene, coneWidth, coneSpread, sampler, stats);
 		}
 	}
 	return isect;
@@ -14,6 +14,18 @@
 #include "../datatypes/material.h"
 
 struct world;
+struct stats;
+
+/**
+ Closest hit found during BVH traversal. This is all the intersection routines store,
+ the rest of the shading information is computed once for the final hit, see hitRecord.
+ */
+struct hit {
+	float distance;					//Distance to intersection point
+	struct coord uv;				//UV barycentric coordinates, only set for polygons
+	const struct triangle *polygon;	//Polygon that was hit, NULL for spheres
+	int instIndex;					//Instance index, negative if no intersection
+};
 
 /**
  Shading/intersection information, used to perform shading and rendering logic.
@@ -22,19 +34,30 @@ struct world;
  */
 struct hitRecord {
 	struct lightRay incident;		//Light ray that encountered this intersection
-	struct material material;		//Material of the intersected object
+	const struct material *material;	//Material of the intersected object
 	struct vector hitPoint;			//Hit point vector in 3D space
 	struct vector surfaceNormal;	//Surface normal at that point of intersection
 	struct coord uv;				//UV barycentric coordinates for intersection point
 	float distance;					//Distance to intersection point
-	struct poly *polygon;			//ptr to polygon that was encountered
+	const struct triangle *polygon;	//ptr to polygon that was encountered
+	const struct mesh *mesh;		//Mesh the polygon belongs to, NULL for spheres
 	int instIndex;					//Instance index, negative if no intersection
+	float footprint;				//Width of the ray cone at the hit point, stretched along textured surfaces
+	float uvScale;					//Texture coordinate units per world unit, only set for textured polygons
 };
 
+/// First hit features, accumulated into the feature buffers the denoiser uses
+struct featureSample {
+	struct color albedo;	//Surface color at the first hit, or the background color
+	struct vector normal;	//Shading normal at the first hit, zero for the background
+	float depth;			//Distance to the first hit, zero for the background
+};
 
 /// Recursive path tracer.
 /// @param incidentRay View ray to be casted into the scene
 /// @param scene Scene to cast the ray into
 /// @param maxDepth Maximum depth of recursion
 /// @param rng A random number generator. One per execution thread.
-struct color pathTrace(const struct lightRay *incidentRay, const struct world *scene, int maxDepth, sampler *sampler);
+/// @param stats Render counters. One per execution thread.
+/// @param features First hit features are stored here, if not NULL
+struct color pathTrace(const struct lightRay *incidentRay, const struct world *scene, int maxDepth, sampler *sampler, struct stats *stats, struct featureSample *features);
@@ -13,26 +13,59 @@
 #include "../datatypes/camera.h"
 #include "../datatypes/scene.h"
 #include "pathtrace.h"
+#include "denoise.h"
 #include "../utils/logging.h"
 #include "../utils/ui.h"
 #include "../datatypes/tile.h"
 #include "../utils/timer.h"
 #include "../datatypes/image/texture.h"
+#include "../datatypes/image/texturecache.h"
 #include "../datatypes/mesh.h"
 #include "../datatypes/sphere.h"
-#include "../datatypes/vertexbuffer.h"
 #include "../utils/platform/thread.h"
 #include "../utils/platform/mutex.h"
 #include "samplers/sampler.h"
 #include "../utils/args.h"
+#include "../utils/networking.h"
 
-//Main thread loop speeds
+//Main thread loop speeds, only used when there is a preview window to update
 #define paused_msec 100
 #define active_msec  16
+//Status line update interval
+#define status_msec 280
 
 void *renderThread(void *arg);
 void *renderThreadInteractive(void *arg);
 
+static float renderProgress(struct renderer *r, bool interactive) {
+	return interactive ? ((float)r->state.finishedPasses / (float)r->prefs.sampleCount) :
+						 ((float)r->state.finishedTileCount / (float)r->state.tileCount);
+}
+
+static void printStatus(struct renderer *r, bool interactive) {
+	float avgTimePerTilePass = 0.0f;
+	uint64_t completedSamples = 0;
+	for (int t = 0; t < r->prefs.threadCount; ++t) {
+		avgTimePerTilePass += r->state.threadStates[t].avgSampleTime;
+		completedSamples += r->state.threadStates[t].totalSamples;
+	}
+	avgTimePerTilePass /= r->prefs.threadCount;
+	float usPerRay = avgTimePerTilePass / (r->prefs.tileHeight * r->prefs.tileWidth);
+	uint64_t remainingTileSamples = (r->state.tileCount * r->prefs.sampleCount) - completedSamples;
+	uint64_t msecTillFinished = 0.001f * (avgTimePerTilePass * remainingTileSamples);
+	float sps = (1000000.0f/usPerRay) * r->prefs.threadCount;
+	char rem[64];
+	smartTime((msecTillFinished) / r->prefs.threadCount, rem);
+	logr(info, "[%s%.0f%%%s] μs/path: %.02f, etf: %s, %.02lfMs/s %s        \r",
+		 KBLU,
+		 renderProgress(r, interactive) * 100.0f,
+		 KNRM,
+		 usPerRay,
+		 rem,
+		 0.000001f * sps,
+		 r->state.threadStates[0].paused ? "[PAUSED]" : "");
+}
+
 /// @todo Use defaultSettings state struct for this.
 /// @todo Clean this up, it's ugly.
 struct texture *renderFrame(struct renderer *r) {
@@ -56,15 +89,24 @@ struct texture *renderFrame(struct renderer *r) {
 	r->state.saveImage = true; // Set to false if user presses X
 	
 	//Main loop (input)
-	float avgSampleTime = 0.0f;
-	float avgTimePerTilePass = 0.0f;
-	int pauser = 0;
-	int ctr = 1;
 	bool interactive = isSet("interactive");
+	//Without a preview window there is nothing to poll, so only wake up for events and the status line
+	bool hasDisplay = isDisplayActive();
+	struct timeval statusTimer = {0};
+	startTimer(&statusTimer);
 	
+	//Previous frame of an animation
+	free(r->state.threads);
+	free(r->state.threadStates);
 	r->state.threads = calloc(r->prefs.threadCount, sizeof(*r->state.threads));
 	r->state.threadStates = calloc(r->prefs.threadCount, sizeof(*r->state.threadStates));
 	
+	//Network workers pull from the same tile queue, one thread each (Nonblocking)
+	if (!interactive) {
+		int remoteThreads = startRemoteThreads(r, output);
+		if (remoteThreads) logr(info, "Rendering with %i network worker%s\n", remoteThreads, remoteThreads > 1 ? "s" : "");
+	}
+	
 	//Create render threads (Nonblocking)
 	for (int t = 0; t < r->prefs.threadCount; ++t) {
 		r->state.threadStates[t] = (struct renderThreadState){.thread_num = t, .threadComplete = false, .renderer = r, .output = output};
@@ -80,41 +122,25 @@ struct texture *renderFrame(struct renderer *r) {
 	while (r->state.isRendering) {
 		getKeyboardInput(r);
 		
-		//Gather and maintain this average constantly.
 		if (!r->state.threadStates[0].paused) {
 			drawWindow(r, output);
-			for (int t = 0; t < r->prefs.threadCount; ++t) {
-				avgSampleTime += r->state.threadStates[t].avgSampleTime;
-			}
-			avgTimePerTilePass += avgSampleTime / r->prefs.threadCount;
-			avgTimePerTilePass /= ctr++;
 		}
 		
 		//Run the sample printing about 4x/s
-		if (pauser == 280 / active_msec) {
-			float usPerRay = avgTimePerTilePass / (r->prefs.tileHeight * r->prefs.tileWidth);
-			uint64_t completedSamples = 0;
-			for (int t = 0; t < r->prefs.threadCount; ++t) {
-				completedSamples += r->state.threadStates[t].totalSamples;
-			}
-			uint64_t remainingTileSamples = (r->state.tileCount * r->prefs.sampleCount) - completedSamples;
-			uint64_t msecTillFinished = 0.001f * (avgTimePerTilePass * remainingTileSamples);
-			float sps = (1000000.0f/usPerRay) * r->prefs.threadCount;
-			char rem[64];
-			smartTime((msecTillFinished) / r->prefs.threadCount, rem);
-			logr(info, "[%s%.0f%%%s] μs/path: %.02f, etf: %s, %.02lfMs/s %s        \r",
-				 KBLU,
-				 interactive ? ((float)r->state.finishedPasses / (float)r->prefs.sampleCount) * 100.0f :
-							   ((float)r->state.finishedTileCount / (float)r->state.tileCount) * 100.0f,
-				 KNRM,
-				 usPerRay,
-				 rem,
-				 0.000001f * sps,
-				 r->state.threadStates[0].paused ? "[PAUSED]" : "");
-			
-			pauser = 0;
+		long sinceStatus = getMs(statusTimer);
+		if (sinceStatus >= status_msec) {
+			printStatus(r, interactive);
+			startTimer(&statusTimer);
+			sinceStatus = 0;
+		}
+		
+		if (r->state.progressCallback) {
+			r->state.progressCallback(renderProgress(r, interactive), r->state.progressUserData);
 		}
-		pauser++;
+		
+		lockMutex(r->state.tileMutex);
+		//Wake up paused and idle render threads, so they notice the abort
+		if (r->state.renderAborted) broadcastCondition(r->state.workerCond);
 		
 		//Wait for render threads to finish (Render finished)
 		for (int t = 0; t < r->prefs.threadCount; ++t) {
@@ -122,20 +148,72 @@ struct texture *renderFrame(struct renderer *r) {
 				--r->state.activeThreads;
 				r->state.threadStates[t].thread_num = -1; //Mark as checked
 			}
-			if (!r->state.activeThreads || r->state.renderAborted) {
-				r->state.isRendering = false;
-			}
 		}
-		sleepMSec(r->state.threadStates[0].paused ? paused_msec : active_msec);
+		if (!r->state.activeThreads || r->state.renderAborted) {
+			r->state.isRendering = false;
+		} else {
+			//Sleep until a tile or thread finishes, or until the window or status line needs updating
+			int timeout = status_msec - sinceStatus;
+			if (hasDisplay) timeout = r->state.threadStates[0].paused ? paused_msec : active_msec;
+			timedWaitCondition(r->state.mainCond, r->state.tileMutex, timeout);
+		}
+		releaseMutex(r->state.tileMutex);
 	}
 	
 	//Make sure render threads are terminated before continuing (This blocks)
 	for (int t = 0; t < r->prefs.threadCount; ++t) {
 		threadWait(&r->state.threads[t]);
 	}
+	joinRemoteThreads(r);
+	
+	clear_stats(&r->state.stats);
+	for (int t = 0; t < r->prefs.threadCount; ++t) {
+		merge_stats(&r->state.stats, &r->state.threadStates[t].stats);
+	}
+	collectTextureCacheStats(r->scene->textures, &r->state.stats);
+	print_stats(&r->state.stats);
+	
+	if (r->prefs.denoise && r->state.saveImage && !interactive) {
+		struct timeval timer = {0};
+		startTimer(&timer);
+		struct texture *denoised = denoise(r);
+		for (unsigned y = 0; y < output->height; ++y) {
+			for (unsigned x = 0; x < output->width; ++x) {
+				setPixelSRGB(output, textureGetPixel(denoised, x, y), x, y);
+			}
+		}
+		destroyTexture(denoised);
+		logr(info, "Denoised in %lims\n", getMs(timer));
+	}
 	return output;
 }
 
+//Block while the user has paused rendering
+static void waitWhilePaused(struct renderer *r, struct renderThreadState *threadState) {
+	if (!threadState->paused) return;
+	lockMutex(r->state.tileMutex);
+	while (threadState->paused && !r->state.renderAborted) {
+		waitCondition(r->state.workerCond, r->state.tileMutex);
+	}
+	releaseMutex(r->state.tileMutex);
+}
+
+static void markThreadComplete(struct renderer *r, struct renderThreadState *threadState) {
+	lockMutex(r->state.tileMutex);
+	threadState->threadComplete = true;
+	signalCondition(r->state.mainCond);
+	releaseMutex(r->state.tileMutex);
+}
+
+void togglePause(struct renderer *r) {
+	lockMutex(r->state.tileMutex);
+	for (int t = 0; t < r->prefs.threadCount; ++t) {
+		r->state.threadStates[t].paused = !r->state.threadStates[t].paused;
+	}
+	broadcastCondition(r->state.workerCond);
+	releaseMutex(r->state.tileMutex);
+}
+
 // An interactive render thread that progressively
 // renders samples up to a limit
 void *renderThreadInteractive(void *arg) {
@@ -144,6 +222,7 @@ void *renderThreadInteractive(void *arg) {
 	struct renderer *r = threadState->renderer;
 	struct texture *image = threadState->output;
 	sampler *sampler = newSampler();
+	struct stats stats = {0};
 	
 	//First time setup for each thread
 	struct renderTile tile = nextTile(r);
@@ -157,15 +236,19 @@ void *renderThreadInteractive(void *arg) {
 		long totalUsec = 0;
 		
 		startTimer(&timer);
+		const int epoch = textureCacheEnter(r->scene->textures);
 		for (int y = tile.end.y - 1; y > tile.begin.y - 1; --y) {
 			for (int x = tile.begin.x; x < tile.end.x; ++x) {
-				if (r->state.renderAborted) return 0;
+				if (r->state.renderAborted) {
+					textureCacheLeave(r->scene->textures, epoch);
+					return 0;
+				}
 				uint32_t pixIdx = y * image->width + x;
-				initSampler(sampler, Halton, r->state.finishedPasses, r->prefs.sampleCount, pixIdx);
+				initSampler(sampler, r->prefs.sampler, r->state.finishedPasses, r->prefs.sampleCount, pixIdx);
 				
 				incidentRay = getCameraRay(r->scene->camera, x, y, sampler);
 				struct color output = textureGetPixel(r->state.renderBuffer, x, y);
-				struct color sample = pathTrace(&incidentRay, r->scene, r->prefs.bounces, sampler);
+				struct color sample = pathTrace(&incidentRay, r->scene, r->prefs.bounces, sampler, &stats, NULL);
 				
 				//And process the running average
 				output = colorCoef((float)(r->state.finishedPasses - 1), output);
@@ -176,21 +259,19 @@ void *renderThreadInteractive(void *arg) {
 				//Store internal render buffer (float precision)
 				setPixel(r->state.renderBuffer, output, x, y);
 				
-				//Gamma correction
-				output = toSRGB(output);
-				
-				//And store the image data
-				setPixel(image, output, x, y);
+				//Gamma correction, and store the image data
+				setPixelSRGB(image, output, x, y);
 			}
 		}
+		textureCacheLeave(r->scene->textures, epoch);
 		//For performance metrics
 		totalUsec += getUs(timer);
+		merge_stats(&threadState->stats, &stats);
+		clear_stats(&stats);
 		threadState->totalSamples++;
 		threadState->completedSamples++;
 		//Pause rendering when bool is set
-		while (threadState->paused && !r->state.renderAborted) {
-			sleepMSec(100);
-		}
+		waitWhilePaused(r, threadState);
 		threadState->avgSampleTime = totalUsec / r->state.finishedPasses;
 		
 		//Tile has finished rendering, get a new one and start rendering it.
@@ -202,12 +283,64 @@ void *renderThreadInteractive(void *arg) {
 	}
 	destroySampler(sampler);
 	//No more tiles to render, exit thread. (render done)
-	threadState->threadComplete = true;
 	threadState->currentTileNum = -1;
+	markThreadComplete(r, threadState);
 	logr(debug, "thread %i did %i passes\n", threadState->thread_num, r->state.finishedPasses);
 	return 0;
 }
 
+static struct color runningAverage(struct color average, struct color sample, int count) {
+	return colorCoef(1.0f / count, addColors(colorCoef((float)(count - 1), average), sample));
+}
+
+static void accumulateFeatures(struct renderer *r, const struct featureSample *features, int sample, int x, int y) {
+	struct color albedo = textureGetPixel(r->state.albedoBuffer, x, y);
+	setPixel(r->state.albedoBuffer, runningAverage(albedo, features->albedo, sample), x, y);
+	struct color normal = textureGetPixel(r->state.normalBuffer, x, y);
+	struct color sampleNormal = {features->normal.x, features->normal.y, features->normal.z, 0.0f};
+	setPixel(r->state.normalBuffer, runningAverage(normal, sampleNormal, sample), x, y);
+	struct color depth = textureGetPixel(r->state.depthBuffer, x, y);
+	struct color sampleDepth = {features->depth, features->depth, features->depth, 0.0f};
+	setPixel(r->state.depthBuffer, runningAverage(depth, sampleDepth, sample), x, y);
+}
+
+static bool tracePass(struct renderer *r, const struct renderTile *tile, int sample, sampler *sampler, struct stats *stats, struct texture *image) {
+	for (int y = tile->end.y - 1; y > tile->begin.y - 1; --y) {
+		for (int x = tile->begin.x; x < tile->end.x; ++x) {
+			if (r->state.renderAborted) return false;
+			uint32_t pixIdx = y * r->prefs.imageWidth + x;
+			initSampler(sampler, r->prefs.sampler, sample - 1, r->prefs.sampleCount, pixIdx);
+			
+			struct lightRay incidentRay = getCameraRay(r->scene->camera, x, y, sampler);
+			struct color output = textureGetPixel(r->state.renderBuffer, x, y);
+			struct featureSample features = {{0}};
+			struct color result = pathTrace(&incidentRay, r->scene, r->prefs.bounces, sampler, stats, r->state.albedoBuffer ? &features : NULL);
+			
+			//And process the running average
+			output = colorCoef((float)(sample - 1), output);
+			output = addColors(output, result);
+			float t = 1.0f / sample;
+			output = colorCoef(t, output);
+			
+			//Store internal render buffer (float precision)
+			setPixel(r->state.renderBuffer, output, x, y);
+			if (r->state.albedoBuffer) accumulateFeatures(r, &features, sample, x, y);
+			
+			//Gamma correction, and store the image data
+			if (image) setPixelSRGB(image, output, x, y);
+		}
+	}
+	return true;
+}
+
+bool renderTilePass(struct renderer *r, const struct renderTile *tile, int sample, sampler *sampler, struct stats *stats, struct texture *image) {
+	//Textures sampled during the pass stay resident until we leave
+	const int epoch = textureCacheEnter(r->scene->textures);
+	const bool finished = tracePass(r, tile, sample, sampler, stats, image);
+	textureCacheLeave(r->scene->textures, epoch);
+	return finished;
+}
+
 /**
  A render thread
  
@@ -215,18 +348,18 @@ void *renderThreadInteractive(void *arg) {
  @return Exits when thread is done
  */
 void *renderThread(void *arg) {
-	struct lightRay incidentRay;
 	struct renderThreadState *threadState = (struct renderThreadState*)threadUserData(arg);
 	struct renderer *r = threadState->renderer;
 	struct texture *image = threadState->output;
 	sampler *sampler = newSampler();
+	struct stats stats = {0};
 	
 	//First time setup for each thread
 	struct renderTile tile = nextTile(r);
 	threadState->currentTileNum = tile.tileNum;
 	
 	struct timeval timer = {0};
-	threadState->completedSamples = 1;
+	threadState->completedSamples = tile.startSample;
 	
 	while (tile.tileNum != -1 && r->state.isRendering) {
 		long totalUsec = 0;
@@ -234,55 +367,31 @@ void *renderThread(void *arg) {
 		
 		while (threadState->completedSamples < r->prefs.sampleCount+1 && r->state.isRendering) {
 			startTimer(&timer);
-			for (int y = tile.end.y - 1; y > tile.begin.y - 1; --y) {
-				for (int x = tile.begin.x; x < tile.end.x; ++x) {
-					if (r->state.renderAborted) return 0;
-					uint32_t pixIdx = y * image->width + x;
-					initSampler(sampler, Halton, threadState->completedSamples - 1, r->prefs.sampleCount, pixIdx);
-					
-					incidentRay = getCameraRay(r->scene->camera, x, y, sampler);
-					struct color output = textureGetPixel(r->state.renderBuffer, x, y);
-					struct color sample = pathTrace(&incidentRay, r->scene, r->prefs.bounces, sampler);
-					
-					//And process the running average
-					output = colorCoef((float)(threadState->completedSamples - 1), output);
-					output = addColors(output, sample);
-					float t = 1.0f / threadState->completedSamples;
-					output = colorCoef(t, output);
-					
-					//Store internal render buffer (float precision)
-					setPixel(r->state.renderBuffer, output, x, y);
-					
-					//Gamma correction
-					output = toSRGB(output);
-					
-					//And store the image data
-					setPixel(image, output, x, y);
-				}
-			}
+			if (!renderTilePass(r, &tile, threadState->completedSamples, sampler, &stats, image)) return 0;
 			//For performance metrics
 			samples++;
 			totalUsec += getUs(timer);
+			merge_stats(&threadState->stats, &stats);
+			clear_stats(&stats);
 			threadState->totalSamples++;
 			threadState->completedSamples++;
 			//Pause rendering when bool is set
-			while (threadState->paused && !r->state.renderAborted) {
-				sleepMSec(100);
-			}
+			waitWhilePaused(r, threadState);
 			threadState->avgSampleTime = totalUsec / samples;
+			//Hand half of the remaining area to idle threads near the end of the frame
+			splitTile(r, &tile, threadState->completedSamples);
 		}
 		//Tile has finished rendering, get a new one and start rendering it.
-		r->state.renderTiles[tile.tileNum].isRendering = false;
-		r->state.renderTiles[tile.tileNum].renderComplete = true;
+		finishTile(r, tile.tileNum);
 		threadState->currentTileNum = -1;
-		threadState->completedSamples = 1;
 		tile = nextTile(r);
+		threadState->completedSamples = tile.startSample;
 		threadState->currentTileNum = tile.tileNum;
 	}
 	destroySampler(sampler);
 	//No more tiles to render, exit thread. (render done)
-	threadState->threadComplete = true;
 	threadState->currentTileNum = -1;
+	markThreadComplete(r, threadState);
 	return 0;
 }
 
@@ -300,12 +409,10 @@ struct renderer *newRenderer() {
 	r->scene->meshes = calloc(1, sizeof(*r->scene->meshes));
 	r->scene->spheres = calloc(1, sizeof(*r->scene->spheres));
 	
-	if (!g_vertices) {
-		allocVertexBuffers();
-	}
-	
 	//Mutex
 	r->state.tileMutex = createMutex();
+	r->state.workerCond = createCondition();
+	r->state.mainCond = createCondition();
 	return r;
 }
 	
@@ -314,15 +421,18 @@ void destroyRenderer(struct renderer *r) {
 		destroyScene(r->scene);
 		destroyTexture(r->state.renderBuffer);
 		destroyTexture(r->state.uiBuffer);
-		destroyVertexBuffers();
+		destroyFeatureBuffers(r);
 		free(r->state.timer);
 		free(r->state.renderTiles);
 		free(r->state.threads);
 		free(r->state.threadStates);
-		free(r->state.tileMutex);
+		destroyMutex(r->state.tileMutex);
+		destroyCondition(r->state.workerCond);
+		destroyCondition(r->state.mainCond);
 		free(r->prefs.imgFileName);
 		free(r->prefs.imgFilePath);
 		free(r->prefs.assetPath);
+		free(r->state.sceneJson);
 		free(r);
 	}
 }
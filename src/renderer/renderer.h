@@ -16,6 +16,10 @@ enum renderOrder {
 	renderOrderRandom
 };
 
+#include "../utils/statistics.h"
+#include "samplers/sampler.h"
+#include "../datatypes/image/texture.h"
+
 struct renderThreadState {
 	int thread_num;
 	bool threadComplete;
@@ -30,6 +34,8 @@ struct renderThreadState {
 	
 	long avgSampleTime; //Single tile pass
 	
+	struct stats stats; //Render counters, only written by this thread
+	
 	struct renderer *renderer;
 	struct texture *output;
 };
@@ -38,10 +44,17 @@ struct renderThreadState {
 struct state {
 	struct renderTile *renderTiles; //Array of renderTiles to render
 	int tileCount; //Total amount of render tiles
+	int tileCapacity; //Room in renderTiles, tiles split at the end of a frame are appended
+	int requeueReserve; //Part of tileCapacity kept for requeued tiles, splitting doesn't use it
 	int finishedTileCount;
+	int activeTiles; //Tiles currently being rendered
+	int idleThreads; //Threads waiting for a tile to be split off
 	int finishedPasses; // For interactive mode
 	struct texture *renderBuffer;  //float-precision buffer for multisampling
 	struct texture *uiBuffer; //UI element buffer
+	struct texture *albedoBuffer; //First hit feature buffers, running averages like renderBuffer.
+	struct texture *normalBuffer; //Only allocated when denoising or writing them out
+	struct texture *depthBuffer;
 	int activeThreads; //Amount of threads currently rendering
 	bool isRendering;
 	bool renderAborted;//SDL listens for X key pressed, which sets this
@@ -53,7 +66,20 @@ struct state {
 	struct renderThreadState *threadStates;
 	struct timeval *timer;
 	
+	struct stats stats; //Render counters for the last frame, merged from threadStates
+	long parseTimeUs; //Time spent parsing the scene and loading assets in loadScene()
+	long bvhBuildTimeUs; //Thread time spent building acceleration structures. Mesh BVHs are built while loading, so this overlaps parseTimeUs.
+	
+	char *sceneJson; //Copy of the scene input, kept for network workers (--nodes)
+	struct remoteSession *remote; //Network workers rendering this frame, see networking.c
+	
 	struct crMutex *tileMutex;
+	struct crCondition *workerCond; //Wakes up idle and paused render threads
+	struct crCondition *mainCond; //Wakes up the main thread when a tile or thread finishes
+	
+	//Called from the main thread when a tile finishes, and on status updates
+	void (*progressCallback)(float progress, void *userData);
+	void *progressUserData;
 };
 
 /// Preferences data (Set by user)
@@ -84,6 +110,11 @@ struct prefs {
 	float scale;
 	
 	bool antialiasing;
+	enum samplerType sampler; //Sample sequence the pixels draw from
+	bool denoise; //Run denoise() on the finished frame
+	bool writeAovs; //Also write the noisy image and feature buffers
+	size_t textureCacheSize; //Memory budget for decoded textures, in bytes
+	enum precision hdrPrecision; //How the environment map is stored
 };
 
 /**
@@ -102,5 +133,21 @@ struct renderer *newRenderer(void);
 //Start main render loop
 struct texture *renderFrame(struct renderer *r);
 
+struct renderTile;
+struct sampler;
+
+/// Render one sample pass over a tile, and accumulate it into the running average in renderBuffer
+/// @param r Renderer
+/// @param tile Tile to render
+/// @param sample 1-based index of the sample pass
+/// @param sampler Sampler for the calling thread
+/// @param stats Render counters for the calling thread
+/// @param image Output image to store the gamma corrected result in, or NULL
+/// @return false if the render was aborted mid-way
+bool renderTilePass(struct renderer *r, const struct renderTile *tile, int sample, struct sampler *sampler, struct stats *stats, struct texture *image);
+
+//Toggle the paused state of all render threads
+void togglePause(struct renderer *r);
+
 //Free renderer allocations
 void destroyRenderer(struct renderer *r);
@@ -30,21 +30,6 @@ static inline float wrapAdd(float u, float v) {
 	return (u + v < 1.0f) ? u + v : u + v - 1.0f;
 }
 
-// By PBRT authors
-static inline float radicalInverse(int pass, int base) {
-	const float invBase = 1.0f / base;
-	int reversedDigits = 0;
-	float invBaseN = 1.0f;
-	while (pass) {
-		const int next = pass / base;
-		const int digit = pass - base * next;
-		reversedDigits = reversedDigits * base + digit;
-		invBaseN *= invBase;
-		pass = next;
-	}
-	return min(reversedDigits * invBaseN, 0.99999994f);
-}
-
 static inline float uintToUnitReal(uint32_t v) {
 	// Trick from MTGP: generate an uniformly distributed single precision number in [1,2) and subtract 1
 	union {
@@ -10,6 +10,7 @@
 #include "halton.h"
 
 #include "common.h"
+#include "radicalinverse.h"
 #include "../../datatypes/vector.h"
 #include "../../utils/assert.h"
 
@@ -18,13 +19,20 @@ static const unsigned int primesCount = 6;
 
 void initHalton(haltonSampler *s, int pass, uint32_t seed) {
 	s->rndOffset = uintToUnitReal(seed);
-	s->currPass = pass;
 	s->currPrime = 0;
+	//All pixels in a tile pass share the pass, so the inverses only change between passes
+	if (!s->hasInverses || s->currPass != pass) {
+		for (unsigned i = 0; i < primesCount; ++i) {
+			s->inverses[i] = radicalInverse(pass, primes[i]);
+		}
+		s->currPass = pass;
+		s->hasInverses = true;
+	}
 }
 
 float getHalton(haltonSampler *s) {
 	// Wrapping around trick by @lycium
-	float v = wrapAdd(radicalInverse(s->currPass, primes[s->currPrime++ % primesCount]), s->rndOffset);
+	float v = wrapAdd(s->inverses[s->currPrime++ % primesCount], s->rndOffset);
 	ASSERT(v >= 0);
 	ASSERT(v < 1);
 	return v;
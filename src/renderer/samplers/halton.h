@@ -8,10 +8,14 @@
 
 #pragma once
 
+#include <stdbool.h>
+
 struct haltonSampler {
 	float rndOffset;
 	unsigned currPrime;
 	int currPass;
+	bool hasInverses;
+	float inverses[6]; //Radical inverse of currPass in each prime base
 };
 
 typedef struct haltonSampler haltonSampler;
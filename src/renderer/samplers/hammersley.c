@@ -9,6 +9,7 @@
 #include "hammersley.h"
 
 #include "common.h"
+#include "radicalinverse.h"
 #include "../../datatypes/vector.h"
 #include "../../utils/assert.h"
 
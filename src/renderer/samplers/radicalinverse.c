@@ -0,0 +1,157 @@
+//
+//  radicalinverse.c
+//  C-ray
+//
+//  Created by Valtteri on 18.10.2020.
+//  Copyright © 2020 Valtteri Koskivuori. All rights reserved.
+//
+
+#include "../../includes.h"
+#include "radicalinverse.h"
+
+// Digits are reversed a few at a time with lookup tables, so a 32 bit index only takes a handful of divisions.
+// Each table maps a number of base^digits to the same digits in reverse order.
+
+//Base 2, 8 digits at a time
+static const uint8_t reversed2[256] = {
+	0, 128, 64, 192, 32, 160, 96, 224, 16, 144, 80, 208, 48, 176, 112, 240,
+	8, 136, 72, 200, 40, 168, 104, 232, 24, 152, 88, 216, 56, 184, 120, 248,
+	4, 132, 68, 196, 36, 164, 100, 228, 20, 148, 84, 212, 52, 180, 116, 244,
+	12, 140, 76, 204, 44, 172, 108, 236, 28, 156, 92, 220, 60, 188, 124, 252,
+	2, 130, 66, 194, 34, 162, 98, 226, 18, 146, 82, 210, 50, 178, 114, 242,
+	10, 138, 74, 202, 42, 170, 106, 234, 26, 154, 90, 218, 58, 186, 122, 250,
+	6, 134, 70, 198, 38, 166, 102, 230, 22, 150, 86, 214, 54, 182, 118, 246,
+	14, 142, 78, 206, 46, 174, 110, 238, 30, 158, 94, 222, 62, 190, 126, 254,
+	1, 129, 65, 193, 33, 161, 97, 225, 17, 145, 81, 209, 49, 177, 113, 241,
+	9, 137, 73, 201, 41, 169, 105, 233, 25, 153, 89, 217, 57, 185, 121, 249,
+	5, 133, 69, 197, 37, 165, 101, 229, 21, 149, 85, 213, 53, 181, 117, 245,
+	13, 141, 77, 205, 45, 173, 109, 237, 29, 157, 93, 221, 61, 189, 125, 253,
+	3, 131, 67, 195, 35, 163, 99, 227, 19, 147, 83, 211, 51, 179, 115, 243,
+	11, 139, 75, 203, 43, 171, 107, 235, 27, 155, 91, 219, 59, 187, 123, 251,
+	7, 135, 71, 199, 39, 167, 103, 231, 23, 151, 87, 215, 55, 183, 119, 247,
+	15, 143, 79, 207, 47, 175, 111, 239, 31, 159, 95, 223, 63, 191, 127, 255
+};
+
+//Base 3, 5 digits at a time
+static const uint8_t reversed3[243] = {
+	0, 81, 162, 27, 108, 189, 54, 135, 216, 9, 90, 171, 36, 117, 198, 63,
+	144, 225, 18, 99, 180, 45, 126, 207, 72, 153, 234, 3, 84, 165, 30, 111,
+	192, 57, 138, 219, 12, 93, 174, 39, 120, 201, 66, 147, 228, 21, 102, 183,
+	48, 129, 210, 75, 156, 237, 6, 87, 168, 33, 114, 195, 60, 141, 222, 15,
+	96, 177, 42, 123, 204, 69, 150, 231, 24, 105, 186, 51, 132, 213, 78, 159,
+	240, 1, 82, 163, 28, 109, 190, 55, 136, 217, 10, 91, 172, 37, 118, 199,
+	64, 145, 226, 19, 100, 181, 46, 127, 208, 73, 154, 235, 4, 85, 166, 31,
+	112, 193, 58, 139, 220, 13, 94, 175, 40, 121, 202, 67, 148, 229, 22, 103,
+	184, 49, 130, 211, 76, 157, 238, 7, 88, 169, 34, 115, 196, 61, 142, 223,
+	16, 97, 178, 43, 124, 205, 70, 151, 232, 25, 106, 187, 52, 133, 214, 79,
+	160, 241, 2, 83, 164, 29, 110, 191, 56, 137, 218, 11, 92, 173, 38, 119,
+	200, 65, 146, 227, 20, 101, 182, 47, 128, 209, 74, 155, 236, 5, 86, 167,
+	32, 113, 194, 59, 140, 221, 14, 95, 176, 41, 122, 203, 68, 149, 230, 23,
+	104, 185, 50, 131, 212, 77, 158, 239, 8, 89, 170, 35, 116, 197, 62, 143,
+	224, 17, 98, 179, 44, 125, 206, 71, 152, 233, 26, 107, 188, 53, 134, 215,
+	80, 161, 242
+};
+
+//Base 5, 3 digits at a time
+static const uint8_t reversed5[125] = {
+	0, 25, 50, 75, 100, 5, 30, 55, 80, 105, 10, 35, 60, 85, 110, 15,
+	40, 65, 90, 115, 20, 45, 70, 95, 120, 1, 26, 51, 76, 101, 6, 31,
+	56, 81, 106, 11, 36, 61, 86, 111, 16, 41, 66, 91, 116, 21, 46, 71,
+	96, 121, 2, 27, 52, 77, 102, 7, 32, 57, 82, 107, 12, 37, 62, 87,
+	112, 17, 42, 67, 92, 117, 22, 47, 72, 97, 122, 3, 28, 53, 78, 103,
+	8, 33, 58, 83, 108, 13, 38, 63, 88, 113, 18, 43, 68, 93, 118, 23,
+	48, 73, 98, 123, 4, 29, 54, 79, 104, 9, 34, 59, 84, 109, 14, 39,
+	64, 89, 114, 19, 44, 69, 94, 119, 24, 49, 74, 99, 124
+};
+
+//Base 7, 2 digits at a time
+static const uint8_t reversed7[49] = {
+	0, 7, 14, 21, 28, 35, 42, 1, 8, 15, 22, 29, 36, 43, 2, 9,
+	16, 23, 30, 37, 44, 3, 10, 17, 24, 31, 38, 45, 4, 11, 18, 25,
+	32, 39, 46, 5, 12, 19, 26, 33, 40, 47, 6, 13, 20, 27, 34, 41,
+	48
+};
+
+//Base 11, 2 digits at a time
+static const uint8_t reversed11[121] = {
+	0, 11, 22, 33, 44, 55, 66, 77, 88, 99, 110, 1, 12, 23, 34, 45,
+	56, 67, 78, 89, 100, 111, 2, 13, 24, 35, 46, 57, 68, 79, 90, 101,
+	112, 3, 14, 25, 36, 47, 58, 69, 80, 91, 102, 113, 4, 15, 26, 37,
+	48, 59, 70, 81, 92, 103, 114, 5, 16, 27, 38, 49, 60, 71, 82, 93,
+	104, 115, 6, 17, 28, 39, 50, 61, 72, 83, 94, 105, 116, 7, 18, 29,
+	40, 51, 62, 73, 84, 95, 106, 117, 8, 19, 30, 41, 52, 63, 74, 85,
+	96, 107, 118, 9, 20, 31, 42, 53, 64, 75, 86, 97, 108, 119, 10, 21,
+	32, 43, 54, 65, 76, 87, 98, 109, 120
+};
+
+//Base 13, 2 digits at a time
+static const uint8_t reversed13[169] = {
+	0, 13, 26, 39, 52, 65, 78, 91, 104, 117, 130, 143, 156, 1, 14, 27,
+	40, 53, 66, 79, 92, 105, 118, 131, 144, 157, 2, 15, 28, 41, 54, 67,
+	80, 93, 106, 119, 132, 145, 158, 3, 16, 29, 42, 55, 68, 81, 94, 107,
+	120, 133, 146, 159, 4, 17, 30, 43, 56, 69, 82, 95, 108, 121, 134, 147,
+	160, 5, 18, 31, 44, 57, 70, 83, 96, 109, 122, 135, 148, 161, 6, 19,
+	32, 45, 58, 71, 84, 97, 110, 123, 136, 149, 162, 7, 20, 33, 46, 59,
+	72, 85, 98, 111, 124, 137, 150, 163, 8, 21, 34, 47, 60, 73, 86, 99,
+	112, 125, 138, 151, 164, 9, 22, 35, 48, 61, 74, 87, 100, 113, 126, 139,
+	152, 165, 10, 23, 36, 49, 62, 75, 88, 101, 114, 127, 140, 153, 166, 11,
+	24, 37, 50, 63, 76, 89, 102, 115, 128, 141, 154, 167, 12, 25, 38, 51,
+	64, 77, 90, 103, 116, 129, 142, 155, 168
+};
+
+struct digitTable {
+	const uint8_t *reversed;
+	unsigned size; //base^digits
+	float scale; //1 / size
+};
+
+static const struct digitTable tables[] = {
+	{reversed2, 256, 1.0f / 256.0f},
+	{reversed3, 243, 1.0f / 243.0f},
+	{reversed5, 125, 1.0f / 125.0f},
+	{reversed7, 49, 1.0f / 49.0f},
+	{reversed11, 121, 1.0f / 121.0f},
+	{reversed13, 169, 1.0f / 169.0f},
+};
+
+static inline const struct digitTable *digitTable(int base) {
+	switch (base) {
+		case 2: return &tables[0];
+		case 3: return &tables[1];
+		case 5: return &tables[2];
+		case 7: return &tables[3];
+		case 11: return &tables[4];
+		case 13: return &tables[5];
+		default: return NULL;
+	}
+}
+
+// By PBRT authors
+static float radicalInverseDigits(int pass, int base) {
+	const float invBase = 1.0f / base;
+	int reversedDigits = 0;
+	float invBaseN = 1.0f;
+	while (pass) {
+		const int next = pass / base;
+		const int digit = pass - base * next;
+		reversedDigits = reversedDigits * base + digit;
+		invBaseN *= invBase;
+		pass = next;
+	}
+	return min(reversedDigits * invBaseN, 0.99999994f);
+}
+
+float radicalInverse(int pass, int base) {
+	const struct digitTable *table = digitTable(base);
+	if (!table) return radicalInverseDigits(pass, base);
+	unsigned index = (unsigned)pass;
+	float result = 0.0f;
+	float scale = table->scale;
+	while (index) {
+		const unsigned next = index / table->size;
+		result += table->reversed[index - next * table->size] * scale;
+		scale *= table->scale;
+		index = next;
+	}
+	return min(result, 0.99999994f);
+}
@@ -0,0 +1,16 @@
+//
+//  radicalinverse.h
+//  C-ray
+//
+//  Created by Valtteri on 18.10.2020.
+//  Copyright © 2020 Valtteri Koskivuori. All rights reserved.
+//
+
+#pragma once
+
+/// Mirror the digits of pass in the given base around the decimal point.
+/// @remarks Bases up to 13 use lookup tables, others fall back to one division per digit
+/// @param pass Sample index
+/// @param base Prime base
+/// @return Value in [0, 1)
+float radicalInverse(int pass, int base);
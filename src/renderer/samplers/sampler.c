@@ -8,9 +8,11 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include "halton.h"
 #include "hammersley.h"
 #include "random.h"
+#include "sobol.h"
 #include "sampler.h"
 #include "common.h"
 #include "../../utils/logging.h"
@@ -21,6 +23,7 @@ struct sampler {
 		hammersleySampler hammersley;
 		haltonSampler halton;
 		randomSampler random;
+		sobolSampler sobol;
 	} sampler;
 };
 
@@ -29,6 +32,8 @@ struct sampler *newSampler() {
 }
 
 void initSampler(sampler *sampler, enum samplerType type, int pass, int maxPasses, uint32_t pixelIndex) {
+	//Samplers may keep state between pixels, which is only valid for the same type
+	if (sampler->type != type) memset(&sampler->sampler, 0, sizeof(sampler->sampler));
 	switch (type) {
 		case Halton:
 			initHalton(&sampler->sampler.halton, pass, hash(pixelIndex));
@@ -42,6 +47,10 @@ void initSampler(sampler *sampler, enum samplerType type, int pass, int maxPasse
 			initRandom(&sampler->sampler.random, hash64(pixelIndex * maxPasses + pass));
 			sampler->type = Random;
 			break;
+		case Sobol:
+			initSobol(&sampler->sampler.sobol, pass, hash(pixelIndex));
+			sampler->type = Sobol;
+			break;
 	}
 }
 
@@ -53,6 +62,8 @@ float getDimension(struct sampler *sampler) {
 			return getHalton(&sampler->sampler.halton);
 		case Random:
 			return getRandom(&sampler->sampler.random);
+		case Sobol:
+			return getSobol(&sampler->sampler.sobol);
 	}
 	return 0;
 }
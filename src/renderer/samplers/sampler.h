@@ -14,7 +14,8 @@ typedef struct sampler sampler;
 enum samplerType {
 	Halton = 0,
 	Hammersley,
-	Random
+	Random,
+	Sobol
 };
 
 struct sampler *newSampler(void);
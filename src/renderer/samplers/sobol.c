@@ -0,0 +1,110 @@
+//
+//  sobol.c
+//  C-ray
+//
+//  Created by Valtteri on 18.10.2020.
+//  Copyright © 2020 Valtteri Koskivuori. All rights reserved.
+//
+
+#include "../../includes.h"
+#include "sobol.h"
+
+#include "common.h"
+#include "../../utils/assert.h"
+
+// Owen scrambled Sobol points, from Burley 2020, "Practical Hash-based Owen Scrambling".
+// Only the first four Sobol dimensions are used, since higher ones have poor 2D projections.
+// Further dimensions are padded with independently shuffled and scrambled copies of those four.
+
+#define SOBOL_DIMENSIONS 4
+
+// Direction numbers for the first four dimensions, from Joe & Kuo 2008 (new-joe-kuo-6.21201).
+// These are stored bit-reversed, so the scrambling below can skip one reversal.
+static const uint32_t directions[SOBOL_DIMENSIONS][32] = {
+	{
+		0x00000001, 0x00000002, 0x00000004, 0x00000008, 0x00000010, 0x00000020, 0x00000040, 0x00000080,
+		0x00000100, 0x00000200, 0x00000400, 0x00000800, 0x00001000, 0x00002000, 0x00004000, 0x00008000,
+		0x00010000, 0x00020000, 0x00040000, 0x00080000, 0x00100000, 0x00200000, 0x00400000, 0x00800000,
+		0x01000000, 0x02000000, 0x04000000, 0x08000000, 0x10000000, 0x20000000, 0x40000000, 0x80000000
+	},
+	{
+		0x00000001, 0x00000003, 0x00000005, 0x0000000f, 0x00000011, 0x00000033, 0x00000055, 0x000000ff,
+		0x00000101, 0x00000303, 0x00000505, 0x00000f0f, 0x00001111, 0x00003333, 0x00005555, 0x0000ffff,
+		0x00010001, 0x00030003, 0x00050005, 0x000f000f, 0x00110011, 0x00330033, 0x00550055, 0x00ff00ff,
+		0x01010101, 0x03030303, 0x05050505, 0x0f0f0f0f, 0x11111111, 0x33333333, 0x55555555, 0xffffffff
+	},
+	{
+		0x00000001, 0x00000003, 0x00000006, 0x00000009, 0x00000017, 0x0000003a, 0x00000071, 0x000000a3,
+		0x00000116, 0x00000339, 0x00000677, 0x000009aa, 0x00001601, 0x00003903, 0x00007706, 0x0000aa09,
+		0x00010117, 0x0003033a, 0x00060671, 0x000909a3, 0x00171616, 0x003a3939, 0x00717777, 0x00a3aaaa,
+		0x01170001, 0x033a0003, 0x06710006, 0x09a30009, 0x16160017, 0x3939003a, 0x77770071, 0xaaaa00a3
+	},
+	{
+		0x00000001, 0x00000003, 0x00000004, 0x0000000a, 0x0000001f, 0x0000002e, 0x00000045, 0x000000c9,
+		0x0000011b, 0x000002a4, 0x0000079a, 0x00000b67, 0x0000101e, 0x0000302d, 0x00004041, 0x0000a0c3,
+		0x0001f104, 0x0002e28a, 0x000457df, 0x000c9bae, 0x0011a105, 0x002a7289, 0x0079e7db, 0x00b6dba4,
+		0x0100011a, 0x030002a7, 0x0400079e, 0x0a000b6d, 0x1f001001, 0x2e003003, 0x45004004, 0xc900a00a
+	}
+};
+
+static inline uint32_t reverseBits(uint32_t x) {
+	x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+	x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+	x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+	x = ((x >> 8) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8);
+	return (x >> 16) | (x << 16);
+}
+
+// Laine-Karras style hash, where each bit only depends on the bits below it
+static inline uint32_t laineKarras(uint32_t x, uint32_t seed) {
+	x += seed;
+	x ^= x * 0x6c50b47cu;
+	x ^= x * 0xb82f1e52u;
+	x ^= x * 0xc7afe638u;
+	x ^= x * 0x8d22f6e6u;
+	return x;
+}
+
+// Owen scrambling flips bits depending on the bits above them, so hash the reversed value
+static inline uint32_t nestedUniformScramble(uint32_t x, uint32_t seed) {
+	return reverseBits(laineKarras(reverseBits(x), seed));
+}
+
+static inline uint32_t hashCombine(uint32_t seed, uint32_t v) {
+	return seed ^ (v + (seed << 6) + (seed >> 2));
+}
+
+//Bit-reversed Sobol points in all four dimensions
+static inline void sobolReversed(uint32_t index, uint32_t *points) {
+	points[0] = points[1] = points[2] = points[3] = 0;
+	for (unsigned bit = 0; index; index >>= 1, ++bit) {
+		const uint32_t mask = -(index & 1);
+		points[0] ^= directions[0][bit] & mask;
+		points[1] ^= directions[1][bit] & mask;
+		points[2] ^= directions[2][bit] & mask;
+		points[3] ^= directions[3][bit] & mask;
+	}
+}
+
+void initSobol(sobolSampler *s, int pass, uint32_t seed) {
+	s->seed = seed;
+	s->index = (uint32_t)pass;
+	s->currDimension = 0;
+	s->currGroup = UINT32_MAX;
+}
+
+float getSobol(sobolSampler *s) {
+	const unsigned dimension = s->currDimension++;
+	//Every group of four dimensions gets its own shuffle of the sample order, so the groups don't correlate
+	if (dimension / SOBOL_DIMENSIONS != s->currGroup) {
+		s->currGroup = dimension / SOBOL_DIMENSIONS;
+		s->groupSeed = hash(hashCombine(s->seed, s->currGroup));
+		sobolReversed(nestedUniformScramble(s->index, s->groupSeed), s->points);
+	}
+	const uint32_t reversed = s->points[dimension % SOBOL_DIMENSIONS];
+	const uint32_t x = reverseBits(laineKarras(reversed, hash(hashCombine(s->groupSeed, dimension))));
+	const float v = uintToUnitReal(x);
+	ASSERT(v >= 0);
+	ASSERT(v < 1);
+	return v;
+}
@@ -0,0 +1,24 @@
+//
+//  sobol.h
+//  C-ray
+//
+//  Created by Valtteri on 18.10.2020.
+//  Copyright © 2020 Valtteri Koskivuori. All rights reserved.
+//
+
+#pragma once
+
+struct sobolSampler {
+	uint32_t seed;
+	uint32_t index;
+	unsigned currDimension;
+	//Unscrambled points for the current group of four dimensions
+	uint32_t currGroup;
+	uint32_t groupSeed;
+	uint32_t points[4];
+};
+
+typedef struct sobolSampler sobolSampler;
+
+void initSobol(sobolSampler *s, int pass, uint32_t seed);
+float getSobol(sobolSampler *s);
@@ -21,6 +21,8 @@
 #include "textbuffer.h"
 #include "testrunner.h"
 #include "string.h"
+#include "benchmark.h"
+#include "networking.h"
 
 static struct hashtable *g_options;
 
@@ -35,6 +37,13 @@ static void printUsage(const char *progname) {
 	printf("    [-v]            -> Enable verbose mode\n");
 	printf("    [--interactive] -> Start in interactive mode (Experimental)\n");
 	printf("    [--test]        -> Run the test suite\n");
+	printf("    [--perf]        -> Run kernel micro-benchmarks\n");
+	printf("    [--benchmark]   -> Render the bundled benchmark scenes and print results as JSON\n");
+	printf("    [--denoise]     -> Denoise the finished image\n");
+	printf("    [--aovs]        -> Also write the noisy image, albedo, normal and depth buffers\n");
+	printf("    [--worker [port]] -> Run as a network render worker, listening on port (default %i)\n", C_RAY_PORT);
+	printf("    [--nodes <list>]  -> Render with network workers, e.g. host1:2222,host2\n");
+	printf("    [--convert <mesh> [output]] -> Convert an OBJ to a .crmesh with a prebuilt BVH\n");
 	restoreTerminal();
 	exit(0);
 }
@@ -64,7 +73,10 @@ bool parseDims(const char *dimStr, int *widthOut, int *heightOut) {
 void parseArgs(int argc, char **argv) {
 	g_options = newTable();
 	static bool inputFileSet = false;
+#ifdef CRAY_TESTING
 	int testIdx = -1;
+	int benchIdx = -1;
+#endif
 	char *alternatePath = NULL;
 	//Always omit the first argument.
 	for (int i = 1; i < argc; ++i) {
@@ -121,23 +133,86 @@ void parseArgs(int argc, char **argv) {
 			}
 		} else if (strncmp(argv[i], "--test", 6) == 0) {
 			setTag(g_options, "runTests");
+#ifdef CRAY_TESTING
 			char *testIdxStr = argv[i + 1];
 			if (testIdxStr) {
 				int n = atoi(testIdxStr);
 				n = n < 0 ? 0 : n;
 				testIdx = n;
 			}
+#endif
+		} else if (strncmp(argv[i], "--perf", 6) == 0) {
+			setTag(g_options, "runKernelBenchmarks");
+#ifdef CRAY_TESTING
+			char *benchIdxStr = argv[i + 1];
+			if (benchIdxStr) {
+				int n = atoi(benchIdxStr);
+				n = n < 0 ? 0 : n;
+				benchIdx = n;
+			}
+#endif
 		} else if (strncmp(argv[i], "--tcount", 8) == 0) {
 			setTag(g_options, "runTests");
+#ifdef CRAY_TESTING
 			testIdx = -2;
+#endif
 		} else if (strncmp(argv[i], "--interactive", 13) == 0) {
 			setTag(g_options, "interactive");
+		} else if (strncmp(argv[i], "--benchmark", 11) == 0) {
+			setTag(g_options, "benchmark");
+		} else if (strncmp(argv[i], "--denoise", 9) == 0) {
+			setTag(g_options, "denoise");
+		} else if (strncmp(argv[i], "--aovs", 6) == 0) {
+			setTag(g_options, "write_aovs");
+		} else if (strncmp(argv[i], "--worker", 8) == 0) {
+			setTag(g_options, "worker");
+			char *portStr = argv[i + 1];
+			int port = portStr ? atoi(portStr) : 0;
+			setInt(g_options, "worker_port", port > 0 && port < 65536 ? port : C_RAY_PORT);
+		} else if (strncmp(argv[i], "--nodes", 7) == 0) {
+			char *nodeList = argv[i + 1];
+			if (nodeList && nodeList[0] != '-') {
+				setString(g_options, "nodes", nodeList);
+				++i;
+			} else {
+				logr(warning, "Invalid --nodes parameter given!\n");
+			}
+		} else if (strncmp(argv[i], "--convert", 9) == 0) {
+			char *meshPath = argv[i + 1];
+			if (meshPath && meshPath[0] != '-') {
+				setTag(g_options, "convert");
+				setString(g_options, "convert_input", meshPath);
+				++i;
+				char *outputPath = argv[i + 1];
+				if (outputPath && outputPath[0] != '-') {
+					setString(g_options, "convert_output", outputPath);
+					++i;
+				}
+			} else {
+				logr(warning, "Invalid --convert parameter given!\n");
+			}
 		} else if (strncmp(argv[i], "-", 1) == 0) {
 			setTag(g_options, ++argv[i]);
 		}
 	}
 	logr(debug, "Verbose mode enabled\n");
 	
+	//Benchmark runs use fixed settings so results are comparable between machines.
+	//Thread count is left to the system, since that's what we're measuring.
+	if (isSet("benchmark")) {
+		if (!isSet("samples_override")) setInt(g_options, "samples_override", BENCHMARK_SAMPLES);
+		if (!isSet("dims_override")) {
+			setTag(g_options, "dims_override");
+			setInt(g_options, "dims_width", BENCHMARK_WIDTH);
+			setInt(g_options, "dims_height", BENCHMARK_HEIGHT);
+		}
+		if (!isSet("tiledims_override")) {
+			setTag(g_options, "tiledims_override");
+			setInt(g_options, "tile_width", BENCHMARK_TILE_SIZE);
+			setInt(g_options, "tile_height", BENCHMARK_TILE_SIZE);
+		}
+	}
+	
 	if (isSet("runTests")) {
 #ifdef CRAY_TESTING
 		switch (testIdx) {
@@ -156,12 +231,22 @@ void parseArgs(int argc, char **argv) {
 		logr(warning, "You need to compile with tests enabled.\n");
 		logr(warning, "Run: `cmake . -DTESTING=True` and then `make`\n");
 		exit(-1);
+#endif
+	}
+	
+	if (isSet("runKernelBenchmarks")) {
+#ifdef CRAY_TESTING
+		exit(benchIdx < 0 ? runKernelBenchmarks() : runKernelBenchmark(benchIdx));
+#else
+		logr(warning, "You need to compile with tests enabled.\n");
+		logr(warning, "Run: `cmake . -DTESTING=True` and then `make`\n");
+		exit(-1);
 #endif
 	}
 }
 
 bool isSet(char *key) {
-	return exists(g_options, key);
+	return g_options && exists(g_options, key);
 }
 
 int intPref(char *key) {
@@ -169,6 +254,11 @@ int intPref(char *key) {
 	return getInt(g_options, key);
 }
 
+char *stringPref(char *key) {
+	ASSERT(exists(g_options, key));
+	return getString(g_options, key);
+}
+
 char *pathArg() {
 	ASSERT(exists(g_options, "inputFile"));
 	return getString(g_options, "inputFile");
@@ -176,4 +266,6 @@ char *pathArg() {
 
 void destroyOptions() {
 	freeTable(g_options);
+	//Logging still checks options on the way out
+	g_options = NULL;
 }
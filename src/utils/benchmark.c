@@ -0,0 +1,102 @@
+//
+//  benchmark.c
+//  C-ray
+//
+//  Created by Valtteri on 18.10.2020.
+//  Copyright © 2020 Valtteri Koskivuori. All rights reserved.
+//
+
+#include "../includes.h"
+#include "benchmark.h"
+
+#include "../datatypes/image/imagefile.h"
+#include "../renderer/renderer.h"
+#include "../datatypes/scene.h"
+#include "../datatypes/image/texture.h"
+#include "../libraries/cJSON.h"
+#include "platform/capabilities.h"
+#include "statistics.h"
+#include "logging.h"
+#include "fileio.h"
+#include "timer.h"
+#include "gitsha1.h"
+
+//Scenes are rendered in this order. Sampling is deterministic, so each run traces the same paths.
+static const char *benchmarkScenes[] = {
+	"input/scene.json",
+	"input/hdr.json",
+	"input/refraction.json",
+	"input/fence.json",
+};
+
+#define benchmarkSceneCount (sizeof(benchmarkScenes) / sizeof(benchmarkScenes[0]))
+
+static cJSON *benchmarkScene(const char *path) {
+	size_t bytes = 0;
+	char *input = loadFile(path, &bytes);
+	if (!input) return NULL;
+	
+	struct renderer *r = newRenderer();
+	r->prefs.assetPath = getFilePath(path);
+	if (loadScene(r, input)) {
+		free(input);
+		destroyRenderer(r);
+		return NULL;
+	}
+	free(input);
+	
+	struct timeval timer = {0};
+	startTimer(&timer);
+	destroyTexture(renderFrame(r));
+	long renderUs = getUs(timer);
+	renderUs = renderUs > 0 ? renderUs : 1;
+	
+	uint64_t rayCount = get_value(&r->state.stats, rays_traced);
+	uint64_t pathCount = get_value(&r->state.stats, paths);
+	
+	cJSON *result = cJSON_CreateObject();
+	cJSON_AddStringToObject(result, "scene", path);
+	cJSON_AddNumberToObject(result, "width", r->prefs.imageWidth);
+	cJSON_AddNumberToObject(result, "height", r->prefs.imageHeight);
+	cJSON_AddNumberToObject(result, "samples", r->prefs.sampleCount);
+	cJSON_AddNumberToObject(result, "bounces", r->prefs.bounces);
+	cJSON_AddNumberToObject(result, "threads", r->prefs.threadCount);
+	cJSON_AddNumberToObject(result, "load_ms", 0.001 * r->state.parseTimeUs);
+	cJSON_AddNumberToObject(result, "bvh_build_ms", 0.001 * r->state.bvhBuildTimeUs);
+	cJSON_AddNumberToObject(result, "render_ms", 0.001 * renderUs);
+	cJSON_AddNumberToObject(result, "rays", rayCount);
+	cJSON_AddNumberToObject(result, "paths", pathCount);
+	cJSON_AddNumberToObject(result, "mrays_per_sec", (double)rayCount / renderUs);
+	//Thread time per path, the same figure as in the progress line
+	cJSON_AddNumberToObject(result, "us_per_path", pathCount ? (double)renderUs * r->prefs.threadCount / pathCount : 0.0);
+	
+	destroyRenderer(r);
+	return result;
+}
+
+int runBenchmark() {
+	cJSON *report = cJSON_CreateObject();
+	cJSON_AddStringToObject(report, "git_hash", gitHash());
+	cJSON_AddNumberToObject(report, "cores", getSysCores());
+	cJSON *scenes = cJSON_AddArrayToObject(report, "scenes");
+	
+	int ret = 0;
+	for (size_t i = 0; i < benchmarkSceneCount; ++i) {
+		logr(info, "Benchmarking %s (%zu/%zu)\n", benchmarkScenes[i], i + 1, benchmarkSceneCount);
+		cJSON *result = benchmarkScene(benchmarkScenes[i]);
+		if (!result) {
+			logr(warning, "Failed to load benchmark scene %s\n", benchmarkScenes[i]);
+			ret = -1;
+			break;
+		}
+		cJSON_AddItemToArray(scenes, result);
+	}
+	//Peak memory usage is tracked for the whole process, so this covers all scenes
+	cJSON_AddNumberToObject(report, "peak_rss_bytes", getPeakMemoryUsage());
+	
+	char *json = cJSON_Print(report);
+	printf("%s\n", json);
+	free(json);
+	cJSON_Delete(report);
+	return ret;
+}
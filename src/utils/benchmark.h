@@ -0,0 +1,19 @@
+//
+//  benchmark.h
+//  C-ray
+//
+//  Created by Valtteri on 18.10.2020.
+//  Copyright © 2020 Valtteri Koskivuori. All rights reserved.
+//
+
+#pragma once
+
+//Fixed render settings for --benchmark, applied unless overridden on the command line
+#define BENCHMARK_SAMPLES 16
+#define BENCHMARK_WIDTH 480
+#define BENCHMARK_HEIGHT 300
+#define BENCHMARK_TILE_SIZE 32
+
+/// Render the bundled benchmark scenes headless, and print the results to stdout as JSON.
+/// @return 0 on success, -1 if a scene failed to load
+int runBenchmark(void);
@@ -72,7 +72,7 @@ struct poly polyFromObj(obj_face *face, int firstVertexIndex, int firstNormalInd
  @return c-ray material
  */
 struct material materialFromObj(obj_material *mat) {
-	struct material newMat;
+	struct material newMat = {0};
 	
 	newMat.name = calloc(256, sizeof(*newMat.name));
 	newMat.normalMapPath = calloc(500, sizeof(*newMat.normalMapPath));
@@ -16,6 +16,14 @@
 #endif
 #include "string.h"
 #include <errno.h>
+#ifdef WINDOWS
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 char *loadFile(const char *fileName, size_t *bytes) {
 	FILE *f = fopen(fileName, "rb");
@@ -31,10 +39,70 @@ char *loadFile(const char *fileName, size_t *bytes) {
 	} else {
 		buf[len] = '\0';
 	}
+	fclose(f);
 	if (bytes) *bytes = len;
 	return buf;
 }
 
+struct fileMapping *mapFile(const char *fileName) {
+	struct fileMapping *file = calloc(1, sizeof(*file));
+#ifdef WINDOWS
+	HANDLE handle = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	LARGE_INTEGER size;
+	if (handle == INVALID_HANDLE_VALUE || !GetFileSizeEx(handle, &size)) {
+		logr(warning, "Can't access '%s': error %lu\n", fileName, GetLastError());
+		if (handle != INVALID_HANDLE_VALUE) CloseHandle(handle);
+		free(file);
+		return NULL;
+	}
+	file->size = (size_t)size.QuadPart;
+	if (file->size) {
+		//The view keeps the mapping alive, so the handles can be closed right away
+		HANDLE mapping = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+		file->data = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+		if (mapping) CloseHandle(mapping);
+	}
+	CloseHandle(handle);
+#else
+	const int fd = open(fileName, O_RDONLY);
+	struct stat info;
+	if (fd < 0 || fstat(fd, &info) != 0) {
+		logr(warning, "Can't access '%s': %s (%i)\n", fileName, strerror(errno), errno);
+		if (fd >= 0) close(fd);
+		free(file);
+		return NULL;
+	}
+	file->size = (size_t)info.st_size;
+	if (file->size) {
+		void *data = mmap(NULL, file->size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data != MAP_FAILED) {
+			madvise(data, file->size, MADV_SEQUENTIAL);
+			madvise(data, file->size, MADV_WILLNEED);
+			file->data = data;
+		}
+	}
+	close(fd);
+#endif
+	if (file->size && !file->data) {
+		logr(warning, "Failed to map '%s'\n", fileName);
+		free(file);
+		return NULL;
+	}
+	return file;
+}
+
+void unmapFile(struct fileMapping *file) {
+	if (!file) return;
+	if (file->data) {
+#ifdef WINDOWS
+		UnmapViewOfFile(file->data);
+#else
+		munmap((void *)file->data, file->size);
+#endif
+	}
+	free(file);
+}
+
 void writeFile(const unsigned char *buf, size_t bufsize, const char *filePath) {
 	FILE *file = fopen(filePath, "wb" );
 	char *backupPath = NULL;
@@ -136,6 +204,19 @@ char *getFilePath(const char *input) {
 	return final;
 }
 
+char *getCanonicalPath(const char *input) {
+	char *canonical = calloc(CRAY_PATH_MAX, sizeof(*canonical));
+#ifdef WINDOWS
+	if (!_fullpath(canonical, input, CRAY_PATH_MAX)) {
+#else
+	if (!realpath(input, canonical)) {
+#endif
+		free(canonical);
+		return copyString(input);
+	}
+	return canonical;
+}
+
 #define chunksize 1024
 //Get scene data from stdin and return a pointer to it
 char *readStdin(size_t *bytes) {
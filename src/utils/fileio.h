@@ -8,6 +8,9 @@
 
 #pragma once
 
+#include <stdbool.h>
+#include <stddef.h>
+
 /// Returns a string containing `bytes` converted into a more human readable format.
 /// @param bytes How many bytes you have
 /// @return A human readable file size string.
@@ -18,6 +21,20 @@ char *humanFileSize(unsigned long bytes);
 /// @param bytes Will be set to amount of bytes read, if provided.
 char *loadFile(const char *fileName, size_t *bytes);
 
+/// Read-only view of the contents of a file
+struct fileMapping {
+	const unsigned char *data; //Not null terminated
+	size_t size;
+};
+
+/// Map a file into memory, so it can be parsed in place instead of copied into a buffer first.
+/// Pages are read in on first access, and the OS is told the file will be read front to back.
+/// @param fileName Path to file
+/// @return Mapping to release with unmapFile(), or NULL if the file can't be opened
+struct fileMapping *mapFile(const char *fileName);
+
+void unmapFile(struct fileMapping *file);
+
 // This is a more robust file writing function, that will seek alternate directories
 // if the specified one wasn't writeable.
 void writeFile(const unsigned char *buf, size_t bufsize, const char *filePath);
@@ -38,6 +55,12 @@ char *getFileName(const char *input);
 /// @param input Full path
 char *getFilePath(const char *input);
 
+/// Resolve a path to an absolute one, with symlinks and relative components removed.
+/// Two paths to the same file resolve to the same string.
+/// @param input Path to an existing file
+/// @return Canonical path, or a copy of input if it couldn't be resolved
+char *getCanonicalPath(const char *input);
+
 /// Await for input on stdin for up to 2 seconds. If nothing shows up, return NULL
 /// @param bytes Bytes read, if successful.
 char *readStdin(size_t *bytes);
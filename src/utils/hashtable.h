@@ -21,6 +21,9 @@ struct hashtable {
 	uint64_t size;
 };
 
+/// Fowler-Noll-Vo hash of size bytes of data
+uint64_t hashDataToU64(const char *data, size_t size);
+
 struct bucket *getBucketPtr(struct hashtable *e, const char *key);
 
 bool exists(struct hashtable *e, const char *key);
@@ -0,0 +1,394 @@
+//
+//  crmesh.c
+//  C-ray
+//
+//  Created by Valtteri on 18.10.2020.
+//  Copyright © 2020 Valtteri Koskivuori. All rights reserved.
+//
+
+#include "../../includes.h"
+#include <limits.h>
+#include "crmesh.h"
+
+#include "meshloader.h"
+#include "../../datatypes/vector.h"
+#include "../../datatypes/color.h"
+#include "../../datatypes/poly.h"
+#include "../../datatypes/material.h"
+#include "../../accelerators/bvh.h"
+#include "../fileio.h"
+#include "../logging.h"
+#include "../string.h"
+#include "../timer.h"
+#include "../platform/capabilities.h"
+
+// A .crmesh file is a header followed by sections of fixed size records. Every section starts
+// at a multiple of CRMESH_ALIGNMENT bytes from the start of the file, so once it's mapped the
+// arrays can be used in place. Values are stored in the byte order of the machine that wrote it.
+// Meshes are stored welded, so vertex positions can be used in place once the mesh is compacted.
+
+#define CRMESH_VERSION 2
+#define CRMESH_ALIGNMENT 64
+#define CRMESH_BYTE_ORDER 0x01020304
+#define CRMESH_NO_STRING UINT32_MAX
+
+static const char crMeshMagic[8] = "CRMESH";
+
+enum crMeshSectionType {
+	sectionVertices,
+	sectionNormals,
+	sectionTextureCoords,
+	sectionTriangles,
+	sectionMaterials,
+	sectionStrings,
+	sectionBvhNodes,
+	sectionBvhPrimIndices,
+	sectionCount
+};
+
+struct crMeshSection {
+	uint64_t offset; //From the start of the file
+	uint64_t count; //Amount of records
+};
+
+struct crMeshHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t byteOrder;
+	uint32_t bvhNodeSize; //0 if there is no BVH
+	uint32_t reserved;
+	struct crMeshSection sections[sectionCount];
+};
+
+struct crMeshTriangle {
+	int32_t vertex[3];
+	int32_t normal[3]; //-1 if the corner has no normal
+	int32_t texture[3]; //-1 if the corner has no texture coordinate
+	uint32_t material;
+};
+
+struct crMeshMaterial {
+	//Offsets into the string section, or CRMESH_NO_STRING
+	uint32_t name;
+	uint32_t texture;
+	uint32_t normalMap;
+	uint32_t specularMap;
+	struct color ambient;
+	struct color diffuse;
+	struct color specular;
+	struct color emission;
+	float reflectivity;
+	float roughness;
+	float refractivity;
+	float IOR;
+	float transparency;
+	float sharpness;
+	float glossiness;
+	uint32_t reserved;
+};
+
+static size_t recordSize(enum crMeshSectionType type, const struct crMeshHeader *header) {
+	switch (type) {
+		case sectionVertices: return sizeof(struct vector);
+		case sectionNormals: return sizeof(struct vector);
+		case sectionTextureCoords: return sizeof(struct coord);
+		case sectionTriangles: return sizeof(struct crMeshTriangle);
+		case sectionMaterials: return sizeof(struct crMeshMaterial);
+		case sectionStrings: return sizeof(char);
+		case sectionBvhNodes: return header->bvhNodeSize;
+		case sectionBvhPrimIndices: return sizeof(int32_t);
+		default: return 0;
+	}
+}
+
+static inline uint64_t alignOffset(uint64_t offset) {
+	return (offset + CRMESH_ALIGNMENT - 1) & ~(uint64_t)(CRMESH_ALIGNMENT - 1);
+}
+
+static const void *sectionData(const struct fileMapping *mapping, const struct crMeshHeader *header, enum crMeshSectionType type) {
+	if (!header->sections[type].count) return NULL;
+	return mapping->data + header->sections[type].offset;
+}
+
+static const char *checkHeader(const struct fileMapping *mapping) {
+	if (mapping->size < sizeof(struct crMeshHeader)) return "File is too small";
+	const struct crMeshHeader *header = (const struct crMeshHeader *)mapping->data;
+	if (memcmp(header->magic, crMeshMagic, sizeof(crMeshMagic))) return "Not a .crmesh file";
+	if (header->byteOrder != CRMESH_BYTE_ORDER) return "Written on a machine with a different byte order";
+	if (header->version != CRMESH_VERSION) return "Unsupported version, convert the mesh again";
+	for (int i = 0; i < sectionCount; ++i) {
+		const struct crMeshSection *section = &header->sections[i];
+		const size_t size = recordSize(i, header);
+		if (!section->count) continue;
+		if (!size || section->offset % CRMESH_ALIGNMENT || section->offset > mapping->size) return "Invalid section offset";
+		if (section->count > (mapping->size - section->offset) / size) return "File is truncated";
+	}
+	//Polygon indices are stored in ints
+	for (int i = sectionVertices; i <= sectionTriangles; ++i) {
+		if (header->sections[i].count > INT_MAX) return "Too many elements";
+	}
+	if (header->sections[sectionMaterials].count > UINT16_MAX) return "Too many materials";
+	const uint64_t stringBytes = header->sections[sectionStrings].count;
+	if (stringBytes && ((const char *)sectionData(mapping, header, sectionStrings))[stringBytes - 1] != '\0') return "Invalid string table";
+	return NULL;
+}
+
+static bool validIndex(int32_t index, uint64_t count, bool optional) {
+	return (optional && index == -1) || (index >= 0 && (uint64_t)index < count);
+}
+
+//Welded corners use the vertex index for the normal and texture coordinate too, see weldMeshFile()
+static bool weldedIndex(int32_t index, int32_t vertex) {
+	return index == -1 || index == vertex;
+}
+
+static bool decodeTriangles(struct meshFile *file, const struct crMeshTriangle *triangles) {
+	file->polygons = malloc(file->polyCount * sizeof(*file->polygons));
+	//Meshes without materials get a placeholder one at index 0
+	const uint32_t materialCount = (uint32_t)max(file->materialCount, 1);
+	for (size_t i = 0; i < file->polyCount; ++i) {
+		const struct crMeshTriangle *t = &triangles[i];
+		struct poly *p = &file->polygons[i];
+		if (t->material >= materialCount) return false;
+		p->vertexCount = 3;
+		p->materialIndex = t->material;
+		p->hasNormals = true;
+		for (int c = 0; c < 3; ++c) {
+			if (!validIndex(t->vertex[c], file->vertexCount, false)) return false;
+			if (!validIndex(t->normal[c], file->normalCount, true)) return false;
+			if (!validIndex(t->texture[c], file->textureCount, true)) return false;
+			if (!weldedIndex(t->normal[c], t->vertex[c]) || !weldedIndex(t->texture[c], t->vertex[c])) return false;
+			p->vertexIndex[c] = t->vertex[c];
+			p->normalIndex[c] = t->normal[c];
+			p->textureIndex[c] = t->texture[c];
+			if (t->normal[c] < 0) p->hasNormals = false;
+		}
+	}
+	return true;
+}
+
+static char *getString(const char *strings, uint64_t stringBytes, uint32_t offset) {
+	if (offset == CRMESH_NO_STRING || offset >= stringBytes) return NULL;
+	return copyString(strings + offset);
+}
+
+static void decodeMaterials(struct meshFile *file, const struct crMeshMaterial *materials, const char *strings, uint64_t stringBytes) {
+	file->materials = calloc(file->materialCount, sizeof(*file->materials));
+	for (int i = 0; i < file->materialCount; ++i) {
+		const struct crMeshMaterial *m = &materials[i];
+		file->materials[i] = (struct material){
+			.name = getString(strings, stringBytes, m->name),
+			.textureFilePath = getString(strings, stringBytes, m->texture),
+			.normalMapPath = getString(strings, stringBytes, m->normalMap),
+			.specularMapPath = getString(strings, stringBytes, m->specularMap),
+			.ambient = m->ambient,
+			.diffuse = m->diffuse,
+			.specular = m->specular,
+			.emission = m->emission,
+			.reflectivity = m->reflectivity,
+			.roughness = m->roughness,
+			.refractivity = m->refractivity,
+			.IOR = m->IOR,
+			.transparency = m->transparency,
+			.sharpness = m->sharpness,
+			.glossiness = m->glossiness
+		};
+	}
+}
+
+struct meshFile *loadCrMesh(const char *filePath) {
+	struct timeval timer;
+	startTimer(&timer);
+	struct fileMapping *mapping = mapFile(filePath);
+	if (!mapping) return NULL;
+	const char *error = checkHeader(mapping);
+	if (error) {
+		logr(warning, "Can't load %s: %s\n", filePath, error);
+		unmapFile(mapping);
+		return NULL;
+	}
+	const struct crMeshHeader *header = (const struct crMeshHeader *)mapping->data;
+	const struct crMeshSection *sections = header->sections;
+	
+	struct meshFile *file = calloc(1, sizeof(*file));
+	file->mapping = mapping;
+	file->vertices = (struct vector *)sectionData(mapping, header, sectionVertices);
+	file->vertexCount = sections[sectionVertices].count;
+	file->normals = (struct vector *)sectionData(mapping, header, sectionNormals);
+	file->normalCount = sections[sectionNormals].count;
+	file->textureCoords = (struct coord *)sectionData(mapping, header, sectionTextureCoords);
+	file->textureCount = sections[sectionTextureCoords].count;
+	file->polyCount = sections[sectionTriangles].count;
+	file->materialCount = (int)sections[sectionMaterials].count;
+	
+	if (!decodeTriangles(file, sectionData(mapping, header, sectionTriangles))) {
+		logr(warning, "Can't load %s: Invalid triangle\n", filePath);
+		destroyMeshFile(file);
+		return NULL;
+	}
+	decodeMaterials(file, sectionData(mapping, header, sectionMaterials), sectionData(mapping, header, sectionStrings), sections[sectionStrings].count);
+	
+	if (header->bvhNodeSize && header->bvhNodeSize != bvhNodeSize()) {
+		logr(info, "BVH in %s is from a different version of c-ray, building a new one\n", filePath);
+	} else if (sections[sectionBvhNodes].count && sections[sectionBvhPrimIndices].count == file->polyCount) {
+		file->bvh = bvhFromArrays(sectionData(mapping, header, sectionBvhNodes),
+								  (unsigned)sections[sectionBvhNodes].count,
+								  sectionData(mapping, header, sectionBvhPrimIndices),
+								  (unsigned)file->polyCount);
+		if (!file->bvh) logr(warning, "BVH in %s is invalid, building a new one\n", filePath);
+	}
+	
+	logr(debug, "Loaded %s in %lims\n", filePath, getMs(timer));
+	return file;
+}
+
+struct stringTable {
+	char *data;
+	size_t size;
+};
+
+static uint32_t addString(struct stringTable *table, const char *string) {
+	if (!string) return CRMESH_NO_STRING;
+	const size_t length = strlen(string) + 1;
+	const uint32_t offset = (uint32_t)table->size;
+	table->data = realloc(table->data, table->size + length);
+	memcpy(table->data + table->size, string, length);
+	table->size += length;
+	return offset;
+}
+
+static struct crMeshTriangle *encodeTriangles(const struct meshFile *mesh) {
+	struct crMeshTriangle *triangles = calloc(mesh->polyCount, sizeof(*triangles));
+	for (size_t i = 0; i < mesh->polyCount; ++i) {
+		const struct poly *p = &mesh->polygons[i];
+		triangles[i].material = p->materialIndex;
+		for (int c = 0; c < 3; ++c) {
+			triangles[i].vertex[c] = p->vertexIndex[c];
+			triangles[i].normal[c] = p->normalIndex[c];
+			triangles[i].texture[c] = p->textureIndex[c];
+		}
+	}
+	return triangles;
+}
+
+static struct crMeshMaterial *encodeMaterials(const struct meshFile *mesh, struct stringTable *strings) {
+	struct crMeshMaterial *materials = calloc(mesh->materialCount, sizeof(*materials));
+	for (int i = 0; i < mesh->materialCount; ++i) {
+		const struct material *m = &mesh->materials[i];
+		materials[i] = (struct crMeshMaterial){
+			.name = addString(strings, m->name),
+			.texture = addString(strings, m->textureFilePath),
+			.normalMap = addString(strings, m->normalMapPath),
+			.specularMap = addString(strings, m->specularMapPath),
+			.ambient = m->ambient,
+			.diffuse = m->diffuse,
+			.specular = m->specular,
+			.emission = m->emission,
+			.reflectivity = m->reflectivity,
+			.roughness = m->roughness,
+			.refractivity = m->refractivity,
+			.IOR = m->IOR,
+			.transparency = m->transparency,
+			.sharpness = m->sharpness,
+			.glossiness = m->glossiness
+		};
+	}
+	return materials;
+}
+
+bool writeCrMesh(const struct meshFile *mesh, const char *filePath) {
+	FILE *f = fopen(filePath, "wb");
+	if (!f) {
+		logr(warning, "Can't open %s for writing\n", filePath);
+		return false;
+	}
+	
+	struct stringTable strings = {0};
+	struct crMeshTriangle *triangles = encodeTriangles(mesh);
+	struct crMeshMaterial *materials = encodeMaterials(mesh, &strings);
+	const void *nodes = NULL;
+	const int *primIndices = NULL;
+	const unsigned nodeCount = mesh->bvh ? getBvhArrays(mesh->bvh, &nodes, &primIndices) : 0;
+	
+	struct crMeshHeader header = {
+		.version = CRMESH_VERSION,
+		.byteOrder = CRMESH_BYTE_ORDER,
+		.bvhNodeSize = nodeCount ? (uint32_t)bvhNodeSize() : 0
+	};
+	memcpy(header.magic, crMeshMagic, sizeof(crMeshMagic));
+	const void *data[sectionCount] = {mesh->vertices, mesh->normals, mesh->textureCoords, triangles, materials, strings.data, nodes, primIndices};
+	const size_t counts[sectionCount] = {
+		mesh->vertexCount,
+		mesh->normalCount,
+		mesh->textureCount,
+		mesh->polyCount,
+		mesh->materialCount,
+		strings.size,
+		nodeCount,
+		nodeCount ? mesh->polyCount : 0
+	};
+	uint64_t offset = alignOffset(sizeof(header));
+	for (int i = 0; i < sectionCount; ++i) {
+		header.sections[i] = (struct crMeshSection){.offset = offset, .count = counts[i]};
+		offset = alignOffset(offset + counts[i] * recordSize(i, &header));
+	}
+	
+	static const unsigned char padding[CRMESH_ALIGNMENT] = {0};
+	bool success = fwrite(&header, sizeof(header), 1, f) == 1;
+	uint64_t written = sizeof(header);
+	for (int i = 0; i < sectionCount && success; ++i) {
+		if (!counts[i]) continue;
+		const uint64_t size = counts[i] * recordSize(i, &header);
+		success = fwrite(padding, 1, header.sections[i].offset - written, f) == header.sections[i].offset - written;
+		success = success && fwrite(data[i], 1, size, f) == size;
+		written = header.sections[i].offset + size;
+	}
+	success = fclose(f) == 0 && success;
+	if (!success) logr(warning, "Failed to write %s\n", filePath);
+	
+	free(triangles);
+	free(materials);
+	free(strings.data);
+	return success;
+}
+
+//Same name and directory as the input, with a .crmesh extension
+static char *defaultOutputPath(const char *inputPath) {
+	const char *extension = strrchr(inputPath, '.');
+	const char *separator = strrchr(inputPath, '/');
+	const size_t length = extension && (!separator || extension > separator) ? (size_t)(extension - inputPath) : strlen(inputPath);
+	char *path = calloc(length + sizeof(".crmesh"), sizeof(*path));
+	memcpy(path, inputPath, length);
+	strcat(path, ".crmesh");
+	return path;
+}
+
+int convertMesh(const char *inputPath, const char *outputPath) {
+	struct timeval timer;
+	startTimer(&timer);
+	struct meshFile *mesh = loadMeshFile(inputPath, getSysCores());
+	if (!mesh) {
+		logr(warning, "Can't read mesh %s\n", inputPath);
+		return -1;
+	}
+	weldMeshFile(mesh);
+	if (!mesh->bvh && mesh->polyCount) {
+		mesh->bvh = buildBottomLevelBvh(mesh->vertices, mesh->polygons, (unsigned)mesh->polyCount);
+	}
+	
+	char *defaultPath = outputPath ? NULL : defaultOutputPath(inputPath);
+	const char *path = outputPath ? outputPath : defaultPath;
+	const bool success = writeCrMesh(mesh, path);
+	if (success) {
+		char *size = humanFileSize(getFileSize(path));
+		logr(info, "Converted %s to %s (%zu triangles, %s) in %lims\n", inputPath, path, mesh->polyCount, size, getMs(timer));
+		free(size);
+	}
+	
+	for (int i = 0; i < mesh->materialCount; ++i) {
+		destroyMaterial(&mesh->materials[i]);
+	}
+	destroyMeshFile(mesh);
+	free(defaultPath);
+	return success ? 0 : -1;
+}
@@ -0,0 +1,31 @@
+//
+//  crmesh.h
+//  C-ray
+//
+//  Created by Valtteri on 18.10.2020.
+//  Copyright © 2020 Valtteri Koskivuori. All rights reserved.
+//
+
+#pragma once
+
+#include <stdbool.h>
+
+struct meshFile;
+
+/// Map a .crmesh file. Vertex, normal and texture coordinate arrays and the BVH point straight into the mapping,
+/// polygons and materials are decoded into new arrays.
+/// @param filePath Path to the .crmesh file
+/// @return Loaded mesh, or NULL if the file can't be read or is invalid
+struct meshFile *loadCrMesh(const char *filePath);
+
+/// Write a mesh out as a .crmesh file
+/// @param mesh Mesh to write, welded with weldMeshFile(). The BVH is stored too, if it has one.
+/// @param filePath Where to write the file
+/// @return true on success
+bool writeCrMesh(const struct meshFile *mesh, const char *filePath);
+
+/// Convert a mesh file to .crmesh, with a prebuilt BVH
+/// @param inputPath Mesh to convert, in any format loadMeshFile() reads
+/// @param outputPath Where to write the converted mesh. NULL writes it next to the input, with a .crmesh extension.
+/// @return 0 on success
+int convertMesh(const char *inputPath, const char *outputPath);
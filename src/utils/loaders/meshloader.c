@@ -6,12 +6,176 @@
 //  Copyright © 2015-2020 Valtteri Koskivuori. All rights reserved.
 //
 
+#include "../../includes.h"
 #include "meshloader.h"
 
-#include <stddef.h>
 #include "objloader.h"
+#include "crmesh.h"
+#include "../fileio.h"
+#include "../logging.h"
+#include "../assert.h"
+#include "../../accelerators/bvh.h"
+#include "../../datatypes/mesh.h"
+#include "../../datatypes/poly.h"
 
-//TODO: Implement more mesh loaders and switch between 'em here.
-/*struct mesh *parseMesh(char *filePath) {
-	return parseOBJFile(filePath);
-}*/
+static bool hasExtension(const char *path, const char *extension) {
+	size_t pathLength = strlen(path);
+	size_t extLength = strlen(extension);
+	return pathLength > extLength && strcasecmp(path + pathLength - extLength, extension) == 0;
+}
+
+struct meshFile *loadMeshFile(const char *filePath, int threadCount) {
+	if (hasExtension(filePath, ".crmesh")) return loadCrMesh(filePath);
+	return parseWavefront(filePath, threadCount);
+}
+
+void destroyMeshFile(struct meshFile *file) {
+	if (file) {
+		if (!file->mapping) {
+			free(file->vertices);
+			free(file->normals);
+			free(file->textureCoords);
+		}
+		free(file->polygons);
+		free(file->materials);
+		destroyBvh(file->bvh);
+		unmapFile(file->mapping);
+		free(file);
+	}
+}
+
+//Welded meshes use the position index for normals and texture coordinates too
+static bool isWelded(const struct meshFile *file) {
+	for (size_t i = 0; i < file->polyCount; ++i) {
+		const struct poly *p = &file->polygons[i];
+		for (int c = 0; c < p->vertexCount; ++c) {
+			if (p->normalIndex[c] != -1 && p->normalIndex[c] != p->vertexIndex[c]) return false;
+			if (p->textureIndex[c] != -1 && p->textureIndex[c] != p->vertexIndex[c]) return false;
+		}
+	}
+	return true;
+}
+
+struct weldedVertex {
+	int vertex;
+	int normal;
+	int texture;
+	int next; //Next welded vertex with the same position, or -1
+};
+
+void weldMeshFile(struct meshFile *file) {
+	if (isWelded(file)) return;
+	ASSERT(!file->mapping);
+	//Welded vertices are chained per position, so a lookup only walks the few variants of one position
+	int *firstWelded = malloc(file->vertexCount * sizeof(*firstWelded));
+	for (size_t i = 0; i < file->vertexCount; ++i) firstWelded[i] = -1;
+	struct weldedVertex *welded = malloc(3 * file->polyCount * sizeof(*welded));
+	int weldedCount = 0;
+	bool hasNormals = false;
+	bool hasTextureCoords = false;
+	for (size_t i = 0; i < file->polyCount; ++i) {
+		struct poly *p = &file->polygons[i];
+		for (int c = 0; c < p->vertexCount; ++c) {
+			const int v = p->vertexIndex[c];
+			const int n = p->normalIndex[c];
+			const int t = p->textureIndex[c];
+			int w = firstWelded[v];
+			while (w != -1 && (welded[w].normal != n || welded[w].texture != t)) w = welded[w].next;
+			if (w == -1) {
+				w = weldedCount++;
+				welded[w] = (struct weldedVertex){v, n, t, firstWelded[v]};
+				firstWelded[v] = w;
+			}
+			p->vertexIndex[c] = w;
+			p->normalIndex[c] = n == -1 ? -1 : w;
+			p->textureIndex[c] = t == -1 ? -1 : w;
+			hasNormals |= n != -1;
+			hasTextureCoords |= t != -1;
+		}
+	}
+	free(firstWelded);
+	
+	struct vector *vertices = malloc(weldedCount * sizeof(*vertices));
+	struct vector *normals = hasNormals ? calloc(weldedCount, sizeof(*normals)) : NULL;
+	struct coord *textureCoords = hasTextureCoords ? calloc(weldedCount, sizeof(*textureCoords)) : NULL;
+	for (int i = 0; i < weldedCount; ++i) {
+		vertices[i] = file->vertices[welded[i].vertex];
+		if (welded[i].normal != -1) normals[i] = file->normals[welded[i].normal];
+		if (welded[i].texture != -1) textureCoords[i] = file->textureCoords[welded[i].texture];
+	}
+	free(welded);
+	
+	free(file->vertices);
+	free(file->normals);
+	free(file->textureCoords);
+	file->vertices = vertices;
+	file->vertexCount = weldedCount;
+	file->normals = normals;
+	file->normalCount = hasNormals ? weldedCount : 0;
+	file->textureCoords = textureCoords;
+	file->textureCount = hasTextureCoords ? weldedCount : 0;
+}
+
+void compactMeshFile(struct meshFile *file, struct mesh *mesh) {
+	weldMeshFile(file);
+	const size_t count = file->vertexCount;
+	mesh->vertices = file->vertices;
+	mesh->vertexCount = (int)count;
+	file->vertices = NULL;
+	
+	//Welded files may have fewer normals or texture coordinates than vertices, if the last vertices don't use them
+	mesh->normals = NULL;
+	if (file->normalCount) {
+		mesh->normals = calloc(count, sizeof(*mesh->normals));
+		for (size_t i = 0; i < min(count, file->normalCount); ++i) {
+			mesh->normals[i] = encodeNormal(file->normals[i]);
+		}
+	}
+	
+	mesh->textureCoords = NULL;
+	mesh->exactTextureCoords = NULL;
+	mesh->uvMin = mesh->uvStep = (struct coord){0.0f, 0.0f};
+	if (file->textureCount) {
+		const size_t textureCount = min(count, file->textureCount);
+		struct coord uvMin = file->textureCoords[0];
+		struct coord uvMax = uvMin;
+		for (size_t i = 1; i < textureCount; ++i) {
+			uvMin = (struct coord){min(uvMin.x, file->textureCoords[i].x), min(uvMin.y, file->textureCoords[i].y)};
+			uvMax = (struct coord){max(uvMax.x, file->textureCoords[i].x), max(uvMax.y, file->textureCoords[i].y)};
+		}
+		const struct coord uvStep = {(uvMax.x - uvMin.x) / UINT16_MAX, (uvMax.y - uvMin.y) / UINT16_MAX};
+		if (uvStep.x > MAX_UV_STEP || uvStep.y > MAX_UV_STEP) {
+			//Steps this coarse would visibly shift textures, so keep these at full precision
+			logr(debug, "Texture coordinates span %.1f by %.1f, not quantizing them\n", (double)(uvMax.x - uvMin.x), (double)(uvMax.y - uvMin.y));
+			mesh->exactTextureCoords = calloc(count, sizeof(*mesh->exactTextureCoords));
+			memcpy(mesh->exactTextureCoords, file->textureCoords, textureCount * sizeof(*mesh->exactTextureCoords));
+		} else {
+			mesh->uvMin = uvMin;
+			mesh->uvStep = uvStep;
+			mesh->textureCoords = calloc(2 * count, sizeof(*mesh->textureCoords));
+			for (size_t i = 0; i < textureCount; ++i) {
+				encodeTextureCoord(mesh, (unsigned)i, file->textureCoords[i]);
+			}
+		}
+	}
+	
+	//The full precision streams aren't needed anymore
+	if (!file->mapping) {
+		free(file->normals);
+		free(file->textureCoords);
+	}
+	file->normals = NULL;
+	file->normalCount = 0;
+	file->textureCoords = NULL;
+	file->textureCount = 0;
+	
+	mesh->polygons = malloc(file->polyCount * sizeof(*mesh->polygons));
+	mesh->polyCount = (int)file->polyCount;
+	for (size_t i = 0; i < file->polyCount; ++i) {
+		const struct poly *p = &file->polygons[i];
+		struct triangle *t = &mesh->polygons[i];
+		for (int c = 0; c < 3; ++c) t->index[c] = (uint32_t)p->vertexIndex[c];
+		t->materialIndex = p->materialIndex;
+		t->hasNormals = p->hasNormals && mesh->normals;
+	}
+}
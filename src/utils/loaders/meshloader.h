@@ -8,4 +8,48 @@
 
 #pragma once
 
-//struct mesh *parseMesh(char *filePath);
+#include <stddef.h>
+
+struct vector;
+struct coord;
+struct poly;
+struct material;
+struct bvh;
+struct fileMapping;
+struct mesh;
+
+/// Geometry and materials of a mesh file. Polygon indices point into the arrays here,
+/// and are -1 where a face has no normal or texture coordinate.
+struct meshFile {
+	struct vector *vertices;
+	size_t vertexCount;
+	struct vector *normals;
+	size_t normalCount;
+	struct coord *textureCoords;
+	size_t textureCount;
+	struct poly *polygons; //Faces with more than three corners are split into triangle fans
+	size_t polyCount;
+	struct material *materials; //In the order polygon material indices refer to them
+	int materialCount;
+	struct bvh *bvh; //Prebuilt BVH for the polygons, or NULL if it has to be built
+	struct fileMapping *mapping; //If set, the vertex arrays and BVH point into this mapped file
+};
+
+/// Load a mesh, picking the loader from the file extension. Wavefront OBJ and .crmesh files are supported.
+/// @param filePath Path to the mesh file
+/// @param threadCount Thread count for loaders that can use more than one thread
+/// @return Loaded mesh, or NULL if it can't be read
+struct meshFile *loadMeshFile(const char *filePath, int threadCount);
+
+/// Free a loaded mesh. Materials are freed shallowly, their strings are left to whoever took them over.
+void destroyMeshFile(struct meshFile *file);
+
+/// Give every distinct position, normal and texture coordinate combination its own vertex, so one index per corner
+/// addresses all three arrays. Corners without a normal or texture coordinate keep -1 for it. Welded meshes are left as is.
+void weldMeshFile(struct meshFile *file);
+
+/// Weld a mesh file and move its geometry over to a mesh, in the compact form the renderer uses.
+/// Vertex positions are taken over without copying, normals and texture coordinates are compressed and released.
+/// Texture coordinates with too large a range to quantize, see MAX_UV_STEP, are copied at full precision instead.
+/// Polygons, materials, the BVH and the mapping are left for the caller.
+void compactMeshFile(struct meshFile *file, struct mesh *mesh);
@@ -8,343 +8,458 @@
 
 #include "../../includes.h"
 #include "objloader.h"
+#include "meshloader.h"
 
-#include "../../datatypes/mesh.h"
 #include "../../datatypes/vector.h"
 #include "../../datatypes/poly.h"
 #include "../../datatypes/material.h"
-#include "../../utils/logging.h"
-#include "../../utils/string.h"
-#include "../../datatypes/vertexbuffer.h"
-#include "mtlloader.h"
+#include "../../libraries/obj_parser.h"
+#include "../converter.h"
 #include "../fileio.h"
-#include "../../utils/assert.h"
-#include "../../utils/textbuffer.h"
+#include "../logging.h"
+#include "../string.h"
+#include "../timer.h"
+#include "../platform/thread.h"
 
-//TODO: REMOVE
-#include "../../utils/platform/terminal.h"
+// The file is mapped and split into one chunk per thread, on line boundaries.
+// A first pass counts the elements in each chunk, which gives every chunk its offsets
+// into the output arrays. The second pass then parses all chunks in parallel, straight into place.
 
-#define ws " \t\n\r"
+enum objKeyword {
+	objVertex,
+	objNormal,
+	objTextureCoord,
+	objFace,
+	objUseMaterial,
+	objMaterialLibrary,
+	objIgnored,
+	objUnknown
+};
+
+struct objChunk {
+	const char *start;
+	const char *end;
+	struct meshFile *file;
+	
+	//Counted in the first pass
+	size_t vertexCount;
+	size_t normalCount;
+	size_t textureCount;
+	size_t polyCount;
+	size_t unknownLines;
+	const char *lastMaterial; //Name from the last usemtl line, not null terminated
+	size_t lastMaterialLength;
+	const char **libraries; //mtllib lines
+	int libraryCount;
+	
+	//Where this chunk goes in the output arrays, and the material in use where it starts
+	size_t firstVertex;
+	size_t firstNormal;
+	size_t firstTexture;
+	size_t firstPoly;
+	int material;
+	size_t invalidIndices;
+};
 
-static struct vector parseVertex() {
-	return (struct vector){atof(strtok(NULL, ws)), atof(strtok(NULL, ws)), atof(strtok(NULL, ws))};
+static inline bool isSpace(char c) {
+	return c == ' ' || c == '\t' || c == '\r';
 }
 
-static struct coord parseCoord() {
-	return (struct coord){atof(strtok(NULL, ws)), atof(strtok(NULL, ws))};
+static inline const char *skipSpace(const char *c, const char *end) {
+	while (c < end && isSpace(*c)) c++;
+	return c;
 }
 
-static int parseIndices(int *vertexIndex, int *normalIndex, int *textureIndex) {
-	
-	char *tempstr;
-	char *token;
-	int vertexCount = 0;
-	
-	while ((token = strtok(NULL, ws)) != NULL) {
-		
-		//texture and normal indices are optional
-		if (textureIndex != NULL) {
-			textureIndex[vertexCount] = 0;
+static inline const char *tokenEnd(const char *c, const char *end) {
+	while (c < end && !isSpace(*c)) c++;
+	return c;
+}
+
+static inline const char *lineEnd(const char *c, const char *end) {
+	const char *newline = memchr(c, '\n', end - c);
+	return newline ? newline : end;
+}
+
+static enum objKeyword parseKeyword(const char *c, const char *end) {
+	const size_t length = end - c;
+	if (!length || c[0] == '#') return objIgnored;
+	if (length == 1) {
+		switch (c[0]) {
+			case 'v': return objVertex;
+			case 'f': return objFace;
+			case 'o': case 'g': case 's': case 'l': case 'p': case 'c': return objIgnored;
+			default: return objUnknown;
 		}
-		if (normalIndex != NULL) {
-			normalIndex[vertexCount] = 0;
+	}
+	if (length == 2) {
+		if (c[0] == 'v' && c[1] == 'n') return objNormal;
+		if (c[0] == 'v' && c[1] == 't') return objTextureCoord;
+		//c-ray extensions the old obj_parser knew, but meshes never used
+		if (!memcmp(c, "sp", 2) || !memcmp(c, "pl", 2) || !memcmp(c, "lp", 2) || !memcmp(c, "ld", 2) || !memcmp(c, "lq", 2)) return objIgnored;
+		return objUnknown;
+	}
+	if (length == 6 && !memcmp(c, "usemtl", 6)) return objUseMaterial;
+	if (length == 6 && !memcmp(c, "mtllib", 6)) return objMaterialLibrary;
+	return objUnknown;
+}
+
+static const double powersOfTen[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+//Numbers with up to 15 significant digits and small exponents are exact as doubles, so
+//one multiply or divide rounds them correctly (Clinger 1990). The result is the same as
+//(float)strtod(), which handles everything else.
+static float parseFloat(const char **cursor, const char *end) {
+	const char *c = skipSpace(*cursor, end);
+	const char *start = c;
+	*cursor = tokenEnd(c, end);
+	bool negative = false;
+	if (c < end && (*c == '-' || *c == '+')) negative = *c++ == '-';
+	
+	uint64_t mantissa = 0;
+	int digits = 0;
+	int exponent = 0;
+	bool exact = true;
+	bool hasDigits = false;
+	for (; c < end && *c >= '0' && *c <= '9'; ++c) {
+		hasDigits = true;
+		if (digits < 15) {
+			mantissa = mantissa * 10 + (*c - '0');
+			if (mantissa) digits++;
+		} else {
+			exponent++;
+			exact = false;
 		}
-		
-		vertexIndex[vertexCount] = atoi(token);
-		
-		if (stringContains(token, "//")) {
-			//Only normal and vertex
-			tempstr = strchr(token, '/');
-			tempstr++;
-			normalIndex[vertexCount] = atoi(++tempstr);
-		} else if (stringContains(token, "/")) {
-			tempstr = strchr(token, '/');
-			textureIndex[vertexCount] = atoi(++tempstr);
-			if (stringContains(tempstr, "/")) {
-				tempstr = strchr(tempstr, '/');
-				normalIndex[vertexCount] = atoi(++tempstr);
+	}
+	if (c < end && *c == '.') {
+		for (++c; c < end && *c >= '0' && *c <= '9'; ++c) {
+			hasDigits = true;
+			if (digits < 15) {
+				mantissa = mantissa * 10 + (*c - '0');
+				if (mantissa) digits++;
+				exponent--;
+			} else {
+				exact = false;
 			}
 		}
-		
-		vertexCount++;
+	}
+	if (hasDigits && c < end && (*c == 'e' || *c == 'E')) {
+		const char *e = c + 1;
+		bool negativeExponent = false;
+		if (e < end && (*e == '-' || *e == '+')) negativeExponent = *e++ == '-';
+		int value = 0;
+		const char *exponentStart = e;
+		for (; e < end && *e >= '0' && *e <= '9'; ++e) value = value < 10000 ? value * 10 + (*e - '0') : value;
+		if (e > exponentStart) {
+			exponent += negativeExponent ? -value : value;
+			c = e;
+		}
 	}
 	
-	return vertexCount;
+	if (hasDigits && c == *cursor && exact && exponent >= -22 && exponent <= 22) {
+		const double value = exponent < 0 ? mantissa / powersOfTen[-exponent] : mantissa * powersOfTen[exponent];
+		return (float)(negative ? -value : value);
+	}
+	
+	//Long mantissas, huge exponents, inf, nan and anything malformed. The mapping isn't null terminated.
+	char buffer[64];
+	const size_t length = min((size_t)(*cursor - start), sizeof(buffer) - 1);
+	memcpy(buffer, start, length);
+	buffer[length] = '\0';
+	return (float)strtod(buffer, NULL);
 }
 
-static struct poly parsePoly(struct mesh mesh) {
-	struct poly p;
-	p.vertexCount = parseIndices(p.vertexIndex, p.normalIndex, p.textureIndex);
-	
-	/*convertIndices(vertexCount, p.vertexIndex);
-	convertIndices(normalCount, p.normalIndex);
-	convertIndices(textureCount, p.textureIndex);*/
-	
-	for (int i = 0; i < p.vertexCount; ++i) {
-		if (p.normalIndex[i] == 0) {
-			p.hasNormals = false;
-		}
-		
-		p.vertexIndex[i] = mesh.firstVectorIndex + (p.vertexIndex[i] - 1);
-		p.normalIndex[i] = mesh.firstNormalIndex + (p.normalIndex[i] - 1);
-		p.textureIndex[i] = mesh.firstTextureIndex + (p.textureIndex[i] - 1);
+static inline long parseInteger(const char **cursor, const char *end) {
+	const char *c = *cursor;
+	bool negative = false;
+	if (c < end && (*c == '-' || *c == '+')) negative = *c++ == '-';
+	long value = 0;
+	for (; c < end && *c >= '0' && *c <= '9'; ++c) value = value * 10 + (*c - '0');
+	*cursor = c;
+	return negative ? -value : value;
+}
+
+//OBJ indices start at 1, and negative ones count back from the last element so far. 0 means none.
+static inline int toArrayIndex(long index, size_t current, size_t count, size_t *invalid) {
+	if (!index) return -1;
+	const long converted = index < 0 ? (long)current + index : index - 1;
+	if (converted < 0 || (size_t)converted >= count) {
+		(*invalid)++;
+		return -1;
 	}
-	
-	return p;
+	return (int)converted;
 }
 
-static int findMaterialIndex(struct mesh *mesh, char *mtlName) {
-	for (int i = 0; i < mesh->materialCount; ++i) {
-		if (stringEquals(mesh->materials[i].name, mtlName)) {
-			return i;
+struct objIndex {
+	int vertex;
+	int texture;
+	int normal;
+};
+
+//One v, v/vt, v//vn or v/vt/vn corner of a face
+static struct objIndex parseCorner(const char *c, const char *end, const struct objChunk *chunk, size_t vertex, size_t texture, size_t normal, size_t *invalid) {
+	const struct meshFile *file = chunk->file;
+	struct objIndex index = {-1, -1, -1};
+	const long position = parseInteger(&c, end);
+	index.vertex = toArrayIndex(position, vertex, file->vertexCount, invalid);
+	if (!position) (*invalid)++;
+	if (c < end && *c == '/') {
+		c++;
+		if (c < end && *c != '/') index.texture = toArrayIndex(parseInteger(&c, end), texture, file->textureCount, invalid);
+		if (c < end && *c == '/') {
+			c++;
+			index.normal = toArrayIndex(parseInteger(&c, end), normal, file->normalCount, invalid);
 		}
 	}
-	return 0;
+	return index;
 }
 
-static struct mesh parseOBJMesh(textBuffer *segment) {
-	(void)segment;
-	return (struct mesh){0};
+static int findMaterial(const struct meshFile *file, const char *name, size_t length) {
+	for (int i = 0; i < file->materialCount; ++i) {
+		//Names from the mtl loader can have a trailing newline
+		const char *candidate = file->materials[i].name;
+		if (!strncmp(candidate, name, length) && (!candidate[length] || isSpace(candidate[length]) || candidate[length] == '\n')) return i;
+	}
+	return -1;
 }
 
-static size_t countMeshes(textBuffer *buffer) {
-	size_t meshCount = 0;
-	char *head = firstLine(buffer);
-	lineBuffer line = {0};
-	while (head) {
-		fillLineBuffer(&line, head, " ");
-		char *first = firstToken(&line);
-		if (first[0] == 'o') meshCount++;
-		head = nextLine(buffer);
+static void *countChunk(void *arg) {
+	struct objChunk *chunk = (struct objChunk *)threadUserData(arg);
+	for (const char *line = chunk->start; line < chunk->end;) {
+		const char *end = lineEnd(line, chunk->end);
+		const char *c = skipSpace(line, end);
+		const char *keywordEnd = tokenEnd(c, end);
+		switch (parseKeyword(c, keywordEnd)) {
+			case objVertex:
+				chunk->vertexCount++;
+				break;
+			case objNormal:
+				chunk->normalCount++;
+				break;
+			case objTextureCoord:
+				chunk->textureCount++;
+				break;
+			case objFace: {
+				//Faces are split into triangle fans
+				int corners = 0;
+				for (c = skipSpace(keywordEnd, end); c < end; c = skipSpace(tokenEnd(c, end), end)) corners++;
+				if (corners > 2) chunk->polyCount += corners - 2;
+			}
+				break;
+			case objUseMaterial:
+				chunk->lastMaterial = skipSpace(keywordEnd, end);
+				chunk->lastMaterialLength = tokenEnd(chunk->lastMaterial, end) - chunk->lastMaterial;
+				break;
+			case objMaterialLibrary:
+				chunk->libraries = realloc(chunk->libraries, (chunk->libraryCount + 1) * sizeof(*chunk->libraries));
+				chunk->libraries[chunk->libraryCount++] = keywordEnd;
+				break;
+			case objIgnored:
+				break;
+			case objUnknown:
+				chunk->unknownLines++;
+				break;
+		}
+		line = end + 1;
 	}
-	logr(debug, "File contains %zu meshes\n", meshCount);
-	head = firstLine(buffer);
-	return meshCount;
+	return NULL;
 }
 
-enum currentMode {
-	None,
-	Mesh
-};
-
-struct mesh *parseWavefront(const char *filePath, size_t *finalMeshCount) {
-	logr(debug, "Loading OBJ at %s\n", filePath);
-	size_t bytes = 0;
-	char *rawText = loadFile(filePath, &bytes);
-	ASSERT(rawText);
-	textBuffer *file = newTextBuffer(rawText);
-	
-	//Start processing line-by-line, state machine style.
-	size_t meshCount = countMeshes(file);
-	size_t currentMesh = 0;
-	
-	struct material *currentMaterialSet = NULL;
-	size_t currentMaterialSetMaterialCount = 0;
-	
-	struct mesh *meshes = calloc(meshCount, sizeof(*meshes));
-	struct mesh *currentMeshPtr = NULL;
-	
-	char *head = firstLine(file);
-	lineBuffer line = {0};
-	while (head) {
-		fillLineBuffer(&line, head, " ");
-		char *first = firstToken(&line);
-		if (first[0] == '#') {
-			head = nextLine(file);
-			continue;
-		} else if (first[0] == 'o') {
-			currentMeshPtr = &meshes[currentMesh++];
-			currentMeshPtr->name = copyString(peekNextToken(&line));
-		} else if (stringEquals(first, "newmtl")) {
-			char *mtlFilePath = concatString(getFilePath(filePath), peekNextToken(&line));
-			currentMaterialSet = parseMTLFile(mtlFilePath, &currentMaterialSetMaterialCount);
+static void *parseChunk(void *arg) {
+	struct objChunk *chunk = (struct objChunk *)threadUserData(arg);
+	struct meshFile *file = chunk->file;
+	size_t vertex = chunk->firstVertex;
+	size_t normal = chunk->firstNormal;
+	size_t texture = chunk->firstTexture;
+	size_t poly = chunk->firstPoly;
+	int material = chunk->material;
+	for (const char *line = chunk->start; line < chunk->end;) {
+		const char *end = lineEnd(line, chunk->end);
+		const char *keyword = skipSpace(line, end);
+		const char *c = tokenEnd(keyword, end);
+		switch (parseKeyword(keyword, c)) {
+			case objVertex: {
+				const float x = parseFloat(&c, end);
+				const float y = parseFloat(&c, end);
+				const float z = parseFloat(&c, end);
+				file->vertices[vertex++] = (struct vector){x, y, z};
+			}
+				break;
+			case objNormal: {
+				const float x = parseFloat(&c, end);
+				const float y = parseFloat(&c, end);
+				const float z = parseFloat(&c, end);
+				file->normals[normal++] = (struct vector){x, y, z};
+			}
+				break;
+			case objTextureCoord: {
+				const float u = parseFloat(&c, end);
+				const float v = parseFloat(&c, end);
+				file->textureCoords[texture++] = (struct coord){u, v};
+			}
+				break;
+			case objFace: {
+				struct objIndex first = {0}, previous = {0};
+				int corners = 0;
+				for (c = skipSpace(c, end); c < end; c = skipSpace(c, end)) {
+					const char *next = tokenEnd(c, end);
+					const struct objIndex current = parseCorner(c, next, chunk, vertex, texture, normal, &chunk->invalidIndices);
+					c = next;
+					if (corners == 0) first = current;
+					if (corners++ < 2) {
+						previous = current;
+						continue;
+					}
+					const struct objIndex corner[3] = {first, previous, current};
+					//Triangles without a position for every corner are dropped
+					if (first.vertex < 0 || previous.vertex < 0 || current.vertex < 0) {
+						previous = current;
+						continue;
+					}
+					struct poly *p = &file->polygons[poly++];
+					p->vertexCount = 3;
+					p->materialIndex = material < 0 ? 0 : material;
+					p->hasNormals = true;
+					for (int i = 0; i < 3; ++i) {
+						p->vertexIndex[i] = corner[i].vertex;
+						p->textureIndex[i] = corner[i].texture;
+						p->normalIndex[i] = corner[i].normal;
+						if (corner[i].normal < 0) p->hasNormals = false;
+					}
+					previous = current;
+				}
+			}
+				break;
+			case objUseMaterial: {
+				const char *name = skipSpace(c, end);
+				material = findMaterial(file, name, tokenEnd(name, end) - name);
+			}
+				break;
+			default:
+				break;
 		}
-		head = nextLine(file);
+		line = end + 1;
 	}
-	
-	if (finalMeshCount) *finalMeshCount = meshCount;
-	exit(0);
+	chunk->polyCount = poly - chunk->firstPoly; //Fewer than counted if triangles were dropped
 	return NULL;
 }
 
-struct mesh *parseOBJFileNah(char *filePath, size_t *meshCountOut) {
-	logr(debug, "Loading OBJ file\n");
-	char *rawText = loadFile(filePath, NULL);
-	textBuffer *file = newTextBuffer(rawText);
-	
-	//Figure out how many meshes this file contains
-	size_t meshCount = countMeshes(file);
-	if (!meshCount) return NULL;
-
-	//Get the offsets
-	char *head = firstLine(file);
-	lineBuffer line = {0};
-	size_t *meshOffsets = malloc(meshCount * sizeof(*meshOffsets));
-	int i = 0;
-	while (head) {
-		fillLineBuffer(&line, head, " ");
-		char *first = firstToken(&line);
-		if (first[0] == 'o') meshOffsets[i++] = file->current.line;
-		head = nextLine(file);
+static void runChunks(struct objChunk *chunks, int count, void *(*func)(void *)) {
+	if (count == 1) {
+		struct crThread thread = {.userData = &chunks[0]};
+		func(&thread);
+		return;
 	}
-	logr(debug, "They start on lines:\n");
-	
-	for (size_t l = 0; l < meshCount; ++l) {
-		logr(debug, "%zu\n", meshOffsets[l]);
+	struct crThread *threads = calloc(count, sizeof(*threads));
+	for (int t = 0; t < count; ++t) {
+		threads[t] = (struct crThread){
+			.threadFunc = func,
+			.userData = &chunks[t]
+		};
+		if (threadStart(&threads[t])) {
+			logr(error, "Failed to create an OBJ parser thread\n");
+		}
 	}
-	head = firstLine(file);
-	
-	struct mesh *meshes = calloc(meshCount, sizeof(*meshes));
-	
-	for (size_t m = 0; m < meshCount; ++m) {
-		size_t start = meshOffsets[m];
-		size_t end = meshCount == 1 ? file->amountOf.lines : meshOffsets[m + 1] - meshOffsets[m];
-		textBuffer *segment = newTextView(file, start, end);
-		meshes[m] = parseOBJMesh(segment);
-		freeTextBuffer(segment);
+	for (int t = 0; t < count; ++t) {
+		threadWait(&threads[t]);
 	}
-	
-	free(meshOffsets);
-	freeLineBuffer(&line);
-	freeTextBuffer(file);
-	restoreTerminal();
-	if (meshCountOut) *meshCountOut = meshCount;
-	exit(0);
-	return NULL;
+	free(threads);
 }
 
-//Parse a Wavefront OBJ file and return a generic mesh.
-//Note: This will also alter the global vertex arrays
-//We will add vertices to them as the OBJ is loaded.
-struct mesh *parseOBJFilea(char *filePath) {
-	struct mesh *newMesh = calloc(1, sizeof(*newMesh));
-	
-	int linenum = 0;
-	char *token;
-	char currLine[500];
-	FILE *fileStream;
-	
-	fileStream = fopen(filePath, "r");
-	if (fileStream == 0) {
-		logr(warning, "OBJ not found at %s\n", filePath);
-		free(newMesh);
-		return NULL;
-	}
-	
-	//First, find vertex counts
-	int vCount = 0;
-	int nCount = 0;
-	int tCount = 0;
-	int pCount = 0;
-	
-	while (fgets(currLine, 500, fileStream)) {
-		token = strtok(currLine, ws);
-		//skip comments
-		if(token == NULL || stringEquals(token, "#")) {
-			continue;
-		} else if (stringEquals(token, "v")) {
-			vCount++;
-		} else if (stringEquals(token, "vn")) {
-			nCount++;
-		} else if (stringEquals(token, "vt")) {
-			tCount++;
-		} else if (stringEquals(token, "f")) {
-			pCount++;
+static void loadMaterialLibraries(struct meshFile *file, const char *filePath, struct objChunk *chunks, int chunkCount) {
+	list materials;
+	list_make(&materials, 10, 1);
+	char *directory = getFilePath(filePath);
+	for (int i = 0; i < chunkCount; ++i) {
+		for (int l = 0; l < chunks[i].libraryCount; ++l) {
+			const char *end = lineEnd(chunks[i].libraries[l], chunks[i].end);
+			const char *name = skipSpace(chunks[i].libraries[l], end);
+			char *fileName = calloc(tokenEnd(name, end) - name + 1, sizeof(*fileName));
+			memcpy(fileName, name, tokenEnd(name, end) - name);
+			char *path = concatString(directory, fileName);
+			obj_parse_mtl_file(path, &materials);
+			free(path);
+			free(fileName);
 		}
 	}
-	fseek(fileStream, 0, SEEK_SET);
+	free(directory);
 	
-	newMesh->firstVectorIndex = vertexCount;
-	newMesh->firstNormalIndex = normalCount;
-	newMesh->firstTextureIndex = textureCount;
+	file->materialCount = materials.item_count;
+	file->materials = calloc(file->materialCount, sizeof(*file->materials));
+	for (int i = 0; i < materials.item_count; ++i) {
+		file->materials[i] = materialFromObj(materials.items[i]);
+		free(materials.items[i]);
+	}
+	list_free(&materials);
+}
+
+struct meshFile *parseWavefront(const char *filePath, int threadCount) {
+	struct timeval timer;
+	startTimer(&timer);
+	struct fileMapping *mapping = mapFile(filePath);
+	if (!mapping) return NULL;
+	const char *text = (const char *)mapping->data;
+	const size_t size = mapping->size;
 	
-	newMesh->vertexCount = vCount;
-	newMesh->normalCount = nCount;
-	newMesh->textureCount = tCount;
-	newMesh->polyCount = pCount;
+	//Chunks end after a newline, so no line is split between two of them
+	const int chunkCount = max(threadCount, 1);
+	struct objChunk *chunks = calloc(chunkCount, sizeof(*chunks));
+	struct meshFile *file = calloc(1, sizeof(*file));
+	const char *start = text;
+	for (int i = 0; i < chunkCount; ++i) {
+		const char *end = text + (size * (i + 1)) / chunkCount;
+		if (end < start) end = start;
+		if (i < chunkCount - 1 && end < text + size) end = min(lineEnd(end, text + size) + 1, text + size);
+		chunks[i] = (struct objChunk){.start = start, .end = end, .file = file};
+		start = end;
+	}
 	
-	vertexCount += vCount;
-	g_vertices = realloc(g_vertices, vertexCount * sizeof(struct vector));
-	normalCount += nCount;
-	g_normals = realloc(g_normals, normalCount * sizeof(struct vector));
-	textureCount += tCount;
-	g_textureCoords = realloc(g_textureCoords, textureCount * sizeof(struct coord));
+	runChunks(chunks, chunkCount, countChunk);
 	
-	newMesh->polygons = malloc(pCount * sizeof(struct poly));
+	size_t unknownLines = 0;
+	for (int i = 0; i < chunkCount; ++i) {
+		chunks[i].firstVertex = file->vertexCount;
+		chunks[i].firstNormal = file->normalCount;
+		chunks[i].firstTexture = file->textureCount;
+		chunks[i].firstPoly = file->polyCount;
+		file->vertexCount += chunks[i].vertexCount;
+		file->normalCount += chunks[i].normalCount;
+		file->textureCount += chunks[i].textureCount;
+		file->polyCount += chunks[i].polyCount;
+		unknownLines += chunks[i].unknownLines;
+	}
+	file->vertices = malloc(file->vertexCount * sizeof(*file->vertices));
+	file->normals = malloc(file->normalCount * sizeof(*file->normals));
+	file->textureCoords = malloc(file->textureCount * sizeof(*file->textureCoords));
+	file->polygons = malloc(file->polyCount * sizeof(*file->polygons));
 	
-	//newMesh->name;
-	//newMesh->materials;
-	//newMesh->materialCount;
+	//Materials have to be known before the faces that use them are parsed
+	loadMaterialLibraries(file, filePath, chunks, chunkCount);
+	int material = -1;
+	for (int i = 0; i < chunkCount; ++i) {
+		chunks[i].material = material;
+		if (chunks[i].lastMaterial) material = findMaterial(file, chunks[i].lastMaterial, chunks[i].lastMaterialLength);
+	}
 	
-	int currMatIdx = 0;
-	int currVecIdx = 0;
-	int currNorIdx = 0;
-	int currTexIdx = 0;
-	int currPolIdx = 0;
+	runChunks(chunks, chunkCount, parseChunk);
 	
-	while (fgets(currLine, 500, fileStream)) {
-		token = strtok(currLine, ws);
-		linenum++;
-		
-		if (token == NULL || stringEquals(token, "#")) {
-			//skip comments
-			continue;
-		} else if (stringEquals(token, "v")) {
-			//Vertex
-			g_vertices[newMesh->firstVectorIndex + currVecIdx] = parseVertex();
-			currVecIdx++;
-		} else if (stringEquals(token, "vn")) {
-			//Normal
-			g_normals[newMesh->firstNormalIndex + currNorIdx] = parseVertex();
-			currNorIdx++;
-		} else if (stringEquals(token, "vt")) {
-			//Texture coord
-			g_textureCoords[newMesh->firstTextureIndex + currTexIdx] = parseCoord();
-			currTexIdx++;
-		} else if (stringEquals(token, "f")) {
-			//Polygon
-			struct poly p = parsePoly(*newMesh);
-			p.materialIndex = currMatIdx;
-			newMesh->polygons[currPolIdx] = p;
-			currPolIdx++;
-		} else if (stringEquals(token, "usemtl")) {
-			//current material index
-			currMatIdx = findMaterialIndex(newMesh, strtok(NULL, ws));
-		} else if (stringEquals(token, "mtllib")) {
-			//new material
-			int mtlCount = 0;
-			//I am so very sorry for this. I didn't mean to. Just wanted to get it working.
-			char *fullPath = (char*)calloc(1024, sizeof(char));
-			sprintf(fullPath, "%s", filePath);
-			char key = '\0';
-			int i = (int)strcspn(filePath, &key);
-			fullPath[i-3] = 'm';
-			fullPath[i-2] = 't';
-			fullPath[i-1] = 'l';
-			
-			struct material *newMats = parseMTLFile(fullPath, &mtlCount);
-			
-			if (newMats != NULL) {
-				newMesh->materialCount = mtlCount;
-				newMesh->materials = newMats;
-			} else {
-				newMesh->materials = calloc(1, sizeof(*newMesh->materials));
-				newMesh->materials[0] = warningMaterial();
-				newMesh->materialCount = 1;
-			}
-			free(fullPath);
-		} else if (stringEquals(token, "o")) {
-			//object name
-			newMesh->name = copyString(strtok(NULL, ws));
-		} else if (stringEquals(token, "s")) {
-			//smoothShading
-			//TODO
-		} else {
-			logr(warning, "Unrecognized command '%s' in OBJ file %s on line %i\n", token, filePath, linenum);
-		}
+	//Dropped triangles leave gaps at the end of each chunk's range
+	size_t invalidIndices = 0;
+	file->polyCount = 0;
+	for (int i = 0; i < chunkCount; ++i) {
+		memmove(file->polygons + file->polyCount, file->polygons + chunks[i].firstPoly, chunks[i].polyCount * sizeof(*file->polygons));
+		file->polyCount += chunks[i].polyCount;
+		invalidIndices += chunks[i].invalidIndices;
+		free(chunks[i].libraries);
 	}
+	free(chunks);
+	unmapFile(mapping);
 	
-	fclose(fileStream);
-	
-	return newMesh;
+	if (unknownLines) logr(warning, "Skipped %zu unrecognized lines in %s\n", unknownLines, filePath);
+	if (invalidIndices) logr(warning, "%zu face indices in %s are out of range\n", invalidIndices, filePath);
+	const long us = getUs(timer);
+	logr(debug, "Parsed %s in %lims with %i threads, %.0fMB/s\n", filePath, us / 1000, chunkCount, us ? (size / 1000000.0) / (us / 1000000.0) : 0.0);
+	return file;
 }
@@ -8,4 +8,10 @@
 
 #pragma once
 
-struct mesh *parseWavefront(const char *filePath, size_t *meshCount);
+struct meshFile;
+
+/// Parse a Wavefront OBJ file. The file is split into newline aligned chunks, which are parsed in parallel.
+/// @param filePath Path to the OBJ file
+/// @param threadCount How many chunks to split the file into, each parsed in its own thread
+/// @return Parsed file, free with destroyMeshFile(). NULL if it can't be read.
+struct meshFile *parseWavefront(const char *filePath, int threadCount);
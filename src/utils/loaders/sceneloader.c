@@ -12,9 +12,7 @@
 //FIXME: We should only need to include c-ray.h here!
 
 #include "../../libraries/cJSON.h"
-#include "../../libraries/obj_parser.h"
 #include "../../datatypes/scene.h"
-#include "../../datatypes/vertexbuffer.h"
 #include "../../datatypes/vector.h"
 #include "../../datatypes/camera.h"
 #include "../../datatypes/mesh.h"
@@ -26,20 +24,26 @@
 #include "../fileio.h"
 #include "../string.h"
 #include "../platform/capabilities.h"
+#include "../platform/thread.h"
+#include "../platform/mutex.h"
+#include "../timer.h"
 #include "../../datatypes/image/imagefile.h"
+#include "../../datatypes/image/texture.h"
+#include "../../datatypes/image/mipmap.h"
+#include "../../datatypes/image/texturecache.h"
 #include "../../renderer/renderer.h"
-#include "../converter.h"
 #include "textureloader.h"
-#include "objloader.h"
+#include "meshloader.h"
 #include "../../datatypes/instance.h"
+#include "../../datatypes/animation.h"
 #include "../../utils/args.h"
 #include "../../renderer/envmap.h"
+#include "../../accelerators/bvh.h"
 
 struct transform parseTransformComposite(const cJSON *transforms);
 
 static struct color parseColor(const cJSON *data);
 
-static void addMaterialToMesh(struct mesh *mesh, struct material newMaterial);
 
 static struct instance *lastInstance(struct renderer *r) {
 	return &r->scene->instances[r->scene->instanceCount - 1];
@@ -53,185 +57,257 @@ static struct sphere *lastSphere(struct renderer *r) {
 	return &r->scene->spheres[r->scene->sphereCount - 1];
 }
 
+//Textures are decoded by the cache when they are first sampled
+static struct mipmap *loadMipmap(struct textureCache *cache, char *assetPath, char *path, enum colorspace colorspace) {
+	char *fullPath = concatString(assetPath, path);
+	struct mipmap *mipmap = textureCacheAdd(cache, fullPath, colorspace);
+	free(fullPath);
+	return mipmap;
+}
+
 //FIXME: Do something about this awful mess.
-static void loadMeshTextures(char *assetPath, struct mesh *mesh) {
-	for (int i = 0; i < mesh->materialCount; ++i) {
+static void loadMeshTextures(struct textureCache *cache, char *assetPath, struct material *materials, int materialCount) {
+	for (int i = 0; i < materialCount; ++i) {
 		//FIXME: do this check in materialFromOBJ and just check against hasTexture here
-		if (mesh->materials[i].textureFilePath) {
-			if (strcmp(mesh->materials[i].textureFilePath, "")) {
+		if (materials[i].textureFilePath) {
+			if (strcmp(materials[i].textureFilePath, "")) {
 				//TODO: Set the shader for this obj to an obnoxious checker pattern if the texture wasn't found
-				char *fullPath = concatString(assetPath, mesh->materials[i].textureFilePath);
-				mesh->materials[i].texture = loadTexture(fullPath);
-				free(fullPath);
-				if (mesh->materials[i].texture) {
-					mesh->materials[i].hasTexture = true;
+				materials[i].texture = loadMipmap(cache, assetPath, materials[i].textureFilePath, sRGB);
+				if (materials[i].texture) {
+					materials[i].hasTexture = true;
 				} else {
-					mesh->materials[i].hasTexture = false;
+					materials[i].hasTexture = false;
 				}
 			} else {
-				mesh->materials[i].hasTexture = false;
+				materials[i].hasTexture = false;
 			}
 		} else {
-			mesh->materials[i].hasTexture = false;
+			materials[i].hasTexture = false;
 		}
 		
-		if (mesh->materials[i].normalMapPath) {
-			if (strcmp(mesh->materials[i].normalMapPath, "")) {
-				char *fullPath = concatString(assetPath, mesh->materials[i].normalMapPath);
-				mesh->materials[i].normalMap = loadTexture(fullPath);
-				free(fullPath);
-				if (mesh->materials[i].normalMap) {
-					mesh->materials[i].hasNormalMap = true;
+		if (materials[i].normalMapPath) {
+			if (strcmp(materials[i].normalMapPath, "")) {
+				materials[i].normalMap = loadMipmap(cache, assetPath, materials[i].normalMapPath, linear);
+				if (materials[i].normalMap) {
+					materials[i].hasNormalMap = true;
 				} else {
-					mesh->materials[i].hasNormalMap = false;
+					materials[i].hasNormalMap = false;
 				}
 			} else {
-				mesh->materials[i].hasNormalMap = false;
+				materials[i].hasNormalMap = false;
 			}
 		} else {
-			mesh->materials[i].hasNormalMap = false;
+			materials[i].hasNormalMap = false;
 		}
 		
-		if (mesh->materials[i].specularMapPath) {
-			if (strcmp(mesh->materials[i].specularMapPath, "")) {
-				char *fullPath = concatString(assetPath, mesh->materials[i].specularMapPath);
-				mesh->materials[i].specularMap = loadTexture(fullPath);
-				free(fullPath);
-				if (mesh->materials[i].specularMap) {
-					mesh->materials[i].hasSpecularMap = true;
+		if (materials[i].specularMapPath) {
+			if (strcmp(materials[i].specularMapPath, "")) {
+				materials[i].specularMap = loadMipmap(cache, assetPath, materials[i].specularMapPath, linear);
+				if (materials[i].specularMap) {
+					materials[i].hasSpecularMap = true;
 				} else {
-					mesh->materials[i].hasSpecularMap = false;
+					materials[i].hasSpecularMap = false;
 				}
 			} else {
-				mesh->materials[i].hasSpecularMap = false;
+				materials[i].hasSpecularMap = false;
 			}
 		} else {
-			mesh->materials[i].hasSpecularMap = false;
+			materials[i].hasSpecularMap = false;
 		}
 		
 	}
 }
 
-static bool loadMeshNew(struct renderer *r, char *inputFilePath) {
-	logr(info, "Loading OBJ %s...\n", inputFilePath);
-	
-	bool valid = false;
-	
-	size_t meshCount = 0;
-	struct mesh *newMeshes = parseWavefront(inputFilePath, &meshCount);
-	r->scene->meshes = realloc(r->scene->meshes, (r->scene->meshCount + meshCount) * sizeof(struct mesh));
-	if (newMeshes) {
-		for (size_t m = 0; m < meshCount; ++m) {
-			r->scene->meshes[r->scene->meshCount + m] = newMeshes[m];
-			free(&newMeshes[m]);
-			valid = true;
-			loadMeshTextures(r->prefs.assetPath, &r->scene->meshes[r->scene->meshCount + m]);
+//Mesh files and the environment map are loaded by a pool of at most prefs.threadCount threads,
+//while the rest of the scene is parsed. Jobs run in the order they're added.
+struct loadJob {
+	void *(*func)(void *);
+	void *arg;
+	bool done;
+};
+
+struct loaderPool {
+	struct crMutex *mutex;
+	struct crCondition *jobAdded;
+	struct crCondition *jobDone;
+	struct loadJob **jobs;
+	int jobCount;
+	int nextJob;
+	bool closing;
+	struct crThread *threads;
+	int threadCount; //Started as jobs come in, up to maxThreads
+	int maxThreads;
+};
+
+static void *loaderThread(void *arg) {
+	struct loaderPool *pool = (struct loaderPool *)threadUserData(arg);
+	lockMutex(pool->mutex);
+	while (true) {
+		while (pool->nextJob == pool->jobCount && !pool->closing) waitCondition(pool->jobAdded, pool->mutex);
+		if (pool->nextJob == pool->jobCount) break;
+		struct loadJob *job = pool->jobs[pool->nextJob++];
+		releaseMutex(pool->mutex);
+		job->func(job->arg);
+		lockMutex(pool->mutex);
+		job->done = true;
+		broadcastCondition(pool->jobDone);
+	}
+	releaseMutex(pool->mutex);
+	return NULL;
+}
+
+static struct loaderPool *newLoaderPool(int maxThreads) {
+	struct loaderPool *pool = calloc(1, sizeof(*pool));
+	pool->mutex = createMutex();
+	pool->jobAdded = createCondition();
+	pool->jobDone = createCondition();
+	pool->maxThreads = max(maxThreads, 1);
+	pool->threads = calloc(pool->maxThreads, sizeof(*pool->threads));
+	return pool;
+}
+
+static void addLoadJob(struct loaderPool *pool, struct loadJob *job, void *(*func)(void *), void *arg) {
+	*job = (struct loadJob){.func = func, .arg = arg};
+	lockMutex(pool->mutex);
+	pool->jobs = realloc(pool->jobs, (pool->jobCount + 1) * sizeof(*pool->jobs));
+	pool->jobs[pool->jobCount++] = job;
+	//Small scenes don't need a thread for every core
+	if (pool->threadCount < pool->maxThreads) {
+		struct crThread *thread = &pool->threads[pool->threadCount];
+		*thread = (struct crThread){.threadFunc = loaderThread, .userData = pool};
+		if (threadStart(thread)) {
+			logr(error, "Failed to create a loader thread\n");
 		}
+		pool->threadCount++;
 	}
-	
-	logr(info, "Found %zu meshes\n", meshCount);
-	
-	r->scene->meshCount += meshCount;
-	return valid;
+	signalCondition(pool->jobAdded);
+	releaseMutex(pool->mutex);
 }
 
-static bool loadMesh(struct renderer *r, const char *inputFilePath, int idx, int meshCount) {
-	printf("\r");
+static void waitLoadJob(struct loaderPool *pool, struct loadJob *job) {
+	lockMutex(pool->mutex);
+	while (!job->done) waitCondition(pool->jobDone, pool->mutex);
+	releaseMutex(pool->mutex);
+}
+
+static void destroyLoaderPool(struct loaderPool *pool) {
+	lockMutex(pool->mutex);
+	pool->closing = true;
+	broadcastCondition(pool->jobAdded);
+	releaseMutex(pool->mutex);
+	for (int i = 0; i < pool->threadCount; ++i) {
+		threadWait(&pool->threads[i]);
+	}
+	destroyCondition(pool->jobAdded);
+	destroyCondition(pool->jobDone);
+	destroyMutex(pool->mutex);
+	free(pool->threads);
+	free(pool->jobs);
+	free(pool);
+}
+
+//OBJ files are split into chunks of at least this many bytes, so small meshes don't spin up threads
+#define OBJ_CHUNK_SIZE (1 << 20)
+
+//Each mesh file has its BVH built, its geometry compacted and its textures registered by the same job that parses it.
+struct meshLoadTask {
+	char *path;
+	int threadCount; //For the OBJ parser
+	struct textureCache *textures;
+	struct meshFile *file; //NULL if it couldn't be loaded
+	struct mesh geometry; //Vertex streams and triangles, see compactMeshFile()
+	long bvhBuildTimeUs;
+	struct loadJob job;
+};
+
+static void *meshLoadJob(void *arg) {
+	struct meshLoadTask *task = (struct meshLoadTask *)arg;
+	task->file = loadMeshFile(task->path, task->threadCount);
+	if (!task->file) return NULL;
+	if (!task->file->bvh) {
+		struct timeval timer = {0};
+		startTimer(&timer);
+		task->file->bvh = buildBottomLevelBvh(task->file->vertices, task->file->polygons, (unsigned)task->file->polyCount);
+		task->bvhBuildTimeUs = getUs(timer);
+		logr(debug, "Built BVH for %s in %lims\n", task->path, task->bvhBuildTimeUs / 1000);
+	}
+	const struct meshFile *file = task->file;
+	const size_t fileBytes = file->vertexCount * sizeof(struct vector) + file->normalCount * sizeof(struct vector) +
+							 file->textureCount * sizeof(struct coord) + file->polyCount * sizeof(struct poly);
+	compactMeshFile(task->file, &task->geometry);
+	const struct mesh *mesh = &task->geometry;
+	const size_t meshBytes = mesh->vertexCount * (sizeof(struct vector) + (mesh->normals ? sizeof(*mesh->normals) : 0) +
+							 (mesh->textureCoords ? 2 * sizeof(*mesh->textureCoords) : 0) + (mesh->exactTextureCoords ? sizeof(*mesh->exactTextureCoords) : 0)) + mesh->polyCount * sizeof(struct triangle);
+	if (mesh->polyCount) {
+		logr(debug, "Compacted %s from %.1f to %.1f bytes per triangle\n", task->path,
+			 (double)fileBytes / mesh->polyCount, (double)meshBytes / mesh->polyCount);
+	}
+	char *assetPath = getFilePath(task->path);
+	loadMeshTextures(task->textures, assetPath, task->file->materials, task->file->materialCount);
+	free(assetPath);
+	return NULL;
+}
+
+//parserThreads is this mesh's share of prefs.threadCount, since other meshes are loaded at the same time
+static void startMeshLoad(struct renderer *r, struct loaderPool *pool, struct meshLoadTask *task, const char *fileName, int parserThreads) {
+	task->path = concatString(r->prefs.assetPath, fileName);
+	task->threadCount = (int)min((size_t)parserThreads, getFileSize(task->path) / OBJ_CHUNK_SIZE + 1);
+	task->textures = r->scene->textures;
+	addLoadJob(pool, &task->job, meshLoadJob, task);
+}
+
+static bool loadMesh(struct renderer *r, struct loaderPool *pool, struct meshLoadTask *task, int idx, int meshCount) {
+	waitLoadJob(pool, &task->job);
+	fprintf(logStream(), "\r");
 	logr(info, "Loading mesh %i/%i%s", idx, meshCount, idx == meshCount ? "\n" : "\r");
 	
-	char *fileName = getFileName(inputFilePath);
-	obj_scene_data data;
-	char *pathCopy = copyString(inputFilePath); //Yuck.
-	if (parse_obj_scene(&data, pathCopy) == 0) {
-		if (idx != meshCount) printf("\n");
+	char *fileName = getFileName(task->path);
+	free(task->path);
+	task->path = NULL;
+	struct meshFile *file = task->file;
+	r->state.bvhBuildTimeUs += task->bvhBuildTimeUs;
+	if (!file) {
+		if (idx != meshCount) fprintf(logStream(), "\n");
 		logr(warning, "Mesh \"%s\" not found!\n", fileName);
-		free(pathCopy);
+		free(fileName);
 		return false;
 	}
-	free(pathCopy);
 	
 	//Create mesh to keep track of meshes
 	struct mesh *newMesh = &r->scene->meshes[r->scene->meshCount];
-	//Vertex data
-	newMesh->firstVectorIndex = vertexCount;
-	newMesh->vertexCount = data.vertex_count;
-	//Normal data
-	newMesh->firstNormalIndex = normalCount;
-	newMesh->normalCount = data.vertex_normal_count;
-	//Texture vector data
-	newMesh->firstTextureIndex = textureCount;
-	newMesh->textureCount = data.vertex_texture_count;
-	//Poly data
-	newMesh->polyCount = data.face_count;
-	
-	newMesh->materialCount = 0;
-	//Set name
+	//Vertex streams and triangles were compacted on the loading thread
+	*newMesh = task->geometry;
 	newMesh->name = fileName;
 	
-	//Update vector and poly counts
-	vertexCount += data.vertex_count;
-	normalCount += data.vertex_normal_count;
-	textureCount += data.vertex_texture_count;
-	
-	//Data loaded, now convert everything
-	//Convert vectors
-	g_vertices = realloc(g_vertices, vertexCount * sizeof(struct vector));
-	for (int i = 0; i < data.vertex_count; ++i) {
-		g_vertices[newMesh->firstVectorIndex + i] = vectorFromObj(data.vertex_list[i]);
-	}
-	
-	//Convert normals
-	g_normals = realloc(g_normals, normalCount * sizeof(struct vector));
-	for (int i = 0; i < data.vertex_normal_count; ++i) {
-		g_normals[newMesh->firstNormalIndex + i] = vectorFromObj(data.vertex_normal_list[i]);
-	}
-	//Convert texture vectors
-	g_textureCoords = realloc(g_textureCoords, textureCount * sizeof(struct coord));
-	for (int i = 0; i < data.vertex_texture_count; ++i) {
-		g_textureCoords[newMesh->firstTextureIndex + i] = coordFromObj(data.vertex_texture_list[i]);
-	}
-	//Convert polygons
-	newMesh->polygons = malloc(data.face_count * sizeof(struct poly));
-	for (int i = 0; i < data.face_count; ++i) {
-		newMesh->polygons[i] = polyFromObj(data.face_list[i],
-										   newMesh->firstVectorIndex,
-										   newMesh->firstNormalIndex,
-										   newMesh->firstTextureIndex);
-	}
+	newMesh->materialCount = 0;
+	newMesh->materials = NULL;
 	
-	newMesh->materials = calloc(1, sizeof(*newMesh->materials));
 	//Parse materials
-	if (data.material_count == 0) {
+	if (file->materialCount == 0) {
 		//No material, set to something obscene to make it noticeable
 		newMesh->materials = calloc(1, sizeof(*newMesh->materials));
 		newMesh->materials[0] = warningMaterial();
 		assignBSDF(&newMesh->materials[0]);
 		newMesh->materialCount++;
 	} else {
-		//Loop to add materials to mesh (We already set the material indices in polyFromObj)
-		for (int i = 0; i < data.material_count; ++i) {
-			addMaterialToMesh(newMesh, materialFromObj(data.material_list[i]));
-		}
+		//Polygons already have their material indices, take over the whole list
+		newMesh->materials = file->materials;
+		newMesh->materialCount = file->materialCount;
+		file->materials = NULL;
 	}
 	
-	//Load textures for meshes
-	char *filePath = getFilePath(inputFilePath);
-	loadMeshTextures(filePath, newMesh);
-	free(filePath);
-	
-	//Delete OBJ data
-	delete_obj_data(&data);
+	//Vertex data and a prebuilt BVH from a .crmesh file point into the mapping, so the mesh holds on to it
+	newMesh->bvh = file->bvh;
+	file->bvh = NULL;
+	newMesh->mapping = file->mapping;
+	file->mapping = NULL;
+	destroyMeshFile(file);
 	
 	//Mesh added, update count
 	r->scene->meshCount++;
 	return true;
 }
 
-static void addMaterialToMesh(struct mesh *mesh, struct material newMaterial) {
-	mesh->materials = realloc(mesh->materials, (mesh->materialCount + 1) * sizeof(struct material));
-	mesh->materials[mesh->materialCount++] = newMaterial;
-}
-
 static void addSphere(struct world *scene, struct sphere newSphere) {
 	scene->spheres[scene->sphereCount++] = newSphere;
 }
@@ -320,7 +396,7 @@ static struct material *parseMaterial(const cJSON *data) {
 	return mat;
 }
 
-static struct transform parseTransform(const cJSON *data, char *targetName) {
+static struct transformParams parseTransformParams(const cJSON *data, char *targetName) {
 	cJSON *type = cJSON_GetObjectItem(data, "type");
 	if (!cJSON_IsString(type)) {
 		logr(warning, "Failed to parse transform! No type found\n");
@@ -384,43 +460,43 @@ static struct transform parseTransform(const cJSON *data, char *targetName) {
 	
 	if (strcmp(type->valuestring, "rotateX") == 0) {
 		if (validDegrees) {
-			return newTransformRotateX(toRadians(degrees->valuedouble));
+			return (struct transformParams){transformTypeXRotate, toRadians(degrees->valuedouble), 0.0f, 0.0f};
 		} else if (validRadians) {
-			return newTransformRotateX(radians->valuedouble);
+			return (struct transformParams){transformTypeXRotate, radians->valuedouble, 0.0f, 0.0f};
 		} else {
 			logr(warning, "Found rotateX transform for object \"%s\" with no valid degrees or radians value given.\n", targetName);
 		}
 	} else if (strcmp(type->valuestring, "rotateY") == 0) {
 		if (validDegrees) {
-			return newTransformRotateY(toRadians(degrees->valuedouble));
+			return (struct transformParams){transformTypeYRotate, toRadians(degrees->valuedouble), 0.0f, 0.0f};
 		} else if (validRadians) {
-			return newTransformRotateY(radians->valuedouble);
+			return (struct transformParams){transformTypeYRotate, radians->valuedouble, 0.0f, 0.0f};
 		} else {
 			logr(warning, "Found rotateY transform for object \"%s\" with no valid degrees or radians value given.\n", targetName);
 		}
 	} else if (strcmp(type->valuestring, "rotateZ") == 0) {
 		if (validDegrees) {
-			return newTransformRotateZ(toRadians(degrees->valuedouble));
+			return (struct transformParams){transformTypeZRotate, toRadians(degrees->valuedouble), 0.0f, 0.0f};
 		} else if (validRadians) {
-			return newTransformRotateZ(radians->valuedouble);
+			return (struct transformParams){transformTypeZRotate, radians->valuedouble, 0.0f, 0.0f};
 		} else {
 			logr(warning, "Found rotateZ transform for object \"%s\" with no valid degrees or radians value given.\n", targetName);
 		}
 	} else if (strcmp(type->valuestring, "translate") == 0) {
 		if (validCoords > 0) {
-			return newTransformTranslate(Xval, Yval, Zval);
+			return (struct transformParams){transformTypeTranslate, Xval, Yval, Zval};
 		} else {
 			logr(warning, "Found translate transform for object \"%s\" with less than 1 valid coordinate given.\n", targetName);
 		}
 	} else if (strcmp(type->valuestring, "scale") == 0) {
 		if (validCoords > 0) {
-			return newTransformScale(Xval, Yval, Zval);
+			return (struct transformParams){transformTypeScale, Xval, Yval, Zval};
 		} else {
 			logr(warning, "Found scale transform for object \"%s\" with less than 1 valid scale value given.\n", targetName);
 		}
 	} else if (strcmp(type->valuestring, "scaleUniform") == 0) {
 		if (validScale) {
-			return newTransformScaleUniform(scale->valuedouble);
+			return (struct transformParams){transformTypeScale, scale->valuedouble, scale->valuedouble, scale->valuedouble};
 		} else {
 			logr(warning, "Found scaleUniform transform for object \"%s\" with no valid scale value given.\n", targetName);
 		}
@@ -429,7 +505,12 @@ static struct transform parseTransform(const cJSON *data, char *targetName) {
 	}
 	
 	//Hack. This is essentially just a NOP transform that does nothing.
-	return newTransformTranslate(0.0f, 0.0f, 0.0f);
+	return (struct transformParams){transformTypeTranslate, 0.0f, 0.0f, 0.0f};
+}
+
+static struct transform parseTransform(const cJSON *data, char *targetName) {
+	struct transformParams params = parseTransformParams(data, targetName);
+	return transformFromParams(&params);
 }
 
 static struct prefs defaultPrefs() {
@@ -445,6 +526,11 @@ static struct prefs defaultPrefs() {
 		.tileWidth = 32,
 		.tileHeight = 32,
 		.antialiasing = true,
+		.sampler = Sobol,
+		.denoise = false,
+		.writeAovs = false,
+		.textureCacheSize = (size_t)2048 * 1024 * 1024,
+		.hdrPrecision = half_p,
 		.imgFilePath = imgFilePath,
 		.imgFileName = imgFileName,
 		.imgCount = 0,
@@ -475,6 +561,11 @@ static struct prefs parsePrefs(const cJSON *data) {
 	const cJSON *width = NULL;
 	const cJSON *height = NULL;
 	const cJSON *fileType = NULL;
+	const cJSON *sampler = NULL;
+	const cJSON *denoise = NULL;
+	const cJSON *writeAovs = NULL;
+	const cJSON *textureCacheSize = NULL;
+	const cJSON *hdrFormat = NULL;
 	
 	threads = cJSON_GetObjectItem(data, "threads");
 	if (threads) {
@@ -671,6 +762,75 @@ static struct prefs parsePrefs(const cJSON *data) {
 		p.imgType = defaultPrefs().imgType;
 	}
 	
+	sampler = cJSON_GetObjectItem(data, "sampler");
+	if (sampler) {
+		if (cJSON_IsString(sampler)) {
+			if (strcmp(sampler->valuestring, "sobol") == 0) {
+				p.sampler = Sobol;
+			} else if (strcmp(sampler->valuestring, "random") == 0) {
+				p.sampler = Random;
+			} else if (strcmp(sampler->valuestring, "halton") == 0) {
+				p.sampler = Halton;
+			} else {
+				logr(warning, "Unknown sampler \"%s\", using sobol\n", sampler->valuestring);
+				p.sampler = defaultPrefs().sampler;
+			}
+		} else {
+			logr(warning, "Invalid sampler while parsing renderer\n");
+		}
+	} else {
+		p.sampler = defaultPrefs().sampler;
+	}
+	
+	denoise = cJSON_GetObjectItem(data, "denoise");
+	if (denoise) {
+		if (cJSON_IsBool(denoise)) {
+			p.denoise = cJSON_IsTrue(denoise);
+		} else {
+			logr(warning, "Invalid denoise bool while parsing renderer\n");
+		}
+	} else {
+		p.denoise = defaultPrefs().denoise;
+	}
+	
+	writeAovs = cJSON_GetObjectItem(data, "writeAovs");
+	if (writeAovs) {
+		if (cJSON_IsBool(writeAovs)) {
+			p.writeAovs = cJSON_IsTrue(writeAovs);
+		} else {
+			logr(warning, "Invalid writeAovs bool while parsing renderer\n");
+		}
+	} else {
+		p.writeAovs = defaultPrefs().writeAovs;
+	}
+	
+	//In megabytes, 0 for no limit
+	textureCacheSize = cJSON_GetObjectItem(data, "textureCacheSize");
+	if (textureCacheSize) {
+		if (cJSON_IsNumber(textureCacheSize) && textureCacheSize->valuedouble >= 0.0) {
+			p.textureCacheSize = textureCacheSize->valuedouble > 0.0 ? (size_t)(textureCacheSize->valuedouble * 1024 * 1024) : SIZE_MAX;
+		} else {
+			logr(warning, "Invalid textureCacheSize while parsing renderer\n");
+		}
+	}
+	
+	hdrFormat = cJSON_GetObjectItem(data, "hdrFormat");
+	if (hdrFormat) {
+		if (cJSON_IsString(hdrFormat)) {
+			if (strcmp(hdrFormat->valuestring, "float") == 0) {
+				p.hdrPrecision = float_p;
+			} else if (strcmp(hdrFormat->valuestring, "half") == 0) {
+				p.hdrPrecision = half_p;
+			} else if (strcmp(hdrFormat->valuestring, "compressed") == 0) {
+				p.hdrPrecision = block_p;
+			} else {
+				logr(warning, "Unknown hdrFormat \"%s\", using half\n", hdrFormat->valuestring);
+			}
+		} else {
+			logr(warning, "Invalid hdrFormat while parsing renderer\n");
+		}
+	}
+	
 	// Now check and apply potential CLI overrides.
 	if (isSet("thread_override")) {
 		int threads = intPref("thread_override");
@@ -703,6 +863,15 @@ static struct prefs parsePrefs(const cJSON *data) {
 		p.tileHeight = height;
 	}
 	
+	if (isSet("denoise")) {
+		logr(info, "Denoising enabled\n");
+		p.denoise = true;
+	}
+	
+	if (isSet("write_aovs")) {
+		p.writeAovs = true;
+	}
+	
 	return p;
 }
 
@@ -906,8 +1075,38 @@ static struct color parseColor(const cJSON *data) {
 	return newColor;
 }
 
+//The environment map is decoded on the loader pool while meshes load
+struct envMapLoadTask {
+	char *path;
+	enum precision precision;
+	float offset;
+	struct envMap *map;
+	struct loadJob job;
+};
+
+static void *envMapLoadJob(void *arg) {
+	struct envMapLoadTask *task = (struct envMapLoadTask *)arg;
+	task->map = loadEnvMap(task->path, task->precision);
+	return NULL;
+}
+
+static void startEnvMapLoad(struct renderer *r, struct loaderPool *pool, struct envMapLoadTask *task, const char *fileName) {
+	task->path = concatString(r->prefs.assetPath, fileName);
+	task->precision = r->prefs.hdrPrecision;
+	addLoadJob(pool, &task->job, envMapLoadJob, task);
+}
+
+static struct envMap *finishEnvMapLoad(struct loaderPool *pool, struct envMapLoadTask *task) {
+	if (!task->path) return NULL;
+	waitLoadJob(pool, &task->job);
+	free(task->path);
+	task->path = NULL;
+	if (task->map) task->map->offset = task->offset;
+	return task->map;
+}
+
 //FIXME:
-static int parseAmbientColor(struct renderer *r, const cJSON *data) {
+static int parseAmbientColor(struct renderer *r, const cJSON *data, struct loaderPool *pool, struct envMapLoadTask *hdrTask) {
 	const cJSON *down = NULL;
 	const cJSON *up = NULL;
 	const cJSON *hdr = NULL;
@@ -925,16 +1124,12 @@ static int parseAmbientColor(struct renderer *r, const cJSON *data) {
 	
 	hdr = cJSON_GetObjectItem(data, "hdr");
 	if (cJSON_IsString(hdr)) {
-		char *fullPath = concatString(r->prefs.assetPath, hdr->valuestring);
-		r->scene->hdr = loadEnvMap(fullPath);
-		free(fullPath);
+		startEnvMapLoad(r, pool, hdrTask, hdr->valuestring);
 	}
 	
 	offset = cJSON_GetObjectItem(data, "offset");
 	if (cJSON_IsNumber(offset)) {
-		if (r->scene->hdr) {
-			r->scene->hdr->offset = toRadians(offset->valuedouble) / 4.0f;
-		}
+		hdrTask->offset = toRadians(offset->valuedouble) / 4.0f;
 	}
 	
 	return 0;
@@ -951,34 +1146,78 @@ struct transform parseTransformComposite(const cJSON *transforms) {
 		tforms[idx++] = parseTransform(transform, "compositeBuilder");
 	}
 	
-	struct transform composite = newTransform();
-	
-	// Order is: scales/rotates, then translates
-	
-	// Translates
-	for (size_t i = 0; i < count; ++i) {
-		if (isTranslate(&tforms[i])) {
-			composite.A = multiplyMatrices(&composite.A, &tforms[i].A);
+	struct transform composite = composeTransforms(tforms, count);
+	free(tforms);
+	return composite;
+}
+
+static bool parseKeyframes(struct track *track, const cJSON *data) {
+	if (!cJSON_IsArray(data)) return false;
+	const cJSON *key = NULL;
+	cJSON_ArrayForEach(key, data) {
+		const cJSON *frame = cJSON_GetObjectItem(key, "frame");
+		const cJSON *transforms = cJSON_GetObjectItem(key, "transforms");
+		if (!cJSON_IsNumber(frame) || !cJSON_IsArray(transforms)) {
+			logr(warning, "Invalid keyframe while parsing animation, needs a frame and transforms.\n");
+			continue;
+		}
+		track->keys = realloc(track->keys, (track->keyCount + 1) * sizeof(*track->keys));
+		struct keyframe *newKey = &track->keys[track->keyCount++];
+		newKey->frame = frame->valueint;
+		newKey->transformCount = cJSON_GetArraySize(transforms);
+		newKey->transforms = calloc(newKey->transformCount, sizeof(*newKey->transforms));
+		size_t idx = 0;
+		const cJSON *transform = NULL;
+		cJSON_ArrayForEach(transform, transforms) {
+			newKey->transforms[idx++] = parseTransformParams(transform, "keyframe");
 		}
 	}
-	
-	// Rotates
-	for (size_t i = 0; i < count; ++i) {
-		if (isRotation(&tforms[i])) {
-			composite.A = multiplyMatrices(&composite.A, &tforms[i].A);
+	sortKeys(track);
+	return track->keyCount > 0;
+}
+
+static void addTrack(struct animation *animation, struct track track) {
+	animation->tracks = realloc(animation->tracks, (animation->trackCount + 1) * sizeof(*animation->tracks));
+	animation->tracks[animation->trackCount++] = track;
+}
+
+static struct animation *parseAnimation(const cJSON *data, int instanceCount) {
+	if (!data) return NULL;
+	const cJSON *frames = cJSON_GetObjectItem(data, "frames");
+	if (!cJSON_IsNumber(frames) || frames->valueint < 1) {
+		logr(warning, "Invalid frames while parsing animation.\n");
+		return NULL;
+	}
+	struct animation *animation = calloc(1, sizeof(*animation));
+	animation->frameCount = frames->valueint;
+	
+	const cJSON *camera = cJSON_GetObjectItem(data, "camera");
+	if (camera) {
+		struct track track = {.instanceIdx = -1};
+		if (parseKeyframes(&track, camera)) {
+			addTrack(animation, track);
+		} else {
+			logr(warning, "Invalid camera keys while parsing animation.\n");
 		}
 	}
 	
-	// Scales
-	for (size_t i = 0; i < count; ++i) {
-		if (isScale(&tforms[i])) {
-			composite.A = multiplyMatrices(&composite.A, &tforms[i].A);
+	const cJSON *instances = cJSON_GetObjectItem(data, "instances");
+	const cJSON *instance = NULL;
+	cJSON_ArrayForEach(instance, instances) {
+		//Instances are numbered in the order they appear in the scene, primitives first
+		const cJSON *index = cJSON_GetObjectItem(instance, "instance");
+		if (!cJSON_IsNumber(index) || index->valueint < 0 || index->valueint >= instanceCount) {
+			logr(warning, "Invalid instance index while parsing animation.\n");
+			continue;
+		}
+		struct track track = {.instanceIdx = index->valueint};
+		if (parseKeyframes(&track, cJSON_GetObjectItem(instance, "keys"))) {
+			addTrack(animation, track);
+		} else {
+			logr(warning, "Invalid keys for instance %i while parsing animation.\n", index->valueint);
 		}
 	}
-	
-	composite.Ainv = inverseMatrix(&composite.A);
-	composite.type = transformTypeComposite;
-	return composite;
+	return animation;
 }
 
 static struct transform parseInstanceTransform(const cJSON *instance) {
@@ -987,9 +1226,7 @@ static struct transform parseInstanceTransform(const cJSON *instance) {
 }
 
 //FIXME: Only parse everything else if the mesh is found and is valid
-static void parseMesh(struct renderer *r, const cJSON *data, int idx, int meshCount) {
-	const cJSON *fileName = cJSON_GetObjectItem(data, "fileName");
-	
+static void parseMesh(struct renderer *r, const cJSON *data, struct loaderPool *pool, struct meshLoadTask *task, int idx, int meshCount) {
 	const cJSON *bsdf = cJSON_GetObjectItem(data, "bsdf");
 	const cJSON *intensity = cJSON_GetObjectItem(data, "intensity");
 	const cJSON *roughness = cJSON_GetObjectItem(data, "roughness");
@@ -1013,13 +1250,10 @@ static void parseMesh(struct renderer *r, const cJSON *data, int idx, int meshCo
 	}
 	
 	bool meshValid = false;
-	if (fileName != NULL && cJSON_IsString(fileName)) {
-		char *fullPath = concatString(r->prefs.assetPath, fileName->valuestring);
-		if (loadMesh(r, fullPath, idx, meshCount)) {
+	if (task->path) {
+		if (loadMesh(r, pool, task, idx, meshCount)) {
 			meshValid = true;
-			free(fullPath);
 		} else {
-			free(fullPath);
 			return;
 		}
 	}
@@ -1052,16 +1286,27 @@ static void parseMesh(struct renderer *r, const cJSON *data, int idx, int meshCo
 	}
 }
 
-static void parseMeshes(struct renderer *r, const cJSON *data) {
+static void parseMeshes(struct renderer *r, const cJSON *data, struct loaderPool *pool) {
 	const cJSON *mesh = NULL;
 	int idx = 1;
 	int meshCount = cJSON_GetArraySize(data);
 	r->scene->meshes = calloc(meshCount, sizeof(*r->scene->meshes));
 	if (data != NULL && cJSON_IsArray(data)) {
+		//Queue all mesh files first, then set them up in order as they finish.
+		//Up to pool->maxThreads meshes load at once, and split the parser threads between them.
+		const int parserThreads = max(r->prefs.threadCount / max(min(meshCount, pool->maxThreads), 1), 1);
+		struct meshLoadTask *tasks = calloc(meshCount, sizeof(*tasks));
+		cJSON_ArrayForEach(mesh, data) {
+			const cJSON *fileName = cJSON_GetObjectItem(mesh, "fileName");
+			if (cJSON_IsString(fileName)) startMeshLoad(r, pool, &tasks[idx - 1], fileName->valuestring, parserThreads);
+			idx++;
+		}
+		idx = 1;
 		cJSON_ArrayForEach(mesh, data) {
-			parseMesh(r, mesh, idx, meshCount);
+			parseMesh(r, mesh, pool, &tasks[idx - 1], idx, meshCount);
 			idx++;
 		}
+		free(tasks);
 	}
 }
 
@@ -1117,7 +1362,7 @@ static void parseSphere(struct renderer *r, const cJSON *data) {
 			case emission:
 				newSphere.material.emission = parseColor(color);
 				break;
-				
+			
 			default:
 				newSphere.material.ambient = parseColor(color);
 				newSphere.material.diffuse = parseColor(color);
@@ -1196,7 +1441,7 @@ static void parsePrimitives(struct renderer *r, const cJSON *data) {
 	}
 }
 
-static int parseScene(struct renderer *r, const cJSON *data) {
+static int parseScene(struct renderer *r, const cJSON *data, struct loaderPool *pool, struct envMapLoadTask *hdrTask) {
 	
 	const cJSON *ambientColor = NULL;
 	const cJSON *primitives = NULL;
@@ -1205,7 +1450,7 @@ static int parseScene(struct renderer *r, const cJSON *data) {
 	ambientColor = cJSON_GetObjectItem(data, "ambientColor");
 	if (ambientColor) {
 		if (cJSON_IsObject(ambientColor)) {
-			if (parseAmbientColor(r, ambientColor) == -1) {
+			if (parseAmbientColor(r, ambientColor, pool, hdrTask) == -1) {
 				logr(warning, "Invalid ambientColor while parsing scene.\n");
 				return -1;
 			}
@@ -1227,7 +1472,7 @@ static int parseScene(struct renderer *r, const cJSON *data) {
 	meshes = cJSON_GetObjectItem(data, "meshes");
 	if (meshes) {
 		if (cJSON_IsArray(meshes)) {
-			parseMeshes(r, meshes);
+			parseMeshes(r, meshes, pool);
 		}
 	}
 	
@@ -1262,6 +1507,7 @@ int parseJSON(struct renderer *r, char *input) {
 	char *assetPath = r->prefs.assetPath;
 	r->prefs = parsePrefs(renderer);
 	r->prefs.assetPath = assetPath;
+	r->scene->textures = newTextureCache(r->prefs.textureCacheSize);
 	
 	display = cJSON_GetObjectItem(json, "display");
 	if (parseDisplay(&r->prefs, display) == -1) {
@@ -1276,11 +1522,19 @@ int parseJSON(struct renderer *r, char *input) {
 	}
 	
 	scene = cJSON_GetObjectItem(json, "scene");
-	if (parseScene(r, scene) == -1) {
+	struct loaderPool *pool = newLoaderPool(r->prefs.threadCount);
+	struct envMapLoadTask hdrTask = {0};
+	r->state.bvhBuildTimeUs = 0;
+	const int sceneResult = parseScene(r, scene, pool, &hdrTask);
+	r->scene->hdr = finishEnvMapLoad(pool, &hdrTask);
+	destroyLoaderPool(pool);
+	if (sceneResult == -1) {
 		logr(warning, "Scene parse failed!\n");
 		return -2;
 	}
 	
+	r->scene->animation = parseAnimation(cJSON_GetObjectItem(json, "animation"), r->scene->instanceCount);
+	
 	cJSON_Delete(json);
 	
 	return 0;
@@ -19,36 +19,44 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include "../../libraries/stb_image.h"
 
-struct envMap *loadEnvMap(char *filePath) {
-	size_t len = 0;
+struct envMap *loadEnvMap(char *filePath, enum precision precision) {
 	//Handle the trailing newline here
 	filePath[strcspn(filePath, "\n")] = 0;
-	const unsigned char *file = (unsigned char*)loadFile(filePath, &len);
+	struct fileMapping *file = mapFile(filePath);
 	if (!file) return NULL;
-	if (stbi_is_hdr(filePath)) {
-		logr(info, "Loading HDR...");
+	if (stbi_is_hdr_from_memory(file->data, (int)file->size)) {
 		struct texture *tex = newTexture(float_p, 0, 0, 0);
-		tex->data.float_p = stbi_loadf_from_memory(file, (int)len, (int*)&tex->width, (int*)&tex->height, &tex->channels, 0);
+		tex->data.float_p = stbi_loadf_from_memory(file->data, (int)file->size, (int*)&tex->width, (int*)&tex->height, &tex->channels, 0);
 		tex->precision = float_p;
+		const float MB = file->size / 1000000.0f;
+		unmapFile(file);
 		if (!tex->data.float_p) {
 			destroyTexture(tex);
 			logr(warning, "Error while decoding HDR from %s - Corrupted?\n", filePath);
 			return NULL;
 		}
-		float MB = (((getFileSize(filePath))/1000.0f)/1000.0f);
-		printf(" %.1fMB\n", MB);
+		logr(info, "Loaded HDR, %.1fMB\n", MB);
+		if (precision != float_p) {
+			struct texture *compact = convertTexture(tex, precision);
+			if (compact) {
+				logr(info, "Stored HDR in %.1fMB instead of %.1fMB\n", textureBytes(compact) / 1000000.0f, textureBytes(tex) / 1000000.0f);
+				destroyTexture(tex);
+				tex = compact;
+			}
+		}
 		return newEnvMap(tex);
 	}
+	unmapFile(file);
 	return NULL;
 }
 
 struct texture *loadTexture(char *filePath) {
-	size_t len = 0;
 	//Handle the trailing newline here
 	filePath[strcspn(filePath, "\n")] = 0;
-	const unsigned char *file = (unsigned char*)loadFile(filePath, &len);
+	struct fileMapping *file = mapFile(filePath);
 	if (!file) return NULL;
-	struct texture *new = loadTextureFromBuffer(file, (unsigned int)len);
+	struct texture *new = loadTextureFromBuffer(file->data, (unsigned int)file->size);
+	unmapFile(file);
 	if (!new) {
 		logr(warning, "^That happened while decoding texture \"%s\" - Corrupted?\n", filePath);
 		destroyTexture(new);
@@ -58,6 +66,18 @@ struct texture *loadTexture(char *filePath) {
 	return new;
 }
 
+bool loadTextureInfo(char *filePath, unsigned *width, unsigned *height, int *channels) {
+	filePath[strcspn(filePath, "\n")] = 0;
+	int w = 0, h = 0;
+	if (!stbi_info(filePath, &w, &h, channels)) {
+		logr(warning, "Can't read texture \"%s\": %s\n", filePath, stbi_failure_reason());
+		return false;
+	}
+	*width = w;
+	*height = h;
+	return true;
+}
+
 struct texture *loadTextureFromBuffer(const unsigned char *buffer, const unsigned int buflen) {
 	struct texture *new = newTexture(none, 0, 0, 0);
 	new->data.byte_p = stbi_load_from_memory(buffer, buflen, (int*)&new->width, (int*)&new->height, &new->channels, 0);
@@ -8,14 +8,25 @@
 
 #pragma once
 
+#include "../../datatypes/image/texture.h"
+
 //C-ray texture parser
 
 /// Load a radiance HDRI environment map.
 /// @param filePath Path to image file on disk.
-struct envMap *loadEnvMap(char *filePath);
+/// @param precision Precision to store the pixels in, see convertTexture()
+struct envMap *loadEnvMap(char *filePath, enum precision precision);
 
 /// Load a generic texture. Currently supports: JPEG, PNG, BMP, TGA, PIC, PNM
 /// @param filePath Path to image file on disk
 struct texture *loadTexture(char *filePath);
 
+/// Read the dimensions of a texture, without decoding it
+/// @param filePath Path to image file on disk
+/// @param width Set to the width of the image
+/// @param height Set to the height of the image
+/// @param channels Set to the channel count loadTexture() would decode the image to
+/// @return false if the file can't be read, or isn't an image
+bool loadTextureInfo(char *filePath, unsigned *width, unsigned *height, int *channels);
+
 struct texture *loadTextureFromBuffer(const unsigned char *buffer, const unsigned int buflen);
@@ -8,6 +8,8 @@
 
 #pragma once
 
+#include <stdio.h>
+
 struct renderer;
 
 enum logType {
@@ -54,6 +56,9 @@ void logr(enum logType type, const char *fmt, ...)
 #endif
 ;
 
+/// Stream that log output goes to. stderr in benchmark mode, stdout otherwise.
+FILE *logStream(void);
+
 void smartTime(unsigned long long milliseconds, char *buf);
 
 void printSmartTime(unsigned long long ms);
@@ -9,81 +9,1003 @@
 #include "../includes.h"
 #include "networking.h"
 
+/*
+ Distributed rendering
+
+ A master connects to any amount of workers (c-ray --worker) listed with --nodes.
+ It sends the scene JSON and the assets it references, and then hands out tiles
+ from the same queue its local render threads use. Each worker renders whole tiles
+ with all of its threads and sends back the float render buffer for them, which the
+ master merges into its own buffers.
+
+ Every message is an 8 byte header (type, payload length), followed by the payload.
+ All integers are in network byte order, floats are sent as their raw bits.
+
+ master -> worker: asset*, scene, tile*, done
+ worker -> master: ready, result*  (or error at any point)
+ */
+
 //Windows is annoying, so it's just not going to have networking. Because it is annoying and proprietary.
 #ifndef WINDOWS
 
-#include "../utils/logging.h"
+#include "../datatypes/image/imagefile.h"
+#include "../renderer/renderer.h"
+#include "../datatypes/tile.h"
+#include "../datatypes/scene.h"
+#include "../datatypes/animation.h"
+#include "../datatypes/color.h"
+#include "../datatypes/image/texture.h"
+#include "../renderer/samplers/sampler.h"
+#include "../libraries/cJSON.h"
+#include "../datatypes/material.h"
+#include "loaders/meshloader.h"
+#include "loaders/crmesh.h"
+#include "logging.h"
+#include "fileio.h"
+#include "string.h"
+#include "args.h"
+#include "platform/thread.h"
+#include "platform/mutex.h"
 #include <netdb.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <signal.h>
 #include <arpa/inet.h>
 
-#define MAXRCVLEN 1048576 // 1MiB
-#define C_RAY_PORT 2222
+//How often a master blocked on a worker checks if the render was aborted
+#define ABORT_POLL_MSEC 250
 
-int start_interactive() {
-	socklen_t len;
-	int sockfd, connfd;
-	struct sockaddr_in server_address, client_address;
-	sockfd = socket(AF_INET, SOCK_STREAM, 0);
-	if (sockfd == -1) {
-		logr(error, "Socket creation failed.\n");
+//A worker that sends nothing for this long while we wait on it is treated as lost, and its tiles are queued again.
+//Generous, since a single large tile with many samples can take a while.
+#define WORKER_TIMEOUT_SEC 600
+static int workerTimeoutSec = WORKER_TIMEOUT_SEC; //Tests lower this
+
+//Lets the kernel notice a worker host that went away within half a minute, without waiting for WORKER_TIMEOUT_SEC
+#define KEEPALIVE_IDLE_SEC 10
+#define KEEPALIVE_INTERVAL_SEC 5
+#define KEEPALIVE_PROBES 4
+
+//Largest asset or tile result we send or accept. Message lengths come from the peer, so they're checked before allocating.
+#define MAX_MESSAGE_BYTES (1u << 30)
+
+enum messageType {
+	msgAsset = 1,	//u32 path length, path, file contents
+	msgScene,		//Scene JSON
+	msgReady,		//u32 worker thread count
+	msgTile,		//u32 tileNum, beginX, beginY, endX, endY, startSample
+	msgResult,		//u32 tileNum, then width * height * 3 floats, running average from startSample
+	msgDone,		//No payload
+	msgError,		//Error string
+};
+
+struct message {
+	uint32_t type;
+	uint32_t length;
+	unsigned char *payload; //Null-terminated for convenience
+};
+
+static void putU32(unsigned char **cursor, uint32_t value) {
+	uint32_t n = htonl(value);
+	memcpy(*cursor, &n, sizeof(n));
+	*cursor += sizeof(n);
+}
+
+static uint32_t getU32(const unsigned char **cursor) {
+	uint32_t n;
+	memcpy(&n, *cursor, sizeof(n));
+	*cursor += sizeof(n);
+	return ntohl(n);
+}
+
+static void putFloat(unsigned char **cursor, float value) {
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	putU32(cursor, bits);
+}
+
+static float getFloat(const unsigned char **cursor) {
+	uint32_t bits = getU32(cursor);
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+static bool sendAll(int fd, const void *buf, size_t length) {
+	const char *cursor = buf;
+	while (length) {
+		ssize_t sent = send(fd, cursor, length, 0);
+		if (sent < 0 && errno == EINTR) continue;
+		if (sent <= 0) return false;
+		cursor += sent;
+		length -= sent;
+	}
+	return true;
+}
+
+//If aborted is given, the socket has a receive timeout set, and we give up once it becomes true,
+//or when nothing arrives for workerTimeoutSec
+static bool recvAll(int fd, void *buf, size_t length, const bool *aborted) {
+	char *cursor = buf;
+	int idlePolls = 0;
+	while (length) {
+		ssize_t got = recv(fd, cursor, length, 0);
+		if (got < 0 && errno == EINTR) continue;
+		if (got < 0 && aborted && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			if (*aborted) return false;
+			if (++idlePolls >= workerTimeoutSec * 1000 / ABORT_POLL_MSEC) {
+				logr(warning, "Nothing received in %i seconds, giving up\n", workerTimeoutSec);
+				return false;
+			}
+			continue;
+		}
+		if (got <= 0) return false;
+		idlePolls = 0;
+		cursor += got;
+		length -= got;
+	}
+	return true;
+}
+
+static size_t maxPayload(uint32_t type) {
+	switch (type) {
+		case msgAsset: return MAX_MESSAGE_BYTES;
+		case msgScene: return 64 << 20;
+		case msgReady: return sizeof(uint32_t);
+		case msgTile: return 6 * sizeof(uint32_t);
+		case msgResult: return MAX_MESSAGE_BYTES;
+		case msgDone: return 0;
+		case msgError: return 4096;
+		default: return 0;
 	}
+}
+
+static bool sendMessage(int fd, enum messageType type, const void *payload, size_t length) {
+	unsigned char header[8];
+	unsigned char *cursor = header;
+	putU32(&cursor, type);
+	putU32(&cursor, (uint32_t)length);
+	if (!sendAll(fd, header, sizeof(header))) return false;
+	return length ? sendAll(fd, payload, length) : true;
+}
+
+static bool receiveMessage(int fd, struct message *msg, const bool *aborted) {
+	unsigned char header[8];
+	if (!recvAll(fd, header, sizeof(header), aborted)) return false;
+	const unsigned char *cursor = header;
+	msg->type = getU32(&cursor);
+	msg->length = getU32(&cursor);
+	msg->payload = NULL;
+	if (msg->length > maxPayload(msg->type)) {
+		logr(warning, "Dropping connection, got a %"PRIu32" byte message of type %"PRIu32"\n", msg->length, msg->type);
+		return false;
+	}
+	msg->payload = malloc((size_t)msg->length + 1);
+	if (!msg->payload) return false;
+	msg->payload[msg->length] = '\0';
+	if (!recvAll(fd, msg->payload, msg->length, aborted)) {
+		free(msg->payload);
+		msg->payload = NULL;
+		return false;
+	}
+	return true;
+}
+
+static bool sendError(int fd, const char *error) {
+	return sendMessage(fd, msgError, error, strlen(error));
+}
+
+static void setNoDelay(int fd) {
+	//Tile messages are tiny, don't let them sit in the send buffer
+	int opt_val = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &opt_val, sizeof(opt_val));
+}
+
+/*
+ Worker
+ */
+
+struct workerSession {
+	int fd;
+	struct renderer *renderer;
+	char *tempDir; //Received assets go here, with a trailing slash
+	char **createdPaths; //Files and directories to remove when we're done
+	int createdCount;
+	
+	struct crMutex *sendMutex;
+	struct crMutex *queueMutex;
+	struct crCondition *queueCond;
+	struct renderTile queue[MAX_REMOTE_TILES];
+	int queueHead;
+	int queueCount;
+	bool closing; //Master is done, render threads exit once the queue is empty
+	
+	struct crThread *threads;
+	int threadCount;
+};
+
+static void trackPath(struct workerSession *s, char *path) {
+	s->createdPaths = realloc(s->createdPaths, (s->createdCount + 1) * sizeof(*s->createdPaths));
+	s->createdPaths[s->createdCount++] = path;
+}
+
+//Assets are placed in our temp directory, so don't let the master write outside of it
+static bool isSafeAssetPath(const char *path) {
+	if (!path[0] || path[0] == '/') return false;
+	return !strstr(path, "..");
+}
+
+static bool writeAsset(struct workerSession *s, const char *relPath, const unsigned char *data, size_t length) {
+	if (!isSafeAssetPath(relPath)) {
+		logr(warning, "Refusing to write asset to %s\n", relPath);
+		return false;
+	}
+	char *path = concatString(s->tempDir, relPath);
+	//Create intermediate directories
+	for (char *c = path + strlen(s->tempDir); *c; ++c) {
+		if (*c != '/') continue;
+		*c = '\0';
+		if (mkdir(path, 0700) == 0) trackPath(s, copyString(path));
+		*c = '/';
+	}
+	FILE *file = fopen(path, "wb");
+	if (!file) {
+		logr(warning, "Failed to write asset %s\n", path);
+		free(path);
+		return false;
+	}
+	size_t written = fwrite(data, 1, length, file);
+	fclose(file);
+	trackPath(s, path);
+	logr(debug, "Received asset %s (%zu bytes)\n", relPath, length);
+	return written == length;
+}
+
+static void removeAssets(struct workerSession *s) {
+	//Files were tracked after their directories, so removing in reverse empties directories first
+	for (int i = s->createdCount - 1; i >= 0; --i) {
+		remove(s->createdPaths[i]);
+		free(s->createdPaths[i]);
+	}
+	free(s->createdPaths);
+	s->createdPaths = NULL;
+	s->createdCount = 0;
+	if (s->tempDir) remove(s->tempDir);
+	free(s->tempDir);
+	s->tempDir = NULL;
+}
+
+//Remote tiles start from a blank buffer, the master merges in the samples it already has.
+static bool renderRemoteTile(struct renderer *r, const struct renderTile *tile, sampler *sampler, struct stats *stats) {
+	for (int y = tile->begin.y; y < tile->end.y; ++y) {
+		for (int x = tile->begin.x; x < tile->end.x; ++x) {
+			setPixel(r->state.renderBuffer, (struct color){0.0f, 0.0f, 0.0f, 0.0f}, x, y);
+		}
+	}
+	for (int sample = tile->startSample; sample < r->prefs.sampleCount + 1; ++sample) {
+		if (!renderTilePass(r, tile, sample, sampler, stats, NULL)) return false;
+	}
+	return true;
+}
+
+static bool sendResult(struct workerSession *s, const struct renderTile *tile) {
+	struct renderer *r = s->renderer;
+	size_t length = sizeof(uint32_t) + tile->width * tile->height * 3 * sizeof(uint32_t);
+	unsigned char *payload = malloc(length);
+	unsigned char *cursor = payload;
+	putU32(&cursor, tile->tileNum);
+	for (int y = tile->begin.y; y < tile->end.y; ++y) {
+		for (int x = tile->begin.x; x < tile->end.x; ++x) {
+			struct color c = textureGetPixel(r->state.renderBuffer, x, y);
+			putFloat(&cursor, c.red);
+			putFloat(&cursor, c.green);
+			putFloat(&cursor, c.blue);
+		}
+	}
+	lockMutex(s->sendMutex);
+	bool sent = sendMessage(s->fd, msgResult, payload, length);
+	releaseMutex(s->sendMutex);
+	free(payload);
+	return sent;
+}
+
+static void *workerThread(void *arg) {
+	struct workerSession *s = threadUserData(arg);
+	struct renderer *r = s->renderer;
+	sampler *sampler = newSampler();
+	struct stats stats = {0};
+	
+	while (true) {
+		lockMutex(s->queueMutex);
+		while (!s->queueCount && !s->closing) {
+			waitCondition(s->queueCond, s->queueMutex);
+		}
+		if (!s->queueCount) {
+			releaseMutex(s->queueMutex);
+			break;
+		}
+		struct renderTile tile = s->queue[s->queueHead];
+		s->queueHead = (s->queueHead + 1) % MAX_REMOTE_TILES;
+		s->queueCount--;
+		releaseMutex(s->queueMutex);
+		
+		if (!renderRemoteTile(r, &tile, sampler, &stats)) break;
+		if (!sendResult(s, &tile)) {
+			//Master is gone, stop the other threads too
+			r->state.renderAborted = true;
+			break;
+		}
+	}
+	destroySampler(sampler);
+	return 0;
+}
+
+static bool queueTile(struct workerSession *s, const struct message *msg) {
+	if (msg->length != 6 * sizeof(uint32_t)) return false;
+	const unsigned char *cursor = msg->payload;
+	struct renderTile tile = {0};
+	tile.tileNum = getU32(&cursor);
+	tile.begin.x = getU32(&cursor);
+	tile.begin.y = getU32(&cursor);
+	tile.end.x = getU32(&cursor);
+	tile.end.y = getU32(&cursor);
+	tile.startSample = getU32(&cursor);
+	struct renderer *r = s->renderer;
+	if (tile.begin.x < 0 || tile.begin.y < 0 || tile.begin.x >= tile.end.x || tile.begin.y >= tile.end.y ||
+		tile.end.x > (int)r->prefs.imageWidth || tile.end.y > (int)r->prefs.imageHeight ||
+		tile.startSample < 1 || tile.startSample > r->prefs.sampleCount) {
+		return false;
+	}
+	tile.width = tile.end.x - tile.begin.x;
+	tile.height = tile.end.y - tile.begin.y;
+	
+	lockMutex(s->queueMutex);
+	bool queued = s->queueCount < MAX_REMOTE_TILES;
+	if (queued) {
+		s->queue[(s->queueHead + s->queueCount) % MAX_REMOTE_TILES] = tile;
+		s->queueCount++;
+		signalCondition(s->queueCond);
+	}
+	releaseMutex(s->queueMutex);
+	return queued;
+}
+
+//Receive assets until the scene shows up, then load it
+static bool receiveScene(struct workerSession *s) {
+	struct message msg;
+	while (receiveMessage(s->fd, &msg, NULL)) {
+		if (msg.type == msgAsset && msg.length >= sizeof(uint32_t)) {
+			const unsigned char *cursor = msg.payload;
+			uint32_t pathLength = getU32(&cursor);
+			if (pathLength > msg.length - sizeof(uint32_t)) {
+				free(msg.payload);
+				break;
+			}
+			char *path = calloc(pathLength + 1, sizeof(*path));
+			memcpy(path, cursor, pathLength);
+			bool written = writeAsset(s, path, cursor + pathLength, msg.length - sizeof(uint32_t) - pathLength);
+			free(path);
+			free(msg.payload);
+			if (!written) {
+				sendError(s->fd, "Failed to write asset");
+				return false;
+			}
+		} else if (msg.type == msgScene) {
+			s->renderer = newRenderer();
+			s->renderer->prefs.assetPath = copyString(s->tempDir);
+			int ret = loadScene(s->renderer, (char *)msg.payload);
+			free(msg.payload);
+			if (ret) {
+				sendError(s->fd, "Failed to load scene");
+				return false;
+			}
+			return true;
+		} else {
+			free(msg.payload);
+			break;
+		}
+	}
+	logr(warning, "Master sent an invalid message, or disconnected\n");
+	return false;
+}
+
+static void serveMaster(int fd) {
+	struct workerSession s = {0};
+	s.fd = fd;
+	char dirTemplate[] = "/tmp/c-ray-XXXXXX";
+	if (!mkdtemp(dirTemplate)) {
+		logr(warning, "Failed to create a directory for assets\n");
+		sendError(fd, "Failed to create a directory for assets");
+		return;
+	}
+	s.tempDir = concatString(dirTemplate, "/");
+	
+	if (!receiveScene(&s)) {
+		if (s.renderer) destroyRenderer(s.renderer);
+		removeAssets(&s);
+		return;
+	}
+	struct renderer *r = s.renderer;
+	
+	s.sendMutex = createMutex();
+	s.queueMutex = createMutex();
+	s.queueCond = createCondition();
+	s.threadCount = r->prefs.threadCount;
+	s.threads = calloc(s.threadCount, sizeof(*s.threads));
+	
+	bool done = false;
+	unsigned char ready[sizeof(uint32_t)];
+	unsigned char *cursor = ready;
+	putU32(&cursor, s.threadCount);
+	if (sendMessage(fd, msgReady, ready, sizeof(ready))) {
+		logr(info, "Rendering with %i threads\n", s.threadCount);
+		for (int t = 0; t < s.threadCount; ++t) {
+			s.threads[t] = (struct crThread){.threadFunc = workerThread, .userData = &s};
+			if (threadStart(&s.threads[t])) logr(error, "Failed to create a crThread.\n");
+		}
+		
+		uint64_t tileCount = 0;
+		struct message msg;
+		while (receiveMessage(fd, &msg, NULL)) {
+			bool valid = msg.type == msgTile && queueTile(&s, &msg);
+			done = msg.type == msgDone;
+			free(msg.payload);
+			if (done || !valid) break;
+			tileCount++;
+		}
+		if (done) logr(info, "Rendered %"PRIu64" tiles\n", tileCount);
+	}
+	
+	//Lost the master if we didn't get msgDone, so render threads shouldn't bother finishing up
+	if (!done) {
+		logr(warning, "Master sent an invalid message, or disconnected\n");
+		r->state.renderAborted = true;
+	}
+	lockMutex(s.queueMutex);
+	s.closing = true;
+	broadcastCondition(s.queueCond);
+	releaseMutex(s.queueMutex);
+	for (int t = 0; t < s.threadCount; ++t) {
+		threadWait(&s.threads[t]);
+	}
+	
+	free(s.threads);
+	destroyMutex(s.sendMutex);
+	destroyMutex(s.queueMutex);
+	destroyCondition(s.queueCond);
+	destroyRenderer(r);
+	removeAssets(&s);
+}
+
+int startWorker(int port) {
+	//A master that goes away mid-send shouldn't take us down with it
+	signal(SIGPIPE, SIG_IGN);
 	
-	bzero(&server_address, sizeof(server_address));
+	int sockfd = socket(AF_INET, SOCK_STREAM, 0);
+	if (sockfd == -1) {
+		logr(warning, "Socket creation failed.\n");
+		return -1;
+	}
 	
+	struct sockaddr_in server_address = {0};
 	server_address.sin_family = AF_INET;
 	server_address.sin_addr.s_addr = htonl(INADDR_ANY);
-	server_address.sin_port = htons(C_RAY_PORT);
+	server_address.sin_port = htons(port);
 	
 	int opt_val = 1;
 	setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &opt_val, sizeof(opt_val));
 	
 	if ((bind(sockfd, (struct sockaddr*)&server_address, sizeof(server_address))) != 0) {
-		logr(error, "Failed to bind to socket\n");
+		logr(warning, "Failed to bind to port %i\n", port);
+		close(sockfd);
+		return -1;
 	}
 	
-	if (listen(sockfd, 5) != 0) {
-		logr(error, "It wouldn't listen\n");
+	if (listen(sockfd, 1) != 0) {
+		logr(warning, "It wouldn't listen\n");
+		close(sockfd);
+		return -1;
 	}
-	logr(debug, "Listening on port %i\n", C_RAY_PORT);
 	
-	len = sizeof(client_address);
-	char *buf = calloc(MAXRCVLEN, sizeof(*buf));
+	while (true) {
+		logr(info, "Worker listening on port %i\n", port);
+		struct sockaddr_in client_address;
+		socklen_t len = sizeof(client_address);
+		int connfd = accept(sockfd, (struct sockaddr*)&client_address, &len);
+		if (connfd < 0) {
+			logr(warning, "Failed to accept\n");
+			continue;
+		}
+		logr(info, "Got connection from %s\n", inet_ntoa(client_address.sin_addr));
+		setNoDelay(connfd);
+		serveMaster(connfd);
+		close(connfd);
+	}
 	
-	bool active = true;
+	close(sockfd);
+	return 0;
+}
+
+/*
+ Master
+ */
+
+struct remoteSession {
+	struct remoteNode *nodes;
+	int nodeCount;
+	char *sceneJson; //With the effective render settings
+	char **assets; //Relative to assetPath
+	int assetCount;
+};
+
+struct remoteNode {
+	struct crThread thread;
+	struct remoteSession *session;
+	struct renderer *renderer;
+	struct texture *output;
+	char *host;
+	char *port;
+	int fd;
+	int inFlight[MAX_REMOTE_TILES];
+	int inFlightCount;
+	int maxInFlight;
+	uint64_t tilesRendered;
+};
+
+static void setNumber(cJSON *object, const char *key, double value) {
+	if (cJSON_GetObjectItem(object, key)) {
+		cJSON_ReplaceItemInObject(object, key, cJSON_CreateNumber(value));
+	} else {
+		cJSON_AddNumberToObject(object, key, value);
+	}
+}
+
+//Command line overrides only apply here on the master, so workers get the effective settings in the JSON.
+static char *workerScene(struct renderer *r) {
+	cJSON *json = cJSON_Parse(r->state.sceneJson);
+	if (!json) return NULL;
+	cJSON *prefs = cJSON_GetObjectItem(json, "renderer");
+	if (!prefs) {
+		prefs = cJSON_CreateObject();
+		cJSON_AddItemToObject(json, "renderer", prefs);
+	}
+	setNumber(prefs, "width", r->prefs.imageWidth);
+	setNumber(prefs, "height", r->prefs.imageHeight);
+	setNumber(prefs, "samples", r->prefs.sampleCount);
+	setNumber(prefs, "bounces", r->prefs.bounces);
+	//Workers pick their own thread count
+	setNumber(prefs, "threads", 0);
+	char *scene = cJSON_PrintUnformatted(json);
+	cJSON_Delete(json);
+	return scene;
+}
+
+static void addAsset(struct remoteSession *s, const char *path) {
+	//getFilePath() gives "./" for files in the scene directory, and the loaders don't care
+	while (strncmp(path, "./", 2) == 0) path += 2;
+	for (int i = 0; i < s->assetCount; ++i) {
+		if (stringEquals(s->assets[i], path)) return;
+	}
+	s->assets = realloc(s->assets, (s->assetCount + 1) * sizeof(*s->assets));
+	s->assets[s->assetCount++] = copyString(path);
+}
+
+static void collectSceneAssets(struct remoteSession *s, const cJSON *item) {
+	for (; item; item = item->next) {
+		if (cJSON_IsString(item) && item->string && (stringEquals(item->string, "fileName") || stringEquals(item->string, "hdr"))) {
+			addAsset(s, item->valuestring);
+		}
+		collectSceneAssets(s, item->child);
+	}
+}
+
+static bool hasExtension(const char *path, const char *extension) {
+	size_t pathLength = strlen(path);
+	size_t extLength = strlen(extension);
+	return pathLength > extLength && strcasecmp(path + pathLength - extLength, extension) == 0;
+}
+
+//.crmesh files carry their own material table. Textures in it are relative to assetPath, like in MTL files.
+static void collectMeshAssets(struct remoteSession *s, const char *assetPath, const char *relPath) {
+	char *fullPath = concatString(assetPath, relPath);
+	struct meshFile *mesh = loadCrMesh(fullPath);
+	free(fullPath);
+	if (!mesh) return;
+	for (int i = 0; i < mesh->materialCount; ++i) {
+		const struct material *m = &mesh->materials[i];
+		const char *paths[] = {m->textureFilePath, m->normalMapPath, m->specularMapPath};
+		for (int p = 0; p < 3; ++p) {
+			if (paths[p] && paths[p][0]) addAsset(s, paths[p]);
+		}
+		destroyMaterial(&mesh->materials[i]);
+	}
+	destroyMeshFile(mesh);
+}
+
+//OBJ files reference their materials relative to themselves, and materials reference textures relative to assetPath
+static void collectFileAssets(struct remoteSession *s, const char *assetPath, const char *relPath) {
+	if (hasExtension(relPath, ".crmesh")) {
+		collectMeshAssets(s, assetPath, relPath);
+		return;
+	}
+	bool isObj = hasExtension(relPath, ".obj");
+	if (!isObj && !hasExtension(relPath, ".mtl")) return;
+	char *fullPath = concatString(assetPath, relPath);
+	char *data = loadFile(fullPath, NULL);
+	free(fullPath);
+	if (!data) return;
+	char *dir = getFilePath(relPath);
+	char *save = NULL;
+	for (char *line = strtok_r(data, "\r\n", &save); line; line = strtok_r(NULL, "\r\n", &save)) {
+		char token[64];
+		char name[1024];
+		if (sscanf(line, " %63s %1023s", token, name) != 2) continue;
+		if (isObj && stringEquals(token, "mtllib")) {
+			char *mtlPath = concatString(dir, name);
+			addAsset(s, mtlPath);
+			free(mtlPath);
+		} else if (!isObj && (stringEquals(token, "map_Kd") || stringEquals(token, "norm") || stringEquals(token, "map_Ns"))) {
+			addAsset(s, name);
+		}
+	}
+	free(dir);
+	free(data);
+}
+
+static void collectAssets(struct remoteSession *s, struct renderer *r) {
+	cJSON *json = cJSON_Parse(r->state.sceneJson);
+	collectSceneAssets(s, json);
+	cJSON_Delete(json);
+	//Materials and textures get appended as we go
+	for (int i = 0; i < s->assetCount; ++i) {
+		collectFileAssets(s, r->prefs.assetPath, s->assets[i]);
+	}
+	//Drop what we can't or don't need to send
+	int kept = 0;
+	for (int i = 0; i < s->assetCount; ++i) {
+		char *fullPath = concatString(r->prefs.assetPath, s->assets[i]);
+		bool valid = isValidFile(fullPath);
+		free(fullPath);
+		if (valid && !isSafeAssetPath(s->assets[i])) {
+			logr(warning, "Asset %s is outside the scene directory, workers won't have it\n", s->assets[i]);
+			valid = false;
+		}
+		if (valid) {
+			s->assets[kept++] = s->assets[i];
+		} else {
+			free(s->assets[i]);
+		}
+	}
+	s->assetCount = kept;
+}
+
+static bool sendAsset(struct remoteNode *node, const char *relPath) {
+	char *fullPath = concatString(node->renderer->prefs.assetPath, relPath);
+	size_t bytes = 0;
+	char *data = loadFile(fullPath, &bytes);
+	free(fullPath);
+	if (!data) return false;
+	size_t pathLength = strlen(relPath);
+	size_t length = sizeof(uint32_t) + pathLength + bytes;
+	if (length > MAX_MESSAGE_BYTES) {
+		logr(warning, "Asset %s is too large to send to workers\n", relPath);
+		free(data);
+		return false;
+	}
+	unsigned char *payload = malloc(length);
+	unsigned char *cursor = payload;
+	putU32(&cursor, (uint32_t)pathLength);
+	memcpy(cursor, relPath, pathLength);
+	memcpy(cursor + pathLength, data, bytes);
+	free(data);
+	bool sent = sendMessage(node->fd, msgAsset, payload, length);
+	free(payload);
+	return sent;
+}
+
+static bool sendTile(struct remoteNode *node, const struct renderTile *tile) {
+	unsigned char payload[6 * sizeof(uint32_t)];
+	unsigned char *cursor = payload;
+	putU32(&cursor, tile->tileNum);
+	putU32(&cursor, tile->begin.x);
+	putU32(&cursor, tile->begin.y);
+	putU32(&cursor, tile->end.x);
+	putU32(&cursor, tile->end.y);
+	putU32(&cursor, tile->startSample);
+	return sendMessage(node->fd, msgTile, payload, sizeof(payload));
+}
+
+//The worker sends the average of samples [startSample, sampleCount] scaled by (samples it rendered) / sampleCount,
+//so we just add on the samples we had before the tile was split off.
+static bool mergeResult(struct remoteNode *node, const struct message *msg) {
+	struct renderer *r = node->renderer;
+	if (msg->length < sizeof(uint32_t)) return false;
+	const unsigned char *cursor = msg->payload;
+	int tileNum = getU32(&cursor);
+	int slot = -1;
+	for (int i = 0; i < node->inFlightCount; ++i) {
+		if (node->inFlight[i] == tileNum) slot = i;
+	}
+	if (slot == -1) return false;
+	//Remote tiles never get split, so this is stable while in flight
+	struct renderTile tile = r->state.renderTiles[tileNum];
+	if (msg->length != sizeof(uint32_t) + tile.width * tile.height * 3 * sizeof(uint32_t)) return false;
 	
-	while (active) {
-		connfd = accept(sockfd, (struct sockaddr*)&client_address, &len);
-		if (connfd < 0) {
-			logr(error, "Failed to accept\n");
+	float prior = (float)(tile.startSample - 1) / (float)r->prefs.sampleCount;
+	for (int y = tile.begin.y; y < tile.end.y; ++y) {
+		for (int x = tile.begin.x; x < tile.end.x; ++x) {
+			struct color remote = {0.0f, 0.0f, 0.0f, 0.0f};
+			remote.red = getFloat(&cursor);
+			remote.green = getFloat(&cursor);
+			remote.blue = getFloat(&cursor);
+			struct color output = addColors(colorCoef(prior, textureGetPixel(r->state.renderBuffer, x, y)), remote);
+			setPixel(r->state.renderBuffer, output, x, y);
+			setPixelSRGB(node->output, output, x, y);
 		}
-		logr(debug, "Got connection from %s\n", inet_ntoa(client_address.sin_addr));
+	}
+	node->inFlight[slot] = node->inFlight[--node->inFlightCount];
+	node->tilesRendered++;
+	finishTile(r, tileNum);
+	return true;
+}
+
+static int connectToNode(const char *host, const char *port) {
+	struct addrinfo hints = {0};
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	struct addrinfo *result = NULL;
+	if (getaddrinfo(host, port, &hints, &result)) return -1;
+	int fd = -1;
+	for (struct addrinfo *addr = result; addr; addr = addr->ai_next) {
+		fd = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+		if (fd == -1) continue;
+		if (connect(fd, addr->ai_addr, addr->ai_addrlen) == 0) break;
+		close(fd);
+		fd = -1;
+	}
+	freeaddrinfo(result);
+	if (fd == -1) return -1;
+	setNoDelay(fd);
+	struct timeval timeout = {.tv_sec = 0, .tv_usec = ABORT_POLL_MSEC * 1000};
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	//Dead hosts and broken links make recv() fail, which requeues the tiles the worker had
+	int opt_val = 1;
+	setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &opt_val, sizeof(opt_val));
+#ifdef TCP_KEEPIDLE
+	opt_val = KEEPALIVE_IDLE_SEC;
+	setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE, &opt_val, sizeof(opt_val));
+#elif defined(TCP_KEEPALIVE)
+	opt_val = KEEPALIVE_IDLE_SEC;
+	setsockopt(fd, IPPROTO_TCP, TCP_KEEPALIVE, &opt_val, sizeof(opt_val));
+#endif
+#ifdef TCP_KEEPINTVL
+	opt_val = KEEPALIVE_INTERVAL_SEC;
+	setsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, &opt_val, sizeof(opt_val));
+#endif
+#ifdef TCP_KEEPCNT
+	opt_val = KEEPALIVE_PROBES;
+	setsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT, &opt_val, sizeof(opt_val));
+#endif
+	return fd;
+}
+
+static bool startSession(struct remoteNode *node) {
+	struct renderer *r = node->renderer;
+	for (int i = 0; i < node->session->assetCount; ++i) {
+		if (!sendAsset(node, node->session->assets[i])) return false;
+	}
+	const char *scene = node->session->sceneJson;
+	if (!sendMessage(node->fd, msgScene, scene, strlen(scene))) return false;
+	
+	struct message msg;
+	if (!receiveMessage(node->fd, &msg, &r->state.renderAborted)) return false;
+	bool ready = msg.type == msgReady && msg.length == sizeof(uint32_t);
+	if (ready) {
+		const unsigned char *cursor = msg.payload;
+		int threads = getU32(&cursor);
+		//Keep one extra tile queued up, so the worker doesn't idle while we send the next one
+		node->maxInFlight = threads + 1 > MAX_REMOTE_TILES ? MAX_REMOTE_TILES : threads + 1;
+		logr(info, "Worker %s:%s ready with %i threads\n", node->host, node->port, threads);
+	} else if (msg.type == msgError) {
+		logr(warning, "Worker %s:%s failed: %s\n", node->host, node->port, msg.payload);
+	}
+	free(msg.payload);
+	return ready;
+}
+
+static void *remoteThread(void *arg) {
+	struct remoteNode *node = threadUserData(arg);
+	struct renderer *r = node->renderer;
+	
+	node->fd = connectToNode(node->host, node->port);
+	if (node->fd == -1) {
+		logr(warning, "Failed to connect to worker %s:%s\n", node->host, node->port);
+		goto exit;
+	}
+	if (!startSession(node)) goto fail;
+	
+	while (!r->state.renderAborted) {
+		//Keep the worker fed. Only wait on the queue when we have nothing out, since tiles we hold
+		//keep the other threads waiting for splits.
+		while (node->inFlightCount < node->maxInFlight) {
+			struct renderTile tile = node->inFlightCount ? tryNextTile(r) : nextTile(r);
+			if (tile.tileNum == -1) break;
+			node->inFlight[node->inFlightCount++] = tile.tileNum;
+			if (!sendTile(node, &tile)) goto fail;
+		}
+		if (!node->inFlightCount) break; //Render done
 		
-		while (active) {
-			size_t read = recv(connfd, buf, MAXRCVLEN, 0);
-			if (!read) break;
-			
-			char *dst = calloc(read, sizeof(*dst));
-			memcpy(dst, buf, read);
-			logr(debug, "Got from client: %s\n", dst);
-			if (strncmp(dst, "exit", 4) == 0) {
-				active = false;
-			}
-			free(dst);
-			
-			size_t err = send(connfd, buf, read, 0);
-			if (err) logr(error, "send() failed\n");
-			close(connfd);
-			break;
+		struct message msg;
+		if (!receiveMessage(node->fd, &msg, &r->state.renderAborted)) goto fail;
+		bool merged = msg.type == msgResult && mergeResult(node, &msg);
+		if (msg.type == msgError) logr(warning, "Worker %s:%s failed: %s\n", node->host, node->port, msg.payload);
+		free(msg.payload);
+		if (!merged) goto fail;
+	}
+	//Workers notice an abort when we hang up on them
+	if (r->state.renderAborted) goto exit;
+	sendMessage(node->fd, msgDone, NULL, 0);
+	logr(debug, "Worker %s:%s rendered %"PRIu64" tiles\n", node->host, node->port, node->tilesRendered);
+	goto exit;
+
+fail:
+	if (!r->state.renderAborted) {
+		logr(warning, "Lost worker %s:%s, queueing its %i tiles again\n", node->host, node->port, node->inFlightCount);
+		for (int i = 0; i < node->inFlightCount; ++i) {
+			if (!requeueTile(r, node->inFlight[i])) logr(warning, "No room to queue tile %i again\n", node->inFlight[i]);
 		}
+		node->inFlightCount = 0;
 	}
+exit:
+	if (node->fd != -1) close(node->fd);
+	lockMutex(r->state.tileMutex);
+	r->state.activeThreads--;
+	signalCondition(r->state.mainCond);
+	releaseMutex(r->state.tileMutex);
+	return 0;
+}
+
+static void parseNodes(struct remoteSession *s) {
+	char *list = copyString(stringPref("nodes"));
+	char *save = NULL;
+	for (char *entry = strtok_r(list, ",", &save); entry; entry = strtok_r(NULL, ",", &save)) {
+		s->nodes = realloc(s->nodes, (s->nodeCount + 1) * sizeof(*s->nodes));
+		struct remoteNode *node = &s->nodes[s->nodeCount++];
+		memset(node, 0, sizeof(*node));
+		char *port = strrchr(entry, ':');
+		if (port) *port++ = '\0';
+		node->host = copyString(entry);
+		if (port) {
+			node->port = copyString(port);
+		} else {
+			node->port = calloc(8, sizeof(*node->port));
+			snprintf(node->port, 8, "%i", C_RAY_PORT);
+		}
+		node->fd = -1;
+	}
+	free(list);
+}
+
+int startRemoteThreads(struct renderer *r, struct texture *output) {
+	if (!isSet("nodes") || !r->state.sceneJson) return 0;
+	if (r->scene->animation) {
+		//Workers only know the scene as it was loaded
+		logr(warning, "Animations are rendered locally, ignoring --nodes\n");
+		return 0;
+	}
+	if (r->state.albedoBuffer) {
+		//Workers only send back the color, not the feature buffers
+		logr(warning, "Denoising needs feature buffers workers don't send, ignoring --nodes\n");
+		return 0;
+	}
+	signal(SIGPIPE, SIG_IGN);
 	
-	close(sockfd);
+	struct remoteSession *s = calloc(1, sizeof(*s));
+	parseNodes(s);
+	s->sceneJson = workerScene(r);
+	collectAssets(s, r);
+	logr(info, "Sending %i assets to %i worker%s\n", s->assetCount, s->nodeCount, s->nodeCount == 1 ? "" : "s");
+	
+	//Reserve room for requeuing tiles in flight on a worker that drops out
+	lockMutex(r->state.tileMutex);
+	r->state.tileCapacity += s->nodeCount * MAX_REMOTE_TILES;
+	r->state.requeueReserve += s->nodeCount * MAX_REMOTE_TILES;
+	r->state.renderTiles = realloc(r->state.renderTiles, r->state.tileCapacity * sizeof(*r->state.renderTiles));
+	releaseMutex(r->state.tileMutex);
+	
+	int started = 0;
+	for (int i = 0; i < s->nodeCount; ++i) {
+		struct remoteNode *node = &s->nodes[i];
+		node->session = s;
+		node->renderer = r;
+		node->output = output;
+		node->thread = (struct crThread){.threadFunc = remoteThread, .userData = node};
+		lockMutex(r->state.tileMutex);
+		r->state.activeThreads++;
+		releaseMutex(r->state.tileMutex);
+		if (threadStart(&node->thread)) {
+			logr(warning, "Failed to create a crThread.\n");
+			lockMutex(r->state.tileMutex);
+			r->state.activeThreads--;
+			releaseMutex(r->state.tileMutex);
+			node->host[0] = '\0'; //Not started, skip when joining
+		} else {
+			started++;
+		}
+	}
+	r->state.remote = s;
+	return started;
+}
+
+void joinRemoteThreads(struct renderer *r) {
+	struct remoteSession *s = r->state.remote;
+	if (!s) return;
+	for (int i = 0; i < s->nodeCount; ++i) {
+		if (s->nodes[i].host[0]) threadWait(&s->nodes[i].thread);
+		free(s->nodes[i].host);
+		free(s->nodes[i].port);
+	}
+	for (int i = 0; i < s->assetCount; ++i) {
+		free(s->assets[i]);
+	}
+	free(s->assets);
+	free(s->sceneJson);
+	free(s->nodes);
+	free(s);
+	r->state.remote = NULL;
+}
+
+#ifdef CRAY_TESTING
+// Not in networking.h. Lets tests feed forged messages to receiveMessage() over a socket pair.
+bool testReceiveMessage(int fd, uint32_t *type, uint32_t *length) {
+	struct message msg;
+	if (!receiveMessage(fd, &msg, NULL)) return false;
+	*type = msg.type;
+	*length = msg.length;
+	free(msg.payload);
+	return true;
+}
+
+// Not in networking.h. Waits on a socket with a receive timeout like the master does, but gives up after timeoutSec.
+bool testReceiveMessageTimeout(int fd, int timeoutSec) {
+	struct timeval timeout = {.tv_sec = 0, .tv_usec = ABORT_POLL_MSEC * 1000};
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	const bool aborted = false;
+	workerTimeoutSec = timeoutSec;
+	struct message msg;
+	const bool received = receiveMessage(fd, &msg, &aborted);
+	workerTimeoutSec = WORKER_TIMEOUT_SEC;
+	if (received) free(msg.payload);
+	return received;
+}
+#endif
+
+#else
+
+#include "logging.h"
+#include "args.h"
+
+int startWorker(int port) {
+	(void)port;
+	logr(warning, "Networking is not supported on Windows\n");
+	return -1;
+}
+
+int startRemoteThreads(struct renderer *r, struct texture *output) {
+	(void)r;
+	(void)output;
+	if (isSet("nodes")) logr(warning, "Networking is not supported on Windows, rendering locally\n");
 	return 0;
 }
 
+void joinRemoteThreads(struct renderer *r) {
+	(void)r;
+}
+
 #endif
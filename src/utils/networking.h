@@ -8,4 +8,29 @@
 
 #pragma once
 
-int start_interactive(void);
+//Default port render workers listen on
+#define C_RAY_PORT 2222
+
+//Upper limit for tiles a single worker has in flight at once.
+//Tiles of a worker that drops out are queued again, so room for these is reserved in tileCapacity and requeueReserve.
+#define MAX_REMOTE_TILES 64
+
+struct renderer;
+struct texture;
+
+/// Run as a render worker. Waits for a master to connect, receives the scene and its assets,
+/// and renders the tiles the master sends until it is done. Then waits for the next master.
+/// @param port TCP port to listen on
+/// @return Non-zero if the worker couldn't start listening
+int startWorker(int port);
+
+/// Connect to the render workers given with --nodes, and start a render thread for each of them.
+/// @remarks Call before starting local render threads, this reserves room for requeued tiles.
+/// @param r Renderer with a loaded scene
+/// @param output Image to merge finished tiles into
+/// @return Amount of remote render threads started. These count towards activeThreads.
+int startRemoteThreads(struct renderer *r, struct texture *output);
+
+/// Block until all remote render threads have exited, and free them.
+/// @param r Renderer
+void joinRemoteThreads(struct renderer *r);
@@ -0,0 +1,57 @@
+//
+//  atomic.h
+//  C-ray
+//
+//  Created by Valtteri on 18.10.2020.
+//  Copyright © 2020 Valtteri Koskivuori. All rights reserved.
+//
+
+#pragma once
+
+//Platform-agnostic loads and stores for data that is read without holding a lock.
+//Writers still need a crMutex between them, these only order the reads against them.
+
+#ifdef WINDOWS
+//MSVC gives volatile accesses acquire and release semantics on x86 and x64
+#include <intrin.h>
+
+static inline void *atomicLoadPointer(void *const *p) {
+	void *value = *(void *volatile const *)p;
+	_ReadWriteBarrier();
+	return value;
+}
+
+static inline void atomicStorePointer(void **p, void *value) {
+	_ReadWriteBarrier();
+	*(void *volatile *)p = value;
+}
+
+static inline unsigned atomicLoadRelaxed(const unsigned *p) {
+	return *(volatile const unsigned *)p;
+}
+
+static inline void atomicStoreRelaxed(unsigned *p, unsigned value) {
+	*(volatile unsigned *)p = value;
+}
+#else
+
+/// Load a pointer published with atomicStorePointer(). Everything written before
+/// the store is visible to the caller after this returns it.
+static inline void *atomicLoadPointer(void *const *p) {
+	return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+/// Publish a pointer to readers using atomicLoadPointer()
+static inline void atomicStorePointer(void **p, void *value) {
+	__atomic_store_n(p, value, __ATOMIC_RELEASE);
+}
+
+/// Unordered load, for counters and timestamps that tolerate stale values
+static inline unsigned atomicLoadRelaxed(const unsigned *p) {
+	return __atomic_load_n(p, __ATOMIC_RELAXED);
+}
+
+static inline void atomicStoreRelaxed(unsigned *p, unsigned value) {
+	__atomic_store_n(p, value, __ATOMIC_RELAXED);
+}
+#endif
@@ -11,10 +11,13 @@
 #ifdef __APPLE__
 #include <sys/param.h>
 #include <sys/sysctl.h>
+#include <sys/resource.h>
 #elif _WIN32
 #include <windows.h>
+#include <psapi.h>
 #elif __linux__
 #include <unistd.h>
+#include <sys/resource.h>
 #endif
 
 int getSysCores() {
@@ -44,3 +47,21 @@ int getSysCores() {
 	return 1;
 #endif
 }
+
+size_t getPeakMemoryUsage() {
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+	return counters.PeakWorkingSetSize;
+#elif defined(__APPLE__) || defined(__linux__)
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage)) return 0;
+#ifdef __APPLE__
+	return (size_t)usage.ru_maxrss; //Bytes on macOS
+#else
+	return (size_t)usage.ru_maxrss * 1024; //Kilobytes on Linux
+#endif
+#else
+	return 0;
+#endif
+}
@@ -6,6 +6,7 @@
 //  Copyright © 2020 Valtteri Koskivuori. All rights reserved.
 //
 
+#include <stdbool.h>
 #include "mutex.h"
 #include <stdlib.h>
 
@@ -13,20 +14,30 @@
 #include <Windows.h>
 #else
 #include <pthread.h>
+#include <sys/time.h>
+#include <errno.h>
 #endif
 
 struct crMutex {
 	#ifdef WINDOWS
-		HANDLE tileMutex; // = INVALID_HANDLE_VALUE;
+		CRITICAL_SECTION tileMutex; // Condition variables on Windows require a critical section
 	#else
 		pthread_mutex_t tileMutex; // = PTHREAD_MUTEX_INITIALIZER;
 	#endif
 };
 
+struct crCondition {
+	#ifdef WINDOWS
+		CONDITION_VARIABLE cond;
+	#else
+		pthread_cond_t cond;
+	#endif
+};
+
 struct crMutex *createMutex() {
 	struct crMutex *new = calloc(1, sizeof(*new));
 #ifdef WINDOWS
-	new->tileMutex = CreateMutex(NULL, FALSE, NULL);
+	InitializeCriticalSection(&new->tileMutex);
 #else
 	new->tileMutex = (pthread_mutex_t)PTHREAD_MUTEX_INITIALIZER;
 #endif
@@ -35,7 +46,7 @@ struct crMutex *createMutex() {
 
 void lockMutex(struct crMutex *m) {
 #ifdef WINDOWS
-	WaitForSingleObject(m->tileMutex, INFINITE);
+	EnterCriticalSection(&m->tileMutex);
 #else
 	pthread_mutex_lock(&m->tileMutex);
 #endif
@@ -43,8 +54,77 @@ void lockMutex(struct crMutex *m) {
 
 void releaseMutex(struct crMutex *m) {
 #ifdef WINDOWS
-	ReleaseMutex(m->tileMutex);
+	LeaveCriticalSection(&m->tileMutex);
 #else
 	pthread_mutex_unlock(&m->tileMutex);
 #endif
 }
+
+void destroyMutex(struct crMutex *m) {
+	if (m) {
+#ifdef WINDOWS
+		DeleteCriticalSection(&m->tileMutex);
+#else
+		pthread_mutex_destroy(&m->tileMutex);
+#endif
+		free(m);
+	}
+}
+
+struct crCondition *createCondition() {
+	struct crCondition *new = calloc(1, sizeof(*new));
+#ifdef WINDOWS
+	InitializeConditionVariable(&new->cond);
+#else
+	new->cond = (pthread_cond_t)PTHREAD_COND_INITIALIZER;
+#endif
+	return new;
+}
+
+void waitCondition(struct crCondition *c, struct crMutex *m) {
+#ifdef WINDOWS
+	SleepConditionVariableCS(&c->cond, &m->tileMutex, INFINITE);
+#else
+	pthread_cond_wait(&c->cond, &m->tileMutex);
+#endif
+}
+
+bool timedWaitCondition(struct crCondition *c, struct crMutex *m, int ms) {
+#ifdef WINDOWS
+	return SleepConditionVariableCS(&c->cond, &m->tileMutex, ms);
+#else
+	struct timeval now;
+	gettimeofday(&now, NULL);
+	long nsec = now.tv_usec * 1000L + (ms % 1000) * 1000000L;
+	struct timespec deadline = {
+		.tv_sec = now.tv_sec + ms / 1000 + nsec / 1000000000L,
+		.tv_nsec = nsec % 1000000000L
+	};
+	return pthread_cond_timedwait(&c->cond, &m->tileMutex, &deadline) != ETIMEDOUT;
+#endif
+}
+
+void signalCondition(struct crCondition *c) {
+#ifdef WINDOWS
+	WakeConditionVariable(&c->cond);
+#else
+	pthread_cond_signal(&c->cond);
+#endif
+}
+
+void broadcastCondition(struct crCondition *c) {
+#ifdef WINDOWS
+	WakeAllConditionVariable(&c->cond);
+#else
+	pthread_cond_broadcast(&c->cond);
+#endif
+}
+
+void destroyCondition(struct crCondition *c) {
+	if (c) {
+#ifndef WINDOWS
+		pthread_cond_destroy(&c->cond);
+#endif
+		free(c);
+	}
+}
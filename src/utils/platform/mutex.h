@@ -17,3 +17,30 @@ struct crMutex *createMutex(void);
 void lockMutex(struct crMutex *m);
 
 void releaseMutex(struct crMutex *m);
+
+void destroyMutex(struct crMutex *m);
+
+//Platform-agnostic condition variables, always used together with a crMutex
+
+struct crCondition;
+
+struct crCondition *createCondition(void);
+
+/// Atomically release the mutex and block until the condition is signaled.
+/// @remarks The mutex must be locked by the caller, and is locked again on return.
+/// Spurious wakeups are possible, so check your predicate in a loop.
+/// @param c Condition to wait on
+/// @param m Mutex protecting the predicate
+void waitCondition(struct crCondition *c, struct crMutex *m);
+
+/// Like waitCondition(), but gives up after the given amount of milliseconds
+/// @return true if woken up before the timeout
+bool timedWaitCondition(struct crCondition *c, struct crMutex *m, int ms);
+
+/// Wake up one thread waiting on the given condition
+void signalCondition(struct crCondition *c);
+
+/// Wake up all threads waiting on the given condition
+void broadcastCondition(struct crCondition *c);
+
+void destroyCondition(struct crCondition *c);
@@ -35,7 +35,7 @@ static void showCursor(bool show) {
 
 static void handler(int sig) {
 	if (sig == 2) { //SIGINT
-		printf("\n");
+		fprintf(logStream(), "\n");
 		logr(info, "Aborting initialization.\n");
 		restoreTerminal();
 		exit(0);
@@ -9,6 +9,14 @@
 #pragma once
 
 //Multi-platform threading
+
+/// Storage class for variables that have a separate instance in each thread
+#ifdef WINDOWS
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
 /**
  Thread information struct to communicate with main thread
  */
@@ -13,30 +13,6 @@
 #include <string.h>
 #include <stdlib.h>
 
-struct stats {
-	bool enabled;
-	//Memory
-	unsigned long kd_tree_bytes;
-	unsigned long image_buffer_bytes;
-	unsigned long mesh_bytes;
-	
-	unsigned long raw_bytes_allocated;
-	unsigned long raw_bytes_freed;
-	
-	//Scene
-	unsigned long lights;
-	unsigned long materials;
-	unsigned long meshes;
-	unsigned long spheres;
-	
-	//Counters
-	unsigned long paths;
-	unsigned long path_lengths; //div by paths to get avg path length
-	
-	unsigned long calls_to_allocate;
-	unsigned long calls_to_free;
-};
-
 void clear_stats(struct stats *s) {
 	memset(s, 0, sizeof(*s));
 }
@@ -49,91 +25,42 @@ bool stats_enabled(struct stats *s) {
 	return s->enabled;
 }
 
-void increment(struct stats *s, enum counter c, unsigned long amount) {
+void increment(struct stats *s, enum counter c, uint64_t amount) {
 	if (!s->enabled) return;
-	
-	switch (c) {
-		case kd_tree_bytes:
-			s->kd_tree_bytes += amount;
-			break;
-		case image_buffer_bytes:
-			s->image_buffer_bytes += amount;
-			break;
-		case mesh_bytes:
-			s->mesh_bytes += amount;
-			break;
-		case raw_bytes_allocated:
-			s->raw_bytes_allocated += amount;
-			break;
-		case raw_bytes_freed:
-			s->raw_bytes_freed += amount;
-			break;
-		case lights:
-			s->lights += amount;
-			break;
-		case materials:
-			s->materials += amount;
-			break;
-		case meshes:
-			s->meshes += amount;
-			break;
-		case spheres:
-			s->spheres += amount;
-			break;
-		case paths:
-			s->paths += amount;
-			break;
-		case path_lengths:
-			s->path_lengths += amount;
-			break;
-		case calls_to_allocate:
-			s->calls_to_allocate += amount;
-			break;
-		case calls_to_free:
-			s->calls_to_free += amount;
-			break;
-		default:
-			ASSERT_NOT_REACHED();
-			break;
+	ASSERT(c != avg_path_length && c < counter_count);
+	s->counters[c] += amount;
+}
+
+uint64_t get_value(struct stats *s, enum counter c) {
+	ASSERT(c < counter_count);
+	if (c == avg_path_length) {
+		return s->counters[paths] ? s->counters[path_lengths] / s->counters[paths] : 0;
 	}
+	return s->counters[c];
 }
 
-unsigned long get_value(struct stats *s, enum counter c) {
-	switch (c) {
-		case kd_tree_bytes:
-			return s->kd_tree_bytes;
-		case image_buffer_bytes:
-			return s->image_buffer_bytes;
-		case mesh_bytes:
-			return s->mesh_bytes;
-		case raw_bytes_allocated:
-			return s->raw_bytes_allocated;
-		case raw_bytes_freed:
-			return s->raw_bytes_freed;
-		case lights:
-			return s->lights;
-		case materials:
-			return s->materials;
-		case meshes:
-			return s->meshes;
-		case spheres:
-			return s->spheres;
-		case paths:
-			return s->paths;
-		case path_lengths:
-			return s->path_lengths;
-		case avg_path_length:
-			return 0;
-		case calls_to_allocate:
-			return s->calls_to_allocate;
-		case calls_to_free:
-			return s->calls_to_free;
-		default:
-			ASSERT_NOT_REACHED();
-			return 0;
+void merge_stats(struct stats *dst, const struct stats *src) {
+	for (int c = 0; c < counter_count; ++c) {
+		dst->counters[c] += src->counters[c];
 	}
 }
 
-void print_stats() {
-	logr(debug, "TODO");
+static float ratio(uint64_t a, uint64_t b) {
+	return b ? (float)a / (float)b : 0.0f;
+}
+
+void print_stats(struct stats *s) {
+	uint64_t rays = get_value(s, rays_traced);
+	logr(debug, "Render statistics:\n");
+	logr(debug, "Paths:             %llu (avg length %.02f)\n", (unsigned long long)get_value(s, paths), ratio(get_value(s, path_lengths), get_value(s, paths)));
+	logr(debug, "Rays traced:       %llu\n", (unsigned long long)rays);
+	logr(debug, "Shadow rays:       %llu\n", (unsigned long long)get_value(s, shadow_rays));
+	logr(debug, "BVH nodes visited: %llu (%.02f per ray)\n", (unsigned long long)get_value(s, bvh_nodes_visited), ratio(get_value(s, bvh_nodes_visited), rays));
+	logr(debug, "Triangle tests:    %llu (%.02f per ray)\n", (unsigned long long)get_value(s, triangle_tests), ratio(get_value(s, triangle_tests), rays));
+	logr(debug, "Sphere tests:      %llu (%.02f per ray)\n", (unsigned long long)get_value(s, sphere_tests), ratio(get_value(s, sphere_tests), rays));
+	logr(debug, "Bounces:           %llu\n", (unsigned long long)get_value(s, bounces));
+	logr(debug, "Russian roulette:  %llu paths terminated\n", (unsigned long long)get_value(s, rr_kills));
+	logr(debug, "Background hits:   %llu\n", (unsigned long long)get_value(s, background_hits));
+	const uint64_t lookups = get_value(s, texture_hits) + get_value(s, texture_misses);
+	logr(debug, "Texture lookups:   %llu (%.02f%% hits, %llu misses, %llu evictions)\n", (unsigned long long)lookups, 100.0 * ratio(get_value(s, texture_hits), lookups), (unsigned long long)get_value(s, texture_misses), (unsigned long long)get_value(s, texture_evictions));
 }
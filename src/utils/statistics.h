@@ -9,6 +9,7 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdint.h>
 
 enum counter {
 	//Memory
@@ -31,10 +32,30 @@ enum counter {
 	avg_path_length,
 	
 	calls_to_allocate,
-	calls_to_free
+	calls_to_free,
+	
+	//Render counters, always on
+	rays_traced,
+	shadow_rays, //Next-event estimation, also counted in rays_traced
+	bvh_nodes_visited,
+	triangle_tests,
+	sphere_tests,
+	bounces,
+	rr_kills,
+	background_hits,
+	texture_hits, //Mip level lookups that found the level resident
+	texture_misses, //Lookups that had to load the texture from disk
+	texture_evictions,
+	
+	counter_count
 };
 
-struct stats;
+/// A set of counters. Render threads each own one, and increment it without
+/// any synchronization. These are then merged into a total at the end of a frame.
+struct stats {
+	bool enabled;
+	uint64_t counters[counter_count];
+};
 
 void clear_stats(struct stats *s);
 
@@ -43,7 +64,17 @@ void toggle_stats(struct stats *s);
 
 bool stats_enabled(struct stats *s);
 
-void increment(struct stats *s, enum counter c, unsigned long amount);
-unsigned long get_value(struct stats *s, enum counter c);
+void increment(struct stats *s, enum counter c, uint64_t amount);
+uint64_t get_value(struct stats *s, enum counter c);
+
+/// Increment a render counter. Unlike increment(), this ignores the enabled flag
+/// and is inlined, so it's cheap enough for the intersection hot path.
+static inline void stats_add(struct stats *s, enum counter c, uint64_t amount) {
+	s->counters[c] += amount;
+}
+
+/// Add all counters in src to dst
+void merge_stats(struct stats *dst, const struct stats *src);
 
-void print_stats(void);
+/// Print out render counters. Only shown in verbose mode (-v)
+void print_stats(struct stats *s);
@@ -13,11 +13,12 @@
 #include "../utils/assert.h"
 #include "testrunner.h"
 
-// Grab tests
-#include "../../tests/tests.h"
-
 #ifdef CRAY_TESTING
 
+// Grab tests. These reach private functions that are only built for testing.
+#include "../../tests/tests.h"
+#include "../../tests/benchmarks.h"
+
 unsigned totalTests = testCount;
 
 int runTests(void) {
@@ -66,4 +67,66 @@ int getTestCount(void) {
 	return testCount;
 }
 
+#define BENCH_WARMUP_MS 100 //Also used to calibrate the batch size
+#define BENCH_BATCH_MS 10
+#define BENCH_BATCHES 20
+#define BENCH_T_95 2.093 //Two-sided Student's t for 95% confidence with BENCH_BATCHES - 1 degrees of freedom
+
+//Written to, so the benchmarked work can't be optimized out
+static volatile float benchSink;
+
+static long timeBatch(benchmark *b, void *data, uint64_t iterations) {
+	struct timeval timer;
+	startTimer(&timer);
+	benchSink = b->run(data, iterations);
+	return getUs(timer);
+}
+
+int runKernelBenchmark(unsigned b) {
+	b = b < benchmarkCount ? b : benchmarkCount - 1;
+	logr(info, "[%3i/%lu] %-32s ", b + 1, benchmarkCount, benchmarks[b].name);
+	void *data = benchmarks[b].setup ? benchmarks[b].setup() : NULL;
+	
+	//Warm up caches and clocks, and find out how many iterations fit in a batch
+	uint64_t iterations = 1;
+	long elapsed = 0;
+	long warmup = 0;
+	while (warmup < BENCH_WARMUP_MS * 1000) {
+		elapsed = timeBatch(&benchmarks[b], data, iterations);
+		warmup += elapsed;
+		if (elapsed < 1000) iterations *= 2;
+	}
+	iterations = (uint64_t)((double)iterations * (BENCH_BATCH_MS * 1000) / (elapsed > 0 ? elapsed : 1));
+	iterations = iterations > 0 ? iterations : 1;
+	
+	double samples[BENCH_BATCHES];
+	double mean = 0.0;
+	double best = DBL_MAX;
+	for (int i = 0; i < BENCH_BATCHES; ++i) {
+		samples[i] = 1000.0 * timeBatch(&benchmarks[b], data, iterations) / iterations;
+		mean += samples[i];
+		best = samples[i] < best ? samples[i] : best;
+	}
+	mean /= BENCH_BATCHES;
+	double variance = 0.0;
+	for (int i = 0; i < BENCH_BATCHES; ++i) {
+		variance += (samples[i] - mean) * (samples[i] - mean);
+	}
+	variance /= BENCH_BATCHES - 1;
+	double confidence = BENCH_T_95 * sqrt(variance / BENCH_BATCHES);
+	
+	if (benchmarks[b].teardown) benchmarks[b].teardown(data);
+	printf("%9.2f ns/op ± %6.2f (%4.1f%%), best %9.2f ns/op\n", mean, confidence, 100.0 * confidence / mean, best);
+	return 0;
+}
+
+int runKernelBenchmarks(void) {
+	logr(info, "Running %lu kernel benchmark%s, %i batches each with 95%% confidence intervals.\n",
+		 benchmarkCount, benchmarkCount > 1 ? "s" : "", BENCH_BATCHES);
+	for (unsigned b = 0; b < benchmarkCount; ++b) {
+		runKernelBenchmark(b);
+	}
+	return 0;
+}
+
 #endif
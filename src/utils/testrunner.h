@@ -16,4 +16,8 @@
 int runTests(void);
 int runTest(unsigned);
 int getTestCount(void);
+
+/// Run kernel micro-benchmarks, and print ns/op for each
+int runKernelBenchmarks(void);
+int runKernelBenchmark(unsigned);
 #endif
@@ -45,7 +45,7 @@ static struct display *gdisplay = NULL;
 //Take a look at the docs for sigaction() and implement that.
 void sigHandler(int sig) {
 	if (sig == 2) { //SIGINT
-		printf("\n");
+		fprintf(logStream(), "\n");
 		logr(info, "Received ^C, aborting render without saving\n");
 		aborted = true;
 	}
@@ -174,10 +174,14 @@ void destroyDisplay() {
 #endif
 }
 
+bool isDisplayActive() {
+	return gdisplay != NULL;
+}
+
 void printDuration(uint64_t ms) {
 	logr(info, "Finished render in ");
 	printSmartTime(ms);
-	printf("                     \n");
+	fprintf(logStream(), "                     \n");
 }
 
 void getKeyboardInput(struct renderer *r) {
@@ -198,21 +202,19 @@ void getKeyboardInput(struct renderer *r) {
 	while (SDL_PollEvent(&event)) {
 		if (event.type == SDL_KEYDOWN && event.key.repeat == 0) {
 			if (event.key.keysym.sym == SDLK_s) {
-				printf("\n");
+				fprintf(logStream(), "\n");
 				logr(info, "Aborting render, saving\n");
 				r->state.renderAborted = true;
 				r->state.saveImage = true;
 			}
 			if (event.key.keysym.sym == SDLK_x) {
-				printf("\n");
+				fprintf(logStream(), "\n");
 				logr(info, "Aborting render without saving\n");
 				r->state.renderAborted = true;
 				r->state.saveImage = false;
 			}
 			if (event.key.keysym.sym == SDLK_p) {
-				for (int i = 0; i < r->prefs.threadCount; ++i) {
-					r->state.threadStates[i].paused = !r->state.threadStates[i].paused;
-				}
+				togglePause(r);
 			}
 		}
 	}
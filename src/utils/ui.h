@@ -18,6 +18,9 @@ struct texture;
 void initDisplay(bool fullscreen, bool borderless, int width, int height, float scale);
 void destroyDisplay(void);
 
+/// Check if a preview window is open and needs updating
+bool isDisplayActive(void);
+
 void printDuration(uint64_t ms);
 void getKeyboardInput(struct renderer *r);
 void drawWindow(struct renderer *r, struct texture *t);
@@ -0,0 +1,43 @@
+//
+//  bench_camera.h
+//  C-ray
+//
+//  Created by Valtteri on 18.10.2020.
+//  Copyright © 2020 Valtteri Koskivuori. All rights reserved.
+//
+
+#include "../src/datatypes/camera.h"
+#include "../src/renderer/samplers/sampler.h"
+
+#define CAMERA_BENCH_WIDTH 64
+
+struct cameraBench {
+	struct camera *cam;
+	sampler *sampler;
+};
+
+void *camera_setup(void) {
+	struct cameraBench *data = calloc(1, sizeof(*data));
+	data->cam = newCamera(CAMERA_BENCH_WIDTH, CAMERA_BENCH_WIDTH, 80.0f, 2.0f, 1.4f, newTransformRotateY(toRadians(30.0f)));
+	data->sampler = newSampler();
+	return data;
+}
+
+//One operation is one depth of field camera ray, including initializing the sampler for its pixel
+float camera_getCameraRay(void *data, uint64_t iterations) {
+	struct cameraBench *bench = data;
+	float sum = 0.0f;
+	for (uint64_t i = 0; i < iterations; ++i) {
+		const uint32_t pixel = (uint32_t)(i % (CAMERA_BENCH_WIDTH * CAMERA_BENCH_WIDTH));
+		initSampler(bench->sampler, Halton, 0, 1, pixel);
+		sum += getCameraRay(bench->cam, pixel % CAMERA_BENCH_WIDTH, pixel / CAMERA_BENCH_WIDTH, bench->sampler).direction.x;
+	}
+	return sum;
+}
+
+void camera_teardown(void *data) {
+	struct cameraBench *bench = data;
+	destroyCamera(bench->cam);
+	destroySampler(bench->sampler);
+	free(bench);
+}
@@ -0,0 +1,89 @@
+//
+//  bench_intersect.h
+//  C-ray
+//
+//  Created by Valtteri on 18.10.2020.
+//  Copyright © 2020 Valtteri Koskivuori. All rights reserved.
+//
+
+#include "../src/datatypes/poly.h"
+#include "../src/datatypes/sphere.h"
+#include "../src/datatypes/lightRay.h"
+#include "../src/accelerators/bvh.h"
+#include "../src/renderer/pathtrace.h"
+
+// Grab private functions
+unsigned intersectAllNodes(const struct bvh *bvh, const struct lightRay *ray, unsigned *hits);
+
+struct intersectData {
+	struct vector vertices[3 * BENCH_INPUT_COUNT];
+	struct poly polys[BENCH_INPUT_COUNT]; //For the BVH builder
+	struct triangle triangles[BENCH_INPUT_COUNT];
+	struct lightRay rays[BENCH_INPUT_COUNT];
+	struct sphere sphere;
+	struct bvh *bvh;
+};
+
+//Small random triangles in a unit cube, and rays aimed roughly at them so about half of them hit
+void *intersect_setup(void) {
+	struct intersectData *d = calloc(1, sizeof(*d));
+	uint32_t seed = 1234;
+	for (int i = 0; i < BENCH_INPUT_COUNT; ++i) {
+		struct vector center = vecWithPos(benchRandom(&seed), benchRandom(&seed), benchRandom(&seed));
+		for (int v = 0; v < 3; ++v) {
+			struct vector offset = vecWithPos(benchRandom(&seed) - 0.5f, benchRandom(&seed) - 0.5f, benchRandom(&seed) - 0.5f);
+			d->vertices[3 * i + v] = vecAdd(center, vecScale(offset, 0.1f));
+			d->polys[i].vertexIndex[v] = 3 * i + v;
+			d->triangles[i].index[v] = 3 * i + v;
+		}
+		d->polys[i].vertexCount = 3;
+		d->polys[i].hasNormals = false;
+		
+		struct vector start = vecWithPos(benchRandom(&seed) * 4.0f - 2.0f, benchRandom(&seed) * 4.0f - 2.0f, -2.0f);
+		struct vector jitter = vecScale(vecWithPos(benchRandom(&seed) - 0.5f, benchRandom(&seed) - 0.5f, 0.0f), 0.05f);
+		d->rays[i] = newRay(start, vecNormalize(vecSub(vecAdd(center, jitter), start)), rayTypeIncident);
+	}
+	d->sphere = defaultSphere();
+	d->sphere.radius = 1.0f;
+	d->bvh = buildBottomLevelBvh(d->vertices, d->polys, BENCH_INPUT_COUNT);
+	return d;
+}
+
+void intersect_teardown(void *data) {
+	struct intersectData *d = data;
+	destroyBvh(d->bvh);
+	free(d);
+}
+
+float intersect_polygon(void *data, uint64_t iterations) {
+	struct intersectData *d = data;
+	float sum = 0.0f;
+	for (uint64_t i = 0; i < iterations; ++i) {
+		struct hit hit = { .distance = FLT_MAX };
+		if (rayIntersectsWithPolygon(&d->rays[i % BENCH_INPUT_COUNT], d->vertices, &d->triangles[i % BENCH_INPUT_COUNT], &hit))
+			sum += hit.distance;
+	}
+	return sum;
+}
+
+float intersect_sphere(void *data, uint64_t iterations) {
+	struct intersectData *d = data;
+	float sum = 0.0f;
+	for (uint64_t i = 0; i < iterations; ++i) {
+		struct hit hit = { .distance = FLT_MAX };
+		if (rayIntersectsWithSphere(&d->rays[i % BENCH_INPUT_COUNT], &d->sphere, &hit))
+			sum += hit.distance;
+	}
+	return sum;
+}
+
+//One operation is one ray-node slab test
+float intersect_bvhNode(void *data, uint64_t iterations) {
+	struct intersectData *d = data;
+	unsigned hits = 0;
+	uint64_t done = 0;
+	for (uint64_t i = 0; done < iterations; ++i) {
+		done += intersectAllNodes(d->bvh, &d->rays[i % BENCH_INPUT_COUNT], &hits);
+	}
+	return (float)hits;
+}
@@ -0,0 +1,75 @@
+//
+//  bench_sampler.h
+//  C-ray
+//
+//  Created by Valtteri on 18.10.2020.
+//  Copyright © 2020 Valtteri Koskivuori. All rights reserved.
+//
+
+#include "../src/renderer/samplers/sampler.h"
+#include "../src/renderer/samplers/radicalinverse.h"
+
+//One operation is one getDimension(). Samplers are re-initialized every 16 dimensions, like a short path would.
+static float sampleDimensions(enum samplerType type, uint64_t iterations) {
+	sampler *s = newSampler();
+	float sum = 0.0f;
+	for (uint64_t i = 0; i < iterations; ++i) {
+		if (!(i & 15)) initSampler(s, type, (int)((i >> 4) & 255), 256, (uint32_t)(i >> 12));
+		sum += getDimension(s);
+	}
+	destroySampler(s);
+	return sum;
+}
+
+//Same, but every pixel in a 64x64 tile draws from the same pass, like renderTilePass() does
+static float sampleTilePass(enum samplerType type, uint64_t iterations) {
+	sampler *s = newSampler();
+	float sum = 0.0f;
+	for (uint64_t i = 0; i < iterations; ++i) {
+		if (!(i & 15)) initSampler(s, type, (int)((i >> 16) & 255), 256, (uint32_t)((i >> 4) & 4095));
+		sum += getDimension(s);
+	}
+	destroySampler(s);
+	return sum;
+}
+
+float sampler_halton(void *data, uint64_t iterations) {
+	(void)data;
+	return sampleDimensions(Halton, iterations);
+}
+
+float sampler_haltonTilePass(void *data, uint64_t iterations) {
+	(void)data;
+	return sampleTilePass(Halton, iterations);
+}
+
+float sampler_hammersley(void *data, uint64_t iterations) {
+	(void)data;
+	return sampleDimensions(Hammersley, iterations);
+}
+
+float sampler_random(void *data, uint64_t iterations) {
+	(void)data;
+	return sampleDimensions(Random, iterations);
+}
+
+float sampler_sobol(void *data, uint64_t iterations) {
+	(void)data;
+	return sampleDimensions(Sobol, iterations);
+}
+
+float sampler_sobolTilePass(void *data, uint64_t iterations) {
+	(void)data;
+	return sampleTilePass(Sobol, iterations);
+}
+
+//One operation is one radicalInverse() in each of the six bases Halton uses
+float sampler_radicalInverse(void *data, uint64_t iterations) {
+	(void)data;
+	const int bases[] = {2, 3, 5, 7, 11, 13};
+	float sum = 0.0f;
+	for (uint64_t i = 0; i < iterations; ++i) {
+		for (int b = 0; b < 6; ++b) sum += radicalInverse((int)(i & 0xffff), bases[b]);
+	}
+	return sum;
+}
@@ -0,0 +1,174 @@
+//
+//  bench_texture.h
+//  C-ray
+//
+//  Created by Valtteri on 18.10.2020.
+//  Copyright © 2020 Valtteri Koskivuori. All rights reserved.
+//
+
+#include "../src/datatypes/image/texture.h"
+#include "../src/datatypes/image/mipmap.h"
+#include "../src/datatypes/color.h"
+#include "../src/renderer/envmap.h"
+
+struct textureData {
+	struct envMap *envMap;
+	struct envMap *envMapHalf;
+	struct envMap *envMapBlock;
+	struct texture *ldr;
+	struct mipmap *mipmap;
+	float footprints[BENCH_INPUT_COUNT];
+	struct coord uvs[BENCH_INPUT_COUNT];
+	struct lightRay rays[BENCH_INPUT_COUNT];
+};
+
+//A 1k HDR, like the bundled ones, and an 8-bit texture of the same size
+void *texture_setup(void) {
+	struct textureData *d = calloc(1, sizeof(*d));
+	uint32_t seed = 4321;
+	struct texture *hdr = newTexture(float_p, 1024, 512, 3);
+	d->ldr = newTexture(char_p, 1024, 512, 3);
+	for (unsigned y = 0; y < 512; ++y) {
+		for (unsigned x = 0; x < 1024; ++x) {
+			struct color c = colorWithValues(benchRandom(&seed), benchRandom(&seed), benchRandom(&seed), 1.0f);
+			setPixel(hdr, c, x, y);
+			setPixel(d->ldr, c, x, y);
+		}
+	}
+	d->envMapHalf = newEnvMap(convertTexture(hdr, half_p));
+	d->envMapBlock = newEnvMap(convertTexture(hdr, block_p));
+	d->envMap = newEnvMap(hdr);
+	d->mipmap = newMipmap(d->ldr, sRGB);
+	for (int i = 0; i < BENCH_INPUT_COUNT; ++i) {
+		d->uvs[i] = (struct coord){benchRandom(&seed) * 1023.0f + 0.5f, benchRandom(&seed) * 511.0f + 0.5f};
+		struct vector dir = vecWithPos(benchRandom(&seed) - 0.5f, benchRandom(&seed) - 0.5f, benchRandom(&seed) - 0.5f);
+		d->rays[i] = newRay(vecZero(), vecNormalize(dir), rayTypeIncident);
+		//Mostly magnified, with some minified lookups a few levels up
+		d->footprints[i] = benchRandom(&seed) < 0.75f ? 0.0f : benchRandom(&seed) * 0.02f;
+	}
+	return d;
+}
+
+void texture_teardown(void *data) {
+	struct textureData *d = data;
+	destroyEnvMap(d->envMap);
+	destroyEnvMap(d->envMapHalf);
+	destroyEnvMap(d->envMapBlock);
+	destroyTexture(d->ldr);
+	destroyMipmap(d->mipmap);
+	free(d);
+}
+
+float texture_getPixelFiltered(void *data, uint64_t iterations) {
+	struct textureData *d = data;
+	float sum = 0.0f;
+	for (uint64_t i = 0; i < iterations; ++i) {
+		struct coord uv = d->uvs[i % BENCH_INPUT_COUNT];
+		sum += textureGetPixelFiltered(d->ldr, uv.x, uv.y).red;
+	}
+	return sum;
+}
+
+float texture_mipmapSample(void *data, uint64_t iterations) {
+	struct textureData *d = data;
+	float sum = 0.0f;
+	for (uint64_t i = 0; i < iterations; ++i) {
+		struct coord uv = d->uvs[i % BENCH_INPUT_COUNT];
+		uv = (struct coord){uv.x / 1024.0f, uv.y / 512.0f};
+		sum += mipmapSample(d->mipmap, uv, d->footprints[i % BENCH_INPUT_COUNT]).red;
+	}
+	return sum;
+}
+
+//Scanlines across the texture at 1/16 scale, like a distant textured surface
+#define MINIFIED_STEP (16.0f / 1024.0f)
+
+float texture_minifiedFiltered(void *data, uint64_t iterations) {
+	struct textureData *d = data;
+	float sum = 0.0f;
+	for (uint64_t i = 0; i < iterations; ++i) {
+		const float u = (i % 64) * MINIFIED_STEP;
+		const float v = ((i / 64) % 32) * MINIFIED_STEP * 2.0f;
+		sum += textureGetPixelFiltered(d->ldr, u * 1024.0f, v * 512.0f).red;
+	}
+	return sum;
+}
+
+float texture_minifiedMipmap(void *data, uint64_t iterations) {
+	struct textureData *d = data;
+	float sum = 0.0f;
+	for (uint64_t i = 0; i < iterations; ++i) {
+		const float u = (i % 64) * MINIFIED_STEP;
+		const float v = ((i / 64) % 32) * MINIFIED_STEP * 2.0f;
+		sum += mipmapSample(d->mipmap, (struct coord){u, v}, MINIFIED_STEP).red;
+	}
+	return sum;
+}
+
+float texture_getEnvMap(void *data, uint64_t iterations) {
+	struct textureData *d = data;
+	float sum = 0.0f;
+	for (uint64_t i = 0; i < iterations; ++i) {
+		sum += getEnvMap(&d->rays[i % BENCH_INPUT_COUNT], d->envMap).red;
+	}
+	return sum;
+}
+
+float texture_getEnvMapHalf(void *data, uint64_t iterations) {
+	struct textureData *d = data;
+	float sum = 0.0f;
+	for (uint64_t i = 0; i < iterations; ++i) {
+		sum += getEnvMap(&d->rays[i % BENCH_INPUT_COUNT], d->envMapHalf).red;
+	}
+	return sum;
+}
+
+float texture_getEnvMapBlock(void *data, uint64_t iterations) {
+	struct textureData *d = data;
+	float sum = 0.0f;
+	for (uint64_t i = 0; i < iterations; ++i) {
+		sum += getEnvMap(&d->rays[i % BENCH_INPUT_COUNT], d->envMapBlock).red;
+	}
+	return sum;
+}
+
+//Inputs step through [0,1] so both branches of the sRGB curve are hit
+float color_toSRGB(void *data, uint64_t iterations) {
+	(void)data;
+	float sum = 0.0f;
+	for (uint64_t i = 0; i < iterations; ++i) {
+		float v = (i % BENCH_INPUT_COUNT) * (1.0f / BENCH_INPUT_COUNT);
+		sum += toSRGB(colorWithValues(v, v * 0.5f, v * 0.25f, 1.0f)).green;
+	}
+	return sum;
+}
+
+float color_fromSRGB(void *data, uint64_t iterations) {
+	(void)data;
+	float sum = 0.0f;
+	for (uint64_t i = 0; i < iterations; ++i) {
+		float v = (i % BENCH_INPUT_COUNT) * (1.0f / BENCH_INPUT_COUNT);
+		sum += fromSRGB(colorWithValues(v, v * 0.5f, v * 0.25f, 1.0f)).green;
+	}
+	return sum;
+}
+
+float color_linearToSRGB8Table(void *data, uint64_t iterations) {
+	(void)data;
+	uint64_t sum = 0;
+	for (uint64_t i = 0; i < iterations; ++i) {
+		float v = (i % BENCH_INPUT_COUNT) * (1.0f / BENCH_INPUT_COUNT);
+		sum += linearToSRGB8(v) + linearToSRGB8(v * 0.5f) + linearToSRGB8(v * 0.25f);
+	}
+	return (float)sum;
+}
+
+float color_srgb8ToLinearTable(void *data, uint64_t iterations) {
+	(void)data;
+	float sum = 0.0f;
+	for (uint64_t i = 0; i < iterations; ++i) {
+		unsigned char v = (unsigned char)(i * 7);
+		sum += SRGB8ToLinear(v) + SRGB8ToLinear(v >> 1) + SRGB8ToLinear(v >> 2);
+	}
+	return sum;
+}
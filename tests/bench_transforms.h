@@ -0,0 +1,25 @@
+//
+//  bench_transforms.h
+//  C-ray
+//
+//  Created by Valtteri on 18.10.2020.
+//  Copyright © 2020 Valtteri Koskivuori. All rights reserved.
+//
+
+#include "../src/datatypes/transforms.h"
+
+float transforms_transformRay(void *data, uint64_t iterations) {
+	(void)data;
+	struct transform rotate = newTransformRotateY(0.7f);
+	struct transform translate = newTransformTranslate(1.0f, 2.0f, 3.0f);
+	struct matrix4x4 composite = multiplyMatrices(&translate.A, &rotate.A);
+	struct lightRay ray = newRay(vecWithPos(0.1f, 0.2f, 0.3f), vecNormalize(vecWithPos(1.0f, 1.0f, 1.0f)), rayTypeIncident);
+	float sum = 0.0f;
+	for (uint64_t i = 0; i < iterations; ++i) {
+		struct lightRay copy = ray;
+		copy.start.x = (float)(i % BENCH_INPUT_COUNT);
+		transformRay(&copy, &composite);
+		sum += copy.start.x + copy.direction.y;
+	}
+	return sum;
+}
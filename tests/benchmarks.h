@@ -0,0 +1,72 @@
+//
+//  benchmarks.h
+//  C-ray
+//
+//  Created by Valtteri on 18.10.2020.
+//  Copyright © 2020 Valtteri Koskivuori. All rights reserved.
+//
+
+#pragma once
+
+#include <stdint.h>
+
+// Kernel micro-benchmarks. Each one has an optional setup and teardown that aren't timed,
+// and a run function that performs the given amount of operations.
+// Run functions return a value derived from their results, so the compiler can't discard the work.
+
+#define BENCH_INPUT_COUNT 1024 //Inputs are cycled through, so branches aren't perfectly predictable
+
+//xorshift32, for generating repeatable inputs
+static inline float benchRandom(uint32_t *state) {
+	uint32_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return (x >> 8) * (1.0f / 16777216.0f);
+}
+
+#include "bench_camera.h"
+#include "bench_intersect.h"
+#include "bench_sampler.h"
+#include "bench_texture.h"
+#include "bench_transforms.h"
+
+typedef struct {
+	char *name;
+	void *(*setup)(void);
+	float (*run)(void *data, uint64_t iterations);
+	void (*teardown)(void *data);
+} benchmark;
+
+static benchmark benchmarks[] = {
+	{"intersect::polygon", intersect_setup, intersect_polygon, intersect_teardown},
+	{"intersect::sphere", intersect_setup, intersect_sphere, intersect_teardown},
+	{"intersect::bvhNode", intersect_setup, intersect_bvhNode, intersect_teardown},
+	
+	{"camera::getCameraRay", camera_setup, camera_getCameraRay, camera_teardown},
+	
+	{"sampler::halton", NULL, sampler_halton, NULL},
+	{"sampler::haltonTilePass", NULL, sampler_haltonTilePass, NULL},
+	{"sampler::hammersley", NULL, sampler_hammersley, NULL},
+	{"sampler::random", NULL, sampler_random, NULL},
+	{"sampler::sobol", NULL, sampler_sobol, NULL},
+	{"sampler::sobolTilePass", NULL, sampler_sobolTilePass, NULL},
+	{"sampler::radicalInverse", NULL, sampler_radicalInverse, NULL},
+	
+	{"texture::getPixelFiltered", texture_setup, texture_getPixelFiltered, texture_teardown},
+	{"texture::mipmapSample", texture_setup, texture_mipmapSample, texture_teardown},
+	{"texture::minifiedFiltered", texture_setup, texture_minifiedFiltered, texture_teardown},
+	{"texture::minifiedMipmap", texture_setup, texture_minifiedMipmap, texture_teardown},
+	{"texture::getEnvMap", texture_setup, texture_getEnvMap, texture_teardown},
+	{"texture::getEnvMapHalf", texture_setup, texture_getEnvMapHalf, texture_teardown},
+	{"texture::getEnvMapBlock", texture_setup, texture_getEnvMapBlock, texture_teardown},
+	{"color::toSRGB", NULL, color_toSRGB, NULL},
+	{"color::fromSRGB", NULL, color_fromSRGB, NULL},
+	{"color::linearToSRGB8", NULL, color_linearToSRGB8Table, NULL},
+	{"color::srgb8ToLinear", NULL, color_srgb8ToLinearTable, NULL},
+	
+	{"transforms::transformRay", NULL, transforms_transformRay, NULL},
+};
+
+#define benchmarkCount (sizeof(benchmarks) / sizeof(benchmark))
@@ -0,0 +1,62 @@
+//
+//  test_animation.h
+//  C-ray
+//
+//  Created by Valtteri on 18.10.2020.
+//  Copyright © 2020 Valtteri Koskivuori. All rights reserved.
+//
+
+#include "../src/datatypes/animation.h"
+
+bool animation_interpolate(void) {
+	bool pass = true;
+	
+	struct transformParams from = {transformTypeTranslate, 0.0f, 10.0f, -4.0f};
+	struct transformParams to = {transformTypeTranslate, 100.0f, 10.0f, 4.0f};
+	struct keyframe keys[] = {
+		{.frame = 10, .transforms = &to, .transformCount = 1},
+		{.frame = 0, .transforms = &from, .transformCount = 1},
+	};
+	struct track track = {.instanceIdx = -1, .keys = keys, .keyCount = 2};
+	sortKeys(&track);
+	test_assert(track.keys[0].frame == 0);
+	
+	struct transform mid = evaluateTrack(&track, 5);
+	test_assert(mid.A.mtx[0][3] == 50.0f);
+	test_assert(mid.A.mtx[1][3] == 10.0f);
+	test_assert(mid.A.mtx[2][3] == 0.0f);
+	test_assert(mid.Ainv.mtx[0][3] == -50.0f);
+	
+	//Outside of the keyed range holds the closest key
+	struct transform before = evaluateTrack(&track, -3);
+	test_assert(before.A.mtx[0][3] == 0.0f);
+	struct transform after = evaluateTrack(&track, 20);
+	test_assert(after.A.mtx[0][3] == 100.0f);
+	
+	return pass;
+}
+
+bool animation_hold(void) {
+	bool pass = true;
+	
+	//Keys with different transform lists can't be blended, so the earlier one is held
+	struct transformParams from = {transformTypeTranslate, 0.0f, 0.0f, 0.0f};
+	struct transformParams to[] = {
+		{transformTypeTranslate, 100.0f, 0.0f, 0.0f},
+		{transformTypeScale, 2.0f, 2.0f, 2.0f},
+	};
+	struct keyframe keys[] = {
+		{.frame = 0, .transforms = &from, .transformCount = 1},
+		{.frame = 10, .transforms = to, .transformCount = 2},
+	};
+	struct track track = {.instanceIdx = 0, .keys = keys, .keyCount = 2};
+	
+	struct transform held = evaluateTrack(&track, 9);
+	test_assert(held.A.mtx[0][3] == 0.0f);
+	test_assert(held.A.mtx[0][0] == 1.0f);
+	struct transform last = evaluateTrack(&track, 10);
+	test_assert(last.A.mtx[0][3] == 100.0f);
+	test_assert(last.A.mtx[0][0] == 2.0f);
+	
+	return pass;
+}
@@ -0,0 +1,74 @@
+//
+//  test_camera.h
+//  C-ray
+//
+//  Created by Valtteri on 18.10.2020.
+//  Copyright © 2020 Valtteri Koskivuori. All rights reserved.
+//
+
+#include "../src/datatypes/camera.h"
+#include "../src/renderer/samplers/sampler.h"
+
+//The precomputed basis rounds differently than transforming each ray
+static bool vecRoughlyEquals(struct vector a, struct vector b) {
+	return vecLength(vecSub(a, b)) < 0.00001f;
+}
+
+//Same as the one in camera.c
+static float referenceTriangleDistribution(float v) {
+	const float orig = v * 2.0f - 1.0f;
+	v = clamp(orig / sqrtf(fabsf(orig)), -1.0f, 1.0f);
+	return v - (orig >= 0.0f ? 1.0f : -1.0f);
+}
+
+//Camera ray generated in camera space and then transformed, like getCameraRay() used to
+static struct lightRay referenceCameraRay(const struct camera *cam, int x, int y, sampler *sampler) {
+	struct lightRay ray = {{0}};
+	const float jitterX = referenceTriangleDistribution(getDimension(sampler));
+	const float jitterY = referenceTriangleDistribution(getDimension(sampler));
+	struct vector pixX = vecScale(cam->right, cam->sensorSize.x / cam->width);
+	struct vector pixY = vecScale(cam->up, cam->sensorSize.y / cam->height);
+	ray.direction = vecNormalize(vecAdd(cam->forward, vecAdd(vecScale(pixX, x - cam->width * 0.5f + jitterX + 0.5f),
+															  vecScale(pixY, y - cam->height * 0.5f + jitterY + 0.5f))));
+	if (cam->aperture > 0.0f) {
+		struct vector focusPoint = alongRay(&ray, cam->focalDistance / vecDot(ray.direction, cam->forward));
+		struct coord lensPoint = coordScale(cam->aperture, randomCoordOnUnitDisc(sampler));
+		ray.start = vecAdd(ray.start, vecAdd(vecScale(cam->right, lensPoint.x), vecScale(cam->up, lensPoint.y)));
+		ray.direction = vecNormalize(vecSub(focusPoint, ray.start));
+	}
+	transformRay(&ray, &cam->composite.A);
+	return ray;
+}
+
+static bool compareCameraRays(struct camera *cam) {
+	bool pass = true;
+	sampler *s = newSampler();
+	for (int y = 0; y < cam->height; y += 7) {
+		for (int x = 0; x < cam->width; x += 5) {
+			initSampler(s, Halton, 3, 16, y * cam->width + x);
+			struct lightRay expected = referenceCameraRay(cam, x, y, s);
+			initSampler(s, Halton, 3, 16, y * cam->width + x);
+			struct lightRay ray = getCameraRay(cam, x, y, s);
+			test_assert(vecRoughlyEquals(ray.start, expected.start));
+			test_assert(vecRoughlyEquals(ray.direction, expected.direction));
+		}
+	}
+	destroySampler(s);
+	return pass;
+}
+
+bool camera_rays(void) {
+	struct transform composite = newTransformTranslate(1.0f, 2.0f, 3.0f);
+	struct camera *cam = newCamera(64, 32, 80.0f, 0.0f, 0.0f, composite);
+	bool pass = compareCameraRays(cam);
+	destroyCamera(cam);
+	return pass;
+}
+
+bool camera_depthOfField(void) {
+	struct transform composite = newTransformRotateY(toRadians(30.0f));
+	struct camera *cam = newCamera(64, 32, 80.0f, 2.0f, 1.4f, composite);
+	bool pass = compareCameraRays(cam);
+	destroyCamera(cam);
+	return pass;
+}
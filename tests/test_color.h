@@ -0,0 +1,54 @@
+//
+//  test_color.h
+//  C-ray
+//
+//  Created by Valtteri on 18.10.2020.
+//  Copyright © 2020 Valtteri Koskivuori. All rights reserved.
+//
+
+#include "../src/datatypes/color.h"
+#include "../src/datatypes/image/texture.h"
+
+//The decode table has to match the exact curve for every 8-bit value
+bool color_srgb8ToLinear(void) {
+	bool pass = true;
+	for (int i = 0; i < 256; ++i) {
+		test_assert(fabsf(SRGB8ToLinear((unsigned char)i) - SRGBToLinear(i / 255.0f)) < 0.000001f);
+	}
+	return pass;
+}
+
+//The encode table is within one level of rounding the exact curve, and almost always matches it
+bool color_linearToSRGB8(void) {
+	bool pass = true;
+	const int steps = 1 << 20;
+	int mismatches = 0;
+	for (int i = 0; i <= steps; ++i) {
+		//Squaring spends more of the steps near black, where the curve is steepest
+		const float x = ((float)i / steps) * ((float)i / steps);
+		const int expected = (int)(linearToSRGB(x) * 255.0f + 0.5f);
+		const int actual = linearToSRGB8(x);
+		test_assert(abs(actual - expected) <= 1);
+		if (actual != expected) mismatches++;
+	}
+	test_assert(mismatches < steps / 50);
+	test_assert(linearToSRGB8(0.0f) == 0);
+	test_assert(linearToSRGB8(1.0f) == 255);
+	test_assert(linearToSRGB8(-1.0f) == 0);
+	test_assert(linearToSRGB8(4.0f) == 255);
+	test_assert(linearToSRGB8(NAN) == 0);
+	return pass;
+}
+
+//Every 8-bit value survives a decode and encode round trip
+bool color_srgb8RoundTrip(void) {
+	bool pass = true;
+	for (int i = 0; i < 256; ++i) {
+		test_assert(linearToSRGB8(SRGB8ToLinear((unsigned char)i)) == i);
+	}
+	struct texture *t = newTexture(char_p, 1, 1, 3);
+	setPixelSRGB(t, fromSRGB((struct color){0.2f, 0.6f, 1.0f, 1.0f}), 0, 0);
+	test_assert(t->data.byte_p[0] == 51 && t->data.byte_p[1] == 153 && t->data.byte_p[2] == 255);
+	destroyTexture(t);
+	return pass;
+}
@@ -0,0 +1,148 @@
+//
+//  test_crmesh.h
+//  C-ray
+//
+//  Created by Valtteri on 18.10.2020.
+//  Copyright © 2020 Valtteri Koskivuori. All rights reserved.
+//
+
+#include <limits.h>
+#include <stddef.h>
+#include "../src/utils/loaders/crmesh.h"
+#include "../src/accelerators/bvh.h"
+
+//Uses the test mesh from test_objloader.h
+bool crmesh_roundTrip(void) {
+	bool pass = true;
+	
+	writeTestFile("objloader_test.obj", testObj);
+	writeTestFile("objloader_test.mtl", testMtl);
+	test_assert(convertMesh("objloader_test.obj", NULL) == 0);
+	
+	struct meshFile *obj = loadMeshFile("objloader_test.obj", 1);
+	struct meshFile *mesh = loadMeshFile("objloader_test.crmesh", 1);
+	test_assert(obj && mesh);
+	//Converted meshes are stored welded
+	if (obj) weldMeshFile(obj);
+	if (obj && mesh) {
+		test_assert(mesh->mapping && mesh->bvh);
+		test_assert(mesh->vertexCount == obj->vertexCount);
+		test_assert(mesh->normalCount == obj->normalCount);
+		test_assert(mesh->textureCount == obj->textureCount);
+		test_assert(mesh->polyCount == obj->polyCount);
+		test_assert(mesh->materialCount == obj->materialCount);
+		//Arrays are used straight from the file
+		test_assert((uintptr_t)mesh->vertices % 64 == 0);
+		if (mesh->vertexCount == obj->vertexCount) {
+			test_assert(!memcmp(mesh->vertices, obj->vertices, mesh->vertexCount * sizeof(*mesh->vertices)));
+		}
+		if (mesh->textureCount == obj->textureCount) {
+			test_assert(!memcmp(mesh->textureCoords, obj->textureCoords, mesh->textureCount * sizeof(*mesh->textureCoords)));
+		}
+		if (mesh->polyCount == obj->polyCount) {
+			for (size_t i = 0; i < mesh->polyCount; ++i) {
+				test_assert(samePoly(&mesh->polygons[i], &obj->polygons[i]));
+			}
+		}
+		if (mesh->materialCount == obj->materialCount) {
+			for (int i = 0; i < mesh->materialCount; ++i) {
+				test_assert(stringEquals(mesh->materials[i].name, obj->materials[i].name));
+				test_assert(mesh->materials[i].diffuse.blue == obj->materials[i].diffuse.blue);
+			}
+		}
+	}
+	if (obj) {
+		freeObjMaterials(obj);
+		destroyMeshFile(obj);
+	}
+	if (mesh) {
+		freeObjMaterials(mesh);
+		destroyMeshFile(mesh);
+	}
+	
+	remove("objloader_test.obj");
+	remove("objloader_test.mtl");
+	remove("objloader_test.crmesh");
+	
+	return pass;
+}
+
+// Same layout as struct bvhNode in bvh.c, so the tests can build damaged node arrays
+struct testBvhNode {
+	float bounds[6];
+	unsigned firstChildOrPrim;
+	unsigned primCount : 30;
+	bool isLeaf : 1;
+};
+
+static void setTestNode(struct testBvhNode *node, bool isLeaf, unsigned firstChildOrPrim, unsigned primCount) {
+	*node = (struct testBvhNode){ .bounds = { -1, 1, -1, 1, -1, 1 }, .firstChildOrPrim = firstChildOrPrim, .primCount = primCount, .isLeaf = isLeaf };
+}
+
+bool crmesh_invalidBvh(void) {
+	bool pass = true;
+	test_assert(sizeof(struct testBvhNode) == bvhNodeSize());
+	
+	// A root whose index into the primitives wraps around in 32 bits
+	writeTestFile("objloader_test.obj", testObj);
+	writeTestFile("objloader_test.mtl", testMtl);
+	test_assert(convertMesh("objloader_test.obj", NULL) == 0);
+	struct meshFile *mesh = loadMeshFile("objloader_test.crmesh", 1);
+	test_assert(mesh && mesh->bvh);
+	if (mesh && mesh->bvh) {
+		const void *nodes;
+		const int *primIndices;
+		getBvhArrays(mesh->bvh, &nodes, &primIndices);
+		const long rootOffset = (long)((const unsigned char *)nodes - mesh->mapping->data);
+		freeObjMaterials(mesh);
+		destroyMeshFile(mesh);
+		
+		FILE *file = fopen("objloader_test.crmesh", "r+b");
+		test_assert(file);
+		if (file) {
+			const unsigned wrapping = UINT_MAX;
+			fseek(file, rootOffset + offsetof(struct testBvhNode, firstChildOrPrim), SEEK_SET);
+			fwrite(&wrapping, sizeof(wrapping), 1, file);
+			fclose(file);
+		}
+		mesh = loadMeshFile("objloader_test.crmesh", 1);
+		test_assert(mesh && !mesh->bvh);
+	}
+	if (mesh) {
+		freeObjMaterials(mesh);
+		destroyMeshFile(mesh);
+	}
+	remove("objloader_test.obj");
+	remove("objloader_test.mtl");
+	remove("objloader_test.crmesh");
+	
+	// Node arrays that would loop forever or overflow the traversal stack
+	const unsigned maxNodes = 2 * 70 + 1;
+	struct testBvhNode *nodes = calloc(maxNodes, sizeof(*nodes));
+	const int primIndices[] = { 0 };
+	
+	setTestNode(&nodes[0], false, 1, 0);
+	setTestNode(&nodes[1], false, 0, 0);
+	setTestNode(&nodes[2], true, 0, 1);
+	test_assert(!bvhFromArrays(nodes, 3, primIndices, 1));
+	
+	setTestNode(&nodes[0], true, 0, 1);
+	setTestNode(&nodes[1], true, 0, 1);
+	test_assert(!bvhFromArrays(nodes, 3, primIndices, 1));
+	
+	// A chain of inner nodes, each with a leaf on one side
+	for (unsigned depth = 64; depth <= 65; ++depth) {
+		const unsigned nodeCount = 2 * depth + 1;
+		for (unsigned i = 0; i < depth; ++i) {
+			setTestNode(&nodes[2 * i], false, 2 * i + 1, 0);
+			setTestNode(&nodes[2 * i + 1], true, 0, 1);
+		}
+		setTestNode(&nodes[nodeCount - 1], true, 0, 1);
+		struct bvh *bvh = bvhFromArrays(nodes, nodeCount, primIndices, 1);
+		test_assert(depth == 64 ? bvh != NULL : bvh == NULL);
+		if (bvh) destroyBvh(bvh);
+	}
+	free(nodes);
+	
+	return pass;
+}
@@ -0,0 +1,87 @@
+//
+//  test_denoise.h
+//  C-ray
+//
+//  Created by Valtteri on 18.10.2020.
+//  Copyright © 2020 Valtteri Koskivuori. All rights reserved.
+//
+
+#include "../src/datatypes/color.h"
+#include "../src/datatypes/image/imagefile.h"
+#include "../src/renderer/denoise.h"
+#include "../src/renderer/renderer.h"
+#include "../src/datatypes/image/texture.h"
+
+static struct renderer *denoiseRenderer(struct color color, struct color albedo) {
+	struct renderer *r = calloc(1, sizeof(*r));
+	r->prefs = (struct prefs){.imageWidth = 20, .imageHeight = 12, .tileWidth = 8, .tileHeight = 8, .threadCount = 2, .denoise = true};
+	r->state.renderBuffer = newTexture(float_p, r->prefs.imageWidth, r->prefs.imageHeight, 3);
+	allocFeatureBuffers(r);
+	for (unsigned y = 0; y < r->prefs.imageHeight; ++y) {
+		for (unsigned x = 0; x < r->prefs.imageWidth; ++x) {
+			setPixel(r->state.renderBuffer, color, x, y);
+			setPixel(r->state.albedoBuffer, albedo, x, y);
+			setPixel(r->state.normalBuffer, (struct color){0.0f, 1.0f, 0.0f, 0.0f}, x, y);
+			setPixel(r->state.depthBuffer, (struct color){2.0f, 2.0f, 2.0f, 0.0f}, x, y);
+		}
+	}
+	return r;
+}
+
+static void destroyDenoiseRenderer(struct renderer *r) {
+	destroyTexture(r->state.renderBuffer);
+	destroyFeatureBuffers(r);
+	free(r);
+}
+
+static bool roughlyMatches(struct color a, struct color b) {
+	return fabsf(a.red - b.red) < 0.0001f && fabsf(a.green - b.green) < 0.0001f && fabsf(a.blue - b.blue) < 0.0001f;
+}
+
+bool denoise_flat(void) {
+	bool pass = true;
+	struct color color = {0.2f, 0.4f, 0.6f, 1.0f};
+	struct renderer *r = denoiseRenderer(color, (struct color){0.5f, 0.5f, 0.005f, 1.0f});
+	struct texture *result = denoise(r);
+	for (unsigned y = 0; y < result->height; ++y) {
+		for (unsigned x = 0; x < result->width; ++x) {
+			test_assert(roughlyMatches(textureGetPixel(result, x, y), color));
+		}
+	}
+	destroyTexture(result);
+	destroyDenoiseRenderer(r);
+	return pass;
+}
+
+bool denoise_firefly(void) {
+	bool pass = true;
+	struct color color = {0.5f, 0.5f, 0.5f, 1.0f};
+	struct renderer *r = denoiseRenderer(color, (struct color){0.8f, 0.8f, 0.8f, 1.0f});
+	setPixel(r->state.renderBuffer, (struct color){50.0f, 50.0f, 50.0f, 1.0f}, 10, 6);
+	struct texture *result = denoise(r);
+	test_assert(roughlyMatches(textureGetPixel(result, 10, 6), color));
+	test_assert(roughlyMatches(textureGetPixel(result, 11, 6), color));
+	destroyTexture(result);
+	destroyDenoiseRenderer(r);
+	return pass;
+}
+
+bool denoise_edge(void) {
+	bool pass = true;
+	//Two surfaces facing different ways, the filter must not blur across
+	struct color color = {0.5f, 0.5f, 0.5f, 1.0f};
+	struct color other = {0.1f, 0.1f, 0.1f, 1.0f};
+	struct renderer *r = denoiseRenderer(color, (struct color){0.8f, 0.8f, 0.8f, 1.0f});
+	for (unsigned y = 0; y < r->prefs.imageHeight; ++y) {
+		for (unsigned x = 10; x < r->prefs.imageWidth; ++x) {
+			setPixel(r->state.renderBuffer, other, x, y);
+			setPixel(r->state.normalBuffer, (struct color){1.0f, 0.0f, 0.0f, 0.0f}, x, y);
+		}
+	}
+	struct texture *result = denoise(r);
+	test_assert(fabsf(textureGetPixel(result, 9, 6).red - color.red) < 0.01f);
+	test_assert(fabsf(textureGetPixel(result, 10, 6).red - other.red) < 0.01f);
+	destroyTexture(result);
+	destroyDenoiseRenderer(r);
+	return pass;
+}
@@ -0,0 +1,71 @@
+//
+//  test_envmap.h
+//  C-ray
+//
+//  Created by Valtteri on 18.10.2020.
+//  Copyright © 2020 Valtteri Koskivuori. All rights reserved.
+//
+
+#include "../src/renderer/envmap.h"
+#include "../src/datatypes/image/texture.h"
+#include "../src/renderer/samplers/sampler.h"
+
+#define ENVMAP_TEST_SAMPLES 4096
+
+//Small map with a bright sun, and some dim light everywhere else
+static struct envMap *testEnvMap(void) {
+	struct texture *hdr = newTexture(float_p, 16, 8, 3);
+	for (unsigned y = 0; y < hdr->height; ++y) {
+		for (unsigned x = 0; x < hdr->width; ++x) {
+			float value = 0.1f + 0.05f * ((x * 7 + y * 3) % 5);
+			setPixel(hdr, (struct color){value, value, value, 1.0f}, x, y);
+		}
+	}
+	setPixel(hdr, (struct color){100.0f, 90.0f, 80.0f, 1.0f}, 5, 2);
+	struct envMap *map = newEnvMap(hdr);
+	map->offset = 0.3f;
+	return map;
+}
+
+//Sampled directions have to get the same pdf back from envMapPdf()
+bool envmap_pdf(void) {
+	bool pass = true;
+	struct envMap *map = testEnvMap();
+	sampler *s = newSampler();
+	
+	for (int i = 0; i < 256; ++i) {
+		initSampler(s, Halton, i, 256, 0);
+		struct vector direction;
+		float pdf;
+		sampleEnvMap(map, s, &direction, &pdf);
+		test_assert(pdf > 0.0f);
+		test_assert(fabsf(vecLength(direction) - 1.0f) < 0.0001f);
+		test_assert(fabsf(envMapPdf(map, direction) - pdf) < 0.001f * pdf);
+	}
+	
+	destroySampler(s);
+	destroyEnvMap(map);
+	return pass;
+}
+
+//Every direction can be sampled, so the average of 1/pdf is the area of the sphere
+bool envmap_solidAngle(void) {
+	bool pass = true;
+	struct envMap *map = testEnvMap();
+	sampler *s = newSampler();
+	
+	float estimate = 0.0f;
+	for (int i = 0; i < ENVMAP_TEST_SAMPLES; ++i) {
+		initSampler(s, Halton, i, ENVMAP_TEST_SAMPLES, 0);
+		struct vector direction;
+		float pdf;
+		sampleEnvMap(map, s, &direction, &pdf);
+		if (pdf > 0.0f) estimate += 1.0f / pdf;
+	}
+	estimate /= ENVMAP_TEST_SAMPLES;
+	test_assert(fabsf(estimate - 4.0f * PI) < 0.01f * 4.0f * PI);
+	
+	destroySampler(s);
+	destroyEnvMap(map);
+	return pass;
+}
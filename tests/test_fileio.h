@@ -55,3 +55,32 @@ bool fileio_getFilePath(void) {
 	
 	return pass;
 }
+
+bool fileio_mapFile(void) {
+	bool pass = true;
+	
+	const char *path = "fileio_mapFile.txt";
+	const char contents[] = "v 1.0 2.0 3.0\nf 1 2 3\n";
+	FILE *f = fopen(path, "wb");
+	fwrite(contents, 1, sizeof(contents) - 1, f);
+	fclose(f);
+	
+	struct fileMapping *file = mapFile(path);
+	test_assert(file);
+	if (file) {
+		test_assert(file->size == sizeof(contents) - 1);
+		test_assert(memcmp(file->data, contents, file->size) == 0);
+		unmapFile(file);
+	}
+	
+	//Empty files can't be mapped, but are still valid
+	f = fopen(path, "wb");
+	fclose(f);
+	file = mapFile(path);
+	test_assert(file && file->size == 0 && file->data == NULL);
+	unmapFile(file);
+	
+	remove(path);
+	
+	return pass;
+}
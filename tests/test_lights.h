@@ -0,0 +1,91 @@
+//
+//  test_lights.h
+//  C-ray
+//
+//  Created by Valtteri on 18.10.2020.
+//  Copyright © 2020 Valtteri Koskivuori. All rights reserved.
+//
+
+#include "../src/renderer/lights.h"
+#include "../src/renderer/samplers/sampler.h"
+
+#define LIGHT_TEST_SAMPLES 4096
+
+static struct lightList *testLightList(struct emitter *emitters, int count) {
+	struct lightList *lights = calloc(1, sizeof(*lights));
+	lights->emitters = calloc(count, sizeof(*lights->emitters));
+	lights->cdf = calloc(count, sizeof(*lights->cdf));
+	lights->count = count;
+	for (int i = 0; i < count; ++i) {
+		lights->emitters[i] = emitters[i];
+		lights->totalPower += emitters[i].area; //White emitters have a luminance of 1
+		lights->cdf[i] = lights->totalPower;
+	}
+	for (int i = 0; i < count; ++i) lights->cdf[i] /= lights->totalPower;
+	return lights;
+}
+
+static struct emitter testSphere(struct vector center, float radius) {
+	return (struct emitter){.type = emitterSphere, .v0 = center, .radius = radius, .area = 4.0f * PI * radius * radius, .emission = whiteColor};
+}
+
+//Solid angle of a triangle seen from the origin, from Van Oosterom & Strackee 1983
+static float triangleSolidAngle(struct vector a, struct vector b, struct vector c) {
+	const float la = vecLength(a), lb = vecLength(b), lc = vecLength(c);
+	const float numerator = fabsf(vecDot(a, vecCross(b, c)));
+	const float denominator = la * lb * lc + vecDot(a, b) * lc + vecDot(a, c) * lb + vecDot(b, c) * la;
+	return 2.0f * atan2f(numerator, denominator);
+}
+
+//Irradiance from a sphere overhead is pi * L * (r/d)^2
+bool lights_sphere(void) {
+	bool pass = true;
+	struct emitter sphere = testSphere((struct vector){0.0f, 0.0f, 4.0f}, 1.0f);
+	struct lightList *lights = testLightList(&sphere, 1);
+	sampler *s = newSampler();
+	
+	float estimate = 0.0f;
+	for (int i = 0; i < LIGHT_TEST_SAMPLES; ++i) {
+		initSampler(s, Halton, i, LIGHT_TEST_SAMPLES, 0);
+		struct lightSample sample;
+		test_assert(sampleLights(lights, vecZero(), s, &sample));
+		test_assert(fabsf(vecLength(sample.direction) - 1.0f) < 0.0001f);
+		//The sampled point has to lie on the sphere
+		struct vector point = vecScale(sample.direction, sample.distance);
+		test_assert(fabsf(vecLength(vecSub(point, sphere.v0)) - sphere.radius) < 0.001f);
+		estimate += (sample.direction.z / PI) / sample.pdf;
+	}
+	estimate /= LIGHT_TEST_SAMPLES;
+	test_assert(fabsf(estimate - 1.0f / 16.0f) < 0.0005f);
+	
+	destroySampler(s);
+	destroyLightList(lights);
+	return pass;
+}
+
+//The average of 1/pdf is the solid angle all emitters cover, which tests picking emitters too
+bool lights_solidAngle(void) {
+	bool pass = true;
+	struct vector a = {-1.0f, -1.0f, 3.0f}, b = {2.0f, -1.0f, 4.0f}, c = {0.0f, 2.0f, 3.0f};
+	struct emitter emitters[2];
+	emitters[0] = (struct emitter){.type = emitterTriangle, .v0 = a, .e1 = vecSub(b, a), .e2 = vecSub(c, a), .emission = whiteColor};
+	emitters[0].area = 0.5f * vecLength(vecCross(emitters[0].e1, emitters[0].e2));
+	emitters[1] = testSphere((struct vector){0.0f, -5.0f, 0.0f}, 2.0f);
+	struct lightList *lights = testLightList(emitters, 2);
+	sampler *s = newSampler();
+	
+	const float sphereAngle = 2.0f * PI * (1.0f - sqrtf(1.0f - 4.0f / 25.0f));
+	const float expected = triangleSolidAngle(a, b, c) + sphereAngle;
+	float estimate = 0.0f;
+	for (int i = 0; i < LIGHT_TEST_SAMPLES; ++i) {
+		initSampler(s, Halton, i, LIGHT_TEST_SAMPLES, 0);
+		struct lightSample sample;
+		if (sampleLights(lights, vecZero(), s, &sample)) estimate += 1.0f / sample.pdf;
+	}
+	estimate /= LIGHT_TEST_SAMPLES;
+	test_assert(fabsf(estimate - expected) < 0.01f * expected);
+	
+	destroySampler(s);
+	destroyLightList(lights);
+	return pass;
+}
@@ -0,0 +1,159 @@
+//
+//  test_mesh.h
+//  C-ray
+//
+//  Created by Valtteri on 18.10.2020.
+//  Copyright © 2020 Valtteri Koskivuori. All rights reserved.
+//
+
+#include "../src/datatypes/mesh.h"
+
+//Uses the test mesh from test_objloader.h
+bool mesh_weld(void) {
+	bool pass = true;
+	
+	writeTestFile("objloader_test.obj", testObj);
+	writeTestFile("objloader_test.mtl", testMtl);
+	
+	struct meshFile *obj = parseWavefront("objloader_test.obj", 1);
+	struct meshFile *welded = parseWavefront("objloader_test.obj", 1);
+	test_assert(obj && welded);
+	if (obj && welded) {
+		weldMeshFile(welded);
+		//Every corner still has the same attributes, through a single index
+		test_assert(welded->polyCount == obj->polyCount);
+		test_assert(welded->normalCount == welded->vertexCount);
+		test_assert(welded->textureCount == welded->vertexCount);
+		for (size_t i = 0; i < obj->polyCount; ++i) {
+			const struct poly *a = &obj->polygons[i];
+			const struct poly *b = &welded->polygons[i];
+			test_assert(a->hasNormals == b->hasNormals && a->materialIndex == b->materialIndex);
+			for (int c = 0; c < 3; ++c) {
+				const int v = b->vertexIndex[c];
+				test_assert(vecEquals(welded->vertices[v], obj->vertices[a->vertexIndex[c]]));
+				test_assert((a->normalIndex[c] == -1) == (b->normalIndex[c] == -1));
+				test_assert((a->textureIndex[c] == -1) == (b->textureIndex[c] == -1));
+				if (b->normalIndex[c] != -1) {
+					test_assert(b->normalIndex[c] == v);
+					test_assert(vecEquals(welded->normals[v], obj->normals[a->normalIndex[c]]));
+				}
+				if (b->textureIndex[c] != -1) {
+					test_assert(b->textureIndex[c] == v);
+					test_assert(welded->textureCoords[v].x == obj->textureCoords[a->textureIndex[c]].x);
+					test_assert(welded->textureCoords[v].y == obj->textureCoords[a->textureIndex[c]].y);
+				}
+			}
+		}
+		//Corners that share all their attributes share a vertex, the rest are split
+		test_assert(welded->vertexCount == 13);
+		
+		//Welded meshes are left alone
+		struct vector *vertices = welded->vertices;
+		weldMeshFile(welded);
+		test_assert(welded->vertices == vertices && welded->vertexCount == 13);
+	}
+	if (obj) {
+		freeObjMaterials(obj);
+		destroyMeshFile(obj);
+	}
+	if (welded) {
+		freeObjMaterials(welded);
+		destroyMeshFile(welded);
+	}
+	
+	remove("objloader_test.obj");
+	remove("objloader_test.mtl");
+	
+	return pass;
+}
+
+bool mesh_normalEncoding(void) {
+	bool pass = true;
+	
+	uint32_t packed[64];
+	struct vector normals[64];
+	struct mesh mesh = {.normals = packed};
+	uint32_t seed = 4321;
+	for (int i = 0; i < 64; ++i) {
+		//Axes and diagonals on both hemispheres are the edge cases of the octahedral mapping
+		if (i < 6) {
+			normals[i] = (struct vector){i / 2 == 0 ? 1.0f : 0.0f, i / 2 == 1 ? 1.0f : 0.0f, i / 2 == 2 ? 1.0f : 0.0f};
+			if (i % 2) normals[i] = vecNegate(normals[i]);
+		} else {
+			seed = seed * 1664525u + 1013904223u;
+			const float x = (seed >> 8) / (float)(1 << 24) - 0.5f;
+			seed = seed * 1664525u + 1013904223u;
+			const float y = (seed >> 8) / (float)(1 << 24) - 0.5f;
+			seed = seed * 1664525u + 1013904223u;
+			const float z = (seed >> 8) / (float)(1 << 24) - 0.5f;
+			normals[i] = i < 10 ? (struct vector){x, y, 0.0f} : (struct vector){x, y, z};
+		}
+		packed[i] = encodeNormal(vecScale(normals[i], 3.0f));
+	}
+	for (int i = 0; i < 64; ++i) {
+		const struct vector decoded = meshNormal(&mesh, i);
+		test_assert(fabsf(vecLength(decoded) - 1.0f) < 0.0001f);
+		test_assert(vecDot(decoded, vecNormalize(normals[i])) > 0.99999f);
+	}
+	
+	return pass;
+}
+
+bool mesh_textureCoordEncoding(void) {
+	bool pass = true;
+	
+	uint16_t packed[2 * 5];
+	const struct coord uvs[5] = {{-1.0f, 0.0f}, {3.0f, 0.5f}, {0.25f, 0.125f}, {1.0f / 3.0f, 0.3f}, {2.0f, 0.0f}};
+	struct mesh mesh = {
+		.textureCoords = packed,
+		.uvMin = {-1.0f, 0.0f},
+		.uvStep = {4.0f / UINT16_MAX, 0.5f / UINT16_MAX}
+	};
+	for (int i = 0; i < 5; ++i) encodeTextureCoord(&mesh, i, uvs[i]);
+	//The bounds are exact, everything else is within half a step
+	test_assert(meshTextureCoord(&mesh, 0).x == -1.0f && meshTextureCoord(&mesh, 1).y == 0.5f);
+	for (int i = 0; i < 5; ++i) {
+		const struct coord decoded = meshTextureCoord(&mesh, i);
+		test_assert(fabsf(decoded.x - uvs[i].x) <= 0.5001f * mesh.uvStep.x);
+		test_assert(fabsf(decoded.y - uvs[i].y) <= 0.5001f * mesh.uvStep.y);
+	}
+	
+	//Meshes without texture coordinates return zeroes
+	struct mesh untextured = {0};
+	test_assert(meshTextureCoord(&untextured, 3).x == 0.0f && meshTextureCoord(&untextured, 3).y == 0.0f);
+	
+	return pass;
+}
+
+//Texture coordinates spanning a large range lose too much precision when quantized, so they're kept as floats
+bool mesh_textureCoordRange(void) {
+	bool pass = true;
+	
+	const char *objects[] = {
+		"v 0 0 0\nv 1 0 0\nv 0 1 0\nvt 0 0\nvt 1.5 0.25\nvt 0.1 1\nf 1/1 2/2 3/3\n",
+		"v 0 0 0\nv 1 0 0\nv 0 1 0\nvt 0 0\nvt 1000.1 0.25\nvt 0.1 1\nf 1/1 2/2 3/3\n"
+	};
+	for (int o = 0; o < 2; ++o) {
+		writeTestFile("mesh_test.obj", objects[o]);
+		struct meshFile *file = parseWavefront("mesh_test.obj", 1);
+		test_assert(file);
+		if (!file) continue;
+		struct coord uvs[3];
+		memcpy(uvs, file->textureCoords, sizeof(uvs));
+		struct mesh mesh = {0};
+		compactMeshFile(file, &mesh);
+		test_assert(o == 0 ? mesh.textureCoords && !mesh.exactTextureCoords : !mesh.textureCoords && mesh.exactTextureCoords);
+		test_assert(mesh.uvStep.x <= MAX_UV_STEP && mesh.uvStep.y <= MAX_UV_STEP);
+		for (int i = 0; i < 3; ++i) {
+			const struct coord decoded = meshTextureCoord(&mesh, i);
+			test_assert(o == 0 ? fabsf(decoded.x - uvs[i].x) <= 0.5001f * mesh.uvStep.x : decoded.x == uvs[i].x);
+			test_assert(o == 0 ? fabsf(decoded.y - uvs[i].y) <= 0.5001f * mesh.uvStep.y : decoded.y == uvs[i].y);
+		}
+		destroyMesh(&mesh);
+		destroyMeshFile(file);
+	}
+	
+	remove("mesh_test.obj");
+	
+	return pass;
+}
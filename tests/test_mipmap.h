@@ -0,0 +1,81 @@
+//
+//  test_mipmap.h
+//  C-ray
+//
+//  Created by Valtteri on 18.10.2020.
+//  Copyright © 2020 Valtteri Koskivuori. All rights reserved.
+//
+
+#include "../src/datatypes/image/mipmap.h"
+#include "../src/datatypes/image/texture.h"
+#include "../src/datatypes/color.h"
+
+//Checkerboard of two colors, sized so some levels have odd dimensions
+static struct texture *testCheckerTexture(enum precision p, unsigned width, unsigned height) {
+	struct texture *t = newTexture(p, width, height, 3);
+	for (unsigned y = 0; y < height; ++y) {
+		for (unsigned x = 0; x < width; ++x) {
+			struct color c = (x + y) % 2 ? (struct color){0.8f, 0.2f, 0.0f, 1.0f} : (struct color){0.2f, 0.4f, 1.0f, 1.0f};
+			setPixel(t, c, x, y);
+		}
+	}
+	return t;
+}
+
+static bool colorsClose(struct color a, struct color b, float tolerance) {
+	return fabsf(a.red - b.red) <= tolerance && fabsf(a.green - b.green) <= tolerance && fabsf(a.blue - b.blue) <= tolerance && fabsf(a.alpha - b.alpha) <= tolerance;
+}
+
+bool mipmap_levels(void) {
+	bool pass = true;
+	struct texture *t = testCheckerTexture(char_p, 20, 12);
+	struct mipmap *m = newMipmap(t, linear);
+	test_assert(m->levelCount == 5);
+	const unsigned widths[] = {20, 10, 5, 2, 1};
+	const unsigned heights[] = {12, 6, 3, 1, 1};
+	for (int i = 0; i < 5 && i < m->levelCount; ++i) {
+		test_assert(m->levels[i].width == widths[i]);
+		test_assert(m->levels[i].height == heights[i]);
+	}
+	destroyMipmap(m);
+	destroyTexture(t);
+	return pass;
+}
+
+//The tiled full resolution level has to match the source texture, texel for texel
+bool mipmap_fullResolution(void) {
+	bool pass = true;
+	struct texture *t = testCheckerTexture(char_p, 37, 19);
+	setPixel(t, (struct color){0.1f, 0.5f, 0.9f, 1.0f}, 36, 0);
+	struct mipmap *m = newMipmap(t, sRGB);
+	for (unsigned y = 0; y < t->height; ++y) {
+		for (unsigned x = 0; x < t->width; ++x) {
+			test_assert(colorsClose(mipmapGetTexel(m, 0, x, y), textureGetPixel(t, x, y), 0.0001f));
+			//Texel centers with no footprint don't blend in the neighbours, and come out linear
+			struct coord uv = {(x + 0.5f) / t->width, (y + 0.5f) / t->height};
+			test_assert(colorsClose(mipmapSample(m, uv, 0.0f), fromSRGB(textureGetPixel(t, x, y)), 0.0001f));
+		}
+	}
+	//Lookups wrap around the edges
+	test_assert(colorsClose(mipmapGetTexel(m, 0, -1, 0), textureGetPixel(t, 36, 0), 0.0001f));
+	test_assert(colorsClose(mipmapGetTexel(m, 0, 37, 19), textureGetPixel(t, 0, 0), 0.0001f));
+	destroyMipmap(m);
+	destroyTexture(t);
+	return pass;
+}
+
+//sRGB textures are averaged in linear space, so a checkerboard doesn't get darker when minified
+bool mipmap_average(void) {
+	bool pass = true;
+	struct texture *t = testCheckerTexture(float_p, 16, 16);
+	const struct color expected = toSRGB(colorCoef(0.5f, addColors(fromSRGB((struct color){0.8f, 0.2f, 0.0f, 1.0f}), fromSRGB((struct color){0.2f, 0.4f, 1.0f, 1.0f}))));
+	struct mipmap *m = newMipmap(t, sRGB);
+	for (int level = 1; level < m->levelCount; ++level) {
+		test_assert(colorsClose(mipmapGetTexel(m, level, 0, 0), (struct color){expected.red, expected.green, expected.blue, 1.0f}, 0.0001f));
+	}
+	//A footprint covering the whole texture lands on the last level
+	test_assert(colorsClose(mipmapSample(m, (struct coord){0.3f, 0.7f}, 2.0f), fromSRGB(mipmapGetTexel(m, m->levelCount - 1, 0, 0)), 0.0001f));
+	destroyMipmap(m);
+	destroyTexture(t);
+	return pass;
+}
@@ -0,0 +1,78 @@
+//
+//  test_networking.h
+//  C-ray
+//
+//  Created by Valtteri on 18.10.2020.
+//  Copyright © 2020 Valtteri Koskivuori. All rights reserved.
+//
+
+#ifndef WINDOWS
+
+#include <sys/socket.h>
+#include <arpa/inet.h>
+
+// Grab private functions
+bool testReceiveMessage(int fd, uint32_t *type, uint32_t *length);
+bool testReceiveMessageTimeout(int fd, int timeoutSec);
+
+//Write a message header, and a payload of the given size if there is one
+static bool feedMessage(int fd, uint32_t type, uint32_t length, const char *payload) {
+	const uint32_t header[2] = {htonl(type), htonl(length)};
+	if (write(fd, header, sizeof(header)) != sizeof(header)) return false;
+	return !payload || write(fd, payload, length) == (ssize_t)length;
+}
+
+bool networking_messageLength(void) {
+	bool pass = true;
+	
+	int fds[2];
+	test_assert(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+	uint32_t type = 0, length = 0;
+	
+	//A scene message goes through
+	test_assert(feedMessage(fds[0], 2, 5, "hello"));
+	test_assert(testReceiveMessage(fds[1], &type, &length));
+	test_assert(type == 2 && length == 5);
+	
+	//A tile message is always 24 bytes
+	test_assert(feedMessage(fds[0], 4, 25, NULL));
+	test_assert(!testReceiveMessage(fds[1], &type, &length));
+	
+	close(fds[0]);
+	close(fds[1]);
+	
+	//Length + 1 wraps around if it's done in 32 bits. Rejected before the payload is read.
+	test_assert(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+	test_assert(feedMessage(fds[0], 5, UINT32_MAX, NULL));
+	test_assert(!testReceiveMessage(fds[1], &type, &length));
+	test_assert(feedMessage(fds[0], 1, (1u << 30) + 1, NULL));
+	test_assert(!testReceiveMessage(fds[1], &type, &length));
+	close(fds[0]);
+	close(fds[1]);
+	
+	return pass;
+}
+
+//A worker that keeps the connection open but stops sending is given up on
+bool networking_workerTimeout(void) {
+	bool pass = true;
+	
+	int fds[2];
+	test_assert(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+	test_assert(feedMessage(fds[0], 2, 5, "hello"));
+	test_assert(testReceiveMessageTimeout(fds[1], 1));
+	
+	//Stops halfway through a header
+	const uint32_t type = htonl(2);
+	test_assert(write(fds[0], &type, sizeof(type)) == sizeof(type));
+	struct timeval timer;
+	startTimer(&timer);
+	test_assert(!testReceiveMessageTimeout(fds[1], 1));
+	test_assert(getMs(timer) < 5000);
+	close(fds[0]);
+	close(fds[1]);
+	
+	return pass;
+}
+
+#endif
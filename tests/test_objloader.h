@@ -0,0 +1,188 @@
+//
+//  test_objloader.h
+//  C-ray
+//
+//  Created by Valtteri on 18.10.2020.
+//  Copyright © 2020 Valtteri Koskivuori. All rights reserved.
+//
+
+#include "../src/utils/loaders/objloader.h"
+#include "../src/utils/loaders/meshloader.h"
+#include "../src/datatypes/poly.h"
+#include "../src/datatypes/material.h"
+
+static void writeTestFile(const char *path, const char *contents) {
+	FILE *f = fopen(path, "wb");
+	fwrite(contents, 1, strlen(contents), f);
+	fclose(f);
+}
+
+static void freeObjMaterials(struct meshFile *file) {
+	for (int i = 0; i < file->materialCount; ++i) {
+		free(file->materials[i].name);
+		free(file->materials[i].textureFilePath);
+		free(file->materials[i].normalMapPath);
+		free(file->materials[i].specularMapPath);
+	}
+}
+
+static bool samePoly(const struct poly *a, const struct poly *b) {
+	if (a->vertexCount != b->vertexCount || a->materialIndex != b->materialIndex || a->hasNormals != b->hasNormals) return false;
+	for (int i = 0; i < a->vertexCount; ++i) {
+		if (a->vertexIndex[i] != b->vertexIndex[i]) return false;
+		if (a->normalIndex[i] != b->normalIndex[i]) return false;
+		if (a->textureIndex[i] != b->textureIndex[i]) return false;
+	}
+	return true;
+}
+
+static const char *testObj =
+	"# Test mesh\n"
+	"mtllib objloader_test.mtl\n"
+	"o quad\n"
+	"v 0.0 0.0 0.0\n"
+	"v 1.5e0 0.0 0.0\n"
+	"v  1.5 -2.25  0.0\n"
+	"v 0 -2.25 0\n"
+	"vt 0.0 0.0\n"
+	"vt 1.0 0.0\n"
+	"vt 1.0 1.0\n"
+	"vt 0.0 1.0 0.0\n"
+	"vn 0.0 0.0 1.0\n"
+	"usemtl red\n"
+	"s off\n"
+	"f 1/1/1 2/2/1 3/3/1 4/4/1\n"
+	"g triangles\n"
+	"usemtl blue\n"
+	"v 0.125 0.5 -1E-2\n"
+	"f -1 -2 -3\r\n"
+	"f 1//1 3//1 5//1\n"
+	"usemtl missing\n"
+	"f 2/2 3/3 5/1\n";
+
+static const char *testMtl =
+	"newmtl red\n"
+	"Kd 1.0 0.0 0.0\n"
+	"newmtl blue\n"
+	"Kd 0.0 0.0 1.0\n";
+
+bool objloader_parse(void) {
+	bool pass = true;
+	
+	writeTestFile("objloader_test.obj", testObj);
+	writeTestFile("objloader_test.mtl", testMtl);
+	
+	struct meshFile *file = parseWavefront("objloader_test.obj", 1);
+	test_assert(file);
+	if (file) {
+		test_assert(file->vertexCount == 5);
+		test_assert(file->normalCount == 1);
+		test_assert(file->textureCount == 4);
+		test_assert(file->materialCount == 2);
+		test_assert(file->vertices[1].x == 1.5f);
+		test_assert(file->vertices[2].y == -2.25f);
+		test_assert(file->vertices[4].x == 0.125f && file->vertices[4].z == -0.01f);
+		test_assert(file->textureCoords[2].x == 1.0f && file->textureCoords[2].y == 1.0f);
+		
+		//The quad is split into two triangles, and every face after it is a triangle
+		test_assert(file->polyCount == 5);
+		if (file->polyCount == 5) {
+			const struct poly *p = file->polygons;
+			test_assert(p[0].vertexIndex[0] == 0 && p[0].vertexIndex[1] == 1 && p[0].vertexIndex[2] == 2);
+			test_assert(p[1].vertexIndex[0] == 0 && p[1].vertexIndex[1] == 2 && p[1].vertexIndex[2] == 3);
+			test_assert(p[1].textureIndex[2] == 3 && p[1].normalIndex[2] == 0);
+			test_assert(p[0].hasNormals && p[0].materialIndex == 0);
+			//Relative indices
+			test_assert(p[2].vertexIndex[0] == 4 && p[2].vertexIndex[1] == 3 && p[2].vertexIndex[2] == 2);
+			test_assert(!p[2].hasNormals && p[2].textureIndex[0] == -1 && p[2].materialIndex == 1);
+			test_assert(p[3].hasNormals && p[3].textureIndex[1] == -1);
+			//Unknown materials fall back to the first one
+			test_assert(p[4].materialIndex == 0 && p[4].textureIndex[2] == 0);
+		}
+		test_assert(file->materialCount == 2 && file->materials[1].diffuse.blue == 1.0f);
+		freeObjMaterials(file);
+		destroyMeshFile(file);
+	}
+	
+	remove("objloader_test.obj");
+	remove("objloader_test.mtl");
+	
+	return pass;
+}
+
+//Chunk boundaries fall mid-line and between usemtl statements, which should not change the result
+bool objloader_threads(void) {
+	bool pass = true;
+	
+	writeTestFile("objloader_test.obj", testObj);
+	writeTestFile("objloader_test.mtl", testMtl);
+	
+	struct meshFile *single = parseWavefront("objloader_test.obj", 1);
+	test_assert(single);
+	for (int threads = 2; threads < 9 && single; ++threads) {
+		struct meshFile *file = parseWavefront("objloader_test.obj", threads);
+		test_assert(file);
+		if (!file) continue;
+		test_assert(file->vertexCount == single->vertexCount);
+		test_assert(file->textureCount == single->textureCount);
+		test_assert(file->polyCount == single->polyCount);
+		if (file->vertexCount == single->vertexCount) {
+			test_assert(!memcmp(file->vertices, single->vertices, file->vertexCount * sizeof(*file->vertices)));
+		}
+		if (file->polyCount == single->polyCount) {
+			for (size_t i = 0; i < file->polyCount; ++i) {
+				test_assert(samePoly(&file->polygons[i], &single->polygons[i]));
+			}
+		}
+		freeObjMaterials(file);
+		destroyMeshFile(file);
+	}
+	if (single) {
+		freeObjMaterials(single);
+		destroyMeshFile(single);
+	}
+	
+	remove("objloader_test.obj");
+	remove("objloader_test.mtl");
+	
+	return pass;
+}
+
+//Triangles with a missing or out of range position can't be rendered, so they're dropped
+bool objloader_invalidIndices(void) {
+	bool pass = true;
+	
+	writeTestFile("objloader_test.obj", "f 1 2 3\n");
+	struct meshFile *file = parseWavefront("objloader_test.obj", 1);
+	test_assert(file && file->polyCount == 0);
+	if (file) destroyMeshFile(file);
+	
+	writeTestFile("objloader_test.obj",
+		"v 0 0 0\n"
+		"v 1 0 0\n"
+		"v 0 1 0\n"
+		"f 1 2 9\n"
+		"f 1 2 3\n"
+		"f 1//1 2 3\n"
+		"f 1 -7 3 2\n"
+		"f 3 2 1\n");
+	for (int threads = 1; threads < 5; ++threads) {
+		file = parseWavefront("objloader_test.obj", threads);
+		test_assert(file);
+		if (!file) continue;
+		//The quad keeps the triangle that doesn't use the bad corner
+		test_assert(file->polyCount == 4);
+		if (file->polyCount == 4) {
+			const struct poly *p = file->polygons;
+			test_assert(p[0].vertexIndex[0] == 0 && p[0].vertexIndex[1] == 1 && p[0].vertexIndex[2] == 2);
+			test_assert(!p[1].hasNormals && p[1].normalIndex[0] == -1);
+			test_assert(p[2].vertexIndex[0] == 0 && p[2].vertexIndex[1] == 2 && p[2].vertexIndex[2] == 1);
+			test_assert(p[3].vertexIndex[0] == 2 && p[3].vertexIndex[2] == 0);
+		}
+		destroyMeshFile(file);
+	}
+	
+	remove("objloader_test.obj");
+	
+	return pass;
+}
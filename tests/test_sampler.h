@@ -0,0 +1,94 @@
+//
+//  test_sampler.h
+//  C-ray
+//
+//  Created by Valtteri on 18.10.2020.
+//  Copyright © 2020 Valtteri Koskivuori. All rights reserved.
+//
+
+#include "../src/renderer/samplers/sampler.h"
+#include "../src/renderer/samplers/radicalinverse.h"
+
+//Every 4x4 and 16x1 cell of the unit square has to get exactly one of the first 16 samples
+static bool isZeroTwoNet(float *u, float *v) {
+	bool pass = true;
+	int square[16] = {0};
+	int columns[16] = {0};
+	for (int i = 0; i < 16; ++i) {
+		square[(int)(u[i] * 4.0f) * 4 + (int)(v[i] * 4.0f)]++;
+		columns[(int)(u[i] * 16.0f)]++;
+	}
+	for (int i = 0; i < 16; ++i) {
+		test_assert(square[i] == 1);
+		test_assert(columns[i] == 1);
+	}
+	return pass;
+}
+
+//The first two dimensions, and the padded ones after the first four, are scrambled (0,2)-sequences
+bool sampler_sobolStratified(void) {
+	bool pass = true;
+	sampler *s = newSampler();
+	for (uint32_t pixel = 0; pixel < 8; ++pixel) {
+		float dims[4][16];
+		for (int i = 0; i < 16; ++i) {
+			initSampler(s, Sobol, i, 16, pixel);
+			dims[0][i] = getDimension(s);
+			dims[1][i] = getDimension(s);
+			getDimension(s);
+			getDimension(s);
+			dims[2][i] = getDimension(s);
+			dims[3][i] = getDimension(s);
+		}
+		test_assert(isZeroTwoNet(dims[0], dims[1]));
+		test_assert(isZeroTwoNet(dims[2], dims[3]));
+	}
+	destroySampler(s);
+	return pass;
+}
+
+//Pixels and dimension groups are scrambled independently
+bool sampler_sobolDecorrelated(void) {
+	bool pass = true;
+	sampler *s = newSampler();
+	initSampler(s, Sobol, 3, 16, 0);
+	float first[8];
+	for (int d = 0; d < 8; ++d) first[d] = getDimension(s);
+	initSampler(s, Sobol, 3, 16, 1);
+	float other[8];
+	for (int d = 0; d < 8; ++d) other[d] = getDimension(s);
+	for (int d = 0; d < 8; ++d) {
+		test_assert(first[d] != other[d]);
+		test_assert(first[d] >= 0.0f && first[d] < 1.0f);
+	}
+	for (int d = 0; d < 4; ++d) {
+		test_assert(first[d] != first[d + 4]);
+	}
+	destroySampler(s);
+	return pass;
+}
+
+//Digit by digit reference, as radicalInverse() was before the lookup tables
+static float referenceRadicalInverse(int pass, int base) {
+	double result = 0.0;
+	double scale = 1.0 / base;
+	while (pass) {
+		result += (pass % base) * scale;
+		scale /= base;
+		pass /= base;
+	}
+	return (float)result;
+}
+
+bool sampler_radicalInverseTables(void) {
+	bool pass = true;
+	const int bases[] = {2, 3, 5, 7, 11, 13, 17};
+	for (int b = 0; b < 7; ++b) {
+		for (int i = 0; i < 70000; i += 7) {
+			test_assert(fabsf(radicalInverse(i, bases[b]) - referenceRadicalInverse(i, bases[b])) < 0.000001f);
+		}
+		test_assert(radicalInverse(0, bases[b]) == 0.0f);
+		test_assert(radicalInverse(INT32_MAX, bases[b]) < 1.0f);
+	}
+	return pass;
+}
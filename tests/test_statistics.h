@@ -0,0 +1,53 @@
+//
+//  test_statistics.h
+//  C-ray
+//
+//  Created by Valtteri on 18.10.2020.
+//  Copyright © 2020 Valtteri Koskivuori. All rights reserved.
+//
+
+#include "../src/utils/statistics.h"
+
+bool statistics_merge(void) {
+	bool pass = true;
+	
+	struct stats total = {0};
+	struct stats shards[4] = {{0}};
+	for (int i = 0; i < 4; ++i) {
+		stats_add(&shards[i], rays_traced, 100);
+		stats_add(&shards[i], paths, 10);
+		stats_add(&shards[i], path_lengths, 10 * (i + 1));
+		stats_add(&shards[i], background_hits, i);
+		merge_stats(&total, &shards[i]);
+	}
+	
+	test_assert(get_value(&total, rays_traced) == 400);
+	test_assert(get_value(&total, paths) == 40);
+	test_assert(get_value(&total, path_lengths) == 100);
+	test_assert(get_value(&total, avg_path_length) == 2);
+	test_assert(get_value(&total, background_hits) == 6);
+	test_assert(get_value(&total, rr_kills) == 0);
+	
+	return pass;
+}
+
+bool statistics_enabled(void) {
+	bool pass = true;
+	
+	struct stats s;
+	clear_stats(&s);
+	increment(&s, meshes, 1);
+	test_assert(get_value(&s, meshes) == 0);
+	
+	toggle_stats(&s);
+	test_assert(stats_enabled(&s));
+	increment(&s, meshes, 2);
+	test_assert(get_value(&s, meshes) == 2);
+	
+	//Render counters are always on
+	toggle_stats(&s);
+	stats_add(&s, bounces, 3);
+	test_assert(get_value(&s, bounces) == 3);
+	
+	return pass;
+}
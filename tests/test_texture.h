@@ -0,0 +1,113 @@
+//
+//  test_texture.h
+//  C-ray
+//
+//  Created by Valtteri on 18.10.2020.
+//  Copyright © 2020 Valtteri Koskivuori. All rights reserved.
+//
+
+#include "../src/datatypes/image/texture.h"
+#include "../src/datatypes/image/half.h"
+
+//Every finite half survives a decode and encode round trip
+bool texture_halfRoundTrip(void) {
+	bool pass = true;
+	for (uint32_t h = 0; h < 0x10000; ++h) {
+		if ((h & 0x7c00) == 0x7c00) continue; //Inf and NaN
+		test_assert(floatToHalf(halfToFloat((uint16_t)h)) == h);
+	}
+	test_assert(floatToHalf(1.0f) == 0x3c00);
+	test_assert(floatToHalf(-2.0f) == 0xc000);
+	test_assert(floatToHalf(HALF_MAX) == 0x7bff);
+	test_assert(floatToHalf(100000.0f) == 0x7c00);
+	test_assert(halfToFloat(0x0001) == 1.0f / 16777216.0f);
+	test_assert(isnan(halfToFloat(floatToHalf(NAN))));
+	return pass;
+}
+
+//Sky-like HDR gradient that changes hue along a diagonal, with an optional bright spot to stretch the range.
+//Blue falls where red rises, so a block fit along the wrong diagonal shows up.
+static struct texture *testHDR(unsigned width, unsigned height, float spotBrightness) {
+	struct texture *t = newTexture(float_p, width, height, 3);
+	for (unsigned y = 0; y < height; ++y) {
+		for (unsigned x = 0; x < width; ++x) {
+			const float s = x + 0.5f * y;
+			const float spot = spotBrightness * expf(-0.05f * ((x - 10.0f) * (x - 10.0f) + (y - 5.0f) * (y - 5.0f)));
+			setPixel(t, (struct color){0.5f + 0.02f * s + spot, 0.25f + 0.01f * s + spot, 2.0f - 0.04f * s + spot, 1.0f}, x, y);
+		}
+	}
+	return t;
+}
+
+static float relativeError(float expected, float actual) {
+	return fabsf(expected - actual) / max(fabsf(expected), 0.01f);
+}
+
+bool texture_halfPrecision(void) {
+	bool pass = true;
+	struct texture *hdr = testHDR(37, 21, 200.0f);
+	struct texture *half = convertTexture(hdr, half_p);
+	test_assert(textureBytes(half) * 2 == textureBytes(hdr));
+	for (unsigned y = 0; y < hdr->height; ++y) {
+		for (unsigned x = 0; x < hdr->width; ++x) {
+			const struct color expected = textureGetPixel(hdr, x, y);
+			const struct color actual = textureGetPixel(half, x, y);
+			test_assert(relativeError(expected.red, actual.red) < 0.0005f);
+			test_assert(relativeError(expected.green, actual.green) < 0.0005f);
+			test_assert(relativeError(expected.blue, actual.blue) < 0.0005f);
+			test_assert(actual.alpha == 1.0f);
+		}
+	}
+	destroyTexture(half);
+	destroyTexture(hdr);
+	return pass;
+}
+
+//Smooth blocks stay within a few percent, and the edges that don't fill a block are still covered
+bool texture_blockCompressed(void) {
+	bool pass = true;
+	struct texture *hdr = testHDR(37, 21, 0.0f);
+	struct texture *block = convertTexture(hdr, block_p);
+	test_assert(textureBytes(block) == 10 * 6 * 16);
+	float totalError = 0.0f;
+	for (unsigned y = 0; y < hdr->height; ++y) {
+		for (unsigned x = 0; x < hdr->width; ++x) {
+			const struct color expected = textureGetPixel(hdr, x, y);
+			const struct color actual = textureGetPixel(block, x, y);
+			//The shared exponent costs the dimmest channel a few bits
+			test_assert(relativeError(expected.red, actual.red) < 0.03f);
+			test_assert(relativeError(expected.green, actual.green) < 0.03f);
+			test_assert(relativeError(expected.blue, actual.blue) < 0.03f);
+			totalError += relativeError(expected.red, actual.red) + relativeError(expected.green, actual.green) + relativeError(expected.blue, actual.blue);
+		}
+	}
+	test_assert(totalError / (3 * hdr->width * hdr->height) < 0.005f);
+	destroyTexture(block);
+	destroyTexture(hdr);
+	
+	//Blocks with a bright spot in them trade the dark pixels for the bright ones,
+	//so the error is bounded by half a step between the block endpoints
+	hdr = testHDR(37, 21, 200.0f);
+	block = convertTexture(hdr, block_p);
+	for (unsigned y = 0; y < hdr->height; ++y) {
+		for (unsigned x = 0; x < hdr->width; ++x) {
+			const struct color expected = textureGetPixel(hdr, x, y);
+			const struct color actual = textureGetPixel(block, x, y);
+			test_assert(fabsf(expected.red - actual.red) < 202.0f / 25.0f);
+			test_assert(fabsf(expected.blue - actual.blue) < 202.0f / 25.0f);
+		}
+	}
+	destroyTexture(block);
+	destroyTexture(hdr);
+	
+	//A flat block only loses the 9-bit mantissas
+	struct texture *flat = newTexture(float_p, 4, 4, 3);
+	for (unsigned i = 0; i < 16; ++i) setPixel(flat, (struct color){1.5f, 0.25f, 8.0f, 1.0f}, i % 4, i / 4);
+	struct texture *flatBlock = convertTexture(flat, block_p);
+	const struct color c = textureGetPixel(flatBlock, 3, 3);
+	test_assert(c.red == 1.5f && c.green == 0.25f && c.blue == 8.0f);
+	
+	destroyTexture(flatBlock);
+	destroyTexture(flat);
+	return pass;
+}
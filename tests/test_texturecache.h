@@ -0,0 +1,153 @@
+//
+//  test_texturecache.h
+//  C-ray
+//
+//  Created by Valtteri on 18.10.2020.
+//  Copyright © 2020 Valtteri Koskivuori. All rights reserved.
+//
+
+#include "../src/datatypes/image/texturecache.h"
+#include "../src/datatypes/image/mipmap.h"
+#include "../src/datatypes/image/texture.h"
+#include "../src/utils/encoders/formats/bmp.h"
+#include "../src/utils/loaders/textureloader.h"
+#include "../src/utils/statistics.h"
+
+//Write a test pattern to disk for the cache to load
+static void writeTestBMP(const char *path, unsigned width, unsigned height) {
+	unsigned char *data = calloc(3 * width * height, sizeof(*data));
+	for (unsigned i = 0; i < width * height; ++i) {
+		data[3 * i + 0] = (unsigned char)(i * 7);
+		data[3 * i + 1] = (unsigned char)(i / width * 13);
+		data[3 * i + 2] = (unsigned char)(i % width * 29);
+	}
+	encodeBMPFromArray(path, data, width, height);
+	free(data);
+}
+
+//Levels loaded on demand have to match a mipmap built up front from the same file
+bool texturecache_lazyLoad(void) {
+	bool pass = true;
+	char path[] = "texturecache_test_lazy.bmp";
+	writeTestBMP(path, 37, 21);
+	struct texture *t = loadTexture(path);
+	struct mipmap *eager = newMipmap(t, sRGB);
+	struct textureCache *cache = newTextureCache(SIZE_MAX);
+	struct mipmap *lazy = textureCacheAdd(cache, path, sRGB);
+	test_assert(lazy);
+	if (!lazy) goto done;
+	test_assert(lazy->levelCount == eager->levelCount);
+	test_assert(textureCacheResidentBytes(cache) == 0);
+	
+	const int epoch = textureCacheEnter(cache);
+	for (int level = lazy->levelCount - 1; level >= 0; --level) {
+		for (unsigned y = 0; y < eager->levels[level].height; ++y) {
+			for (unsigned x = 0; x < eager->levels[level].width; ++x) {
+				struct color a = mipmapGetTexel(eager, level, x, y);
+				struct color b = mipmapGetTexel(lazy, level, x, y);
+				test_assert(a.red == b.red && a.green == b.green && a.blue == b.blue && a.alpha == b.alpha);
+			}
+		}
+	}
+	textureCacheLeave(cache, epoch);
+	test_assert(textureCacheResidentBytes(cache) > 0);
+	
+	struct stats stats = {0};
+	collectTextureCacheStats(cache, &stats);
+	//Coarsest level first, then each finer level decodes the file again
+	test_assert(get_value(&stats, texture_misses) == (uint64_t)lazy->levelCount);
+	test_assert(get_value(&stats, texture_evictions) == 0);
+	
+done:
+	destroyTextureCache(cache);
+	destroyMipmap(eager);
+	destroyTexture(t);
+	remove(path);
+	return pass;
+}
+
+//With room for one texture, loading another evicts the first one, which is loaded again when needed
+bool texturecache_eviction(void) {
+	bool pass = true;
+	char pathA[] = "texturecache_test_a.bmp";
+	char pathB[] = "texturecache_test_b.bmp";
+	writeTestBMP(pathA, 64, 64);
+	writeTestBMP(pathB, 64, 64);
+	struct texture *t = loadTexture(pathA);
+	struct mipmap *eager = newMipmap(t, linear);
+	size_t pyramidBytes = 0;
+	for (int level = 0; level < eager->levelCount; ++level) pyramidBytes += mipLevelBytes(eager, level);
+	
+	struct textureCache *cache = newTextureCache(pyramidBytes);
+	struct mipmap *a = textureCacheAdd(cache, pathA, linear);
+	struct mipmap *b = textureCacheAdd(cache, pathB, linear);
+	test_assert(a && b);
+	if (!a || !b) goto done;
+	
+	int epoch = textureCacheEnter(cache);
+	mipmapGetTexel(a, 0, 0, 0);
+	textureCacheLeave(cache, epoch);
+	test_assert(textureCacheResidentBytes(cache) == pyramidBytes);
+	
+	epoch = textureCacheEnter(cache);
+	mipmapGetTexel(b, 0, 0, 0);
+	textureCacheLeave(cache, epoch);
+	test_assert(textureCacheResidentBytes(cache) <= pyramidBytes);
+	test_assert(a->levels[0].data.byte_p == NULL);
+	test_assert(b->levels[0].data.byte_p != NULL);
+	
+	epoch = textureCacheEnter(cache);
+	for (unsigned y = 0; y < 64; ++y) {
+		for (unsigned x = 0; x < 64; ++x) {
+			struct color expected = mipmapGetTexel(eager, 0, x, y);
+			struct color reloaded = mipmapGetTexel(a, 0, x, y);
+			test_assert(expected.red == reloaded.red && expected.green == reloaded.green && expected.blue == reloaded.blue);
+		}
+	}
+	textureCacheLeave(cache, epoch);
+	
+	struct stats stats = {0};
+	collectTextureCacheStats(cache, &stats);
+	test_assert(get_value(&stats, texture_misses) == 3);
+	test_assert(get_value(&stats, texture_evictions) > 0);
+	test_assert(get_value(&stats, texture_hits) == 64 * 64 - 1);
+	
+done:
+	destroyTextureCache(cache);
+	destroyMipmap(eager);
+	destroyTexture(t);
+	remove(pathA);
+	remove(pathB);
+	return pass;
+}
+
+//Different paths to the same file share one mipmap, until the last reference is dropped
+bool texturecache_sharing(void) {
+	bool pass = true;
+	char path[] = "texturecache_test_shared.bmp";
+	writeTestBMP(path, 16, 16);
+	struct textureCache *cache = newTextureCache(SIZE_MAX);
+	struct mipmap *a = textureCacheAdd(cache, path, sRGB);
+	struct mipmap *b = textureCacheAdd(cache, "./texturecache_test_shared.bmp", sRGB);
+	struct mipmap *c = textureCacheAdd(cache, path, linear);
+	test_assert(a && a == b);
+	test_assert(c && c != a);
+	
+	int epoch = textureCacheEnter(cache);
+	mipmapGetTexel(a, 0, 0, 0);
+	mipmapGetTexel(b, 0, 0, 0);
+	textureCacheLeave(cache, epoch);
+	struct stats stats = {0};
+	collectTextureCacheStats(cache, &stats);
+	test_assert(get_value(&stats, texture_misses) == 1);
+	const size_t shared = textureCacheResidentBytes(cache);
+	
+	textureCacheRelease(a);
+	test_assert(textureCacheResidentBytes(cache) == shared);
+	textureCacheRelease(b);
+	test_assert(textureCacheResidentBytes(cache) == 0);
+	
+	destroyTextureCache(cache);
+	remove(path);
+	return pass;
+}
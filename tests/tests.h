@@ -20,6 +20,21 @@ static char *failed_expression;
 #include "test_fileio.h"
 #include "test_string.h"
 #include "test_hashtable.h"
+#include "test_statistics.h"
+#include "test_animation.h"
+#include "test_camera.h"
+#include "test_denoise.h"
+#include "test_lights.h"
+#include "test_envmap.h"
+#include "test_sampler.h"
+#include "test_color.h"
+#include "test_texture.h"
+#include "test_mipmap.h"
+#include "test_texturecache.h"
+#include "test_objloader.h"
+#include "test_crmesh.h"
+#include "test_mesh.h"
+#include "test_networking.h"
 
 typedef struct {
 	char *testName;
@@ -60,6 +75,7 @@ static test tests[] = {
 	{"fileio::humanFileSize", fileio_humanFileSize},
 	{"fileio::getFileName", fileio_getFileName},
 	{"fileio::getFilePath", fileio_getFilePath},
+	{"fileio::mapFile", fileio_mapFile},
 	
 	{"string::stringEquals", string_stringEquals},
 	{"string::stringContains", string_stringContains},
@@ -69,6 +85,58 @@ static test tests[] = {
 	
 	{"hashtable::mixed", hashtable_mixed},
 	{"hashtable::fill", hashtable_fill},
+	
+	{"statistics::merge", statistics_merge},
+	{"statistics::enabled", statistics_enabled},
+	
+	{"animation::interpolate", animation_interpolate},
+	{"animation::hold", animation_hold},
+	
+	{"camera::rays", camera_rays},
+	{"camera::depthOfField", camera_depthOfField},
+	
+	{"denoise::flat", denoise_flat},
+	{"denoise::firefly", denoise_firefly},
+	{"denoise::edge", denoise_edge},
+	
+	{"lights::sphere", lights_sphere},
+	{"lights::solidAngle", lights_solidAngle},
+	
+	{"envmap::pdf", envmap_pdf},
+	{"envmap::solidAngle", envmap_solidAngle},
+	
+	{"sampler::sobolStratified", sampler_sobolStratified},
+	{"sampler::sobolDecorrelated", sampler_sobolDecorrelated},
+	{"sampler::radicalInverseTables", sampler_radicalInverseTables},
+	
+	{"color::srgb8ToLinear", color_srgb8ToLinear},
+	{"color::linearToSRGB8", color_linearToSRGB8},
+	{"color::srgb8RoundTrip", color_srgb8RoundTrip},
+	
+	{"texture::halfRoundTrip", texture_halfRoundTrip},
+	{"texture::halfPrecision", texture_halfPrecision},
+	{"texture::blockCompressed", texture_blockCompressed},
+	
+	{"mipmap::levels", mipmap_levels},
+	{"mipmap::fullResolution", mipmap_fullResolution},
+	{"mipmap::average", mipmap_average},
+	{"texturecache::lazyLoad", texturecache_lazyLoad},
+	{"texturecache::eviction", texturecache_eviction},
+	{"texturecache::sharing", texturecache_sharing},
+	
+	{"objloader::parse", objloader_parse},
+	{"objloader::threads", objloader_threads},
+	{"objloader::invalidIndices", objloader_invalidIndices},
+	{"crmesh::roundTrip", crmesh_roundTrip},
+	{"crmesh::invalidBvh", crmesh_invalidBvh},
+	{"mesh::weld", mesh_weld},
+	{"mesh::normalEncoding", mesh_normalEncoding},
+	{"mesh::textureCoordEncoding", mesh_textureCoordEncoding},
+	{"mesh::textureCoordRange", mesh_textureCoordRange},
+#ifndef WINDOWS
+	{"networking::messageLength", networking_messageLength},
+	{"networking::workerTimeout", networking_workerTimeout},
+#endif
 };
 
 #define testCount (sizeof(tests) / sizeof(test))